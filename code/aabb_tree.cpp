@@ -0,0 +1,386 @@
+#include "aabb_tree.h"
+
+// Deep enough for a balanced tree of far more leaves than fit in memory
+static const int kStackSize = 64;
+
+bool AabbOverlaps( const Aabb& a, const Aabb& b )
+{
+  return a.min.x <= b.max.x && b.min.x <= a.max.x
+    && a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+bool AabbContains( const Aabb& outer, const Aabb& inner )
+{
+  return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y
+    && inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+}
+
+Aabb AabbUnion( const Aabb& a, const Aabb& b )
+{
+  Aabb result;
+  result.min.x = a.min.x < b.min.x ? a.min.x : b.min.x;
+  result.min.y = a.min.y < b.min.y ? a.min.y : b.min.y;
+  result.max.x = a.max.x > b.max.x ? a.max.x : b.max.x;
+  result.max.y = a.max.y > b.max.y ? a.max.y : b.max.y;
+  return result;
+}
+
+float AabbPerimeter( const Aabb& aabb )
+{
+  return ( aabb.max.x - aabb.min.x ) + ( aabb.max.y - aabb.min.y );
+}
+
+static Aabb AabbGrow( const Aabb& aabb, float amount )
+{
+  Aabb result;
+  result.min = aabb.min - Vector2( amount, amount );
+  result.max = aabb.max + Vector2( amount, amount );
+  return result;
+}
+
+static int MaxHeight( int a, int b )
+{
+  return a > b ? a : b;
+}
+
+AabbTree::AabbTree( float margin )
+{
+  mMargin = margin;
+  mRoot = -1;
+  mFirstFree = -1;
+  mLeafCount = 0;
+}
+
+int AabbTree::AllocateNode()
+{
+  int node;
+  if( mFirstFree != -1 )
+  {
+    node = mFirstFree;
+    mFirstFree = mNodes[ node ].parent;
+  }
+  else
+  {
+    node = ( int )mNodes.size();
+    mNodes.push_back( Node() );
+  }
+  Node& result = mNodes[ node ];
+  result.parent = -1;
+  result.child1 = -1;
+  result.child2 = -1;
+  result.height = 0;
+  return node;
+}
+
+void AabbTree::FreeNode( int node )
+{
+  mNodes[ node ].parent = mFirstFree;
+  mNodes[ node ].height = -1;
+  mFirstFree = node;
+}
+
+AabbHandle AabbTree::Insert( const Aabb& aabb )
+{
+  int leaf = AllocateNode();
+  mNodes[ leaf ].aabb = AabbGrow( aabb, mMargin );
+  InsertLeaf( leaf );
+  ++mLeafCount;
+  return leaf;
+}
+
+void AabbTree::Remove( AabbHandle handle )
+{
+  Assert( mNodes[ handle ].height == 0 );
+  RemoveLeaf( handle );
+  FreeNode( handle );
+  --mLeafCount;
+}
+
+bool AabbTree::Move( AabbHandle handle, const Aabb& aabb, Vector2 displacement )
+{
+  Node& leaf = mNodes[ handle ];
+  Assert( leaf.height == 0 );
+
+  // Stretch toward where it's going, so it stays inside for a few frames
+  Aabb fat = AabbGrow( aabb, mMargin );
+  Vector2 ahead = displacement * 2.0f;
+  if( ahead.x < 0 )
+    fat.min.x += ahead.x;
+  else
+    fat.max.x += ahead.x;
+  if( ahead.y < 0 )
+    fat.min.y += ahead.y;
+  else
+    fat.max.y += ahead.y;
+
+  if( AabbContains( leaf.aabb, aabb ) )
+  {
+    // Still inside, but shrink it back down if it got much bigger than it
+    // needs to be, e.g. after a fast move followed by stopping
+    Aabb huge = AabbGrow( fat, 4 * mMargin );
+    if( AabbContains( huge, leaf.aabb ) )
+      return false;
+  }
+
+  RemoveLeaf( handle );
+  mNodes[ handle ].aabb = fat;
+  InsertLeaf( handle );
+  return true;
+}
+
+const Aabb& AabbTree::GetFatAabb( AabbHandle handle ) const
+{
+  return mNodes[ handle ].aabb;
+}
+
+int AabbTree::GetHeight() const
+{
+  return mRoot == -1 ? 0 : mNodes[ mRoot ].height;
+}
+
+int AabbTree::GetLeafCount() const
+{
+  return mLeafCount;
+}
+
+void AabbTree::InsertLeaf( int leaf )
+{
+  if( mRoot == -1 )
+  {
+    mRoot = leaf;
+    mNodes[ leaf ].parent = -1;
+    return;
+  }
+
+  // Walk down to the sibling that costs the least perimeter overall. Every
+  // node on the way has to grow to hold the leaf, which is the inherited cost
+  Aabb leafAabb = mNodes[ leaf ].aabb;
+  int index = mRoot;
+  while( mNodes[ index ].child1 != -1 )
+  {
+    const Node& node = mNodes[ index ];
+    float perimeter = AabbPerimeter( node.aabb );
+    float combinedPerimeter = AabbPerimeter( AabbUnion( node.aabb, leafAabb ) );
+
+    // Making a new parent for this node and the leaf
+    float cost = 2 * combinedPerimeter;
+    float inheritedCost = 2 * ( combinedPerimeter - perimeter );
+
+    // Pushing the leaf further down one of the children
+    float childCosts[ 2 ];
+    int children[ 2 ] = { node.child1, node.child2 };
+    for( int i = 0; i < 2; ++i )
+    {
+      const Node& child = mNodes[ children[ i ] ];
+      float grown = AabbPerimeter( AabbUnion( child.aabb, leafAabb ) );
+      if( child.child1 != -1 )
+        grown -= AabbPerimeter( child.aabb );
+      childCosts[ i ] = grown + inheritedCost;
+    }
+
+    if( cost < childCosts[ 0 ] && cost < childCosts[ 1 ] )
+      break;
+    index = childCosts[ 0 ] < childCosts[ 1 ] ? children[ 0 ] : children[ 1 ];
+  }
+  int sibling = index;
+
+  // AllocateNode() can move mNodes, so no references across it
+  int oldParent = mNodes[ sibling ].parent;
+  int newParent = AllocateNode();
+  mNodes[ newParent ].parent = oldParent;
+  mNodes[ newParent ].aabb = AabbUnion( leafAabb, mNodes[ sibling ].aabb );
+  mNodes[ newParent ].height = mNodes[ sibling ].height + 1;
+  mNodes[ newParent ].child1 = sibling;
+  mNodes[ newParent ].child2 = leaf;
+  mNodes[ sibling ].parent = newParent;
+  mNodes[ leaf ].parent = newParent;
+  if( oldParent == -1 )
+    mRoot = newParent;
+  else if( mNodes[ oldParent ].child1 == sibling )
+    mNodes[ oldParent ].child1 = newParent;
+  else
+    mNodes[ oldParent ].child2 = newParent;
+
+  Refit( oldParent );
+}
+
+void AabbTree::RemoveLeaf( int leaf )
+{
+  if( leaf == mRoot )
+  {
+    mRoot = -1;
+    return;
+  }
+
+  int parent = mNodes[ leaf ].parent;
+  int grandParent = mNodes[ parent ].parent;
+  int sibling = mNodes[ parent ].child1 == leaf
+    ? mNodes[ parent ].child2
+    : mNodes[ parent ].child1;
+
+  // The sibling takes the parent's place
+  mNodes[ sibling ].parent = grandParent;
+  FreeNode( parent );
+  if( grandParent == -1 )
+  {
+    mRoot = sibling;
+    return;
+  }
+  if( mNodes[ grandParent ].child1 == parent )
+    mNodes[ grandParent ].child1 = sibling;
+  else
+    mNodes[ grandParent ].child2 = sibling;
+  Refit( grandParent );
+}
+
+void AabbTree::Refit( int index )
+{
+  while( index != -1 )
+  {
+    index = Balance( index );
+    Node& node = mNodes[ index ];
+    const Node& child1 = mNodes[ node.child1 ];
+    const Node& child2 = mNodes[ node.child2 ];
+    node.aabb = AabbUnion( child1.aabb, child2.aabb );
+    node.height = 1 + MaxHeight( child1.height, child2.height );
+    index = node.parent;
+  }
+}
+
+int AabbTree::Balance( int indexA )
+{
+  // A has children B and C. If C is more than one taller than B, C takes A's
+  // place with A as its first child. A keeps B, and gets whichever of C's
+  // children is shorter. The mirror image when B is the taller one
+  Node& a = mNodes[ indexA ];
+  if( a.child1 == -1 || a.height < 2 )
+    return indexA;
+
+  int indexB = a.child1;
+  int indexC = a.child2;
+  int balance = mNodes[ indexC ].height - mNodes[ indexB ].height;
+  if( balance >= -1 && balance <= 1 )
+    return indexA;
+
+  // up is the taller child, which replaces A. stay is the other one
+  bool isRight = balance > 1;
+  int indexUp = isRight ? indexC : indexB;
+  int indexStay = isRight ? indexB : indexC;
+  Node& up = mNodes[ indexUp ];
+  const Node& stay = mNodes[ indexStay ];
+  int indexF = up.child1;
+  int indexG = up.child2;
+  Node& f = mNodes[ indexF ];
+  Node& g = mNodes[ indexG ];
+
+  up.child1 = indexA;
+  up.parent = a.parent;
+  a.parent = indexUp;
+  if( up.parent == -1 )
+    mRoot = indexUp;
+  else if( mNodes[ up.parent ].child1 == indexA )
+    mNodes[ up.parent ].child1 = indexUp;
+  else
+    mNodes[ up.parent ].child2 = indexUp;
+
+  // The taller grandchild stays with up, the shorter one moves under A into
+  // the slot up used to have
+  int indexTaller = f.height > g.height ? indexF : indexG;
+  int indexShorter = f.height > g.height ? indexG : indexF;
+  Node& taller = mNodes[ indexTaller ];
+  Node& shorter = mNodes[ indexShorter ];
+  up.child2 = indexTaller;
+  if( isRight )
+    a.child2 = indexShorter;
+  else
+    a.child1 = indexShorter;
+  shorter.parent = indexA;
+
+  a.aabb = AabbUnion( stay.aabb, shorter.aabb );
+  a.height = 1 + MaxHeight( stay.height, shorter.height );
+  up.aabb = AabbUnion( a.aabb, taller.aabb );
+  up.height = 1 + MaxHeight( a.height, taller.height );
+  return indexUp;
+}
+
+void AabbTree::QueryAabb( const Aabb& aabb, std::vector< AabbHandle >* results ) const
+{
+  results->clear();
+  if( mRoot == -1 )
+    return;
+  int stack[ kStackSize ];
+  int stackCount = 0;
+  stack[ stackCount++ ] = mRoot;
+  while( stackCount )
+  {
+    const Node& node = mNodes[ stack[ --stackCount ] ];
+    if( !AabbOverlaps( node.aabb, aabb ) )
+      continue;
+    if( node.child1 == -1 )
+    {
+      results->push_back( ( AabbHandle )( &node - mNodes.data() ) );
+      continue;
+    }
+    Assert( stackCount + 2 <= kStackSize );
+    stack[ stackCount++ ] = node.child1;
+    stack[ stackCount++ ] = node.child2;
+  }
+}
+
+void AabbTree::QueryPoint( Vector2 point, std::vector< AabbHandle >* results ) const
+{
+  Aabb aabb;
+  aabb.min = point;
+  aabb.max = point;
+  QueryAabb( aabb, results );
+}
+
+void AabbTree::Raycast( Vector2 from, Vector2 to, RaycastCallback callback, void* userData ) const
+{
+  if( mRoot == -1 )
+    return;
+
+  // In 2d a segment misses a box if their aabbs don't overlap, or if the box
+  // is all on one side of the line
+  Vector2 direction = to - from;
+  Vector2 normal( -direction.y, direction.x );
+  Vector2 absNormal( std::abs( normal.x ), std::abs( normal.y ) );
+
+  float maxFraction = 1;
+  Aabb segment = AabbUnion( Aabb{ from, from }, Aabb{ to, to } );
+
+  int stack[ kStackSize ];
+  int stackCount = 0;
+  stack[ stackCount++ ] = mRoot;
+  while( stackCount )
+  {
+    int index = stack[ --stackCount ];
+    const Node& node = mNodes[ index ];
+    if( !AabbOverlaps( node.aabb, segment ) )
+      continue;
+
+    Vector2 center = ( node.aabb.min + node.aabb.max ) * 0.5f;
+    Vector2 extents = ( node.aabb.max - node.aabb.min ) * 0.5f;
+    float separation = std::abs( Dot( normal, from - center ) ) - Dot( absNormal, extents );
+    if( separation > 0 )
+      continue;
+
+    if( node.child1 == -1 )
+    {
+      float value = callback( userData, index, from, to, maxFraction );
+      if( value == 0 )
+        return;
+      if( value < maxFraction )
+      {
+        // Only closer hits matter now, so shorten the segment
+        maxFraction = value;
+        Vector2 end = from + direction * maxFraction;
+        segment = AabbUnion( Aabb{ from, from }, Aabb{ end, end } );
+      }
+      continue;
+    }
+    Assert( stackCount + 2 <= kStackSize );
+    stack[ stackCount++ ] = node.child1;
+    stack[ stackCount++ ] = node.child2;
+  }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "utility.h"
+
+struct Aabb
+{
+  Vector2 min;
+  Vector2 max;
+};
+
+bool AabbOverlaps( const Aabb& a, const Aabb& b );
+bool AabbContains( const Aabb& outer, const Aabb& inner );
+Aabb AabbUnion( const Aabb& a, const Aabb& b );
+// Half the surface area, which is what the tree tries to keep small
+float AabbPerimeter( const Aabb& aabb );
+
+typedef int AabbHandle;
+
+// What to do with the rest of a raycast after it reached a leaf:
+// return 0 to stop, maxFraction to keep going, or a smaller fraction of
+// from -> to to only look for hits closer than that
+typedef float( *RaycastCallback )( void* userData, AabbHandle handle, Vector2 from, Vector2 to, float maxFraction );
+
+// Bounding volume hierarchy for objects of any size, updated as they move.
+//
+// Leaves store a fat aabb, grown by a margin and by where the object is
+// heading, so an object that moves a little doesn't touch the tree at all.
+// Inserts pick the sibling that grows the tree the least, and rotations on
+// the way back up keep it balanced.
+//
+// Nodes live in one array and point at each other by index, two to a cache
+// line. Queries walk it with a fixed stack, so they never allocate
+struct AabbTree
+{
+  AabbTree( float margin = 0.1f );
+
+  AabbHandle Insert( const Aabb& aabb );
+  void Remove( AabbHandle handle );
+
+  // Returns true if the leaf had to be reinserted. displacement is how far
+  // the object moved this frame, the fat aabb is stretched that way
+  bool Move( AabbHandle handle, const Aabb& aabb, Vector2 displacement );
+
+  // Fat aabb of a leaf. Queries test against these, so refine with the real
+  // shape when it matters
+  const Aabb& GetFatAabb( AabbHandle handle ) const;
+
+  // Every leaf whose fat aabb overlaps. Clears results first
+  void QueryAabb( const Aabb& aabb, std::vector< AabbHandle >* results ) const;
+  void QueryPoint( Vector2 point, std::vector< AabbHandle >* results ) const;
+
+  // Calls back for every leaf the segment from -> to crosses, front to back
+  // isn't guaranteed
+  void Raycast( Vector2 from, Vector2 to, RaycastCallback callback, void* userData ) const;
+
+  int GetHeight() const;
+  int GetLeafCount() const;
+
+  struct Node
+  {
+    Aabb aabb;
+    // The free list goes through parent
+    int parent;
+    // -1 for leaves
+    int child1;
+    int child2;
+    // Leaves are 0, free nodes are -1
+    int height;
+  };
+
+  int AllocateNode();
+  void FreeNode( int node );
+  void InsertLeaf( int leaf );
+  void RemoveLeaf( int leaf );
+  // Rotates a grandchild up if one side is more than one taller, returns
+  // whichever node ends up where index was
+  int Balance( int index );
+  // Recomputes the aabbs and heights from index to the root
+  void Refit( int index );
+
+  float mMargin;
+  std::vector< Node > mNodes;
+  int mRoot;
+  int mFirstFree;
+  int mLeafCount;
+};
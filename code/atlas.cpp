@@ -0,0 +1,162 @@
+#include "atlas.h"
+#include "stb_image.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstring>
+
+static const char* spritePaths[] = {
+  "data/star.png",
+};
+static_assert(
+  ArraySize( spritePaths ) == ( int )Sprite::Count,
+  "Every Sprite needs a path" );
+
+const char* GetSpritePath( Sprite sprite )
+{
+  return spritePaths[ ( int )sprite ];
+}
+
+AtlasRegion& Atlas::GetRegion( Sprite sprite )
+{
+  return regions[ ( int )sprite ];
+}
+
+struct LoadedSprite
+{
+  Sprite sprite;
+  int width;
+  int height;
+  stbi_uc* pixels;
+};
+
+// Copies the sprite into the page, then smears its edge pixels outward
+// extrusion times
+static void Blit(
+  AtlasPage& page,
+  LoadedSprite& loaded,
+  int x,
+  int y,
+  int extrusion )
+{
+  for( int dy = -extrusion; dy < loaded.height + extrusion; ++dy )
+  {
+    int srcY = Clamp( dy, 0, loaded.height - 1 );
+    uint8_t* dst = &page.pixels[ 4 * ( ( y + dy ) * page.width + x - extrusion ) ];
+    for( int dx = -extrusion; dx < loaded.width + extrusion; ++dx )
+    {
+      int srcX = Clamp( dx, 0, loaded.width - 1 );
+      std::memcpy( dst, loaded.pixels + 4 * ( srcY * loaded.width + srcX ), 4 );
+      dst += 4;
+    }
+  }
+}
+
+static LoadedSprite LoadSprite( Sprite sprite )
+{
+  LoadedSprite loaded;
+  loaded.sprite = sprite;
+  const char* path = GetSpritePath( sprite );
+  TemporaryMemory memory( path );
+  int channels;
+  loaded.pixels = stbi_load_from_memory(
+    ( stbi_uc* )memory.mBytes,
+    memory.mByteCount,
+    &loaded.width,
+    &loaded.height,
+    &channels,
+    4 );
+  if( !loaded.pixels )
+    HandleErrorGracefully( va( "Failed to load %s", path ) );
+  return loaded;
+}
+
+void BakeAtlas( Atlas* atlas, AtlasBakeSettings settings )
+{
+  PROFILE_SCOPE( "BakeAtlas" );
+  atlas->pages.clear();
+
+  std::vector< LoadedSprite > loadeds;
+  for( int i = 0; i < ( int )Sprite::Count; ++i )
+    loadeds.push_back( LoadSprite( ( Sprite )i ) );
+
+  // Tallest first keeps the shelves tight
+  std::sort( loadeds.begin(), loadeds.end(),
+    []( const LoadedSprite& a, const LoadedSprite& b )
+  {
+    return a.height > b.height;
+  } );
+
+  int border = settings.extrusion;
+  int cursorX = 0;
+  int cursorY = 0;
+  int shelfHeight = 0;
+  for( LoadedSprite& loaded : loadeds )
+  {
+    // each cell only pads its right and bottom, the page edge pads the rest
+    int cellWidth = loaded.width + 2 * border + settings.padding;
+    int cellHeight = loaded.height + 2 * border + settings.padding;
+    if( cellWidth + settings.padding > settings.pageWidth
+      || cellHeight + settings.padding > settings.pageHeight )
+      HandleErrorGracefully( va( "%s is too big for a %ix%i atlas page",
+        GetSpritePath( loaded.sprite ),
+        settings.pageWidth,
+        settings.pageHeight ) );
+
+    if( cursorX + cellWidth > settings.pageWidth )
+    {
+      cursorX = 0;
+      cursorY += shelfHeight;
+      shelfHeight = 0;
+    }
+    if( atlas->pages.empty()
+      || cursorY + cellHeight + settings.padding > settings.pageHeight )
+    {
+      AtlasPage page;
+      page.width = settings.pageWidth;
+      page.height = settings.pageHeight;
+      page.pixels.resize( 4 * page.width * page.height, 0 );
+      atlas->pages.push_back( page );
+      cursorX = 0;
+      cursorY = 0;
+      shelfHeight = 0;
+    }
+
+    AtlasPage& page = atlas->pages.back();
+    AtlasRegion& region = atlas->GetRegion( loaded.sprite );
+    region.page = ( int )atlas->pages.size() - 1;
+    region.x = settings.padding + cursorX + border;
+    region.y = settings.padding + cursorY + border;
+    region.width = loaded.width;
+    region.height = loaded.height;
+    region.uvMin = Vector2(
+      ( float )region.x / ( float )page.width,
+      ( float )region.y / ( float )page.height );
+    region.uvMax = Vector2(
+      ( float )( region.x + region.width ) / ( float )page.width,
+      ( float )( region.y + region.height ) / ( float )page.height );
+    Blit( page, loaded, region.x, region.y, border );
+
+    cursorX += cellWidth;
+    shelfHeight = std::max( shelfHeight, cellHeight );
+    stbi_image_free( loaded.pixels );
+  }
+}
+
+void BakeAtlasPage( const Atlas& atlas, int page, AtlasBakeSettings settings, AtlasPage* baked )
+{
+  PROFILE_SCOPE( "BakeAtlasPage" );
+  baked->width = settings.pageWidth;
+  baked->height = settings.pageHeight;
+  baked->pixels.assign( 4 * baked->width * baked->height, 0 );
+  for( int i = 0; i < ( int )Sprite::Count; ++i )
+  {
+    const AtlasRegion& region = atlas.regions[ i ];
+    if( region.page != page )
+      continue;
+    LoadedSprite loaded = LoadSprite( ( Sprite )i );
+    if( loaded.width != region.width || loaded.height != region.height )
+      HandleErrorGracefully( va( "%s changed size since the atlas was baked", GetSpritePath( loaded.sprite ) ) );
+    Blit( *baked, loaded, region.x, region.y, settings.extrusion );
+    stbi_image_free( loaded.pixels );
+  }
+}
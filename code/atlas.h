@@ -0,0 +1,62 @@
+#pragma once
+#include "utility.h"
+
+// Every sprite that gets packed into the atlas.
+// Add a value here and a path in spritePaths[] ( atlas.cpp ) to add a sprite.
+enum class Sprite
+{
+  Star,
+
+  Count,
+};
+
+// Where a sprite ended up. uvMin/uvMax feed straight into
+// ConstantBufferData.uvMin / uvMax
+struct AtlasRegion
+{
+  int page;
+  int x;
+  int y;
+  int width;
+  int height;
+  Vector2 uvMin;
+  Vector2 uvMax;
+};
+
+// r8g8b8a8, tightly packed ( stride = 4 * width )
+struct AtlasPage
+{
+  int width;
+  int height;
+  std::vector< uint8_t > pixels;
+};
+
+struct Atlas
+{
+  std::vector< AtlasPage > pages;
+  AtlasRegion regions[ ( int )Sprite::Count ];
+  AtlasRegion& GetRegion( Sprite sprite );
+};
+
+struct AtlasBakeSettings
+{
+  int pageWidth = 1024;
+  int pageHeight = 1024;
+
+  // Transparent gap between neighbouring sprites
+  int padding = 1;
+
+  // Number of times the sprite's edge pixels are copied outward, so bilinear
+  // filtering ( and later, mips ) at the border of a region doesn't pull in
+  // the neighbour's texels
+  int extrusion = 1;
+};
+
+const char* GetSpritePath( Sprite sprite );
+
+// Loads every Sprite png and shelf packs them into as few pages as possible
+void BakeAtlas( Atlas* atlas, AtlasBakeSettings settings );
+
+// Bakes just one page of an atlas BakeAtlas() laid out, loading only the
+// sprites on it. settings must be the ones it was laid out with
+void BakeAtlasPage( const Atlas& atlas, int page, AtlasBakeSettings settings, AtlasPage* baked );
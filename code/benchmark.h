@@ -0,0 +1,133 @@
+#pragma once
+#include "utility.h"
+#include <chrono>
+
+// Headless benchmarks, see benchmark_main.cpp for how to build and run them.
+
+// Runs fn once to warm up, then keeps calling it for at least minSeconds.
+// Returns the average seconds per call
+template< typename Fn >
+double BenchmarkSecondsPerCall( Fn fn, double minSeconds = 0.25 )
+{
+  typedef std::chrono::high_resolution_clock Clock;
+  fn();
+  int callCount = 0;
+  Clock::time_point begin = Clock::now();
+  std::chrono::duration< double > elapsed;
+  do
+  {
+    fn();
+    ++callCount;
+    elapsed = Clock::now() - begin;
+  } while( elapsed.count() < minSeconds );
+  return elapsed.count() / callCount;
+}
+
+// Prints "name: 1.23 ms/call, 456.7 itemName/s", and records it for --json
+void BenchmarkPrint(
+  const char* name,
+  double secondsPerCall,
+  double itemsPerCall,
+  const char* itemName );
+
+// Prints "name ok" or "name FAILED". Any failure makes main() return 1
+void BenchmarkCheck( const char* name, bool isOk );
+
+// Nanoseconds per op over a set of timed repetitions
+struct BenchmarkStats
+{
+  double median;
+  double mean;
+  double stddev;
+  double min;
+  double max;
+  int repetitionCount;
+};
+
+BenchmarkStats BenchmarkComputeStats( std::vector< double >& nanosecondsPerOp );
+
+// Warms up for about a tenth of totalSeconds and sizes the repetitions from
+// that, then times repetitionCount repetitions of several fn() calls each.
+// fn does opsPerCall ops
+template< typename Fn >
+BenchmarkStats BenchmarkNanosecondsPerOp(
+  Fn fn,
+  double opsPerCall,
+  int repetitionCount = 15,
+  double totalSeconds = 0.3 )
+{
+  typedef std::chrono::high_resolution_clock Clock;
+  int warmupCallCount = 0;
+  Clock::time_point begin = Clock::now();
+  std::chrono::duration< double > elapsed;
+  do
+  {
+    fn();
+    ++warmupCallCount;
+    elapsed = Clock::now() - begin;
+  } while( elapsed.count() < totalSeconds * 0.1 );
+  double secondsPerCall = elapsed.count() / warmupCallCount;
+  int callsPerRepetition = ( int )( totalSeconds / repetitionCount / secondsPerCall ) + 1;
+
+  std::vector< double > nanosecondsPerOp( repetitionCount );
+  for( double& result : nanosecondsPerOp )
+  {
+    begin = Clock::now();
+    for( int i = 0; i < callsPerRepetition; ++i )
+      fn();
+    elapsed = Clock::now() - begin;
+    result = elapsed.count() * 1e9 / ( callsPerRepetition * opsPerCall );
+  }
+  return BenchmarkComputeStats( nanosecondsPerOp );
+}
+
+// Prints "name: 1.23 ns/op +- 0.4%, min 1.2 max 1.3", and records it for --json
+void BenchmarkReport( const char* name, BenchmarkStats stats );
+
+// Makes the compiler produce value, without it ending up anywhere
+template< typename T >
+void BenchmarkKeep( const T& value )
+{
+#if defined( _MSC_VER )
+  static volatile char sink;
+  sink = *( const volatile char* )&value;
+#else
+  asm volatile( "" : : "m"( value ) : "memory" );
+#endif
+}
+
+// Makes the compiler forget what it knows about value, so the math on it
+// can't be constant folded or hoisted out of the loop
+template< typename T >
+void BenchmarkOpaque( T& value )
+{
+#if defined( _MSC_VER )
+  BenchmarkKeep( value );
+#else
+  asm volatile( "" : "+m"( value ) : : "memory" );
+#endif
+}
+
+void BenchmarkMipmap();
+void BenchmarkBlockCompression();
+void BenchmarkShaderCache();
+void BenchmarkAffine2();
+void BenchmarkMatrix4();
+void BenchmarkGameUpdateMath();
+void BenchmarkVector2Stream();
+void BenchmarkFastTrig();
+void BenchmarkUtilityMath();
+void BenchmarkEntity();
+void BenchmarkJobSystem();
+void BenchmarkSpatialHash();
+void BenchmarkAabbTree();
+void BenchmarkTileMap();
+void BenchmarkParticles();
+void BenchmarkViewCulling();
+void BenchmarkSnapshot();
+void BenchmarkSaveFile();
+void BenchmarkProfiler();
+void BenchmarkPerfOverlay();
+void BenchmarkLogger();
+void BenchmarkPngDecode();
+void BenchmarkTextureManager();
@@ -0,0 +1,38 @@
+# Headless benchmarks, builds on linux without windows or d3d.
+# From the repo root:
+#   make -f code/benchmark.mk
+#   ./benchmark [filter] [--json results.json]
+# ARCH=-msse2 builds the sse fallbacks instead of the avx2 paths.
+
+CXX ?= g++
+ARCH ?= -mavx2
+CXXFLAGS ?= -O2 -std=c++14 -Wall -Wextra -Wno-unused-function
+
+SOURCES = \
+	$(wildcard code/benchmark*.cpp) \
+	code/utility.cpp \
+	code/mipmap.cpp \
+	code/block_compression.cpp \
+	code/shader_cache.cpp \
+	code/vector2_stream.cpp \
+	code/fast_trig.cpp \
+	code/entity.cpp \
+	code/job_system.cpp \
+	code/spatial_hash.cpp \
+	code/aabb_tree.cpp \
+	code/tile_map.cpp \
+	code/particles.cpp \
+	code/view_culling.cpp \
+	code/snapshot.cpp \
+	code/save_file.cpp \
+	code/profiler.cpp \
+	code/perf_overlay.cpp \
+	code/logger.cpp \
+	code/texture_manager.cpp
+
+benchmark: $(SOURCES) $(wildcard code/*.h) code/benchmark.mk
+	$(CXX) $(CXXFLAGS) $(ARCH) -pthread $(SOURCES) -o $@
+
+.PHONY: clean
+clean:
+	rm -f benchmark
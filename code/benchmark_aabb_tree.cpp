@@ -0,0 +1,278 @@
+#include "benchmark.h"
+#include "aabb_tree.h"
+#include <algorithm>
+#include <cstdio>
+
+static float RandomRange( uint32_t& state, float size )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 24 ) * size;
+}
+
+// Sizes from 0.2 to 20, spread evenly in log space like the mix of props,
+// characters and trigger volumes in a room
+static Aabb RandomAabb( uint32_t& state, float worldSize )
+{
+  Vector2 center( RandomRange( state, worldSize ), RandomRange( state, worldSize ) );
+  Vector2 halfSize(
+    0.1f * std::pow( 100.0f, RandomRange( state, 1 ) ),
+    0.1f * std::pow( 100.0f, RandomRange( state, 1 ) ) );
+  return Aabb{ center - halfSize, center + halfSize };
+}
+
+static bool SegmentHitsAabb( Vector2 from, Vector2 to, const Aabb& aabb )
+{
+  // Slab test, a different way than the tree does it
+  float enter = 0;
+  float exit = 1;
+  for( int axis = 0; axis < 2; ++axis )
+  {
+    float delta = to[ axis ] - from[ axis ];
+    if( delta == 0 )
+    {
+      if( from[ axis ] < aabb.min[ axis ] || from[ axis ] > aabb.max[ axis ] )
+        return false;
+      continue;
+    }
+    float t0 = ( aabb.min[ axis ] - from[ axis ] ) / delta;
+    float t1 = ( aabb.max[ axis ] - from[ axis ] ) / delta;
+    enter = std::max( enter, std::min( t0, t1 ) );
+    exit = std::min( exit, std::max( t0, t1 ) );
+  }
+  return enter <= exit;
+}
+
+static float CollectHit( void* userData, AabbHandle handle, Vector2 from, Vector2 to, float maxFraction )
+{
+  Unused( from );
+  Unused( to );
+  ( ( std::vector< AabbHandle >* )userData )->push_back( handle );
+  return maxFraction;
+}
+
+// Parent links, bounds and heights all agree, returns the node count
+static int ValidateNode( const AabbTree& tree, int index, int parent, bool* isOk )
+{
+  const AabbTree::Node& node = tree.mNodes[ index ];
+  *isOk &= node.parent == parent;
+  if( node.child1 == -1 )
+  {
+    *isOk &= node.height == 0;
+    return 1;
+  }
+  const AabbTree::Node& child1 = tree.mNodes[ node.child1 ];
+  const AabbTree::Node& child2 = tree.mNodes[ node.child2 ];
+  *isOk &= node.height == 1 + std::max( child1.height, child2.height );
+  *isOk &= AabbContains( node.aabb, child1.aabb ) && AabbContains( node.aabb, child2.aabb );
+  return 1 + ValidateNode( tree, node.child1, index, isOk ) + ValidateNode( tree, node.child2, index, isOk );
+}
+
+// Queries and raycasts against testing every fat aabb
+static bool CheckAabbTree()
+{
+  const int count = 3000;
+  float worldSize = 200;
+  uint32_t state = 11;
+  AabbTree tree;
+  std::vector< AabbHandle > handles;
+  std::vector< Aabb > aabbs;
+  for( int i = 0; i < count; ++i )
+  {
+    aabbs.push_back( RandomAabb( state, worldSize ) );
+    handles.push_back( tree.Insert( aabbs.back() ) );
+  }
+  // Small moves mostly stay inside the fat aabb, big ones reinsert
+  int reinsertCount = 0;
+  for( int i = 0; i < count; i += 2 )
+  {
+    float distance = i % 4 ? 0.01f : 5.0f;
+    Vector2 displacement( distance, -distance );
+    aabbs[ i ].min += displacement;
+    aabbs[ i ].max += displacement;
+    reinsertCount += tree.Move( handles[ i ], aabbs[ i ], displacement );
+  }
+  bool isOk = reinsertCount >= count / 4 && reinsertCount < count / 2;
+  for( int i = 1; i < count; i += 5 )
+  {
+    tree.Remove( handles[ i ] );
+    handles[ i ] = -1;
+  }
+  for( int i = 1; i < count; i += 5 )
+  {
+    aabbs[ i ] = RandomAabb( state, worldSize );
+    handles[ i ] = tree.Insert( aabbs[ i ] );
+  }
+
+  int leafCount = 0;
+  for( AabbHandle handle : handles )
+    leafCount += handle != -1;
+  isOk &= tree.GetLeafCount() == leafCount;
+  isOk &= ValidateNode( tree, tree.mRoot, -1, &isOk ) == 2 * leafCount - 1;
+  for( int i = 0; i < count; ++i )
+    isOk &= AabbContains( tree.GetFatAabb( handles[ i ] ), aabbs[ i ] );
+
+  std::vector< AabbHandle > results;
+  std::vector< AabbHandle > expected;
+  for( int query = 0; query < 200; ++query )
+  {
+    Aabb aabb = RandomAabb( state, worldSize );
+    expected.clear();
+    for( AabbHandle handle : handles )
+      if( AabbOverlaps( tree.GetFatAabb( handle ), aabb ) )
+        expected.push_back( handle );
+    std::sort( expected.begin(), expected.end() );
+    tree.QueryAabb( aabb, &results );
+    std::sort( results.begin(), results.end() );
+    isOk &= results == expected;
+
+    Vector2 from( RandomRange( state, worldSize ), RandomRange( state, worldSize ) );
+    Vector2 to( RandomRange( state, worldSize ), RandomRange( state, worldSize ) );
+    expected.clear();
+    for( AabbHandle handle : handles )
+      if( SegmentHitsAabb( from, to, tree.GetFatAabb( handle ) ) )
+        expected.push_back( handle );
+    std::sort( expected.begin(), expected.end() );
+    results.clear();
+    tree.Raycast( from, to, CollectHit, &results );
+    std::sort( results.begin(), results.end() );
+    isOk &= results == expected;
+  }
+
+  // Removing everything leaves an empty tree
+  for( AabbHandle handle : handles )
+    tree.Remove( handle );
+  isOk &= tree.GetLeafCount() == 0 && tree.mRoot == -1;
+  return isOk;
+}
+
+struct ClosestHit
+{
+  const std::vector< Aabb >* aabbs;
+  AabbHandle handle;
+};
+
+// Clips the ray to the leaf's real aabb, so only closer ones get looked at
+static float FindClosestHit( void* userData, AabbHandle handle, Vector2 from, Vector2 to, float maxFraction )
+{
+  ClosestHit* closest = ( ClosestHit* )userData;
+  const Aabb& aabb = ( *closest->aabbs )[ handle ];
+  float enter = 0;
+  float exit = maxFraction;
+  for( int axis = 0; axis < 2; ++axis )
+  {
+    float invDelta = 1 / ( to[ axis ] - from[ axis ] );
+    float t0 = ( aabb.min[ axis ] - from[ axis ] ) * invDelta;
+    float t1 = ( aabb.max[ axis ] - from[ axis ] ) * invDelta;
+    enter = std::max( enter, std::min( t0, t1 ) );
+    exit = std::min( exit, std::max( t0, t1 ) );
+  }
+  if( enter > exit )
+    return maxFraction;
+  closest->handle = handle;
+  return enter;
+}
+
+static float StopAtFirstHit( void* userData, AabbHandle handle, Vector2 from, Vector2 to, float maxFraction )
+{
+  Unused( from );
+  Unused( to );
+  Unused( maxFraction );
+  *( AabbHandle* )userData = handle;
+  return 0;
+}
+
+static void BenchmarkAabbTreeCount( int count )
+{
+  // Each point in the world is covered by a few aabbs
+  float worldSize = std::sqrt( ( float )count ) * 4;
+  uint32_t state = 12;
+  std::vector< Aabb > aabbs( count );
+  for( Aabb& aabb : aabbs )
+    aabb = RandomAabb( state, worldSize );
+
+  AabbTree tree;
+  std::vector< AabbHandle > handles( count );
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    tree = AabbTree();
+    for( int i = 0; i < count; ++i )
+      handles[ i ] = tree.Insert( aabbs[ i ] );
+  } );
+  BenchmarkPrint( va( "aabb tree %i insert", count ), seconds, count, "objects" );
+  std::printf( "%-40s %i\n", va( "aabb tree %i height", count ), tree.GetHeight() );
+
+  // The tree hands out node indexes, the closest hit callback wants them to
+  // index aabbs
+  std::vector< Aabb > aabbsByHandle( tree.mNodes.size() );
+  for( int i = 0; i < count; ++i )
+    aabbsByHandle[ handles[ i ] ] = aabbs[ i ];
+
+  // A tenth of the objects jitter around inside their fat aabbs, which is
+  // what most frames look like
+  int step = 0;
+  const int moveCount = count / 10;
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    Vector2 displacement = ( step++ & 1 ) ? Vector2( -0.02f, 0.01f ) : Vector2( 0.02f, -0.01f );
+    for( int i = 0; i < moveCount; ++i )
+    {
+      Aabb& aabb = aabbsByHandle[ handles[ i ] ];
+      aabb.min += displacement;
+      aabb.max += displacement;
+      tree.Move( handles[ i ], aabb, displacement );
+    }
+  } );
+  BenchmarkPrint( va( "aabb tree %i small moves", count ), seconds, moveCount, "objects" );
+
+  const int queryCount = 1000;
+  std::vector< Vector2 > points( queryCount );
+  std::vector< Vector2 > directions( queryCount );
+  for( int i = 0; i < queryCount; ++i )
+  {
+    points[ i ] = Vector2( RandomRange( state, worldSize ), RandomRange( state, worldSize ) );
+    float angle = RandomRange( state, 6.2831853f );
+    directions[ i ] = Vector2( std::cos( angle ), std::sin( angle ) ) * 50;
+  }
+
+  std::vector< AabbHandle > results;
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < queryCount; ++i )
+      tree.QueryAabb( Aabb{ points[ i ], points[ i ] + Vector2( 10, 10 ) }, &results );
+  } );
+  BenchmarkPrint( va( "aabb tree %i 10x10 aabb query", count ), seconds, queryCount, "queries" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < queryCount; ++i )
+      tree.QueryPoint( points[ i ], &results );
+  } );
+  BenchmarkPrint( va( "aabb tree %i point query", count ), seconds, queryCount, "queries" );
+
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < queryCount; ++i )
+    {
+      ClosestHit closest = { &aabbsByHandle, -1 };
+      tree.Raycast( points[ i ], points[ i ] + directions[ i ], FindClosestHit, &closest );
+      BenchmarkKeep( closest.handle );
+    }
+  } );
+  BenchmarkPrint( va( "aabb tree %i closest raycast", count ), seconds, queryCount, "rays" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < queryCount; ++i )
+    {
+      AabbHandle hit = -1;
+      tree.Raycast( points[ i ], points[ i ] + directions[ i ], StopAtFirstHit, &hit );
+      BenchmarkKeep( hit );
+    }
+  } );
+  BenchmarkPrint( va( "aabb tree %i line of sight raycast", count ), seconds, queryCount, "rays" );
+}
+
+void BenchmarkAabbTree()
+{
+  BenchmarkCheck( "aabb tree vs brute force", CheckAabbTree() );
+  BenchmarkAabbTreeCount( 10000 );
+  BenchmarkAabbTreeCount( 100000 );
+}
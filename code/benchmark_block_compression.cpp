@@ -0,0 +1,112 @@
+#include "benchmark.h"
+#include "block_compression.h"
+#include "stb_image.h"
+#include <cstdio>
+
+// Peak signal to noise ratio over the first channelCount channels, in dB
+static double PSNR(
+  const std::vector< uint8_t >& a,
+  const std::vector< uint8_t >& b,
+  int texelBytes,
+  int channelCount )
+{
+  double sumSquared = 0;
+  size_t count = 0;
+  for( size_t i = 0; i < a.size(); i += texelBytes )
+  {
+    for( int c = 0; c < channelCount; ++c )
+    {
+      sumSquared += Square( ( double )a[ i + c ] - ( double )b[ i + c ] );
+      ++count;
+    }
+  }
+  double mse = sumSquared / count;
+  if( mse == 0 )
+    return 99.0;
+  return 10.0 * std::log10( 255.0 * 255.0 / mse );
+}
+
+static void BenchmarkFormat(
+  const char* imageName,
+  std::vector< uint8_t >& pixels,
+  int width,
+  int height,
+  int channelCount,
+  BlockFormat format,
+  const char* formatName )
+{
+  int texelBytes = format == BlockFormat::BC4 ? 1 : 4;
+  std::vector< uint8_t > blocks( GetBlockRowStride( format, width ) * ( ( height + 3 ) / 4 ) );
+  std::vector< uint8_t > decoded( width * height * texelBytes );
+
+  int threadCounts[] = { 1, 0 };
+  for( int threadCount : threadCounts )
+  {
+    double seconds = BenchmarkSecondsPerCall( [ & ]()
+    {
+      CompressImage(
+        blocks.data(),
+        pixels.data(),
+        width,
+        height,
+        width * channelCount,
+        channelCount,
+        format,
+        threadCount );
+    } );
+    BenchmarkPrint(
+      va( "%s %s %s", formatName, imageName, threadCount ? "1 thread" : "all threads" ),
+      seconds,
+      width * height / 1e6,
+      "MTexels" );
+  }
+
+  DecompressImage( decoded.data(), blocks.data(), width, height, width * texelBytes, format );
+  std::vector< uint8_t > reference( width * height * texelBytes );
+  for( int i = 0; i < width * height; ++i )
+    for( int c = 0; c < texelBytes; ++c )
+      reference[ i * texelBytes + c ] = pixels[ i * channelCount + c ];
+  std::printf( "%-40s %10.2f dB rgb", va( "%s %s psnr", formatName, imageName ),
+    PSNR( reference, decoded, texelBytes, texelBytes == 1 ? 1 : 3 ) );
+  if( format == BlockFormat::BC3 )
+  {
+    std::vector< uint8_t > referenceAlpha( reference.begin() + 3, reference.end() );
+    std::vector< uint8_t > decodedAlpha( decoded.begin() + 3, decoded.end() );
+    std::printf( " %6.2f dB alpha", PSNR( referenceAlpha, decodedAlpha, 4, 1 ) );
+  }
+  std::printf( "\n" );
+}
+
+void BenchmarkBlockCompression()
+{
+  // smooth gradients with some noise, roughly what sprites look like
+  const int size = 1024;
+  std::vector< uint8_t > synthetic( size * size * 4 );
+  uint32_t state = 1;
+  for( int y = 0; y < size; ++y )
+  {
+    for( int x = 0; x < size; ++x )
+    {
+      state = state * 1664525 + 1013904223;
+      int noise = ( int )( state >> 28 ) - 8;
+      uint8_t* texel = &synthetic[ ( y * size + x ) * 4 ];
+      texel[ 0 ] = ( uint8_t )std::min( std::max( x / 4 + noise, 0 ), 255 );
+      texel[ 1 ] = ( uint8_t )std::min( std::max( y / 4 + noise, 0 ), 255 );
+      texel[ 2 ] = ( uint8_t )( 128 + 127 * std::sin( ( x + y ) * 0.02f ) );
+      texel[ 3 ] = ( uint8_t )( ( ( x / 64 ) ^ ( y / 64 ) ) & 1 ? 255 : x / 4 );
+    }
+  }
+  BenchmarkFormat( "synthetic", synthetic, size, size, 4, BlockFormat::BC1, "bc1" );
+  BenchmarkFormat( "synthetic", synthetic, size, size, 4, BlockFormat::BC3, "bc3" );
+  BenchmarkFormat( "synthetic", synthetic, size, size, 4, BlockFormat::BC4, "bc4" );
+
+  int width;
+  int height;
+  int channels;
+  stbi_uc* star = stbi_load( "data/star.png", &width, &height, &channels, 4 );
+  if( !star )
+    return;
+  std::vector< uint8_t > starPixels( star, star + width * height * 4 );
+  stbi_image_free( star );
+  BenchmarkFormat( "star.png", starPixels, width, height, 4, BlockFormat::BC3, "bc3" );
+}
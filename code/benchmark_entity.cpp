@@ -0,0 +1,106 @@
+#include "benchmark.h"
+#include "entity.h"
+#include <algorithm>
+#include <cstdio>
+
+struct Character
+{
+  Vector2 position;
+  Vector2 velocity;
+  Vector2 input;
+};
+
+// How Game::Update moved its one character, before it became a system
+static void MoveCharacters( std::vector< Character >& characters, float dt )
+{
+  for( Character& character : characters )
+  {
+    float maxSpeed = 10;
+    float accel = 30.0f;
+    Vector2 accelVec = accel * character.input;
+    float curSpeed = character.velocity.Length();
+    if( character.input.IsZero() && curSpeed > 0.1f )
+      accelVec += -( character.velocity / curSpeed ) * 20;
+    character.velocity += accelVec * dt;
+    character.position += character.velocity * dt;
+    if( curSpeed > maxSpeed )
+      character.velocity *= maxSpeed / curSpeed;
+    character.velocity *= 0.99f;
+  }
+}
+
+void BenchmarkEntity()
+{
+  const int entityCount = 100000;
+  const float dt = 1 / 60.0f;
+  std::vector< Character > characters( entityCount );
+  EntityStore store;
+  std::vector< EntityId > ids;
+  uint32_t state = 6;
+  for( Character& character : characters )
+  {
+    state = state * 1664525 + 1013904223;
+    character.position = Vector2( ( float )( state % 1000 ), ( float )( state / 1000 % 1000 ) );
+    // A third of them idle, so the braking path gets used too
+    int dirX = ( int )( state >> 24 ) % 3 - 1;
+    int dirY = ( int )( state >> 16 & 0xff ) % 3 - 1;
+    character.input = Vector2( ( float )dirX, ( float )dirY );
+    EntityId id = store.Add( character.position );
+    store.mMoveInputs.Set( store.GetIndex( id ), character.input );
+    ids.push_back( id );
+  }
+
+  for( int frame = 0; frame < 120; ++frame )
+  {
+    // everyone lets go halfway through
+    if( frame == 60 )
+    {
+      for( Character& character : characters )
+        character.input = Vector2( 0, 0 );
+      store.mMoveInputs.Resize( 0 );
+      store.mMoveInputs.Resize( entityCount );
+    }
+    MoveCharacters( characters, dt );
+    UpdateMovement( &store, MovementSettings(), dt );
+  }
+  float maxError = 0;
+  for( int i = 0; i < entityCount; ++i )
+  {
+    Vector2 position = store.mPositions.Get( store.GetIndex( ids[ i ] ) );
+    maxError = std::max( maxError, std::abs( position.x - characters[ i ].position.x ) );
+    maxError = std::max( maxError, std::abs( position.y - characters[ i ].position.y ) );
+  }
+  std::printf( "%-40s %g\n", "movement system vs character, 120 frames", maxError );
+
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    MoveCharacters( characters, dt );
+  } );
+  BenchmarkPrint( "character movement aos", seconds, entityCount, "entities" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    UpdateMovement( &store, MovementSettings(), dt );
+  } );
+  BenchmarkPrint( "UpdateMovement", seconds, entityCount, "entities" );
+
+  // Remove every other entity and add them back, which shuffles the dense
+  // arrays and reuses every freed slot
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < entityCount; i += 2 )
+      store.Remove( ids[ i ] );
+    for( int i = 0; i < entityCount; i += 2 )
+      ids[ i ] = store.Add( Vector2( 0, 0 ) );
+  } );
+  BenchmarkPrint( "EntityStore remove + add", seconds, entityCount, "entities" );
+
+  EntityId stale = ids[ 0 ];
+  store.Remove( stale );
+  EntityId reused = store.Add( Vector2( 0, 0 ) );
+  bool isOk = !store.IsAlive( stale )
+    && store.IsAlive( reused )
+    && reused.index == stale.index
+    && store.GetCount() == entityCount
+    && store.mIds[ store.GetIndex( ids[ 1 ] ) ].index == ids[ 1 ].index;
+  BenchmarkCheck( "entity ids after reuse", isOk );
+}
@@ -0,0 +1,102 @@
+#include "benchmark.h"
+#include "fast_trig.h"
+#include <algorithm>
+#include <cstdio>
+
+// Error of every fast sin / cos over count evenly spaced angles in
+// [ -maxRadians, maxRadians ], against double precision libm
+static void PrintFastTrigError( float maxRadians, int count )
+{
+  std::vector< float > radians( count );
+  for( int i = 0; i < count; ++i )
+    radians[ i ] = -maxRadians + 2 * maxRadians * i / ( count - 1 );
+  std::vector< float > sins( count );
+  std::vector< float > coss( count );
+  FastSinCosArray( radians.data(), sins.data(), coss.data(), count );
+
+  double maxError = 0;
+  double maxScalarDifference = 0;
+  for( int i = 0; i < count; ++i )
+  {
+    maxError = std::max( maxError, std::abs( sins[ i ] - std::sin( ( double )radians[ i ] ) ) );
+    maxError = std::max( maxError, std::abs( coss[ i ] - std::cos( ( double )radians[ i ] ) ) );
+    float sin;
+    float cos;
+    FastSinCos( radians[ i ], &sin, &cos );
+    maxScalarDifference = std::max( maxScalarDifference, ( double )std::abs( sin - sins[ i ] ) );
+    maxScalarDifference = std::max( maxScalarDifference, ( double )std::abs( cos - coss[ i ] ) );
+  }
+  std::printf( "%-40s %g\n", va( "fast sincos max error, |x| <= %g", maxRadians ), maxError );
+  std::printf( "%-40s %g\n", va( "fast sincos scalar vs simd, |x| <= %g", maxRadians ), maxScalarDifference );
+}
+
+void BenchmarkFastTrig()
+{
+  PrintFastTrigError( 6.28318531f, 1 << 20 );
+  PrintFastTrigError( 8192, 1 << 24 );
+  PrintFastTrigError( 100000, 1 << 24 );
+
+  // Exact where it matters for sprites
+  bool isExact
+    = FastSin( 0 ) == 0
+    && FastCos( 0 ) == 1
+    && FastSin( -0.0f ) == 0
+    && std::abs( FastSin( 1.57079633f ) - 1 ) <= 1e-7f
+    && std::abs( FastCos( 3.14159265f ) + 1 ) <= 1e-7f;
+  BenchmarkCheck( "fast sincos special angles", isExact );
+
+  const int count = 100000;
+  std::vector< float > radians( count );
+  uint32_t state = 4;
+  for( float& r : radians )
+  {
+    state = state * 1664525 + 1013904223;
+    r = ( state >> 8 ) / ( float )( 1 << 24 ) * 200 - 100;
+  }
+
+  std::vector< Matrix2 > expected( count );
+  std::vector< Matrix2 > actual( count );
+  for( int i = 0; i < count; ++i )
+    expected[ i ] = Matrix2::Rotate( radians[ i ] );
+  RotateBatch( radians.data(), actual.data(), count );
+  float maxError = 0;
+  for( int i = 0; i < count; ++i )
+    for( int j = 0; j < 4; ++j )
+      maxError = std::max( maxError, std::abs( actual[ i ].values[ j ] - expected[ i ].values[ j ] ) );
+  std::printf( "%-40s %g\n", "RotateBatch vs Matrix2::Rotate", maxError );
+
+  std::vector< float > sins( count );
+  std::vector< float > coss( count );
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < count; ++i )
+    {
+      sins[ i ] = std::sin( radians[ i ] );
+      coss[ i ] = std::cos( radians[ i ] );
+    }
+  } );
+  BenchmarkPrint( "std::sin + std::cos", seconds, count, "angles" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < count; ++i )
+      FastSinCos( radians[ i ], &sins[ i ], &coss[ i ] );
+  } );
+  BenchmarkPrint( "FastSinCos", seconds, count, "angles" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    FastSinCosArray( radians.data(), sins.data(), coss.data(), count );
+  } );
+  BenchmarkPrint( "FastSinCosArray", seconds, count, "angles" );
+
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < count; ++i )
+      expected[ i ] = Matrix2::Rotate( radians[ i ] );
+  } );
+  BenchmarkPrint( "Matrix2::Rotate", seconds, count, "matrices" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    RotateBatch( radians.data(), actual.data(), count );
+  } );
+  BenchmarkPrint( "RotateBatch", seconds, count, "matrices" );
+}
@@ -0,0 +1,169 @@
+#include "benchmark.h"
+#include "job_system.h"
+#include "entity.h"
+#include <cstdio>
+
+static void EmptyJob( void*, int, int )
+{
+}
+
+// Enough math per index that the scaling isn't just memory bandwidth
+static void BusyJob( void* userData, int begin, int end )
+{
+  float* results = ( float* )userData;
+  for( int i = begin; i < end; ++i )
+  {
+    float x = ( float )i;
+    for( int j = 0; j < 64; ++j )
+      x = std::sqrt( x * 1.0001f + 1.0f );
+    results[ i ] = x;
+  }
+}
+
+struct OrderCheck
+{
+  std::atomic< int > step;
+  bool isInOrder;
+};
+
+static void FirstStep( void* userData, int, int )
+{
+  OrderCheck* check = ( OrderCheck* )userData;
+  check->isInOrder &= check->step.fetch_add( 1 ) < 8;
+}
+
+static void SecondStep( void* userData, int, int )
+{
+  OrderCheck* check = ( OrderCheck* )userData;
+  check->isInOrder &= check->step.fetch_add( 1 ) == 8;
+}
+
+// A job of one system that splits its range across another, smaller one
+struct NestedCheck
+{
+  JobSystem* inner;
+  std::atomic< int > sum;
+};
+
+static void InnerJob( void* userData, int begin, int end )
+{
+  NestedCheck* check = ( NestedCheck* )userData;
+  check->sum += end - begin;
+}
+
+static void OuterJob( void* userData, int begin, int end )
+{
+  // Long enough that the other outer workers wake up and take some
+  NestedCheck* check = ( NestedCheck* )userData;
+  std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  for( int i = begin; i < end; ++i )
+  {
+    JobCounter counter;
+    check->inner->ParallelFor( InnerJob, check, 64, &counter, 1 );
+    check->inner->Wait( &counter );
+  }
+}
+
+void BenchmarkJobSystem()
+{
+  int coreCount = ( int )std::thread::hardware_concurrency();
+  std::printf( "%-40s %i\n", "hardware threads", coreCount );
+
+  // Second step depends on all 8 of the first
+  {
+    JobSystem jobs( 4 );
+    OrderCheck check;
+    check.step = 0;
+    check.isInOrder = true;
+    JobCounter first;
+    JobCounter second;
+    for( int i = 0; i < 8; ++i )
+      jobs.Run( FirstStep, &check, &first );
+    jobs.RunAfter( &first, SecondStep, &check, &second );
+    jobs.Wait( &second );
+    bool isOk = check.isInOrder && check.step == 9 && first.count == 0;
+    BenchmarkCheck( "job dependencies", isOk );
+  }
+
+  // Workers of the outer system use the inner one's worker 0 deque, not
+  // their own index, which is past the end of it
+  {
+    JobSystem outer( 8 );
+    JobSystem inner( 2 );
+    NestedCheck check;
+    check.inner = &inner;
+    check.sum = 0;
+    JobCounter counter;
+    outer.ParallelFor( OuterJob, &check, 64, &counter, 1 );
+    outer.Wait( &counter );
+    BenchmarkCheck( "job systems nested", check.sum == 64 * 64 );
+  }
+
+  // Overhead of a job that does nothing
+  {
+    JobSystem jobs( 1 );
+    const int jobCount = 10000;
+    double seconds = BenchmarkSecondsPerCall( [ & ]()
+    {
+      JobCounter counter;
+      for( int i = 0; i < jobCount; ++i )
+        jobs.Run( EmptyJob, nullptr, &counter );
+      jobs.Wait( &counter );
+    } );
+    BenchmarkPrint( "empty jobs, 1 thread", seconds, jobCount, "jobs" );
+  }
+  {
+    JobSystem jobs;
+    const int jobCount = 10000;
+    double seconds = BenchmarkSecondsPerCall( [ & ]()
+    {
+      JobCounter counter;
+      for( int i = 0; i < jobCount; ++i )
+        jobs.Run( EmptyJob, nullptr, &counter );
+      jobs.Wait( &counter );
+    } );
+    BenchmarkPrint( va( "empty jobs, %i threads", jobs.GetThreadCount() ), seconds, jobCount, "jobs" );
+    seconds = BenchmarkSecondsPerCall( [ & ]()
+    {
+      JobCounter counter;
+      jobs.ParallelFor( EmptyJob, nullptr, jobCount, &counter, 1 );
+      jobs.Wait( &counter );
+    } );
+    BenchmarkPrint( va( "empty ParallelFor grain 1, %i threads", jobs.GetThreadCount() ), seconds, jobCount, "jobs" );
+  }
+
+  // Scaling, up to twice the core count to show what oversubscribing does
+  const int count = 1 << 16;
+  std::vector< float > results( count );
+  double oneThreadSeconds = 0;
+  for( int threadCount = 1; threadCount <= 2 * coreCount || threadCount <= 2; threadCount *= 2 )
+  {
+    JobSystem jobs( threadCount );
+    double seconds = BenchmarkSecondsPerCall( [ & ]()
+    {
+      JobCounter counter;
+      jobs.ParallelFor( BusyJob, results.data(), count, &counter );
+      jobs.Wait( &counter );
+    } );
+    if( threadCount == 1 )
+      oneThreadSeconds = seconds;
+    BenchmarkPrint( va( "ParallelFor busy, %i threads", threadCount ), seconds, count, "items" );
+    std::printf( "%-40s %12.2fx\n", "", oneThreadSeconds / seconds );
+  }
+
+  EntityStore store;
+  for( int i = 0; i < 100000; ++i )
+  {
+    EntityId id = store.Add( Vector2( ( float )i, 0 ) );
+    store.mMoveInputs.Set( store.GetIndex( id ), Vector2( 1, 0 ) );
+  }
+  for( int threadCount = 1; threadCount <= coreCount || threadCount == 1; threadCount *= 2 )
+  {
+    JobSystem jobs( threadCount );
+    double seconds = BenchmarkSecondsPerCall( [ & ]()
+    {
+      UpdateMovement( &jobs, &store, MovementSettings(), 1 / 60.0f );
+    } );
+    BenchmarkPrint( va( "UpdateMovement 100k, %i threads", threadCount ), seconds, store.GetCount(), "entities" );
+  }
+}
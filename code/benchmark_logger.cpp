@@ -0,0 +1,154 @@
+#include "benchmark.h"
+#include "logger.h"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// Only touched on the logger thread, and read after LoggerFlush()
+struct LoggerBenchmarkOutput
+{
+  std::vector< std::string > lines;
+  size_t byteCount = 0;
+  bool isKeepingLines = false;
+};
+
+static void LoggerBenchmarkWrite( void* userData, const char* text )
+{
+  LoggerBenchmarkOutput* output = ( LoggerBenchmarkOutput* )userData;
+  output->byteCount += std::strlen( text );
+  if( output->isKeepingLines )
+    output->lines.push_back( text );
+}
+
+// What the old va() + OutputDebugString() cost the caller
+static void NoOutput( const char* text )
+{
+  BenchmarkKeep( text[ 0 ] );
+}
+
+template< typename... Args >
+static bool IsFormattedLikePrintf( const char* format, Args... args )
+{
+  LogSite site = { format, LogSeverity::Info, LogCategory::General };
+  LogRecord record;
+  LogFillRecord( &record, &site, args... );
+  char logged[ 256 ];
+  char printed[ 256 ];
+  LogFormatMessage( record, logged, sizeof( logged ) );
+  std::snprintf( printed, sizeof( printed ), format, args... );
+  if( std::strcmp( logged, printed ) == 0 )
+    return true;
+  std::printf( "  \"%s\" logged \"%s\", printf \"%s\"\n", format, logged, printed );
+  return false;
+}
+
+static bool CheckLogger( LoggerBenchmarkOutput* output )
+{
+  bool isOk = true;
+  char name[] = "star";
+  isOk &= IsFormattedLikePrintf( "%c %s", 'W', "pressed" );
+  isOk &= IsFormattedLikePrintf( "%i %d %5i|%-5d|%05i", -1, 42, 7, -7, 3 );
+  isOk &= IsFormattedLikePrintf( "%u %x %X %o %#x", 3000000000u, -1, 255, 8, 16 );
+  isOk &= IsFormattedLikePrintf( "%lld %llu %llx", -( 1ll << 40 ), ~0ull, 1ull << 63 );
+  isOk &= IsFormattedLikePrintf( "%zu %hhu", sizeof( LogRecord ), ( unsigned char )200 );
+  isOk &= IsFormattedLikePrintf( "%f %.2f %10.3e %g", 1.5f, 3.14159, -12345.678, 1e-7 );
+  isOk &= IsFormattedLikePrintf( "%s in %s, 100%% %p", name, "atlas page", ( void* )name );
+  isOk &= IsFormattedLikePrintf( "%i%i%i%i %i%i%i%i", true, false, true, true, 0, 1, 0, 1 );
+  isOk &= IsFormattedLikePrintf( "no arguments" );
+
+  // Strings past the record's room get cut, not overrun
+  {
+    std::string longString( 400, 'x' );
+    LogSite site = { "%s %s", LogSeverity::Info, LogCategory::General };
+    LogRecord record;
+    LogFillRecord( &record, &site, longString.c_str(), "after" );
+    char logged[ 512 ];
+    int length = LogFormatMessage( record, logged, sizeof( logged ) );
+    isOk &= length == ( int )sizeof( record.strings );
+    isOk &= logged[ 0 ] == 'x' && logged[ length - 1 ] == ' ';
+  }
+
+  // Messages from several threads all come out, each thread's in order
+  output->isKeepingLines = true;
+  output->lines.clear();
+  const int threadCount = 3;
+  const int messageCount = 200;
+  std::thread threads[ threadCount ];
+  for( int iThread = 0; iThread < threadCount; ++iThread )
+    threads[ iThread ] = std::thread( [ iThread ]()
+    {
+      for( int i = 0; i < messageCount; ++i )
+        LOG( Info, General, "thread %i message %i", iThread, i );
+    } );
+  for( std::thread& thread : threads )
+    thread.join();
+  LOG( Warning, Assets, "%s failed", "star.png" );
+  LoggerFlush();
+  output->isKeepingLines = false;
+  int nextMessages[ threadCount ] = {};
+  bool isWarningFound = false;
+  for( const std::string& line : output->lines )
+  {
+    int iThread;
+    int message;
+    const char* text = std::strstr( line.c_str(), ": " );
+    if( text && std::sscanf( text, ": thread %i message %i", &iThread, &message ) == 2 )
+      isOk &= message == nextMessages[ iThread ]++;
+    isWarningFound |= line.find( " warning assets: star.png failed\n" ) != std::string::npos;
+  }
+  for( int nextMessage : nextMessages )
+    isOk &= nextMessage == messageCount;
+  isOk &= isWarningFound;
+
+  // Compiled out, there's no record
+  uint32_t head = logThreadBuffer->head;
+  LOG( Debug, General, "never %i", 1 );
+  isOk &= logThreadBuffer->head == head;
+  return isOk;
+}
+
+void BenchmarkLogger()
+{
+  LoggerBenchmarkOutput output;
+  LoggerStart( LoggerBenchmarkWrite, &output );
+  BenchmarkCheck( "logger formatting and threads", CheckLogger( &output ) );
+
+  // Batches that fit in the ring, flushed between timings so nothing drops
+  typedef std::chrono::high_resolution_clock Clock;
+  const int batchCount = 200;
+  const int batchSize = LogThreadBuffer::capacity / 2;
+  uint32_t droppedCount = LoggerGetDroppedCount();
+  std::chrono::duration< double > elapsed( 0 );
+  for( int batch = 0; batch < batchCount; ++batch )
+  {
+    Clock::time_point begin = Clock::now();
+    for( int i = 0; i < batchSize; ++i )
+      LOG( Info, Render, "draw %i of %i took %.3f ms on %s", i, batchSize, i * 0.001f, "main" );
+    elapsed += Clock::now() - begin;
+    LoggerFlush();
+  }
+  double callCount = ( double )batchCount * batchSize;
+  BenchmarkPrint( "logger LOG() call", elapsed.count() / callCount, 1, "calls" );
+  std::printf( "%-40s %.1f ns\n", "logger cost per call", elapsed.count() / callCount * 1e9 );
+  BenchmarkCheck( "logger nothing dropped", LoggerGetDroppedCount() == droppedCount );
+
+  // The same message formatted on the spot
+  int i = 0;
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    NoOutput( va( "draw %i of %i took %.3f ms on %s", i, batchSize, i * 0.001f, "main" ) );
+    i = ( i + 1 ) % batchSize;
+  } );
+  std::printf( "%-40s %.1f ns\n", "va() cost per call", seconds * 1e9 );
+
+  // The background thread's side, format and output
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int j = 0; j < batchSize; ++j )
+      LOG( Info, Render, "draw %i of %i took %.3f ms on %s", j, batchSize, j * 0.001f, "main" );
+    LoggerFlush();
+  } );
+  BenchmarkPrint( "logger log + flush", seconds, batchSize, "messages" );
+  LoggerStop();
+  BenchmarkKeep( output.byteCount );
+}
@@ -0,0 +1,247 @@
+#include "benchmark.h"
+#include "platform.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+// stb_image isn't -Wextra clean. Its warnings are off, the way game.cpp turns them off for msvc
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wshift-negative-value"
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+#include "stb_image.h"
+#pragma GCC diagnostic pop
+
+// Builds without windows or d3d, see benchmark.mk:
+//   make -f code/benchmark.mk
+//   ./benchmark [filter] [--json results.json]
+// filter runs only the groups whose name contains it, eg. "math".
+// --json also writes every timing out, to compare across commits.
+// Exits with 1 if any check FAILED, so a script can run it as a test.
+// Run it from the repo root so data/ resolves.
+
+void PlatformMessageBox( const char* msg )
+{
+  std::fprintf( stderr, "%s\n", msg );
+}
+
+void PlatformDebugOutput( const char* text )
+{
+  std::fputs( text, stderr );
+}
+
+void PlatformCreateDirectory( const char* path )
+{
+  mkdir( path, 0755 );
+}
+
+bool PlatformReplaceFile( const char* from, const char* to )
+{
+  // rename already replaces in one step here
+  return std::rename( from, to ) == 0;
+}
+
+bool PlatformMapFile( const char* path, PlatformMappedFile* file )
+{
+  int descriptor = open( path, O_RDONLY );
+  if( descriptor == -1 )
+    return false;
+  struct stat status;
+  void* view = MAP_FAILED;
+  if( fstat( descriptor, &status ) == 0 && status.st_size > 0 )
+    view = mmap( nullptr, ( size_t )status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0 );
+  // The mapping keeps the file open
+  close( descriptor );
+  if( view == MAP_FAILED )
+    return false;
+  file->bytes = view;
+  file->byteCount = ( size_t )status.st_size;
+  return true;
+}
+
+void PlatformUnmapFile( PlatformMappedFile* file )
+{
+  if( file->bytes )
+    munmap( ( void* )file->bytes, file->byteCount );
+  *file = PlatformMappedFile();
+}
+
+size_t PlatformGetResidentByteCount()
+{
+  // Second number in statm is the resident page count
+  FILE* file = std::fopen( "/proc/self/statm", "r" );
+  if( !file )
+    return 0;
+  unsigned long long pageCount = 0;
+  unsigned long long residentPageCount = 0;
+  int readCount = std::fscanf( file, "%llu %llu", &pageCount, &residentPageCount );
+  std::fclose( file );
+  return readCount == 2 ? ( size_t )( residentPageCount * sysconf( _SC_PAGESIZE ) ) : 0;
+}
+
+struct BenchmarkRecord
+{
+  std::string name;
+  BenchmarkStats stats;
+};
+static std::vector< BenchmarkRecord > records;
+static std::vector< std::string > failedChecks;
+
+void BenchmarkPrint(
+  const char* name,
+  double secondsPerCall,
+  double itemsPerCall,
+  const char* itemName )
+{
+  std::printf( "%-40s %10.4f ms/call %14.1f %s/s\n",
+    name,
+    secondsPerCall * 1000.0,
+    itemsPerCall / secondsPerCall,
+    itemName );
+  double nanosecondsPerItem = secondsPerCall * 1e9 / itemsPerCall;
+  BenchmarkRecord record;
+  record.name = name;
+  record.stats.median = nanosecondsPerItem;
+  record.stats.mean = nanosecondsPerItem;
+  record.stats.stddev = 0;
+  record.stats.min = nanosecondsPerItem;
+  record.stats.max = nanosecondsPerItem;
+  record.stats.repetitionCount = 1;
+  records.push_back( record );
+}
+
+void BenchmarkCheck( const char* name, bool isOk )
+{
+  std::printf( "%-40s %s\n", name, isOk ? "ok" : "FAILED" );
+  if( !isOk )
+    failedChecks.push_back( name );
+}
+
+BenchmarkStats BenchmarkComputeStats( std::vector< double >& nanosecondsPerOp )
+{
+  BenchmarkStats stats = {};
+  int count = ( int )nanosecondsPerOp.size();
+  if( !count )
+    return stats;
+  std::sort( nanosecondsPerOp.begin(), nanosecondsPerOp.end() );
+  stats.repetitionCount = count;
+  stats.min = nanosecondsPerOp.front();
+  stats.max = nanosecondsPerOp.back();
+  stats.median = count % 2
+    ? nanosecondsPerOp[ count / 2 ]
+    : ( nanosecondsPerOp[ count / 2 - 1 ] + nanosecondsPerOp[ count / 2 ] ) / 2;
+  for( double ns : nanosecondsPerOp )
+    stats.mean += ns;
+  stats.mean /= count;
+  for( double ns : nanosecondsPerOp )
+    stats.stddev += Square( ns - stats.mean );
+  stats.stddev = std::sqrt( stats.stddev / count );
+  return stats;
+}
+
+void BenchmarkReport( const char* name, BenchmarkStats stats )
+{
+  std::printf( "%-40s %10.3f ns/op +-%5.1f%%  min %.3f  max %.3f\n",
+    name,
+    stats.median,
+    stats.mean > 0 ? 100 * stats.stddev / stats.mean : 0,
+    stats.min,
+    stats.max );
+  BenchmarkRecord record;
+  record.name = name;
+  record.stats = stats;
+  records.push_back( record );
+}
+
+static bool WriteJson( const char* path )
+{
+  FILE* file = std::fopen( path, "w" );
+  if( !file )
+    return false;
+  std::fprintf( file, "{\n  \"benchmarks\": [" );
+  for( size_t i = 0; i < records.size(); ++i )
+  {
+    const BenchmarkRecord& record = records[ i ];
+    std::string name;
+    for( char c : record.name )
+    {
+      if( c == '"' || c == '\\' )
+        name += '\\';
+      name += c;
+    }
+    std::fprintf( file,
+      "%s\n    { \"name\": \"%s\", \"median_ns\": %.6g, \"mean_ns\": %.6g, "
+      "\"stddev_ns\": %.6g, \"min_ns\": %.6g, \"max_ns\": %.6g, \"repetitions\": %i }",
+      i ? "," : "",
+      name.c_str(),
+      record.stats.median,
+      record.stats.mean,
+      record.stats.stddev,
+      record.stats.min,
+      record.stats.max,
+      record.stats.repetitionCount );
+  }
+  std::fprintf( file, "\n  ]\n}\n" );
+  return std::fclose( file ) == 0;
+}
+
+int main( int argc, char** argv )
+{
+  const char* filter = "";
+  const char* jsonPath = nullptr;
+  for( int i = 1; i < argc; ++i )
+  {
+    if( !std::strcmp( argv[ i ], "--json" ) && i + 1 < argc )
+      jsonPath = argv[ ++i ];
+    else
+      filter = argv[ i ];
+  }
+
+  struct Group
+  {
+    const char* name;
+    void( *run )();
+  };
+  Group groups[] = {
+    { "mipmap", BenchmarkMipmap },
+    { "block_compression", BenchmarkBlockCompression },
+    { "shader_cache", BenchmarkShaderCache },
+    { "affine2", BenchmarkAffine2 },
+    { "matrix4", BenchmarkMatrix4 },
+    { "game_update_math", BenchmarkGameUpdateMath },
+    { "vector2_stream", BenchmarkVector2Stream },
+    { "fast_trig", BenchmarkFastTrig },
+    { "utility_math", BenchmarkUtilityMath },
+    { "entity", BenchmarkEntity },
+    { "job_system", BenchmarkJobSystem },
+    { "spatial_hash", BenchmarkSpatialHash },
+    { "aabb_tree", BenchmarkAabbTree },
+    { "tile_map", BenchmarkTileMap },
+    { "particles", BenchmarkParticles },
+    { "view_culling", BenchmarkViewCulling },
+    { "snapshot", BenchmarkSnapshot },
+    { "save_file", BenchmarkSaveFile },
+    { "profiler", BenchmarkProfiler },
+    { "perf_overlay", BenchmarkPerfOverlay },
+    { "logger", BenchmarkLogger },
+    { "png_decode", BenchmarkPngDecode },
+    { "texture_manager", BenchmarkTextureManager },
+  };
+  for( Group group : groups )
+    if( std::strstr( group.name, filter ) )
+      group.run();
+
+  for( const std::string& name : failedChecks )
+    std::fprintf( stderr, "FAILED: %s\n", name.c_str() );
+  if( jsonPath && !WriteJson( jsonPath ) )
+  {
+    std::fprintf( stderr, "couldn't write %s\n", jsonPath );
+    return 1;
+  }
+  return failedChecks.empty() ? 0 : 1;
+}
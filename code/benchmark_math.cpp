@@ -0,0 +1,282 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <cstdio>
+
+static float Random01( uint32_t& state )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 24 );
+}
+
+void BenchmarkAffine2()
+{
+  const int spriteCount = 100000;
+  std::vector< Vector2 > positions( spriteCount );
+  std::vector< float > rotations( spriteCount );
+  std::vector< float > scales( spriteCount );
+  uint32_t state = 1;
+  for( int i = 0; i < spriteCount; ++i )
+  {
+    positions[ i ] = Vector2( Random01( state ) * 100, Random01( state ) * 100 );
+    rotations[ i ] = Random01( state ) * 6.28f;
+    scales[ i ] = 0.5f + Random01( state );
+  }
+
+  // What Game::Update used to do per sprite
+  std::vector< Matrix4 > matrices( spriteCount );
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < spriteCount; ++i )
+      matrices[ i ]
+      = Matrix4::Translate( positions[ i ] )
+      * Matrix2::Rotate( rotations[ i ] )
+      * Matrix2::Scale( scales[ i ] );
+  } );
+  BenchmarkPrint( "world Matrix4 T * R * S", seconds, spriteCount, "sprites" );
+
+  std::vector< Affine2 > affines( spriteCount );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < spriteCount; ++i )
+      affines[ i ]
+      = Affine2::Translate( positions[ i ] )
+      * Affine2::Rotate( rotations[ i ] )
+      * Affine2::Scale( scales[ i ] );
+  } );
+  BenchmarkPrint( "world Affine2 T * R * S", seconds, spriteCount, "sprites" );
+
+  std::vector< Matrix4 > expanded( spriteCount );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < spriteCount; ++i )
+      expanded[ i ] = Matrix4( Affine2::TranslateRotateScale(
+        positions[ i ],
+        rotations[ i ],
+        Vector2( scales[ i ], scales[ i ] ) ) );
+  } );
+  BenchmarkPrint( "world Affine2 TRS + expand", seconds, spriteCount, "sprites" );
+
+  float maxError = 0;
+  for( int i = 0; i < spriteCount; ++i )
+    for( int j = 0; j < 16; ++j )
+      maxError = std::max( maxError, std::abs( expanded[ i ].values[ j ] - matrices[ i ].values[ j ] ) );
+  std::printf( "%-40s %g\n", "affine vs matrix4 max abs error", maxError );
+
+  std::vector< Affine2 > composed( spriteCount );
+  Affine2 view = Affine2::Scale( 0.1f, 0.2f ) * Affine2::Translate( Vector2( -3, 4 ) );
+  std::vector< Affine2 > views( spriteCount, view );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    ComposeAffines( views.data(), affines.data(), composed.data(), spriteCount );
+  } );
+  BenchmarkPrint( "ComposeAffines", seconds, spriteCount, "affines" );
+
+  std::vector< Vector2 > transformed( spriteCount );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    TransformPoints( view, positions.data(), transformed.data(), spriteCount );
+  } );
+  BenchmarkPrint( "TransformPoints", seconds, spriteCount, "points" );
+}
+
+// The scalar versions utility.cpp had before it used sse, to check against
+static Matrix4 ReferenceMultiply( Matrix4 lhs, Matrix4 rhs )
+{
+  Matrix4 result;
+  for( int r = 0; r < 4; ++r )
+  {
+    for( int c = 0; c < 4; ++c )
+    {
+      float dot = 0;
+      for( int i = 0; i < 4; ++i )
+        dot += lhs[ r ][ i ] * rhs[ i ][ c ];
+      result[ r ][ c ] = dot;
+    }
+  }
+  return result;
+}
+
+static Vector4 ReferenceTransform( Matrix4 lhs, Vector4 rhs )
+{
+  Vector4 result;
+  for( int r = 0; r < 4; ++r )
+  {
+    float dot = 0;
+    for( int i = 0; i < 4; ++i )
+      dot += lhs[ r ][ i ] * rhs[ i ];
+    result[ r ] = dot;
+  }
+  return result;
+}
+
+static Vector4 ReferenceTransform( Vector4 lhs, Matrix4 rhs )
+{
+  Vector4 result;
+  for( int c = 0; c < 4; ++c )
+  {
+    float dot = 0;
+    for( int i = 0; i < 4; ++i )
+      dot += lhs[ i ] * rhs[ i ][ c ];
+    result[ c ] = dot;
+  }
+  return result;
+}
+
+static float MaxError( const float* a, const float* b, int count )
+{
+  float maxError = 0;
+  for( int i = 0; i < count; ++i )
+    maxError = std::max( maxError, std::abs( a[ i ] - b[ i ] ) );
+  return maxError;
+}
+
+void BenchmarkMatrix4()
+{
+  const int count = 100000;
+  std::vector< Matrix4 > lhs( count );
+  std::vector< Matrix4 > rhs( count );
+  std::vector< Vector4 > vectors( count );
+  uint32_t state = 2;
+  for( int i = 0; i < count; ++i )
+  {
+    for( int j = 0; j < 16; ++j )
+    {
+      lhs[ i ].values[ j ] = Random01( state ) * 4 - 2;
+      rhs[ i ].values[ j ] = Random01( state ) * 4 - 2;
+    }
+    for( int j = 0; j < 4; ++j )
+      vectors[ i ][ j ] = Random01( state ) * 200 - 100;
+  }
+
+  std::vector< Matrix4 > expected( count );
+  std::vector< Matrix4 > actual( count );
+  for( int i = 0; i < count; ++i )
+  {
+    expected[ i ] = ReferenceMultiply( lhs[ i ], rhs[ i ] );
+    actual[ i ] = lhs[ i ] * rhs[ i ];
+  }
+  std::printf( "%-40s %g\n", "Matrix4 * Matrix4 max abs error",
+    MaxError( actual[ 0 ].values, expected[ 0 ].values, 16 * count ) );
+  ComposeMatrices( lhs.data(), rhs.data(), actual.data(), count );
+  std::printf( "%-40s %g\n", "ComposeMatrices max abs error",
+    MaxError( actual[ 0 ].values, expected[ 0 ].values, 16 * count ) );
+
+  std::vector< Vector4 > expectedVectors( count );
+  std::vector< Vector4 > actualVectors( count );
+  for( int i = 0; i < count; ++i )
+  {
+    expectedVectors[ i ] = ReferenceTransform( lhs[ i ], vectors[ i ] );
+    actualVectors[ i ] = lhs[ i ] * vectors[ i ];
+  }
+  std::printf( "%-40s %g\n", "Matrix4 * Vector4 max abs error",
+    MaxError( &actualVectors[ 0 ].x, &expectedVectors[ 0 ].x, 4 * count ) );
+  for( int i = 0; i < count; ++i )
+  {
+    expectedVectors[ i ] = ReferenceTransform( vectors[ i ], lhs[ i ] );
+    actualVectors[ i ] = vectors[ i ] * lhs[ i ];
+  }
+  std::printf( "%-40s %g\n", "Vector4 * Matrix4 max abs error",
+    MaxError( &actualVectors[ 0 ].x, &expectedVectors[ 0 ].x, 4 * count ) );
+  for( int i = 0; i < count; ++i )
+    expectedVectors[ i ] = ReferenceTransform( lhs[ 0 ], vectors[ i ] );
+  TransformVectors( lhs[ 0 ], vectors.data(), actualVectors.data(), count );
+  std::printf( "%-40s %g\n", "TransformVectors max abs error",
+    MaxError( &actualVectors[ 0 ].x, &expectedVectors[ 0 ].x, 4 * count ) );
+
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < count; ++i )
+      expected[ i ] = ReferenceMultiply( lhs[ i ], rhs[ i ] );
+  } );
+  BenchmarkPrint( "Matrix4 * Matrix4 scalar", seconds, count, "matrices" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < count; ++i )
+      actual[ i ] = lhs[ i ] * rhs[ i ];
+  } );
+  BenchmarkPrint( "Matrix4 * Matrix4", seconds, count, "matrices" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    ComposeMatrices( lhs.data(), rhs.data(), actual.data(), count );
+  } );
+  BenchmarkPrint( "ComposeMatrices", seconds, count, "matrices" );
+
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < count; ++i )
+      expectedVectors[ i ] = ReferenceTransform( lhs[ 0 ], vectors[ i ] );
+  } );
+  BenchmarkPrint( "Matrix4 * Vector4 scalar", seconds, count, "vectors" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < count; ++i )
+      actualVectors[ i ] = lhs[ 0 ] * vectors[ i ];
+  } );
+  BenchmarkPrint( "Matrix4 * Vector4", seconds, count, "vectors" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    TransformVectors( lhs[ 0 ], vectors.data(), actualVectors.data(), count );
+  } );
+  BenchmarkPrint( "TransformVectors", seconds, count, "vectors" );
+}
+
+struct GameUpdateState
+{
+  Vector2 characterPosition;
+  Vector2 characterVelocity;
+  Vector2 textPosition;
+  float textScale;
+  Matrix4 world;
+  Matrix4 view;
+  Matrix4 textWorld;
+};
+
+// The math Game::Update does each frame, without the d3d calls around it
+static void GameUpdateMath( GameUpdateState* state, double elapsedSeconds, bool right, bool up )
+{
+  const float dt = 1 / 60.0f;
+  Vector2 inputDir( right ? 1.0f : 0.0f, up ? 1.0f : 0.0f );
+  float maxSpeed = 10;
+  float accel = 30.0f;
+  Vector2 accelVec = accel * inputDir;
+  float curSpeed = state->characterVelocity.Length();
+  if( inputDir.IsZero() && curSpeed > 0.1f )
+    accelVec += -( state->characterVelocity / curSpeed ) * 20;
+  state->characterVelocity += accelVec * dt;
+  state->characterPosition += state->characterVelocity * dt;
+  if( curSpeed > maxSpeed )
+    state->characterVelocity *= maxSpeed / curSpeed;
+  state->characterVelocity *= 0.99f;
+
+  float characterRadius = 5.0f + 0.05f * ( float )std::sin( elapsedSeconds * 1.0f );
+  state->world = Matrix4( Affine2::TranslateRotateScale(
+    state->characterPosition,
+    0,
+    Vector2( characterRadius, characterRadius ) ) );
+
+  float aspectRatio = 16.0f / 9.0f;
+  float cameraWidth = 10.0f;
+  float cameraHeight = cameraWidth / aspectRatio;
+  Vector2 cameraPosition( 0, 0 );
+  Affine2 view
+    = Affine2::Scale( 1.0f / cameraWidth, 1.0f / cameraHeight )
+    * Affine2::Rotate( -0.0f )
+    * Affine2::Translate( -cameraPosition );
+  state->view = Matrix4( view );
+  state->textWorld = Matrix4(
+    Affine2::Translate( state->textPosition ) *
+    Affine2::Scale( state->textScale ) );
+}
+
+void BenchmarkGameUpdateMath()
+{
+  const int frameCount = 10000;
+  GameUpdateState state = {};
+  state.textScale = 3;
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < frameCount; ++i )
+      GameUpdateMath( &state, i / 60.0, ( i & 64 ) != 0, ( i & 128 ) != 0 );
+  } );
+  BenchmarkPrint( "Game::Update math", seconds, frameCount, "frames" );
+}
@@ -0,0 +1,91 @@
+#include "benchmark.h"
+#include "mipmap.h"
+#include <cstdio>
+
+static void BenchmarkMipChain(
+  const char* name,
+  std::vector< uint8_t >& pixels,
+  int size,
+  int channelCount,
+  MipSettings settings )
+{
+  MipChain chain;
+  int levelCount = GetMipLevelCount( size, size );
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    GenerateMipChain(
+      &chain,
+      pixels.data(),
+      size,
+      size,
+      size * channelCount,
+      channelCount,
+      settings );
+  } );
+  // level 0 is a copy, so it doesn't count as a generated mip
+  BenchmarkPrint( name, seconds, levelCount - 1.0, "mips" );
+}
+
+// A bright last column in a 5 x 5 has to come through in the 2 x 2, and
+// a flat color has to stay flat at every odd size on the way down
+static bool CheckOddSizes()
+{
+  bool isOk = true;
+  std::vector< uint8_t > column( 5 * 5, 0 );
+  for( int y = 0; y < 5; ++y )
+    column[ y * 5 + 4 ] = 255;
+  MipSettings settings;
+  settings.sRGB = false;
+  for( MipFilter filter : { MipFilter::Box, MipFilter::Tent } )
+  {
+    settings.filter = filter;
+    MipChain chain;
+    GenerateMipChain( &chain, column.data(), 5, 5, 5, 1, settings );
+    const uint8_t* level = chain.GetLevelBytes( 1 );
+    isOk &= level[ 1 ] > level[ 0 ] && level[ 3 ] > level[ 2 ] && level[ 1 ] > 0;
+    // Box keeps the average, 255 / 5
+    if( filter == MipFilter::Box )
+      isOk &= level[ 0 ] == 0 && std::abs( ( level[ 0 ] + level[ 1 ] ) / 2 - 51 ) <= 1;
+  }
+
+  std::vector< uint8_t > flat( 7 * 5 * 4, 200 );
+  for( bool isSrgb : { false, true } )
+    for( MipFilter filter : { MipFilter::Box, MipFilter::Tent } )
+    {
+      settings.sRGB = isSrgb;
+      settings.filter = filter;
+      MipChain chain;
+      GenerateMipChain( &chain, flat.data(), 7, 5, 7 * 4, 4, settings );
+      for( uint8_t value : chain.bytes )
+        isOk &= std::abs( value - 200 ) <= 1;
+    }
+  return isOk;
+}
+
+void BenchmarkMipmap()
+{
+  BenchmarkCheck( "mip odd sizes keep the edge", CheckOddSizes() );
+
+  const int size = 1024;
+  std::vector< uint8_t > pixels( size * size * 4 );
+  uint32_t state = 1;
+  for( uint8_t& pixel : pixels )
+  {
+    state = state * 1664525 + 1013904223;
+    pixel = ( uint8_t )( state >> 24 );
+  }
+
+  MipSettings settings;
+  settings.sRGB = false;
+  settings.filter = MipFilter::Box;
+  BenchmarkMipChain( "mip 1024 r8 box", pixels, size, 1, settings );
+  BenchmarkMipChain( "mip 1024 r8g8b8a8 box", pixels, size, 4, settings );
+  settings.filter = MipFilter::Tent;
+  BenchmarkMipChain( "mip 1024 r8 tent", pixels, size, 1, settings );
+  BenchmarkMipChain( "mip 1024 r8g8b8a8 tent", pixels, size, 4, settings );
+  settings.sRGB = true;
+  settings.filter = MipFilter::Box;
+  BenchmarkMipChain( "mip 1024 r8g8b8a8 srgb box", pixels, size, 4, settings );
+  settings.filter = MipFilter::Tent;
+  BenchmarkMipChain( "mip 1024 r8g8b8a8 srgb tent", pixels, size, 4, settings );
+}
@@ -0,0 +1,204 @@
+#include "benchmark.h"
+#include "particles.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static float RandomRange( uint32_t& state, float size )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 24 ) * size;
+}
+
+struct ReferenceParticle
+{
+  float positionX;
+  float positionY;
+  float velocityX;
+  float velocityY;
+  float age;
+  float ageRate;
+};
+
+// Same math and the same swap order as ParticleSystem, one particle at a time
+static void ReferenceUpdate( std::vector< ReferenceParticle >& particles, const ParticleSettings& settings, float dt )
+{
+  float drag = std::max( 0.0f, 1 - settings.drag * dt );
+  for( ReferenceParticle& p : particles )
+  {
+    p.velocityX = ( p.velocityX + settings.gravity.x * dt ) * drag;
+    p.velocityY = ( p.velocityY + settings.gravity.y * dt ) * drag;
+    p.positionX += p.velocityX * dt;
+    p.positionY += p.velocityY * dt;
+    p.age += p.ageRate * dt;
+  }
+  for( size_t i = 0; i < particles.size(); )
+  {
+    if( particles[ i ].age > 1 )
+    {
+      particles[ i ] = particles.back();
+      particles.pop_back();
+    }
+    else
+      ++i;
+  }
+}
+
+static uint32_t ReferenceColor( const ParticleSettings& settings, float age )
+{
+  age = std::min( age, 1.0f );
+  uint32_t result = 0;
+  for( int channel = 0; channel < 4; ++channel )
+  {
+    float start = settings.startColor[ channel ] * 255 + 0.5f;
+    float delta = ( settings.endColor[ channel ] - settings.startColor[ channel ] ) * 255;
+    result |= ( uint32_t )( start + age * delta ) << ( 8 * channel );
+  }
+  return result;
+}
+
+static bool CheckParticles()
+{
+  const int count = 1001;
+  ParticleSettings settings;
+  settings.startColor = Color4( 1, 0.5f, 0.25f, 1 );
+  settings.endColor = Color4( 0, 1, 0.75f, 0 );
+  ParticleSystem system( count, settings );
+  std::vector< ReferenceParticle > reference;
+  uint32_t state = 31;
+  for( int i = 0; i < count; ++i )
+  {
+    Vector2 position( RandomRange( state, 10 ), RandomRange( state, 10 ) );
+    Vector2 velocity( RandomRange( state, 4 ) - 2, RandomRange( state, 4 ) - 2 );
+    float lifetime = 0.05f + RandomRange( state, 1 );
+    system.Spawn( position, velocity, lifetime );
+    reference.push_back( ReferenceParticle{ position.x, position.y, velocity.x, velocity.y, 0, 1 / lifetime } );
+  }
+  bool isOk = !system.Spawn( Vector2( 0, 0 ), Vector2( 0, 0 ), 1 );
+
+  // Everything, then the middle of the square
+  Aabb everything = { Vector2( -1e9f, -1e9f ), Vector2( 1e9f, 1e9f ) };
+  Aabb middle = { Vector2( 3, 4 ), Vector2( 6, 5 ) };
+  std::vector< ParticleInstance > instances( count );
+  std::vector< ParticleInstance > culled( count );
+  for( int frame = 0; frame < 40; ++frame )
+  {
+    system.Update( 1 / 60.0f );
+    ReferenceUpdate( reference, settings, 1 / 60.0f );
+    isOk &= system.mCount == ( int )reference.size();
+    if( system.mCount != ( int )reference.size() )
+      break;
+    isOk &= system.WriteInstances( instances.data(), everything ) == system.mCount;
+    int culledCount = system.WriteInstances( culled.data(), middle );
+    int expectedCulledCount = 0;
+    for( int i = 0; i < system.mCount; ++i )
+    {
+      const ReferenceParticle& p = reference[ i ];
+      isOk &= system.mPositionX[ i ] == p.positionX && system.mPositionY[ i ] == p.positionY
+        && system.mVelocityX[ i ] == p.velocityX && system.mVelocityY[ i ] == p.velocityY
+        && system.mAge[ i ] == p.age;
+      float size = settings.startSize + std::min( p.age, 1.0f ) * ( settings.endSize - settings.startSize );
+      isOk &= instances[ i ].position.x == p.positionX && instances[ i ].position.y == p.positionY
+        && instances[ i ].size == size && instances[ i ].color == ReferenceColor( settings, p.age );
+
+      // Culling keeps the order
+      const ParticleInstance& instance = instances[ i ];
+      if( instance.position.x + size >= middle.min.x && instance.position.x - size <= middle.max.x
+        && instance.position.y + size >= middle.min.y && instance.position.y - size <= middle.max.y )
+      {
+        isOk &= expectedCulledCount < culledCount
+          && std::memcmp( &culled[ expectedCulledCount ], &instance, sizeof( instance ) ) == 0;
+        ++expectedCulledCount;
+      }
+    }
+    isOk &= culledCount == expectedCulledCount;
+  }
+  // Some died along the way, but not all of them
+  isOk &= system.mCount > 0 && system.mCount < count / 2;
+
+  // Emitters keep up with their rate
+  ParticleSystem emitted( 10000, settings );
+  ParticleEmitter emitter;
+  emitter.rate = 600;
+  emitter.lifetime = 100;
+  emitted.mEmitters.push_back( emitter );
+  for( int frame = 0; frame < 60; ++frame )
+    emitted.Update( 1 / 60.0f );
+  isOk &= emitted.mCount >= 599 && emitted.mCount <= 600;
+  return isOk;
+}
+
+void BenchmarkParticles()
+{
+  BenchmarkCheck( "particles vs scalar", CheckParticles() );
+
+  // A million live particles, with an emitter that replaces them as fast as
+  // they die. Ages start spread out, so about as many die every frame
+  const int liveCount = 1000000;
+  const float lifetime = 2;
+  const float dt = 1 / 60.0f;
+  ParticleSettings settings;
+  ParticleSystem system( liveCount + liveCount / 10, settings );
+  uint32_t state = 32;
+  for( int i = 0; i < liveCount; ++i )
+  {
+    Vector2 position( RandomRange( state, 100 ), RandomRange( state, 100 ) );
+    Vector2 velocity( RandomRange( state, 4 ) - 2, RandomRange( state, 4 ) - 2 );
+    system.Spawn( position, velocity, lifetime );
+    system.mAge[ i ] = RandomRange( state, 1 );
+  }
+  ParticleEmitter emitter;
+  emitter.position = Vector2( 50, 50 );
+  emitter.rate = liveCount / lifetime;
+  emitter.lifetime = lifetime;
+  system.mEmitters.push_back( emitter );
+
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    system.Update( dt );
+  } );
+  BenchmarkPrint( va( "particles %i update", system.mCount ), seconds, system.mCount, "particles" );
+
+  // The same frames again, split into their two halves, so integrate runs on
+  // the same state with the same deaths as the update above and the two add
+  // up to it. Integrate on its own with dt 0 wasn't comparable, nothing died
+  typedef std::chrono::high_resolution_clock Clock;
+  std::chrono::duration< double > integrateElapsed( 0 );
+  std::chrono::duration< double > emitElapsed( 0 );
+  int frameCount = 0;
+  long long deathCount = 0;
+  BenchmarkSecondsPerCall( [ & ]()
+  {
+    int countBefore = system.mCount;
+    Clock::time_point begin = Clock::now();
+    system.Integrate( dt );
+    Clock::time_point integrated = Clock::now();
+    deathCount += countBefore - system.mCount;
+    system.Emit( &system.mEmitters[ 0 ], dt );
+    Clock::time_point emitted = Clock::now();
+    integrateElapsed += integrated - begin;
+    emitElapsed += emitted - integrated;
+    ++frameCount;
+  } );
+  BenchmarkPrint( va( "particles %i integrate", system.mCount ), integrateElapsed.count() / frameCount, system.mCount, "particles" );
+  BenchmarkPrint( va( "particles %i emit", system.mCount ), emitElapsed.count() / frameCount, ( double )deathCount / frameCount, "spawns" );
+  std::printf( "%-40s %lld\n", "particles died per frame", deathCount / frameCount );
+
+  // The camera sees part of the cloud around the emitter and some empty
+  // space, so there are full, partly visible and skipped blocks
+  std::vector< ParticleInstance > instances( system.mCapacity );
+  Aabb everything = { Vector2( -1e9f, -1e9f ), Vector2( 1e9f, 1e9f ) };
+  Aabb view = { Vector2( 30, 45 ), Vector2( 50, 55 ) };
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    system.WriteInstances( instances.data(), everything );
+  } );
+  BenchmarkPrint( va( "particles %i write instances", system.mCount ), seconds, system.mCount, "particles" );
+  int visibleCount = 0;
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    visibleCount = system.WriteInstances( instances.data(), view );
+  } );
+  BenchmarkPrint( va( "particles %i write culled", system.mCount ), seconds, system.mCount, "particles" );
+  std::printf( "%-40s %i of %i\n", "particles culled visible", visibleCount, system.mCount );
+}
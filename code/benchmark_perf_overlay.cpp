@@ -0,0 +1,127 @@
+#include "benchmark.h"
+#include "perf_overlay.h"
+#include <cstdio>
+#include <cstring>
+
+// Every printable character an 8 x 12 box in a 128 x 128 atlas
+static void MakeFont( stbtt_packedchar* glyphs, OverlayFont* font )
+{
+  std::memset( glyphs, 0, 128 * sizeof( stbtt_packedchar ) );
+  for( int c = 0; c < 128; ++c )
+  {
+    stbtt_packedchar& glyph = glyphs[ c ];
+    glyph.xadvance = 9;
+    if( c <= ' ' )
+      continue;
+    glyph.x0 = ( unsigned short )( c % 16 * 8 );
+    glyph.y0 = ( unsigned short )( c / 16 * 12 );
+    glyph.x1 = glyph.x0 + 8;
+    glyph.y1 = glyph.y0 + 12;
+    glyph.yoff = -10;
+    glyph.xoff2 = 8;
+    glyph.yoff2 = 2;
+  }
+  font->glyphs = glyphs;
+  font->atlasWidth = 128;
+  font->atlasHeight = 128;
+  font->ascent = 10;
+  font->lineHeight = 14;
+}
+
+static const int overlayScopeNameCount = 4;
+static const char* overlayScopeNames[ overlayScopeNameCount ] = {
+  "overlay update",
+  "overlay simulate",
+  "overlay cull",
+  "overlay draw",
+};
+
+// What a frame of the game records, more or less
+static void RecordFrame( int eventCount )
+{
+  uint64_t timestamp = ProfileTimestamp();
+  for( int i = 0; i < eventCount; ++i )
+    ProfileRecord( overlayScopeNames[ i % overlayScopeNameCount ], timestamp, timestamp + 1000 );
+}
+
+static bool CheckPerfOverlay( const OverlayFont& font )
+{
+  bool isOk = true;
+  PerfOverlay overlay;
+  overlay.mIsVisible = true;
+  PerfOverlayCounters counters;
+  counters.drawCount = 3;
+  counters.residentBytes = 5 * 1024 * 1024;
+  overlay.Update( counters );
+  RecordFrame( 8 );
+  overlay.Update( counters );
+
+  // Only what was recorded since the last update, one entry per name
+  int foundCount = 0;
+  for( int i = 0; i < overlay.mScopeCount; ++i )
+    for( const char* name : overlayScopeNames )
+      if( overlay.mScopes[ i ].name == name )
+      {
+        ++foundCount;
+        isOk &= overlay.mScopes[ i ].callCount == 2 && overlay.mScopes[ i ].milliseconds > 0;
+      }
+  isOk &= foundCount == overlayScopeNameCount;
+  isOk &= overlay.mFrameMilliseconds[ overlay.mNewestFrame ] > 0;
+
+  // The background goes first and everything else is inside it
+  std::vector< OverlayQuad > quads( PerfOverlay::quadCapacity );
+  int quadCount = overlay.WriteQuads( quads.data(), font, 1 );
+  const OverlayQuad& panel = quads[ 0 ];
+  isOk &= quadCount > PerfOverlay::frameCapacity && panel.uvMin.x < 0;
+  for( int i = 1; i < quadCount; ++i )
+  {
+    const OverlayQuad& quad = quads[ i ];
+    isOk &= quad.min.x >= panel.min.x && quad.min.y >= panel.min.y;
+    isOk &= quad.max.x <= panel.max.x && quad.max.y <= panel.max.y;
+    isOk &= quad.uvMin.x < 0 || ( quad.uvMax.x <= 1 && quad.uvMax.y <= 1 );
+  }
+
+  // Hidden, the events get skipped rather than piling up for later
+  overlay.mIsVisible = false;
+  RecordFrame( 8 );
+  overlay.Update( counters );
+  overlay.mIsVisible = true;
+  overlay.Update( counters );
+  for( int i = 0; i < overlay.mScopeCount; ++i )
+    isOk &= overlay.mScopes[ i ].callCount == 0;
+  return isOk;
+}
+
+void BenchmarkPerfOverlay()
+{
+  stbtt_packedchar glyphs[ 128 ];
+  OverlayFont font;
+  MakeFont( glyphs, &font );
+  BenchmarkCheck( "perf overlay scopes and layout", CheckPerfOverlay( font ) );
+
+  // A frame's worth of events and every scope slot in use
+  static const char* names[ PerfOverlay::scopeCapacity ];
+  static char nameBytes[ PerfOverlay::scopeCapacity ][ 32 ];
+  for( int i = 0; i < PerfOverlay::scopeCapacity; ++i )
+  {
+    std::snprintf( nameBytes[ i ], sizeof( nameBytes[ i ] ), "Benchmark scope %i", i );
+    names[ i ] = nameBytes[ i ];
+  }
+  PerfOverlay overlay;
+  overlay.mIsVisible = true;
+  PerfOverlayCounters counters;
+  const int eventCount = 200;
+  std::vector< OverlayQuad > quads( PerfOverlay::quadCapacity );
+  int quadCount = 0;
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    uint64_t timestamp = ProfileTimestamp();
+    for( int i = 0; i < eventCount; ++i )
+      ProfileRecord( names[ i % PerfOverlay::scopeCapacity ], timestamp, timestamp + 1000 );
+    overlay.Update( counters );
+    quadCount = overlay.WriteQuads( quads.data(), font, 1 );
+    BenchmarkKeep( quads[ quadCount - 1 ].color );
+  } );
+  BenchmarkPrint( "perf overlay update + quads", seconds, quadCount, "quads" );
+  BenchmarkCheck( "perf overlay under 0.1 ms", seconds < 0.0001 );
+}
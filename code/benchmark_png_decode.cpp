@@ -0,0 +1,295 @@
+#include "benchmark.h"
+#include "stb_image.h"
+#include <cstdio>
+#include <cstring>
+
+// In benchmark_png_scalar.cpp
+unsigned char* BenchmarkLoadPngScalar( const unsigned char* bytes, int byteCount, int* width, int* height, int* channels, int requestedChannels );
+void BenchmarkFreePngScalar( unsigned char* pixels );
+
+static uint32_t PngCrc( const uint8_t* bytes, size_t byteCount, uint32_t crc = 0 )
+{
+  static uint32_t table[ 256 ];
+  if( !table[ 1 ] )
+    for( uint32_t i = 0; i < 256; ++i )
+    {
+      uint32_t c = i;
+      for( int bit = 0; bit < 8; ++bit )
+        c = c & 1 ? 0xedb88320u ^ ( c >> 1 ) : c >> 1;
+      table[ i ] = c;
+    }
+  crc = ~crc;
+  for( size_t i = 0; i < byteCount; ++i )
+    crc = table[ ( crc ^ bytes[ i ] ) & 0xff ] ^ ( crc >> 8 );
+  return ~crc;
+}
+
+static void PngPutU32( std::vector< uint8_t >* bytes, uint32_t value )
+{
+  bytes->push_back( ( uint8_t )( value >> 24 ) );
+  bytes->push_back( ( uint8_t )( value >> 16 ) );
+  bytes->push_back( ( uint8_t )( value >> 8 ) );
+  bytes->push_back( ( uint8_t )value );
+}
+
+static void PngPutChunk( std::vector< uint8_t >* png, const char* type, const std::vector< uint8_t >& data )
+{
+  PngPutU32( png, ( uint32_t )data.size() );
+  size_t typeOffset = png->size();
+  png->insert( png->end(), type, type + 4 );
+  png->insert( png->end(), data.begin(), data.end() );
+  PngPutU32( png, PngCrc( png->data() + typeOffset, png->size() - typeOffset ) );
+}
+
+static int PngPaeth( int a, int b, int c )
+{
+  int p = a + b - c;
+  int pa = p > a ? p - a : a - p;
+  int pb = p > b ? p - b : b - p;
+  int pc = p > c ? p - c : c - p;
+  return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// An 8-bit png with row j filtered by filters[ j % filterCount ], and the
+// deflate stream stored rather than compressed. Decoding it is then almost
+// all unfiltering, which is what the benchmark is after
+static std::vector< uint8_t > EncodePng( const uint8_t* pixels, int width, int height, int channels, const int* filters, int filterCount )
+{
+  int rowBytes = width * channels;
+  std::vector< uint8_t > filtered;
+  filtered.reserve( ( size_t )( rowBytes + 1 ) * height );
+  for( int y = 0; y < height; ++y )
+  {
+    int filter = filters[ y % filterCount ];
+    const uint8_t* row = pixels + ( size_t )y * rowBytes;
+    const uint8_t* prior = y ? row - rowBytes : nullptr;
+    filtered.push_back( ( uint8_t )filter );
+    for( int k = 0; k < rowBytes; ++k )
+    {
+      int a = k >= channels ? row[ k - channels ] : 0;
+      int b = prior ? prior[ k ] : 0;
+      int c = prior && k >= channels ? prior[ k - channels ] : 0;
+      int predicted = filter == 1 ? a : filter == 2 ? b : filter == 3 ? ( a + b ) >> 1 : filter == 4 ? PngPaeth( a, b, c ) : 0;
+      filtered.push_back( ( uint8_t )( row[ k ] - predicted ) );
+    }
+  }
+
+  std::vector< uint8_t > zlib = { 0x78, 0x01 };
+  const size_t storedCapacity = 65535;
+  for( size_t offset = 0; offset < filtered.size(); offset += storedCapacity )
+  {
+    size_t length = filtered.size() - offset < storedCapacity ? filtered.size() - offset : storedCapacity;
+    zlib.push_back( offset + length == filtered.size() ? 1 : 0 );
+    zlib.push_back( ( uint8_t )length );
+    zlib.push_back( ( uint8_t )( length >> 8 ) );
+    zlib.push_back( ( uint8_t )~length );
+    zlib.push_back( ( uint8_t )( ~length >> 8 ) );
+    zlib.insert( zlib.end(), filtered.begin() + offset, filtered.begin() + offset + length );
+  }
+  uint32_t s1 = 1;
+  uint32_t s2 = 0;
+  for( uint8_t byte : filtered )
+  {
+    s1 = ( s1 + byte ) % 65521;
+    s2 = ( s2 + s1 ) % 65521;
+  }
+  PngPutU32( &zlib, s2 << 16 | s1 );
+
+  static const uint8_t colorTypes[] = { 0, 0, 4, 2, 6 };
+  std::vector< uint8_t > header;
+  PngPutU32( &header, width );
+  PngPutU32( &header, height );
+  header.push_back( 8 );
+  header.push_back( colorTypes[ channels ] );
+  header.push_back( 0 );
+  header.push_back( 0 );
+  header.push_back( 0 );
+
+  std::vector< uint8_t > png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  PngPutChunk( &png, "IHDR", header );
+  PngPutChunk( &png, "IDAT", zlib );
+  PngPutChunk( &png, "IEND", std::vector< uint8_t >() );
+  return png;
+}
+
+// Something like a sprite, smooth shading with some noise and a soft edge,
+// so paeth doesn't always pick the same neighbour
+static std::vector< uint8_t > MakeSpritePixels( int width, int height, int channels )
+{
+  std::vector< uint8_t > pixels( ( size_t )width * height * channels );
+  uint32_t random = 12345;
+  for( int y = 0; y < height; ++y )
+    for( int x = 0; x < width; ++x )
+    {
+      float dx = ( x + 0.5f ) / width - 0.5f;
+      float dy = ( y + 0.5f ) / height - 0.5f;
+      float edge = 1 - ( dx * dx + dy * dy ) * 4;
+      edge = edge < 0 ? 0 : edge;
+      uint8_t* pixel = &pixels[ ( ( size_t )y * width + x ) * channels ];
+      for( int c = 0; c < channels; ++c )
+      {
+        random = random * 1664525u + 1013904223u;
+        int noise = ( int )( random >> 28 ) - 8;
+        int value = c == 3 ? ( int )( edge * 255 ) : ( int )( edge * ( 120 + c * 60 ) ) + ( x * ( c + 1 ) + y * 3 ) % 64 + noise;
+        pixel[ c ] = ( uint8_t )( value < 0 ? 0 : value > 255 ? 255 : value );
+      }
+    }
+  return pixels;
+}
+
+struct PngCorpusEntry
+{
+  char name[ 64 ];
+  std::vector< uint8_t > png;
+  std::vector< uint8_t > pixels;
+  int channels;
+};
+
+static bool IsDecodedSame( const std::vector< uint8_t >& png, const uint8_t* expected, int requestedChannels )
+{
+  int width, height, channels;
+  stbi_uc* pixels = stbi_load_from_memory( png.data(), ( int )png.size(), &width, &height, &channels, requestedChannels );
+  stbi_uc* scalar = BenchmarkLoadPngScalar( png.data(), ( int )png.size(), &width, &height, &channels, requestedChannels );
+  int outChannels = requestedChannels ? requestedChannels : channels;
+  size_t byteCount = ( size_t )width * height * outChannels;
+  bool isOk = pixels && scalar && std::memcmp( pixels, scalar, byteCount ) == 0;
+  if( isOk && expected )
+    isOk = std::memcmp( pixels, expected, byteCount ) == 0;
+  stbi_image_free( pixels );
+  BenchmarkFreePngScalar( scalar );
+  return isOk;
+}
+
+static std::vector< uint8_t > AddAlpha( const std::vector< uint8_t >& pixels )
+{
+  std::vector< uint8_t > rgba;
+  rgba.reserve( pixels.size() / 3 * 4 );
+  for( size_t i = 0; i < pixels.size(); i += 3 )
+  {
+    rgba.insert( rgba.end(), pixels.begin() + i, pixels.begin() + i + 3 );
+    rgba.push_back( 255 );
+  }
+  return rgba;
+}
+
+static bool CheckPngDecode( const std::vector< PngCorpusEntry >& corpus )
+{
+  bool isOk = true;
+  for( const PngCorpusEntry& entry : corpus )
+  {
+    const uint8_t* expected = entry.pixels.empty() ? nullptr : entry.pixels.data();
+    bool isEntryOk = IsDecodedSame( entry.png, expected, 0 );
+    // The atlas loads everything as rgba, which adds alpha while unfiltering
+    if( entry.channels == 3 )
+    {
+      std::vector< uint8_t > rgba = AddAlpha( entry.pixels );
+      isEntryOk &= IsDecodedSame( entry.png, rgba.data(), 4 );
+    }
+    else
+      isEntryOk &= IsDecodedSame( entry.png, nullptr, 4 );
+    if( !isEntryOk )
+      std::printf( "  %s decoded differently\n", entry.name );
+    isOk &= isEntryOk;
+  }
+
+  // Odd widths leave a tail after the 16 byte steps, and 1 pixel wide rows
+  // have nothing after the first pixel
+  const int filters[] = { 0, 1, 2, 3, 4 };
+  const int widths[] = { 1, 2, 5, 17, 33, 101 };
+  for( int channels = 1; channels <= 4; ++channels )
+    for( int width : widths )
+    {
+      std::vector< uint8_t > pixels = MakeSpritePixels( width, 11, channels );
+      std::vector< uint8_t > png = EncodePng( pixels.data(), width, 11, channels, filters, 5 );
+      isOk &= IsDecodedSame( png, pixels.data(), 0 );
+      isOk &= IsDecodedSame( png, nullptr, 4 );
+    }
+  return isOk;
+}
+
+static double DecodeSeconds( const std::vector< uint8_t >& png, bool isScalar, int requestedChannels )
+{
+  return BenchmarkSecondsPerCall( [ & ]()
+  {
+    int width, height, channels;
+    if( isScalar )
+    {
+      stbi_uc* pixels = BenchmarkLoadPngScalar( png.data(), ( int )png.size(), &width, &height, &channels, requestedChannels );
+      BenchmarkKeep( pixels[ 0 ] );
+      BenchmarkFreePngScalar( pixels );
+    }
+    else
+    {
+      stbi_uc* pixels = stbi_load_from_memory( png.data(), ( int )png.size(), &width, &height, &channels, requestedChannels );
+      BenchmarkKeep( pixels[ 0 ] );
+      stbi_image_free( pixels );
+    }
+  }, 0.1 );
+}
+
+void BenchmarkPngDecode()
+{
+  // Every filter on every other row, at the sizes the atlas pages and
+  // sprites come in
+  static const char* channelNames[] = { "", "gray", "gray alpha", "rgb", "rgba" };
+  const int mixedFilters[] = { 0, 1, 2, 3, 4 };
+  const int sizes[] = { 64, 256, 1024 };
+  std::vector< PngCorpusEntry > corpus;
+  for( int channels : { 1, 3, 4 } )
+    for( int size : sizes )
+    {
+      PngCorpusEntry entry;
+      std::snprintf( entry.name, sizeof( entry.name ), "%s %i", channelNames[ channels ], size );
+      entry.pixels = MakeSpritePixels( size, size, channels );
+      entry.png = EncodePng( entry.pixels.data(), size, size, channels, mixedFilters, 5 );
+      entry.channels = channels;
+      corpus.push_back( entry );
+    }
+  FILE* file = std::fopen( "data/star.png", "rb" );
+  if( file )
+  {
+    PngCorpusEntry entry;
+    std::snprintf( entry.name, sizeof( entry.name ), "star.png" );
+    std::fseek( file, 0, SEEK_END );
+    entry.png.resize( std::ftell( file ) );
+    std::fseek( file, 0, SEEK_SET );
+    entry.png.resize( std::fread( entry.png.data(), 1, entry.png.size(), file ) );
+    std::fclose( file );
+    entry.channels = 0;
+    corpus.push_back( entry );
+  }
+  BenchmarkCheck( "png decode simd matches scalar", CheckPngDecode( corpus ) );
+
+  // Each filter on its own, where the difference is
+  static const char* filterNames[] = { "none", "sub", "up", "avg", "paeth" };
+  const int filterSize = 512;
+  for( int channels : { 1, 3, 4 } )
+  {
+    std::vector< uint8_t > pixels = MakeSpritePixels( filterSize, filterSize, channels );
+    for( int filter = 1; filter < 5; ++filter )
+    {
+      std::vector< uint8_t > png = EncodePng( pixels.data(), filterSize, filterSize, channels, &filter, 1 );
+      double megabytes = pixels.size() / ( 1024.0 * 1024.0 );
+      char name[ 64 ];
+      std::snprintf( name, sizeof( name ), "png %s %s scalar", channelNames[ channels ], filterNames[ filter ] );
+      BenchmarkPrint( name, DecodeSeconds( png, true, 0 ), megabytes, "MB" );
+      std::snprintf( name, sizeof( name ), "png %s %s simd", channelNames[ channels ], filterNames[ filter ] );
+      BenchmarkPrint( name, DecodeSeconds( png, false, 0 ), megabytes, "MB" );
+    }
+  }
+
+  // The whole corpus, decoded the way the game loads it
+  double scalarSeconds = 0;
+  double simdSeconds = 0;
+  double megabytes = 0;
+  for( const PngCorpusEntry& entry : corpus )
+  {
+    int width, height, channels;
+    stbi_info_from_memory( entry.png.data(), ( int )entry.png.size(), &width, &height, &channels );
+    megabytes += width * height * 4 / ( 1024.0 * 1024.0 );
+    scalarSeconds += DecodeSeconds( entry.png, true, 4 );
+    simdSeconds += DecodeSeconds( entry.png, false, 4 );
+  }
+  BenchmarkPrint( "png corpus as rgba scalar", scalarSeconds, megabytes, "MB" );
+  BenchmarkPrint( "png corpus as rgba simd", simdSeconds, megabytes, "MB" );
+}
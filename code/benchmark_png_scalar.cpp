@@ -0,0 +1,23 @@
+// A second copy of stb_image with the simd paths compiled out, for the png
+// decode benchmark to check against and time
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_SIMD
+#define STBI_ONLY_PNG
+// stb_image isn't -Wextra clean. Its warnings are off, the way game.cpp turns them off for msvc
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wshift-negative-value"
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+#include "stb_image.h"
+#pragma GCC diagnostic pop
+
+unsigned char* BenchmarkLoadPngScalar( const unsigned char* bytes, int byteCount, int* width, int* height, int* channels, int requestedChannels )
+{
+  return stbi_load_from_memory( bytes, byteCount, width, height, channels, requestedChannels );
+}
+
+void BenchmarkFreePngScalar( unsigned char* pixels )
+{
+  stbi_image_free( pixels );
+}
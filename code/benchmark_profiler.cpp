@@ -0,0 +1,133 @@
+#include "benchmark.h"
+#include "profiler.h"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+static const char* benchmarkTracePath = "profiler_benchmark.json";
+
+static ProfileThreadBuffer* GetThreadBuffer()
+{
+  if( !profileThreadBuffer )
+    ProfilerAddThreadBuffer();
+  return profileThreadBuffer;
+}
+
+static bool IsBufferListed( ProfileThreadBuffer* buffer )
+{
+  for( ProfileThreadBuffer* listed = ProfilerGetThreadBuffers(); listed; listed = listed->next )
+    if( listed == buffer )
+      return true;
+  return false;
+}
+
+static bool CheckProfiler()
+{
+  bool isOk = true;
+  ProfileThreadBuffer* buffer = GetThreadBuffer();
+
+  // Scopes nest, the inner one closes first
+  uint32_t count = buffer->count;
+  {
+    PROFILE_SCOPE( "outer" );
+    PROFILE_SCOPE( "inner" );
+  }
+  const ProfileEvent& inner = buffer->events[ count % ProfileThreadBuffer::capacity ];
+  const ProfileEvent& outer = buffer->events[ ( count + 1 ) % ProfileThreadBuffer::capacity ];
+  isOk &= buffer->count == count + 2;
+  isOk &= std::strcmp( inner.name, "inner" ) == 0 && std::strcmp( outer.name, "outer" ) == 0;
+  isOk &= outer.begin <= inner.begin && inner.end <= outer.end;
+
+  // Past capacity the oldest get written over
+  for( uint32_t i = 0; i < ProfileThreadBuffer::capacity + 10; ++i )
+    ProfileRecord( "wrap", i, i + 1 );
+  const ProfileEvent& newest = buffer->events[ ( buffer->count - 1 ) % ProfileThreadBuffer::capacity ];
+  isOk &= newest.begin == ProfileThreadBuffer::capacity + 9;
+
+  // Every thread gets its own buffer
+  ProfileThreadBuffer* otherBuffer = nullptr;
+  std::thread thread( [ & ]()
+  {
+    ProfilerSetThreadName( "Profiler benchmark" );
+    PROFILE_SCOPE( "other thread" );
+    otherBuffer = profileThreadBuffer;
+  } );
+  thread.join();
+  isOk &= otherBuffer && otherBuffer != buffer && otherBuffer->count == 1;
+  isOk &= IsBufferListed( buffer ) && IsBufferListed( otherBuffer );
+
+  // The ticks are a real clock
+  double ticksPerMicrosecond = ProfilerGetTicksPerMicrosecond();
+  isOk &= ticksPerMicrosecond > 100 && ticksPerMicrosecond < 10000;
+
+  // The trace has the thread's name and its event
+  isOk &= ProfilerWriteTrace( benchmarkTracePath );
+  FILE* file = std::fopen( benchmarkTracePath, "rb" );
+  std::string trace;
+  if( file )
+  {
+    char chunk[ 4096 ];
+    size_t readCount;
+    while( ( readCount = std::fread( chunk, 1, sizeof( chunk ), file ) ) > 0 )
+      trace.append( chunk, readCount );
+    std::fclose( file );
+  }
+  isOk &= trace.find( "{\"displayTimeUnit\"" ) == 0;
+  isOk &= trace.find( "\"name\":\"Profiler benchmark\"" ) != std::string::npos;
+  isOk &= trace.find( "\"name\":\"other thread\"" ) != std::string::npos;
+  isOk &= trace.size() > 4 && trace.compare( trace.size() - 4, 4, "\n]}\n" ) == 0;
+  std::remove( benchmarkTracePath );
+  return isOk;
+}
+
+void BenchmarkProfiler()
+{
+  BenchmarkCheck( "profiler scopes and trace", CheckProfiler() );
+  GetThreadBuffer();
+
+  const int scopeCount = 1000;
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < scopeCount; ++i )
+    {
+      PROFILE_SCOPE( "benchmark" );
+      BenchmarkKeep( i );
+    }
+  } );
+  BenchmarkPrint( "profiler scope", seconds, scopeCount, "scopes" );
+
+  // The timestamp alone, what a scope can't get under
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    uint64_t sum = 0;
+    for( int i = 0; i < scopeCount; ++i )
+      sum += ProfileTimestamp();
+    BenchmarkKeep( sum );
+  } );
+  BenchmarkPrint( "profiler timestamp", seconds, scopeCount, "timestamps" );
+
+  // Threads recording at once shouldn't slow each other down. The threads
+  // stay up for the whole run, buffers are never freed
+  const int threadCount = 4;
+  double threadSeconds[ threadCount ];
+  std::thread threads[ threadCount ];
+  for( int iThread = 0; iThread < threadCount; ++iThread )
+    threads[ iThread ] = std::thread( [ &, iThread ]()
+    {
+      threadSeconds[ iThread ] = BenchmarkSecondsPerCall( [ & ]()
+      {
+        for( int i = 0; i < scopeCount; ++i )
+        {
+          PROFILE_SCOPE( "benchmark thread" );
+          BenchmarkKeep( i );
+        }
+      } );
+    } );
+  seconds = 0;
+  for( int iThread = 0; iThread < threadCount; ++iThread )
+  {
+    threads[ iThread ].join();
+    seconds += threadSeconds[ iThread ] / threadCount;
+  }
+  BenchmarkPrint( "profiler scope, 4 threads at once", seconds, scopeCount, "scopes" );
+}
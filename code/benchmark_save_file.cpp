@@ -0,0 +1,266 @@
+#include "benchmark.h"
+#include "entity.h"
+#include "tile_map.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* benchmarkSavePath = "save_file_benchmark.sav";
+
+static float RandomRange( uint32_t& state, float size )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 24 ) * size;
+}
+
+static void MakeWorld( EntityStore* store, TileMap* map, int entityCount, uint32_t& state )
+{
+  for( int i = 0; i < entityCount; ++i )
+  {
+    EntityId id = store->Add( Vector2( RandomRange( state, 1000 ), RandomRange( state, 1000 ) ) );
+    store->mVelocities.Set( store->GetIndex( id ), Vector2( RandomRange( state, 2 ), RandomRange( state, 2 ) ) );
+  }
+  // Holes in the slots, so the free list goes in the save too
+  for( int i = 0; i < entityCount; i += 10 )
+    store->Remove( store->mIds[ i ] );
+  for( int i = 0; i < map->mTileCountX * map->mTileCountY / 64; ++i )
+  {
+    int x = ( int )RandomRange( state, ( float )map->mTileCountX );
+    int y = ( int )RandomRange( state, ( float )map->mTileCountY );
+    map->FillRect( x, y, x + 3, y, true );
+  }
+}
+
+static bool IsSameStore( const EntityStore& a, const EntityStore& b )
+{
+  Snapshot snapshotA;
+  Snapshot snapshotB;
+  a.WriteSnapshot( &snapshotA );
+  b.WriteSnapshot( &snapshotB );
+  return snapshotA.mSize == snapshotB.mSize
+    && std::memcmp( snapshotA.mBytes.data(), snapshotB.mBytes.data(), snapshotA.mSize ) == 0;
+}
+
+static bool IsSameMap( const TileMap& a, const TileMap& b )
+{
+  for( int y = 0; y < a.mTileCountY; ++y )
+    for( int x = 0; x < a.mTileCountX; ++x )
+      if( a.IsSolid( x, y ) != b.IsSolid( x, y ) )
+        return false;
+  return true;
+}
+
+// Rewrites part of the saved file, then reopens it
+static bool OpensWith( const std::vector< uint8_t >& bytes, size_t offset, const void* patch, size_t patchByteCount, size_t byteCount )
+{
+  std::vector< uint8_t > patched( bytes.begin(), bytes.begin() + byteCount );
+  std::memcpy( patched.data() + offset, patch, patchByteCount );
+  FILE* file = std::fopen( benchmarkSavePath, "wb" );
+  std::fwrite( patched.data(), 1, patched.size(), file );
+  std::fclose( file );
+  SaveFile save;
+  return save.Open( benchmarkSavePath );
+}
+
+static bool CheckSaveFile()
+{
+  bool isOk = true;
+  uint32_t state = 47;
+  EntityStore store;
+  TileMap map( 300, 200, 1, Vector2( -5, -5 ) );
+  MakeWorld( &store, &map, 1000, state );
+  SaveWriter writer;
+  store.WriteSave( &writer );
+  map.WriteSave( &writer );
+  isOk &= writer.Write( benchmarkSavePath );
+
+  // Everything comes back, and sections are aligned in the mapped file
+  {
+    SaveFile save;
+    isOk &= save.Open( benchmarkSavePath );
+    EntityStore loadedStore;
+    TileMap loadedMap( 300, 200, 1, Vector2( -5, -5 ) );
+    TileMap wrongSizeMap( 301, 200, 1, Vector2( -5, -5 ) );
+    isOk &= loadedStore.ReadSave( save ) && IsSameStore( store, loadedStore );
+    isOk &= loadedMap.ReadSave( save ) && IsSameMap( map, loadedMap );
+    isOk &= !wrongSizeMap.ReadSave( save );
+    for( EntityId id : store.mIds )
+      isOk &= loadedStore.IsAlive( id );
+    int count;
+    const float* positionX = save.GetSection< float >( SaveTag( 'E', 'P', 'X', ' ' ), &count );
+    isOk &= positionX && ( ( uintptr_t )positionX & 63 ) == 0 && count == store.GetCount();
+    // Wrong element size, and missing
+    isOk &= !save.GetSection< double >( SaveTag( 'E', 'P', 'X', ' ' ), &count ) && count == 0;
+    isOk &= !save.GetSection< float >( SaveTag( 'N', 'O', 'P', 'E' ), &count );
+  }
+
+  // Anything malformed doesn't open
+  std::vector< uint8_t > bytes;
+  {
+    PlatformMappedFile file;
+    PlatformMapFile( benchmarkSavePath, &file );
+    bytes.assign( ( const uint8_t* )file.bytes, ( const uint8_t* )file.bytes + file.byteCount );
+    PlatformUnmapFile( &file );
+  }
+  uint32_t badVersion = saveFileVersion + 1;
+  uint64_t hugeCount = 1ull << 62;
+  uint64_t misalignedOffset = ( ( const SaveSection* )( bytes.data() + sizeof( SaveHeader ) ) )->offset + 4;
+  size_t firstSection = sizeof( SaveHeader );
+  isOk &= OpensWith( bytes, 0, bytes.data(), 0, bytes.size() );
+  isOk &= !OpensWith( bytes, 0, bytes.data(), 0, bytes.size() - 64 );
+  isOk &= !OpensWith( bytes, 0, bytes.data(), 0, 8 );
+  isOk &= !OpensWith( bytes, offsetof( SaveHeader, version ), &badVersion, sizeof( badVersion ), bytes.size() );
+  isOk &= !OpensWith( bytes, firstSection + offsetof( SaveSection, elementCount ), &hugeCount, sizeof( hugeCount ), bytes.size() );
+  isOk &= !OpensWith( bytes, firstSection + offsetof( SaveSection, offset ), &misalignedOffset, sizeof( misalignedOffset ), bytes.size() );
+  std::remove( benchmarkSavePath );
+  return isOk;
+}
+
+// Saves that open fine but whose indexes point nowhere, each broken one way
+// and put back after
+static bool CheckBadIndexes()
+{
+  uint32_t state = 49;
+  EntityStore store;
+  TileMap map( 300, 200, 1, Vector2( -5, -5 ) );
+  MakeWorld( &store, &map, 100, state );
+  auto isRejected = [ & ]()
+  {
+    SaveWriter writer;
+    store.WriteSave( &writer );
+    map.WriteSave( &writer );
+    writer.Write( benchmarkSavePath );
+    SaveFile save;
+    save.Open( benchmarkSavePath );
+    // Left alone, not half loaded
+    EntityStore loadedStore;
+    EntityId kept = loadedStore.Add( Vector2( 1, 2 ) );
+    TileMap loadedMap( 300, 200, 1, Vector2( -5, -5 ) );
+    loadedMap.SetSolid( 7, 8, true );
+    bool isStoreRejected = !loadedStore.ReadSave( save )
+      && loadedStore.GetCount() == 1 && loadedStore.IsAlive( kept );
+    bool isMapRejected = !loadedMap.ReadSave( save ) && loadedMap.IsSolid( 7, 8 )
+      && loadedMap.mChunks.size() == 1;
+    return isStoreRejected || isMapRejected;
+  };
+  bool isOk = !isRejected();
+
+  int count = store.GetCount();
+  uint32_t slotCount = ( uint32_t )store.mSlots.size();
+  EntityId id = store.mIds[ 5 ];
+  EntityStore::Slot slot = store.mSlots[ id.index ];
+  uint32_t firstFree = store.mFirstFree;
+  EntityStore::Slot freeSlot = store.mSlots[ firstFree ];
+  store.mIds[ 5 ].index = slotCount;
+  isOk &= isRejected();
+  store.mIds[ 5 ] = id;
+  store.mSlots[ id.index ].denseIndex = count;
+  isOk &= isRejected();
+  store.mSlots[ id.index ].denseIndex = 6;
+  isOk &= isRejected();
+  store.mSlots[ id.index ] = slot;
+  store.mFirstFree = slotCount;
+  isOk &= isRejected();
+  store.mFirstFree = firstFree;
+  store.mSlots[ firstFree ].nextFree = firstFree;
+  isOk &= isRejected();
+  store.mSlots[ firstFree ].nextFree = id.index;
+  isOk &= isRejected();
+  store.mSlots[ firstFree ] = freeSlot;
+  isOk &= !isRejected();
+
+  int chunk = 0;
+  while( map.mChunkIndexes[ chunk ] == -1 )
+    ++chunk;
+  int chunkIndex = map.mChunkIndexes[ chunk ];
+  map.mChunkIndexes[ chunk ] = ( int )map.mChunks.size();
+  isOk &= isRejected();
+  map.mChunkIndexes[ chunk ] = -2;
+  isOk &= isRejected();
+  map.mChunkIndexes[ chunk ] = chunkIndex;
+  isOk &= !isRejected();
+
+  // Clear really is empty, and usable after
+  store.Clear();
+  isOk &= store.GetCount() == 0 && store.mSlots.empty() && !store.IsAlive( id );
+  EntityId added = store.Add( Vector2( 3, 4 ) );
+  isOk &= added.index == 0 && store.IsAlive( added ) && store.mPositions.count == 1;
+  std::remove( benchmarkSavePath );
+  return isOk;
+}
+
+void BenchmarkSaveFile()
+{
+  BenchmarkCheck( "save file round trip", CheckSaveFile() );
+  BenchmarkCheck( "save file bad indexes rejected", CheckBadIndexes() );
+
+  // A million entities and a 4096 x 4096 tile room
+  uint32_t state = 48;
+  EntityStore store;
+  TileMap map( 4096, 4096, 1, Vector2( 0, 0 ) );
+  MakeWorld( &store, &map, 1000000, state );
+  SaveWriter writer;
+  store.WriteSave( &writer );
+  map.WriteSave( &writer );
+  writer.Write( benchmarkSavePath );
+  double megabytes = writer.mBytes.size() / ( 1024.0 * 1024.0 );
+  std::printf( "%-40s %.1f MB\n", "save file size", megabytes );
+
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    SaveWriter saveWriter;
+    store.WriteSave( &saveWriter );
+    map.WriteSave( &saveWriter );
+    saveWriter.Write( benchmarkSavePath );
+  } );
+  BenchmarkPrint( "save file write", seconds, megabytes, "MB" );
+
+  // The load itself, map and validate
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    SaveFile save;
+    save.Open( benchmarkSavePath );
+  } );
+  BenchmarkPrint( "save file open", seconds, megabytes, "MB" );
+
+  // Using a section in place, every page gets touched once
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    SaveFile save;
+    save.Open( benchmarkSavePath );
+    int count;
+    const float* positionX = save.GetSection< float >( SaveTag( 'E', 'P', 'X', ' ' ), &count );
+    float sum = 0;
+    for( int i = 0; i < count; ++i )
+      sum += positionX[ i ];
+    BenchmarkKeep( sum );
+  } );
+  BenchmarkPrint( "save file open + read positions in place", seconds, store.GetCount(), "entities" );
+
+  // Copied into live systems, one memcpy per section
+  EntityStore loadedStore;
+  TileMap loadedMap( 4096, 4096, 1, Vector2( 0, 0 ) );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    SaveFile save;
+    save.Open( benchmarkSavePath );
+    loadedStore.ReadSave( save );
+    loadedMap.ReadSave( save );
+  } );
+  BenchmarkPrint( "save file open + load into store", seconds, megabytes, "MB" );
+
+  // What reading it all up front would cost instead
+  std::vector< uint8_t > bytes;
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    FILE* file = std::fopen( benchmarkSavePath, "rb" );
+    std::fseek( file, 0, SEEK_END );
+    bytes.resize( ( size_t )std::ftell( file ) );
+    std::fseek( file, 0, SEEK_SET );
+    size_t readCount = std::fread( bytes.data(), 1, bytes.size(), file );
+    BenchmarkKeep( readCount );
+    std::fclose( file );
+  } );
+  BenchmarkPrint( "save file fread whole file", seconds, megabytes, "MB" );
+  BenchmarkCheck( "save file loaded matches", IsSameStore( store, loadedStore ) );
+  std::remove( benchmarkSavePath );
+}
@@ -0,0 +1,99 @@
+#include "benchmark.h"
+#include "shader_cache.h"
+#include <cstdio>
+#include <cstring>
+
+// Stands in for D3DCompile: "bytecode" is the entry point, target and source
+// glued together, and it fails on sources containing "error"
+static bool StubCompile(
+  void* userData,
+  const char* source,
+  size_t sourceByteCount,
+  const char* sourceName,
+  const char* entryPoint,
+  const char* target,
+  uint32_t flags,
+  std::vector< char >* bytecode,
+  std::string* errors )
+{
+  Unused( flags );
+  ++*( int* )userData;
+  std::string text( source, sourceByteCount );
+  if( text.find( "error" ) != std::string::npos )
+  {
+    *errors = std::string( sourceName ) + ": stub compile error";
+    return false;
+  }
+  std::string compiled = std::string( entryPoint ) + target + text;
+  bytecode->assign( compiled.begin(), compiled.end() );
+  return true;
+}
+
+void BenchmarkShaderCache()
+{
+  int compileCount = 0;
+  ShaderCache cache( "shader_cache_benchmark", "stub", StubCompile, &compileCount );
+  std::string source = "float4 vsmain() : SV_POSITION { return 0; }";
+  for( int i = 0; i < 100; ++i )
+    source += "// padding so the source is roughly the size of sprite.fx\n";
+  std::vector< char > bytecode;
+  std::string errors;
+
+  // Make sure the first lookup of each target is a miss, even if an earlier
+  // run left them on disk
+  const char* targets[] = { "vs_5_0", "vs_4_0" };
+  for( const char* target : targets )
+  {
+    uint64_t key = HashShaderKey( source.data(), source.size(), "vsmain", target, 0, "stub" );
+    std::remove( cache.GetPath( key ).c_str() );
+  }
+
+  bool isCompiled = cache.GetBytecode( source.data(), source.size(), "bench.fx", "vsmain", "vs_5_0", 0, &bytecode, &errors );
+  std::vector< char > compiled = bytecode;
+  bool isCached = cache.GetBytecode( source.data(), source.size(), "bench.fx", "vsmain", "vs_5_0", 0, &bytecode, &errors )
+    && bytecode == compiled;
+  bool isOtherTargetMiss = cache.GetBytecode( source.data(), source.size(), "bench.fx", "vsmain", "vs_4_0", 0, &bytecode, &errors );
+  bool isErrorReported = !cache.GetBytecode( "error", 5, "bad.fx", "vsmain", "vs_5_0", 0, &bytecode, &errors );
+  bool isOk = isCompiled && isCached && isOtherTargetMiss && isErrorReported
+    && compileCount == 3
+    && cache.mHitCount == 1;
+  BenchmarkCheck( "shader cache round trip", isOk );
+
+  // An entry cut short, or with a byte count that isn't the file's, is a
+  // miss that gets compiled and written again
+  std::string path = cache.GetPath( HashShaderKey( source.data(), source.size(), "vsmain", "vs_5_0", 0, "stub" ) );
+  std::vector< char > entry;
+  FILE* entryFile = std::fopen( path.c_str(), "rb" );
+  if( entryFile )
+  {
+    char bytes[ 4096 ];
+    size_t byteCount;
+    while( ( byteCount = std::fread( bytes, 1, sizeof( bytes ), entryFile ) ) > 0 )
+      entry.insert( entry.end(), bytes, bytes + byteCount );
+    std::fclose( entryFile );
+  }
+  std::vector< char > truncated( entry.begin(), entry.end() - 1 );
+  std::vector< char > oversized = entry;
+  uint64_t hugeByteCount = 1ull << 40;
+  // after the magic, version and key
+  std::memcpy( oversized.data() + 16, &hugeByteCount, sizeof( hugeByteCount ) );
+  isOk = entry.size() > 24;
+  for( const std::vector< char >* corrupt : { &truncated, &oversized } )
+  {
+    FILE* file = std::fopen( path.c_str(), "wb" );
+    isOk &= file && std::fwrite( corrupt->data(), 1, corrupt->size(), file ) == corrupt->size();
+    if( file )
+      std::fclose( file );
+    int missCount = cache.mMissCount;
+    isOk &= cache.GetBytecode( source.data(), source.size(), "bench.fx", "vsmain", "vs_5_0", 0, &bytecode, &errors )
+      && bytecode == compiled
+      && cache.mMissCount == missCount + 1;
+  }
+  BenchmarkCheck( "shader cache corrupt entry is a miss", isOk );
+
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    cache.GetBytecode( source.data(), source.size(), "bench.fx", "vsmain", "vs_5_0", 0, &bytecode, &errors );
+  } );
+  BenchmarkPrint( "shader cache hit", seconds, 1, "lookups" );
+}
@@ -0,0 +1,195 @@
+#include "benchmark.h"
+#include "entity.h"
+#include "particles.h"
+#include <cstdio>
+#include <cstring>
+
+static float RandomRange( uint32_t& state, float size )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 24 ) * size;
+}
+
+// Entities scattered over a room, movingFraction of them walking somewhere
+static void AddEntities( EntityStore* store, int count, float movingFraction, uint32_t& state )
+{
+  for( int i = 0; i < count; ++i )
+  {
+    EntityId id = store->Add( Vector2( RandomRange( state, 1000 ), RandomRange( state, 1000 ) ) );
+    if( RandomRange( state, 1 ) < movingFraction )
+      store->mMoveInputs.Set( store->GetIndex( id ), Vector2( RandomRange( state, 2 ) - 1, 1 ) );
+  }
+}
+
+static bool IsSameSnapshot( const Snapshot& a, const Snapshot& b )
+{
+  return a.mSize == b.mSize && std::memcmp( a.mBytes.data(), b.mBytes.data(), a.mSize ) == 0;
+}
+
+static bool CheckSnapshot()
+{
+  bool isOk = true;
+
+  // Round trip, with holes in the slots so the free list matters
+  EntityStore store;
+  uint32_t state = 45;
+  AddEntities( &store, 100, 0.5f, state );
+  std::vector< EntityId > removed;
+  for( int i = 0; i < 100; i += 7 )
+  {
+    removed.push_back( store.mIds[ i % store.GetCount() ] );
+    store.Remove( removed.back() );
+  }
+  EntityId kept = store.mIds[ 3 ];
+  Vector2 keptPosition = store.mPositions.Get( store.GetIndex( kept ) );
+  Snapshot saved;
+  store.WriteSnapshot( &saved );
+  for( int i = 0; i < 20; ++i )
+    store.Remove( store.mIds[ 0 ] );
+  AddEntities( &store, 50, 1, state );
+  UpdateMovement( &store, MovementSettings(), 1 / 60.0f );
+  store.ReadSnapshot( &saved );
+  isOk &= saved.mReadOffset == saved.mSize;
+  isOk &= store.IsAlive( kept ) && store.mPositions.x[ store.GetIndex( kept ) ] == keptPosition.x
+    && store.mPositions.y[ store.GetIndex( kept ) ] == keptPosition.y;
+  for( EntityId id : removed )
+    isOk &= !store.IsAlive( id );
+  Snapshot again;
+  store.WriteSnapshot( &again );
+  isOk &= IsSameSnapshot( saved, again );
+
+  // Every frame still in the history comes back byte for byte, including
+  // after a discard and frames that changed size
+  SnapshotHistory history( 64, 16 );
+  std::vector< Snapshot > frames;
+  ParticleSystem particles( 1000, ParticleSettings() );
+  particles.mEmitters.push_back( ParticleEmitter() );
+  for( int frame = 0; frame < 200; ++frame )
+  {
+    if( frame == 150 )
+    {
+      history.Discard( 20 );
+      frames.resize( frames.size() - 20 );
+      Snapshot newest;
+      history.Restore( 0, &newest );
+      isOk &= IsSameSnapshot( newest, frames.back() );
+    }
+    if( frame % 50 == 25 )
+      AddEntities( &store, 3, 1, state );
+    UpdateMovement( &store, MovementSettings(), 1 / 60.0f );
+    particles.Update( 1 / 60.0f );
+    Snapshot snapshot;
+    store.WriteSnapshot( &snapshot );
+    particles.WriteSnapshot( &snapshot );
+    history.Push( snapshot );
+    frames.push_back( snapshot );
+  }
+  int frameCount = history.GetFrameCount();
+  isOk &= frameCount > 64 - 16 && frameCount <= 64;
+  Snapshot restored;
+  for( int framesBack = 0; framesBack < frameCount; ++framesBack )
+  {
+    history.Restore( framesBack, &restored );
+    isOk &= IsSameSnapshot( restored, frames[ frames.size() - 1 - framesBack ] );
+  }
+
+  // And reads back into a particle system that matches
+  history.Restore( 10, &restored );
+  EntityStore restoredStore;
+  ParticleSystem restoredParticles( 1000, ParticleSettings() );
+  restoredStore.ReadSnapshot( &restored );
+  restoredParticles.ReadSnapshot( &restored );
+  Snapshot rewritten;
+  restoredStore.WriteSnapshot( &rewritten );
+  restoredParticles.WriteSnapshot( &rewritten );
+  isOk &= IsSameSnapshot( rewritten, frames[ frames.size() - 11 ] );
+  return isOk;
+}
+
+// Saves, pushes and restores a world with entityCount entities where
+// movingFraction of them move every frame
+static void BenchmarkWorld( int entityCount, float movingFraction )
+{
+  const int keyframeInterval = 60;
+  const float dt = 1 / 60.0f;
+  EntityStore store;
+  uint32_t state = 46;
+  AddEntities( &store, entityCount, movingFraction, state );
+  ParticleSystem particles( 4096, ParticleSettings() );
+  particles.mEmitters.push_back( ParticleEmitter() );
+  for( int frame = 0; frame < 120; ++frame )
+    particles.Update( dt );
+
+  // Two frames in a row, pushed one after the other so every delta is one
+  // frame's worth of change
+  Snapshot frames[ 2 ];
+  for( Snapshot& snapshot : frames )
+  {
+    UpdateMovement( &store, MovementSettings(), dt );
+    particles.Update( dt );
+    snapshot.Clear();
+    store.WriteSnapshot( &snapshot );
+    particles.WriteSnapshot( &snapshot );
+  }
+
+  std::string name = va( "snapshot %i entities %i%% moving", entityCount, ( int )( movingFraction * 100 ) );
+  Snapshot saved;
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    saved.Clear();
+    store.WriteSnapshot( &saved );
+    particles.WriteSnapshot( &saved );
+  } );
+  BenchmarkPrint( va( "%s save", name.c_str() ), seconds, 1, "snapshots" );
+
+  // Filled once first, so the frames have their memory and it's only the
+  // encoding that gets timed
+  const int frameCapacity = 600;
+  SnapshotHistory history( frameCapacity, keyframeInterval );
+  int pushCount = 0;
+  while( pushCount < frameCapacity )
+    history.Push( frames[ pushCount++ & 1 ] );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    history.Push( frames[ pushCount++ & 1 ] );
+  } );
+  BenchmarkPrint( va( "%s push", name.c_str() ), seconds, 1, "snapshots" );
+
+  // The frame right before the newest keyframe has the most deltas to go
+  // through
+  int worstFramesBack = 1;
+  while( !history.GetFrame( history.mFrameCount - worstFramesBack ).isKeyframe )
+    ++worstFramesBack;
+  Snapshot restored;
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    history.Restore( 0, &restored );
+  } );
+  BenchmarkPrint( va( "%s restore newest", name.c_str() ), seconds, 1, "snapshots" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    history.Restore( worstFramesBack, &restored );
+  } );
+  BenchmarkPrint( va( "%s restore %i back", name.c_str(), worstFramesBack ), seconds, 1, "snapshots" );
+
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    restored.mReadOffset = 0;
+    store.ReadSnapshot( &restored );
+    particles.ReadSnapshot( &restored );
+  } );
+  BenchmarkPrint( va( "%s load", name.c_str() ), seconds, 1, "snapshots" );
+
+  std::printf( "%-40s %i bytes whole, %i bytes stored per frame\n",
+    name.c_str(),
+    saved.mSize,
+    history.GetStoredByteCount() / frameCapacity );
+}
+
+void BenchmarkSnapshot()
+{
+  BenchmarkCheck( "snapshot history vs saved frames", CheckSnapshot() );
+  BenchmarkWorld( 10000, 1 );
+  BenchmarkWorld( 10000, 0.05f );
+  BenchmarkWorld( 100000, 0.05f );
+}
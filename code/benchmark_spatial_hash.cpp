@@ -0,0 +1,166 @@
+#include "benchmark.h"
+#include "spatial_hash.h"
+#include <algorithm>
+#include <cstdio>
+
+static float RandomRange( uint32_t& state, float size )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 24 ) * size;
+}
+
+static bool operator<( SpatialPair lhs, SpatialPair rhs )
+{
+  return lhs.a != rhs.a ? lhs.a < rhs.a : lhs.b < rhs.b;
+}
+
+// FindPairs and the queries against checking everything with everything
+static bool CheckSpatialHash()
+{
+  const int count = 2000;
+  const float radius = 0.5f;
+  float worldSize = 40;
+  uint32_t state = 7;
+  SpatialHash hash( GetSpatialHashCellSize( radius ) );
+  std::vector< Vector2 > positions( count );
+  std::vector< float > radii( count );
+  for( int i = 0; i < count; ++i )
+  {
+    // negative coordinates too, so floor() gets tested
+    positions[ i ] = Vector2( RandomRange( state, worldSize ) - worldSize / 2, RandomRange( state, worldSize ) - worldSize / 2 );
+    radii[ i ] = 0.1f + RandomRange( state, radius - 0.1f );
+    hash.Insert( positions[ i ], radii[ i ] );
+  }
+  // Move some, remove some and put them back in a different place
+  for( int i = 0; i < count; i += 3 )
+  {
+    positions[ i ] += Vector2( RandomRange( state, 4 ) - 2, RandomRange( state, 4 ) - 2 );
+    hash.Move( i, positions[ i ] );
+  }
+  for( int i = 1; i < count; i += 7 )
+    hash.Remove( i );
+  for( int i = 1; i < count; i += 7 )
+  {
+    positions[ i ] = Vector2( RandomRange( state, worldSize ) - worldSize / 2, RandomRange( state, worldSize ) - worldSize / 2 );
+    // the free list hands the slots back in reverse, so look the handle up
+    SpatialHandle handle = hash.Insert( positions[ i ], radii[ i ] );
+    if( handle != i )
+    {
+      std::swap( positions[ i ], positions[ handle ] );
+      std::swap( radii[ i ], radii[ handle ] );
+    }
+  }
+  for( int i = 0; i < count; ++i )
+  {
+    positions[ i ] = hash.mObjects[ i ].position;
+    radii[ i ] = hash.mObjects[ i ].radius;
+  }
+
+  std::vector< SpatialPair > expected;
+  for( int i = 0; i < count; ++i )
+    for( int j = i + 1; j < count; ++j )
+      if( Square( positions[ i ].x - positions[ j ].x ) + Square( positions[ i ].y - positions[ j ].y ) < Square( radii[ i ] + radii[ j ] ) )
+        expected.push_back( SpatialPair{ i, j } );
+  std::vector< SpatialPair > pairs;
+  hash.FindPairs( &pairs );
+  std::sort( pairs.begin(), pairs.end() );
+  bool isOk = pairs.size() == expected.size()
+    && std::equal( pairs.begin(), pairs.end(), expected.begin(), []( SpatialPair a, SpatialPair b )
+    {
+      return a.a == b.a && a.b == b.b;
+    } );
+
+  std::vector< SpatialHandle > results;
+  for( int query = 0; query < 100; ++query )
+  {
+    Vector2 center( RandomRange( state, worldSize ) - worldSize / 2, RandomRange( state, worldSize ) - worldSize / 2 );
+    float queryRadius = RandomRange( state, 5 );
+    Vector2 min = center - Vector2( queryRadius, queryRadius * 0.5f );
+    Vector2 max = center + Vector2( queryRadius, queryRadius * 0.5f );
+    std::vector< SpatialHandle > expectedRadius;
+    std::vector< SpatialHandle > expectedAabb;
+    for( int i = 0; i < count; ++i )
+    {
+      if( Square( positions[ i ].x - center.x ) + Square( positions[ i ].y - center.y ) < Square( radii[ i ] + queryRadius ) )
+        expectedRadius.push_back( i );
+      float x = std::max( min.x, std::min( max.x, positions[ i ].x ) );
+      float y = std::max( min.y, std::min( max.y, positions[ i ].y ) );
+      if( Square( positions[ i ].x - x ) + Square( positions[ i ].y - y ) < Square( radii[ i ] ) )
+        expectedAabb.push_back( i );
+    }
+    hash.QueryRadius( center, queryRadius, &results );
+    std::sort( results.begin(), results.end() );
+    isOk &= results == expectedRadius;
+    hash.QueryAabb( min, max, &results );
+    std::sort( results.begin(), results.end() );
+    isOk &= results == expectedAabb;
+  }
+  return isOk;
+}
+
+static void BenchmarkSpatialHashCount( int count )
+{
+  // Dense enough that each object overlaps about one other
+  const float radius = 0.5f;
+  const float density = 0.3f;
+  float worldSize = std::sqrt( count / density );
+  uint32_t state = 8;
+  std::vector< Vector2 > positions( count );
+  for( Vector2& position : positions )
+    position = Vector2( RandomRange( state, worldSize ), RandomRange( state, worldSize ) );
+
+  SpatialHash hash( GetSpatialHashCellSize( radius ) );
+  std::vector< SpatialHandle > handles( count );
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    hash = SpatialHash( GetSpatialHashCellSize( radius ) );
+    for( int i = 0; i < count; ++i )
+      handles[ i ] = hash.Insert( positions[ i ], radius );
+  } );
+  BenchmarkPrint( va( "spatial hash %i insert", count ), seconds, count, "objects" );
+
+  int step = 0;
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    // Back and forth, so the objects don't drift between calls
+    float offset = ( step++ & 1 ) ? -0.3f : 0.3f;
+    for( int i = 0; i < count; ++i )
+    {
+      positions[ i ].x += offset;
+      hash.Move( handles[ i ], positions[ i ] );
+    }
+  } );
+  BenchmarkPrint( va( "spatial hash %i move", count ), seconds, count, "objects" );
+
+  std::vector< SpatialPair > pairs;
+  hash.FindPairs( &pairs );
+  size_t pairCount = pairs.size();
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    hash.FindPairs( &pairs );
+  } );
+  BenchmarkPrint( va( "spatial hash %i find pairs", count ), seconds, ( double )pairCount, "pairs" );
+
+  const int queryCount = 1000;
+  std::vector< SpatialHandle > results;
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < queryCount; ++i )
+      hash.QueryRadius( positions[ i ], 3, &results );
+  } );
+  BenchmarkPrint( va( "spatial hash %i radius 3 query", count ), seconds, queryCount, "queries" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < queryCount; ++i )
+      hash.QueryAabb( positions[ i ], positions[ i ] + Vector2( 6, 3 ), &results );
+  } );
+  BenchmarkPrint( va( "spatial hash %i 6x3 aabb query", count ), seconds, queryCount, "queries" );
+}
+
+void BenchmarkSpatialHash()
+{
+  BenchmarkCheck( "spatial hash vs brute force", CheckSpatialHash() );
+  BenchmarkSpatialHashCount( 10000 );
+  BenchmarkSpatialHashCount( 100000 );
+  BenchmarkSpatialHashCount( 1000000 );
+}
@@ -0,0 +1,204 @@
+#include "benchmark.h"
+#include "texture_manager.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+// Stands in for Graphics, a texture's video memory is its mip chain's bytes
+struct FakeUploads
+{
+  int createCount = 0;
+  int freeCount = 0;
+  size_t residentBytes = 0;
+};
+
+static size_t FakeCreateTexture( void* userData, MipChain& mipChain, Format format, Texture* texture )
+{
+  FakeUploads* uploads = ( FakeUploads* )userData;
+  ++uploads->createCount;
+  uploads->residentBytes += mipChain.bytes.size();
+  *texture = Texture();
+  texture->width = mipChain.levels[ 0 ].width;
+  texture->height = mipChain.levels[ 0 ].height;
+  texture->mipCount = ( uint32_t )mipChain.levels.size();
+  texture->format = format;
+  return mipChain.bytes.size();
+}
+
+static void FakeFreeTexture( void* userData, Texture texture )
+{
+  FakeUploads* uploads = ( FakeUploads* )userData;
+  ++uploads->freeCount;
+  uploads->residentBytes -= ( size_t )texture.width * texture.height * 4;
+}
+
+// A size x size r8g8b8a8 texture, one mip. Fails while isFailing is set
+struct FakeTexture
+{
+  int size;
+  std::atomic< int > loadCount;
+  std::atomic< bool > isFailing;
+};
+
+static bool FakeLoadTexture( void* userData, MipChain* mipChain, Format* format )
+{
+  FakeTexture* fake = ( FakeTexture* )userData;
+  ++fake->loadCount;
+  if( fake->isFailing )
+    return false;
+  mipChain->channelCount = 4;
+  mipChain->levels.resize( 1 );
+  mipChain->levels[ 0 ].width = fake->size;
+  mipChain->levels[ 0 ].height = fake->size;
+  mipChain->levels[ 0 ].stride = 4 * fake->size;
+  mipChain->levels[ 0 ].offset = 0;
+  mipChain->bytes.assign( ( size_t )fake->size * fake->size * 4, 0 );
+  *format = Format::r8g8b8a8unorm;
+  return true;
+}
+
+// Runs frames, acquiring handle every frame, until it's resident
+static bool WaitUntilResident( TextureManager* manager, TextureHandle handle )
+{
+  Texture texture;
+  for( int frame = 0; frame < 1000; ++frame )
+  {
+    if( manager->Acquire( handle, &texture ) )
+      return true;
+    manager->Update();
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  }
+  return false;
+}
+
+static bool IsResident( const TextureManager& manager, TextureHandle handle )
+{
+  return manager.mEntries[ handle ].state == TextureManager::State::Resident;
+}
+
+static bool CheckTextureManager()
+{
+  bool isOk = true;
+  const int textureCount = 4;
+  const size_t textureBytes = 64 * 64 * 4;
+  FakeUploads uploads;
+  FakeTexture fakes[ textureCount ];
+  for( FakeTexture& fake : fakes )
+  {
+    fake.size = 64;
+    fake.loadCount = 0;
+    fake.isFailing = false;
+  }
+  {
+    // Room for two and a half
+    TextureUploader uploader = { FakeCreateTexture, FakeFreeTexture, &uploads };
+    TextureManager manager( uploader, textureBytes * 5 / 2 );
+    TextureHandle handles[ textureCount ];
+    for( int i = 0; i < textureCount; ++i )
+      handles[ i ] = manager.Register( va( "fake %i", i ), FakeLoadTexture, &fakes[ i ] );
+
+    // Require() loads on the spot, Acquire() queues and misses until Update()
+    // picks the load up
+    manager.Require( handles[ 0 ] );
+    isOk &= IsResident( manager, handles[ 0 ] ) && fakes[ 0 ].loadCount == 1;
+    Texture texture;
+    isOk &= !manager.Acquire( handles[ 1 ], &texture );
+    isOk &= manager.mFrameStats.misses == 1;
+    isOk &= WaitUntilResident( &manager, handles[ 1 ] );
+    isOk &= manager.Acquire( handles[ 1 ], &texture ) && texture.width == 64;
+    isOk &= fakes[ 1 ].loadCount == 1;
+    isOk &= manager.mResidentBytes == 2 * textureBytes;
+
+    // Asking again for something already loading doesn't queue it twice
+    for( int frame = 0; frame < 3; ++frame )
+    {
+      manager.Acquire( handles[ 2 ], &texture );
+      manager.Acquire( handles[ 2 ], &texture );
+    }
+    isOk &= WaitUntilResident( &manager, handles[ 2 ] ) && fakes[ 2 ].loadCount == 1;
+
+    // 0 was used least recently, so 2 coming in over the budget evicted it
+    manager.Update();
+    isOk &= !IsResident( manager, handles[ 0 ] );
+    isOk &= IsResident( manager, handles[ 1 ] ) && IsResident( manager, handles[ 2 ] );
+    isOk &= manager.mTotalStats.evictions == 1;
+    isOk &= manager.mResidentBytes <= manager.mBudgetBytes;
+
+    // Touching 1 moves it to the front, so loading 3 pushes out 2
+    manager.Acquire( handles[ 1 ], &texture );
+    manager.Update();
+    isOk &= WaitUntilResident( &manager, handles[ 3 ] );
+    manager.Update();
+    isOk &= IsResident( manager, handles[ 1 ] ) && IsResident( manager, handles[ 3 ] );
+    isOk &= !IsResident( manager, handles[ 2 ] );
+
+    // Everything drawn in a frame stays, even over the budget, until a frame
+    // that doesn't draw it
+    bool isAllResident = false;
+    for( int frame = 0; frame < 1000 && !isAllResident; ++frame )
+    {
+      isAllResident = true;
+      for( TextureHandle handle : handles )
+        isAllResident &= manager.Acquire( handle, &texture );
+      manager.Update();
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+    isOk &= isAllResident && manager.mResidentBytes == textureCount * textureBytes;
+    manager.Update();
+    isOk &= manager.mResidentBytes == 2 * textureBytes;
+
+    // A failed load goes back to unloaded and gets tried again
+    for( TextureHandle handle : handles )
+      if( !IsResident( manager, handle ) )
+      {
+        FakeTexture& fake = fakes[ handle ];
+        fake.isFailing = true;
+        int loadCount = fake.loadCount;
+        while( fake.loadCount == loadCount )
+        {
+          manager.Acquire( handle, &texture );
+          manager.Update();
+          std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+        manager.Update();
+        isOk &= manager.mEntries[ handle ].state == TextureManager::State::Unloaded;
+        fake.isFailing = false;
+        isOk &= WaitUntilResident( &manager, handle );
+        break;
+      }
+    isOk &= uploads.residentBytes == manager.mResidentBytes;
+  }
+
+  // The destructor frees whatever was still resident
+  isOk &= uploads.createCount == uploads.freeCount && uploads.residentBytes == 0;
+  return isOk;
+}
+
+void BenchmarkTextureManager()
+{
+  BenchmarkCheck( "texture manager lru and loads", CheckTextureManager() );
+
+  // What a frame of the game costs it, every texture drawn is a hit
+  const int textureCount = 256;
+  FakeUploads uploads;
+  std::vector< FakeTexture > fakes( textureCount );
+  TextureUploader uploader = { FakeCreateTexture, FakeFreeTexture, &uploads };
+  TextureManager manager( uploader, ( size_t )-1 );
+  std::vector< TextureHandle > handles;
+  for( FakeTexture& fake : fakes )
+  {
+    fake.size = 4;
+    fake.loadCount = 0;
+    fake.isFailing = false;
+    handles.push_back( manager.Register( "fake", FakeLoadTexture, &fake ) );
+    manager.Require( handles.back() );
+  }
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    Texture texture;
+    for( TextureHandle handle : handles )
+      BenchmarkKeep( manager.Acquire( handle, &texture ) );
+    manager.Update();
+  } );
+  BenchmarkPrint( "texture manager acquire + update", seconds, textureCount, "acquires" );
+}
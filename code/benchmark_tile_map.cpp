@@ -0,0 +1,191 @@
+#include "benchmark.h"
+#include "tile_map.h"
+#include <algorithm>
+#include <cstdio>
+
+static float RandomRange( uint32_t& state, float size )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 24 ) * size;
+}
+
+static int RandomInt( uint32_t& state, int count )
+{
+  return std::min( ( int )RandomRange( state, ( float )count ), count - 1 );
+}
+
+// Same rules as TileMap::SweepAxis(), one tile at a time
+static float SweepAxisReference( const TileMap& map, int axis, const Aabb& aabb, float distance, bool* isBlocked )
+{
+  const float skin = 0.01f;
+  *isBlocked = false;
+  if( distance == 0 )
+    return 0;
+  int across = 1 - axis;
+  float invTileSize = 1 / map.mTileSize;
+  float minAlong = ( aabb.min[ axis ] - map.mOrigin[ axis ] ) * invTileSize;
+  float maxAlong = ( aabb.max[ axis ] - map.mOrigin[ axis ] ) * invTileSize;
+  int lineMin = ( int )std::floor( ( aabb.min[ across ] - map.mOrigin[ across ] ) * invTileSize + skin );
+  int lineMax = ( int )std::ceil( ( aabb.max[ across ] - map.mOrigin[ across ] ) * invTileSize - skin ) - 1;
+  float tiles = distance * invTileSize;
+  int from = distance > 0
+    ? ( int )std::ceil( maxAlong - skin )
+    : ( int )std::floor( minAlong + skin ) - 1;
+  int to = distance > 0
+    ? ( int )std::ceil( maxAlong + tiles - skin ) - 1
+    : ( int )std::floor( minAlong + tiles + skin );
+  int step = distance > 0 ? 1 : -1;
+  for( int tile = from; tile * step <= to * step; tile += step )
+  {
+    for( int line = lineMin; line <= lineMax; ++line )
+    {
+      if( !( axis == 0 ? map.IsSolid( tile, line ) : map.IsSolid( line, tile ) ) )
+        continue;
+      *isBlocked = true;
+      if( distance > 0 )
+        return std::max( 0.0f, tile * map.mTileSize + map.mOrigin[ axis ] - aabb.max[ axis ] );
+      return std::min( 0.0f, ( tile + 1 ) * map.mTileSize + map.mOrigin[ axis ] - aabb.min[ axis ] );
+    }
+  }
+  return distance;
+}
+
+static TileSweep SweepAabbReference( const TileMap& map, const Aabb& aabb, Vector2 delta )
+{
+  TileSweep result;
+  result.delta.x = SweepAxisReference( map, 0, aabb, delta.x, &result.isBlockedX );
+  Aabb moved = aabb;
+  moved.min.x += result.delta.x;
+  moved.max.x += result.delta.x;
+  result.delta.y = SweepAxisReference( map, 1, moved, delta.y, &result.isBlockedY );
+  return result;
+}
+
+// Walls around the edge, and pillars of all sizes inside
+static void BuildRoom( TileMap* map, uint32_t& state, float pillarDensity )
+{
+  map->FillRect( 0, 0, map->mTileCountX - 1, 0, true );
+  map->FillRect( 0, map->mTileCountY - 1, map->mTileCountX - 1, map->mTileCountY - 1, true );
+  map->FillRect( 0, 0, 0, map->mTileCountY - 1, true );
+  map->FillRect( map->mTileCountX - 1, 0, map->mTileCountX - 1, map->mTileCountY - 1, true );
+  int pillarCount = ( int )( ( double )map->mTileCountX * map->mTileCountY * pillarDensity / 400 );
+  for( int i = 0; i < pillarCount; ++i )
+  {
+    int x = RandomInt( state, map->mTileCountX );
+    int y = RandomInt( state, map->mTileCountY );
+    map->FillRect( x, y, x + RandomInt( state, 40 ), y + RandomInt( state, 40 ), true );
+  }
+}
+
+// A box that isn't in a wall, and a move of up to maxDistance
+static bool RandomSweep( const TileMap& map, uint32_t& state, Vector2 boxSize, float maxDistance, Aabb* aabb, Vector2* delta )
+{
+  float worldX = map.mTileCountX * map.mTileSize;
+  float worldY = map.mTileCountY * map.mTileSize;
+  Vector2 min = map.mOrigin + Vector2( RandomRange( state, worldX - boxSize.x ), RandomRange( state, worldY - boxSize.y ) );
+  *aabb = Aabb{ min, min + boxSize };
+  *delta = Vector2( RandomRange( state, 2 * maxDistance ) - maxDistance, RandomRange( state, 2 * maxDistance ) - maxDistance );
+  for( int x = ( int )( ( min.x - map.mOrigin.x ) / map.mTileSize ); x * map.mTileSize + map.mOrigin.x < aabb->max.x; ++x )
+    for( int y = ( int )( ( min.y - map.mOrigin.y ) / map.mTileSize ); y * map.mTileSize + map.mOrigin.y < aabb->max.y; ++y )
+      if( map.IsSolid( x, y ) )
+        return false;
+  return true;
+}
+
+static bool CheckTileMap()
+{
+  uint32_t state = 21;
+  TileMap map( 300, 200, 0.25f, Vector2( -30, -20 ) );
+  BuildRoom( &map, state, 0.5f );
+  bool isOk = map.mChunks.size() == 5 * 4;
+
+  // Bits agree both ways round, and clearing works
+  map.FillRect( 100, 100, 170, 130, false );
+  map.SetSolid( 130, 110, true );
+  for( int y = 0; y < map.mTileCountY; ++y )
+    for( int x = 0; x < map.mTileCountX; ++x )
+    {
+      const TileChunk& chunk = map.mChunks[ map.GetChunkIndex( x >> 6, y >> 6 ) ];
+      isOk &= ( ( chunk.rows[ y & 63 ] >> ( x & 63 ) ) & 1 ) == ( ( chunk.columns[ x & 63 ] >> ( y & 63 ) ) & 1 );
+    }
+  isOk &= map.IsSolid( 130, 110 ) && !map.IsSolid( 131, 110 ) && map.IsSolid( -1, 5 ) && map.IsSolid( 5, 200 );
+
+  int blockedCount = 0;
+  for( int i = 0; i < 20000; ++i )
+  {
+    Aabb aabb;
+    Vector2 delta;
+    Vector2 boxSize( 0.1f + RandomRange( state, 10 ), 0.1f + RandomRange( state, 10 ) );
+    if( !RandomSweep( map, state, boxSize, 20, &aabb, &delta ) )
+      continue;
+    TileSweep sweep = map.SweepAabb( aabb, delta );
+    TileSweep expected = SweepAabbReference( map, aabb, delta );
+    isOk &= sweep.delta.x == expected.delta.x && sweep.delta.y == expected.delta.y
+      && sweep.isBlockedX == expected.isBlockedX && sweep.isBlockedY == expected.isBlockedY;
+    blockedCount += sweep.isBlockedX || sweep.isBlockedY;
+
+    // Pushing on from where it stopped doesn't go anywhere
+    if( sweep.isBlockedX )
+    {
+      Aabb moved = aabb;
+      moved.min.x += sweep.delta.x;
+      moved.max.x += sweep.delta.x;
+      TileSweep again = map.SweepAabb( moved, Vector2( delta.x, 0 ) );
+      isOk &= again.isBlockedX && std::abs( again.delta.x ) < 1e-3f;
+    }
+  }
+  return isOk && blockedCount > 1000;
+}
+
+static void BenchmarkTileMapSize( int tileCount, float tileSize )
+{
+  uint32_t state = 22;
+  TileMap map( tileCount, tileCount, tileSize, Vector2( 0, 0 ) );
+  BuildRoom( &map, state, 0.3f );
+
+  // A character sized box, a frame's worth of movement at a brisk run. The
+  // finer the tiles, the more of them it covers
+  const int sweepCount = 10000;
+  Vector2 boxSize( 1, 2 );
+  std::vector< Aabb > aabbs;
+  std::vector< Vector2 > deltas;
+  while( ( int )aabbs.size() < sweepCount )
+  {
+    Aabb aabb;
+    Vector2 delta;
+    if( !RandomSweep( map, state, boxSize, 0.5f, &aabb, &delta ) )
+      continue;
+    aabbs.push_back( aabb );
+    deltas.push_back( delta );
+  }
+
+  // va() only has the one buffer
+  std::string name = va( "tile map %ix%i tiles of %g", tileCount, tileCount, tileSize );
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < sweepCount; ++i )
+    {
+      TileSweep sweep = map.SweepAabb( aabbs[ i ], deltas[ i ] );
+      BenchmarkKeep( sweep );
+    }
+  } );
+  BenchmarkPrint( va( "%s bitmask sweep", name.c_str() ), seconds, sweepCount, "sweeps" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    for( int i = 0; i < sweepCount; ++i )
+    {
+      TileSweep sweep = SweepAabbReference( map, aabbs[ i ], deltas[ i ] );
+      BenchmarkKeep( sweep );
+    }
+  } );
+  BenchmarkPrint( va( "%s per tile sweep", name.c_str() ), seconds, sweepCount, "sweeps" );
+}
+
+void BenchmarkTileMap()
+{
+  BenchmarkCheck( "tile map vs per tile", CheckTileMap() );
+  BenchmarkTileMapSize( 256, 1 );
+  BenchmarkTileMapSize( 1024, 1 / 4.0f );
+  BenchmarkTileMapSize( 4096, 1 / 16.0f );
+  BenchmarkTileMapSize( 16384, 1 / 64.0f );
+}
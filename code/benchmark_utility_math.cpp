@@ -0,0 +1,213 @@
+#include "benchmark.h"
+#include "fast_trig.h"
+#include "vector2_stream.h"
+
+// ns/op for every math operation in utility.h, the composition chains the
+// sprite path uses, and the batched transforms.
+//
+// Each op runs over inputCount different inputs, and BenchmarkKeep stops the
+// compiler from folding or vectorizing across them, so these are the cost of
+// one op as it'd appear in scalar game code
+
+static const int inputCount = 256;
+
+// The products that are meant to work at compile time, so a C++14-only
+// constexpr ( which vs2015 rejects ) doesn't get past the linux build
+static constexpr Affine2 compileTimeAffine = Affine2::Scale( 2 ) * Affine2::Translate( Vector2( 1, 2 ) );
+static_assert( compileTimeAffine.TransformPoint( Vector2( 0, 0 ) ).y == 4, "Affine2 isn't constexpr" );
+static_assert( ( Matrix2::Scale( 2, 3 ) * Matrix2::Rotate( 0, 1 ) ).values[ 2 ] == 3, "Matrix2 isn't constexpr" );
+static_assert( ( Matrix3( Matrix2::Scale( 2 ) ) * Matrix3::Identity() ).values[ 4 ] == 2, "Matrix3 isn't constexpr" );
+static_assert( Matrix4( compileTimeAffine ).values[ 7 ] == 4, "Matrix4 isn't constexpr" );
+
+#define BENCHMARK_OP( name, expression ) \
+  BenchmarkReport( name, BenchmarkNanosecondsPerOp( [ & ]() \
+  { \
+    for( int i = 0; i < inputCount; ++i ) \
+      BenchmarkKeep( expression ); \
+  }, inputCount ) )
+
+// For when the op being measured is one of a whole array
+#define BENCHMARK_BATCH( name, statement, itemCount ) \
+  BenchmarkReport( name, BenchmarkNanosecondsPerOp( [ & ]() \
+  { \
+    statement; \
+  }, itemCount ) )
+
+struct MathInputs
+{
+  float floats[ inputCount ];
+  Vector2 vector2s[ inputCount ];
+  Vector2 otherVector2s[ inputCount ];
+  Vector3 vector3s[ inputCount ];
+  Vector4 vector4s[ inputCount ];
+  Matrix2 matrix2s[ inputCount ];
+  Matrix3 matrix3s[ inputCount ];
+  Affine2 affines[ inputCount ];
+  Affine2 otherAffines[ inputCount ];
+  Matrix4 matrix4s[ inputCount ];
+  Matrix4 otherMatrix4s[ inputCount ];
+};
+
+static float RandomFloat( uint32_t& state )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 23 ) - 1;
+}
+
+static void FillMathInputs( MathInputs* inputs )
+{
+  uint32_t state = 5;
+  for( int i = 0; i < inputCount; ++i )
+  {
+    inputs->floats[ i ] = RandomFloat( state ) + 2;
+    inputs->vector2s[ i ] = Vector2( RandomFloat( state ), RandomFloat( state ) );
+    inputs->otherVector2s[ i ] = Vector2( RandomFloat( state ), RandomFloat( state ) );
+    inputs->vector3s[ i ] = Vector3( RandomFloat( state ), RandomFloat( state ), RandomFloat( state ) );
+    for( int j = 0; j < 4; ++j )
+      inputs->vector4s[ i ][ j ] = RandomFloat( state );
+    for( float& value : inputs->matrix2s[ i ].values )
+      value = RandomFloat( state );
+    for( float& value : inputs->matrix3s[ i ].values )
+      value = RandomFloat( state );
+    for( float& value : inputs->affines[ i ].values )
+      value = RandomFloat( state );
+    for( float& value : inputs->otherAffines[ i ].values )
+      value = RandomFloat( state );
+    for( float& value : inputs->matrix4s[ i ].values )
+      value = RandomFloat( state );
+    for( float& value : inputs->otherMatrix4s[ i ].values )
+      value = RandomFloat( state );
+  }
+}
+
+void BenchmarkUtilityMath()
+{
+  static MathInputs inputs;
+  FillMathInputs( &inputs );
+  const float* f = inputs.floats;
+  const Vector2* a = inputs.vector2s;
+  const Vector2* b = inputs.otherVector2s;
+  const Vector3* v3 = inputs.vector3s;
+  const Vector4* v4 = inputs.vector4s;
+  const Matrix2* m2 = inputs.matrix2s;
+  const Matrix3* m3 = inputs.matrix3s;
+  const Affine2* af = inputs.affines;
+  const Affine2* otherAf = inputs.otherAffines;
+  const Matrix4* m4 = inputs.matrix4s;
+  const Matrix4* otherM4 = inputs.otherMatrix4s;
+
+  // Vector2
+  BENCHMARK_OP( "Vector2( x, y )", Vector2( f[ i ], f[ inputCount - 1 - i ] ) );
+  BENCHMARK_OP( "-Vector2", -a[ i ] );
+  BENCHMARK_OP( "Vector2 + Vector2", a[ i ] + b[ i ] );
+  BENCHMARK_OP( "Vector2 - Vector2", a[ i ] - b[ i ] );
+  BENCHMARK_OP( "Vector2 / float", a[ i ] / f[ i ] );
+  BENCHMARK_OP( "Vector2 * float", a[ i ] * f[ i ] );
+  BENCHMARK_OP( "float * Vector2", f[ i ] * a[ i ] );
+  BENCHMARK_OP( "Vector2 += Vector2", [ & ]{ Vector2 v = a[ i ]; v += b[ i ]; return v; }() );
+  BENCHMARK_OP( "Vector2 *= float", [ & ]{ Vector2 v = a[ i ]; v *= f[ i ]; return v; }() );
+  BENCHMARK_OP( "Vector2 /= float", [ & ]{ Vector2 v = a[ i ]; v /= f[ i ]; return v; }() );
+  BENCHMARK_OP( "Vector2::IsZero", a[ i ].IsZero() );
+  BENCHMARK_OP( "Vector2::Length", a[ i ].Length() );
+  BENCHMARK_OP( "Vector2[]", a[ i ][ i & 1 ] );
+  BENCHMARK_OP( "Dot( Vector2, Vector2 )", Dot( a[ i ], b[ i ] ) );
+
+  // Vector3 / Vector4
+  BENCHMARK_OP( "-Vector3", -v3[ i ] );
+  BENCHMARK_OP( "Vector3[]", v3[ i ][ i % 3 ] );
+  BENCHMARK_OP( "-Vector4", -v4[ i ] );
+  BENCHMARK_OP( "Vector4 * float", v4[ i ] * f[ i ] );
+  BENCHMARK_OP( "Vector4 / float", v4[ i ] / f[ i ] );
+  BENCHMARK_OP( "Vector4[]", v4[ i ][ i & 3 ] );
+
+  // Matrix2 / Matrix3
+  BENCHMARK_OP( "Matrix2::Scale", Matrix2::Scale( f[ i ] ) );
+  BENCHMARK_OP( "Matrix2::Rotate( radians )", Matrix2::Rotate( f[ i ] ) );
+  BENCHMARK_OP( "Matrix2::Rotate( cos, sin )", Matrix2::Rotate( a[ i ].x, a[ i ].y ) );
+  BENCHMARK_OP( "Matrix2 * Matrix2", m2[ i ] * m2[ inputCount - 1 - i ] );
+  BENCHMARK_OP( "Matrix3( Matrix2 )", Matrix3( m2[ i ] ) );
+  BENCHMARK_OP( "Matrix3 * Matrix3", m3[ i ] * m3[ inputCount - 1 - i ] );
+
+  // Affine2
+  BENCHMARK_OP( "Affine2( Matrix2, Vector2 )", Affine2( m2[ i ], a[ i ] ) );
+  BENCHMARK_OP( "Affine2::Translate", Affine2::Translate( a[ i ] ) );
+  BENCHMARK_OP( "Affine2::Scale", Affine2::Scale( a[ i ].x, a[ i ].y ) );
+  BENCHMARK_OP( "Affine2::Rotate", Affine2::Rotate( f[ i ] ) );
+  BENCHMARK_OP( "Affine2::TranslateRotateScale", Affine2::TranslateRotateScale( a[ i ], f[ i ], b[ i ] ) );
+  BENCHMARK_OP( "Affine2 * Affine2", af[ i ] * otherAf[ i ] );
+  BENCHMARK_OP( "Affine2::Inverse", af[ i ].Inverse() );
+  BENCHMARK_OP( "Affine2::TransformPoint", af[ i ].TransformPoint( a[ i ] ) );
+  BENCHMARK_OP( "Affine2::TransformVector", af[ i ].TransformVector( a[ i ] ) );
+
+  // Matrix4
+  BENCHMARK_OP( "Matrix4( Matrix2 )", Matrix4( m2[ i ] ) );
+  BENCHMARK_OP( "Matrix4( Matrix3 )", Matrix4( m3[ i ] ) );
+  BENCHMARK_OP( "Matrix4( Affine2 )", Matrix4( af[ i ] ) );
+  BENCHMARK_OP( "Matrix4::Translate", Matrix4::Translate( a[ i ] ) );
+  BENCHMARK_OP( "Matrix4 * Matrix4", m4[ i ] * otherM4[ i ] );
+  BENCHMARK_OP( "MatrixMultiply< Matrix4, 4 >", ( MatrixMultiply< Matrix4, 4 >( m4[ i ], otherM4[ i ] ) ) );
+  BENCHMARK_OP( "Matrix4 * Vector4", m4[ i ] * v4[ i ] );
+  BENCHMARK_OP( "Vector4 * Matrix4", v4[ i ] * m4[ i ] );
+
+  // The sprite path, old and new
+  BENCHMARK_OP( "chain Matrix4 T * R * S",
+    Matrix4::Translate( a[ i ] )
+    * Matrix4( Matrix2::Rotate( f[ i ] ) )
+    * Matrix4( Matrix2::Scale( b[ i ].x, b[ i ].y ) ) );
+  BENCHMARK_OP( "chain Matrix4 view * T * R * S",
+    m4[ i ]
+    * Matrix4::Translate( a[ i ] )
+    * Matrix4( Matrix2::Rotate( f[ i ] ) )
+    * Matrix4( Matrix2::Scale( b[ i ].x, b[ i ].y ) ) );
+  BENCHMARK_OP( "chain Affine2 T * R * S",
+    Affine2::Translate( a[ i ] )
+    * Affine2::Rotate( f[ i ] )
+    * Affine2::Scale( b[ i ].x, b[ i ].y ) );
+  BENCHMARK_OP( "chain Affine2 view * TRS to Matrix4",
+    Matrix4( af[ i ] * Affine2::TranslateRotateScale( a[ i ], f[ i ], b[ i ] ) ) );
+
+  // Batched
+  const int batchCount = 4096;
+  std::vector< Vector2 > points( batchCount );
+  std::vector< Vector4 > vectors( batchCount );
+  std::vector< Affine2 > affines( batchCount );
+  std::vector< Matrix4 > matrices( batchCount );
+  std::vector< Matrix2 > rotations( batchCount );
+  std::vector< float > radians( batchCount );
+  std::vector< float > sins( batchCount );
+  std::vector< float > coss( batchCount );
+  for( int i = 0; i < batchCount; ++i )
+  {
+    points[ i ] = a[ i % inputCount ];
+    vectors[ i ] = v4[ i % inputCount ];
+    affines[ i ] = af[ i % inputCount ];
+    matrices[ i ] = m4[ i % inputCount ];
+    radians[ i ] = f[ i % inputCount ] * 10;
+  }
+  std::vector< Vector2 > outPoints( batchCount );
+  std::vector< Vector4 > outVectors( batchCount );
+  std::vector< Affine2 > outAffines( batchCount );
+  std::vector< Matrix4 > outMatrices( batchCount );
+  BENCHMARK_BATCH( "TransformPoints",
+    TransformPoints( af[ 0 ], points.data(), outPoints.data(), batchCount ), batchCount );
+  BENCHMARK_BATCH( "ComposeAffines",
+    ComposeAffines( affines.data(), affines.data(), outAffines.data(), batchCount ), batchCount );
+  BENCHMARK_BATCH( "TransformVectors",
+    TransformVectors( m4[ 0 ], vectors.data(), outVectors.data(), batchCount ), batchCount );
+  BENCHMARK_BATCH( "ComposeMatrices",
+    ComposeMatrices( matrices.data(), matrices.data(), outMatrices.data(), batchCount ), batchCount );
+  BENCHMARK_BATCH( "FastSinCosArray",
+    FastSinCosArray( radians.data(), sins.data(), coss.data(), batchCount ), batchCount );
+  BENCHMARK_BATCH( "RotateBatch",
+    RotateBatch( radians.data(), rotations.data(), batchCount ), batchCount );
+
+  Vector2Stream positions;
+  Vector2Stream velocities;
+  for( int i = 0; i < batchCount; ++i )
+  {
+    positions.Push( points[ i ] );
+    velocities.Push( a[ inputCount - 1 - i % inputCount ] );
+  }
+  BENCHMARK_BATCH( "StreamIntegrate",
+    StreamIntegrate( &positions, &velocities, nullptr, 1 / 60.0f, 1, 10 ), batchCount );
+}
@@ -0,0 +1,100 @@
+#include "benchmark.h"
+#include "vector2_stream.h"
+#include <algorithm>
+#include <cstdio>
+
+static float Random11( uint32_t& state )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 23 ) - 1;
+}
+
+struct Body
+{
+  Vector2 position;
+  Vector2 velocity;
+  Vector2 acceleration;
+};
+
+// What the character update does, one body at a time
+static void IntegrateBodies( std::vector< Body >& bodies, float dt, float damping, float maxSpeed )
+{
+  for( Body& body : bodies )
+  {
+    body.velocity += body.acceleration * dt;
+    body.position += body.velocity * dt;
+    body.velocity *= damping;
+    float speed = body.velocity.Length();
+    if( speed > maxSpeed )
+      body.velocity *= maxSpeed / speed;
+  }
+}
+
+void BenchmarkVector2Stream()
+{
+  const int bodyCount = 50000;
+  const float dt = 1 / 60.0f;
+  const float damping = 0.99f;
+  const float maxSpeed = 10;
+
+  std::vector< Body > bodies( bodyCount );
+  Vector2Stream positions;
+  Vector2Stream velocities;
+  Vector2Stream accelerations;
+  uint32_t state = 3;
+  for( Body& body : bodies )
+  {
+    body.position = Vector2( Random11( state ) * 100, Random11( state ) * 100 );
+    body.velocity = Vector2( Random11( state ) * 20, Random11( state ) * 20 );
+    body.acceleration = Vector2( Random11( state ) * 30, Random11( state ) * 30 );
+    positions.Push( body.position );
+    velocities.Push( body.velocity );
+    accelerations.Push( body.acceleration );
+  }
+
+  for( int step = 0; step < 60; ++step )
+  {
+    IntegrateBodies( bodies, dt, damping, maxSpeed );
+    StreamIntegrate( &positions, &velocities, &accelerations, dt, damping, maxSpeed );
+  }
+  float maxError = 0;
+  for( int i = 0; i < bodyCount; ++i )
+  {
+    Vector2 position = positions.Get( i );
+    maxError = std::max( maxError, std::abs( position.x - bodies[ i ].position.x ) );
+    maxError = std::max( maxError, std::abs( position.y - bodies[ i ].position.y ) );
+  }
+  std::printf( "%-40s %g\n", "stream vs aos position error, 60 steps", maxError );
+
+  // position and velocity read + written, acceleration read
+  double bytesPerBody = 5 * sizeof( Vector2 );
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    IntegrateBodies( bodies, dt, damping, maxSpeed );
+  } );
+  BenchmarkPrint( "integrate aos Vector2", seconds, bodyCount, "bodies" );
+  std::printf( "%-40s %12.2f GB/s\n", "", bytesPerBody * bodyCount / seconds / 1e9 );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    StreamIntegrate( &positions, &velocities, &accelerations, dt, damping, maxSpeed );
+  } );
+  BenchmarkPrint( "integrate Vector2Stream", seconds, bodyCount, "bodies" );
+  std::printf( "%-40s %12.2f GB/s\n", "", bytesPerBody * bodyCount / seconds / 1e9 );
+
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    StreamAddScaled( &positions, velocities, dt );
+  } );
+  BenchmarkPrint( "StreamAddScaled", seconds, bodyCount, "bodies" );
+  std::vector< float > lengths( bodyCount );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    StreamLength( velocities, lengths.data() );
+  } );
+  BenchmarkPrint( "StreamLength", seconds, bodyCount, "bodies" );
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    StreamNormalize( &accelerations );
+  } );
+  BenchmarkPrint( "StreamNormalize", seconds, bodyCount, "bodies" );
+}
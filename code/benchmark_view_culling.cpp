@@ -0,0 +1,109 @@
+#include "benchmark.h"
+#include "view_culling.h"
+#include <algorithm>
+#include <cstdio>
+
+static float RandomRange( uint32_t& state, float size )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 24 ) * size;
+}
+
+// Sprites from 0.5 to 2 across, scattered over a square room
+static Aabb RandomSprite( uint32_t& state, float roomSize )
+{
+  Vector2 center( RandomRange( state, roomSize ), RandomRange( state, roomSize ) );
+  float halfSize = 0.25f + RandomRange( state, 0.75f );
+  return Aabb{ center - Vector2( halfSize, halfSize ), center + Vector2( halfSize, halfSize ) };
+}
+
+// Same as the game's camera, looking at center
+static Affine2 MakeView( Vector2 center, float cameraWidth, float cameraHeight )
+{
+  return Affine2::Scale( 1.0f / cameraWidth, 1.0f / cameraHeight ) * Affine2::Translate( -center );
+}
+
+static bool CheckViewCulling()
+{
+  bool isOk = true;
+
+  // The bounds are the camera rectangle, rotated or not
+  Aabb bounds = GetViewBounds( MakeView( Vector2( 3, 4 ), 10, 5 ) );
+  isOk &= std::abs( bounds.min.x + 7 ) < 1e-4f && std::abs( bounds.max.x - 13 ) < 1e-4f;
+  isOk &= std::abs( bounds.min.y + 1 ) < 1e-4f && std::abs( bounds.max.y - 9 ) < 1e-4f;
+  Affine2 rotated = Affine2::TranslateRotateScale( Vector2( 0, 0 ), 3.14159265f / 4, Vector2( 0.1f, 0.1f ) );
+  bounds = GetViewBounds( rotated );
+  float corner = 10 * std::sqrt( 2.0f );
+  isOk &= std::abs( bounds.max.x - corner ) < 1e-3f && std::abs( bounds.min.y + corner ) < 1e-3f;
+
+  // Nothing that overlaps the view gets culled, against testing every fat
+  // aabb
+  const int count = 5000;
+  uint32_t state = 44;
+  AabbTree tree;
+  std::vector< AabbHandle > handles;
+  for( int i = 0; i < count; ++i )
+    handles.push_back( tree.Insert( RandomSprite( state, 200 ) ) );
+  std::vector< AabbHandle > visible;
+  for( int i = 0; i < 50; ++i )
+  {
+    Vector2 center( RandomRange( state, 200 ), RandomRange( state, 200 ) );
+    Aabb viewBounds = GetViewBounds( MakeView( center, 10, 5 ) );
+    CullStats stats;
+    CullSprites( tree, viewBounds, &visible, &stats );
+    std::vector< AabbHandle > expected;
+    for( AabbHandle handle : handles )
+      if( AabbOverlaps( tree.GetFatAabb( handle ), viewBounds ) )
+        expected.push_back( handle );
+    std::sort( visible.begin(), visible.end() );
+    isOk &= visible == expected;
+    isOk &= stats.submitted == ( int )expected.size() && stats.submitted + stats.culled == count;
+  }
+  return isOk;
+}
+
+void BenchmarkViewCulling()
+{
+  BenchmarkCheck( "view culling vs brute force", CheckViewCulling() );
+
+  // A big level, most of it off screen, seen through the game's 20 by 10ish
+  // camera as it pans across
+  const int count = 100000;
+  const float roomSize = 1000;
+  uint32_t state = 45;
+  AabbTree tree;
+  std::vector< Aabb > sprites;
+  for( int i = 0; i < count; ++i )
+  {
+    sprites.push_back( RandomSprite( state, roomSize ) );
+    tree.Insert( sprites.back() );
+  }
+
+  int frame = 0;
+  std::vector< AabbHandle > visible;
+  CullStats stats;
+  auto NextViewBounds = [ & ]()
+  {
+    float t = ( float )( frame++ % 1000 ) / 1000;
+    Vector2 center( 50 + t * ( roomSize - 100 ), roomSize / 2 );
+    return GetViewBounds( MakeView( center, 10, 5 ) );
+  };
+  double seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    stats = CullStats();
+    CullSprites( tree, NextViewBounds(), &visible, &stats );
+  } );
+  BenchmarkPrint( va( "view culling %i sprites tree", count ), seconds, count, "sprites" );
+  std::printf( "%-40s %i submitted %i culled\n", "view culling per frame", stats.submitted, stats.culled );
+
+  // What it would cost without the tree, one test per sprite
+  seconds = BenchmarkSecondsPerCall( [ & ]()
+  {
+    Aabb viewBounds = NextViewBounds();
+    visible.clear();
+    for( int i = 0; i < count; ++i )
+      if( AabbOverlaps( sprites[ i ], viewBounds ) )
+        visible.push_back( i );
+  } );
+  BenchmarkPrint( va( "view culling %i sprites brute force", count ), seconds, count, "sprites" );
+}
@@ -0,0 +1,546 @@
+#include "block_compression.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <emmintrin.h>
+
+// Reference:
+//   https://msdn.microsoft.com/en-us/library/windows/desktop/bb694531(v=vs.85).aspx
+
+int GetBlockByteCount( BlockFormat format )
+{
+  switch( format )
+  {
+    case BlockFormat::BC1: return 8;
+    case BlockFormat::BC3: return 16;
+    case BlockFormat::BC4: return 8;
+  }
+  InvalidCodePath;
+  return 0;
+}
+
+int GetBlockRowStride( BlockFormat format, int width )
+{
+  return ( ( width + 3 ) / 4 ) * GetBlockByteCount( format );
+}
+
+/////////
+// BC1 //
+/////////
+
+struct ColorBlock
+{
+  // SoA so 4 texels fit in a register
+  alignas( 16 ) float r[ 16 ];
+  alignas( 16 ) float g[ 16 ];
+  alignas( 16 ) float b[ 16 ];
+};
+
+static uint16_t To565( const float color[ 3 ] )
+{
+  int r = Clamp( ( int )( color[ 0 ] * 31 / 255 + 0.5f ), 0, 31 );
+  int g = Clamp( ( int )( color[ 1 ] * 63 / 255 + 0.5f ), 0, 63 );
+  int b = Clamp( ( int )( color[ 2 ] * 31 / 255 + 0.5f ), 0, 31 );
+  return ( uint16_t )( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+static void From565( uint16_t packed, float color[ 3 ] )
+{
+  int r = ( packed >> 11 ) & 31;
+  int g = ( packed >> 5 ) & 63;
+  int b = packed & 31;
+  color[ 0 ] = ( float )( ( r << 3 ) | ( r >> 2 ) );
+  color[ 1 ] = ( float )( ( g << 2 ) | ( g >> 4 ) );
+  color[ 2 ] = ( float )( ( b << 3 ) | ( b >> 2 ) );
+}
+
+// Picks the closest of the 4 palette colors for every texel.
+// Returns the summed squared error
+static float SelectColorIndexes(
+  const ColorBlock& block,
+  uint16_t c0,
+  uint16_t c1,
+  uint32_t* indexes )
+{
+  float palette[ 4 ][ 3 ];
+  From565( c0, palette[ 0 ] );
+  From565( c1, palette[ 1 ] );
+  for( int i = 0; i < 3; ++i )
+  {
+    palette[ 2 ][ i ] = ( 2 * palette[ 0 ][ i ] + palette[ 1 ][ i ] ) / 3;
+    palette[ 3 ][ i ] = ( palette[ 0 ][ i ] + 2 * palette[ 1 ][ i ] ) / 3;
+  }
+
+  __m128 totalError = _mm_setzero_ps();
+  uint32_t result = 0;
+  for( int i = 0; i < 16; i += 4 )
+  {
+    __m128 r = _mm_load_ps( block.r + i );
+    __m128 g = _mm_load_ps( block.g + i );
+    __m128 b = _mm_load_ps( block.b + i );
+    __m128 best = _mm_set1_ps( 1e30f );
+    __m128 bestIndex = _mm_setzero_ps();
+    for( int p = 0; p < 4; ++p )
+    {
+      __m128 dr = _mm_sub_ps( r, _mm_set1_ps( palette[ p ][ 0 ] ) );
+      __m128 dg = _mm_sub_ps( g, _mm_set1_ps( palette[ p ][ 1 ] ) );
+      __m128 db = _mm_sub_ps( b, _mm_set1_ps( palette[ p ][ 2 ] ) );
+      __m128 dist = _mm_add_ps(
+        _mm_add_ps( _mm_mul_ps( dr, dr ), _mm_mul_ps( dg, dg ) ),
+        _mm_mul_ps( db, db ) );
+      __m128 closer = _mm_cmplt_ps( dist, best );
+      best = _mm_min_ps( dist, best );
+      bestIndex = _mm_or_ps(
+        _mm_and_ps( closer, _mm_set1_ps( ( float )p ) ),
+        _mm_andnot_ps( closer, bestIndex ) );
+    }
+    totalError = _mm_add_ps( totalError, best );
+    alignas( 16 ) int lanes[ 4 ];
+    _mm_store_si128( ( __m128i* )lanes, _mm_cvtps_epi32( bestIndex ) );
+    for( int lane = 0; lane < 4; ++lane )
+      result |= lanes[ lane ] << ( 2 * ( i + lane ) );
+  }
+  *indexes = result;
+
+  alignas( 16 ) float errors[ 4 ];
+  _mm_store_ps( errors, totalError );
+  return errors[ 0 ] + errors[ 1 ] + errors[ 2 ] + errors[ 3 ];
+}
+
+// Solves for the two endpoints that best fit the current indexes
+static bool LeastSquaresEndpoints(
+  const ColorBlock& block,
+  uint32_t indexes,
+  float c0[ 3 ],
+  float c1[ 3 ] )
+{
+  static const float weights[ 4 ] = { 1.0f, 0.0f, 2 / 3.0f, 1 / 3.0f };
+  float aa = 0;
+  float bb = 0;
+  float ab = 0;
+  float ax[ 3 ] = {};
+  float bx[ 3 ] = {};
+  for( int i = 0; i < 16; ++i )
+  {
+    float a = weights[ ( indexes >> ( 2 * i ) ) & 3 ];
+    float b = 1 - a;
+    aa += a * a;
+    bb += b * b;
+    ab += a * b;
+    float texel[ 3 ] = { block.r[ i ], block.g[ i ], block.b[ i ] };
+    for( int c = 0; c < 3; ++c )
+    {
+      ax[ c ] += a * texel[ c ];
+      bx[ c ] += b * texel[ c ];
+    }
+  }
+  float det = aa * bb - ab * ab;
+  if( std::abs( det ) < 1e-6f )
+    return false;
+  for( int c = 0; c < 3; ++c )
+  {
+    c0[ c ] = ( ax[ c ] * bb - bx[ c ] * ab ) / det;
+    c1[ c ] = ( bx[ c ] * aa - ax[ c ] * ab ) / det;
+  }
+  return true;
+}
+
+// c0 > c1 means 4 color mode, which is the only mode we emit
+static void PackColorBlock(
+  const ColorBlock& block,
+  const float endpoint0[ 3 ],
+  const float endpoint1[ 3 ],
+  uint16_t* c0,
+  uint16_t* c1,
+  uint32_t* indexes,
+  float* error )
+{
+  *c0 = To565( endpoint0 );
+  *c1 = To565( endpoint1 );
+  if( *c0 < *c1 )
+    std::swap( *c0, *c1 );
+  if( *c0 == *c1 )
+  {
+    // 3 color mode, index 0 is still c0
+    float solid[ 3 ];
+    From565( *c0, solid );
+    *indexes = 0;
+    *error = 0;
+    for( int i = 0; i < 16; ++i )
+      *error += Square( block.r[ i ] - solid[ 0 ] )
+      + Square( block.g[ i ] - solid[ 1 ] )
+      + Square( block.b[ i ] - solid[ 2 ] );
+    return;
+  }
+  *error = SelectColorIndexes( block, *c0, *c1, indexes );
+}
+
+static void EncodeBC1Block( const ColorBlock& block, uint8_t* dst )
+{
+  // Principal axis of the texels, via a few rounds of power iteration
+  float mean[ 3 ] = {};
+  for( int i = 0; i < 16; ++i )
+  {
+    mean[ 0 ] += block.r[ i ];
+    mean[ 1 ] += block.g[ i ];
+    mean[ 2 ] += block.b[ i ];
+  }
+  for( float& m : mean )
+    m /= 16;
+  float cov[ 6 ] = {}; // rr rg rb gg gb bb
+  for( int i = 0; i < 16; ++i )
+  {
+    float r = block.r[ i ] - mean[ 0 ];
+    float g = block.g[ i ] - mean[ 1 ];
+    float b = block.b[ i ] - mean[ 2 ];
+    cov[ 0 ] += r * r;
+    cov[ 1 ] += r * g;
+    cov[ 2 ] += r * b;
+    cov[ 3 ] += g * g;
+    cov[ 4 ] += g * b;
+    cov[ 5 ] += b * b;
+  }
+  float axis[ 3 ] = { 0.9f, 1.0f, 0.7f };
+  for( int iteration = 0; iteration < 4; ++iteration )
+  {
+    float x = cov[ 0 ] * axis[ 0 ] + cov[ 1 ] * axis[ 1 ] + cov[ 2 ] * axis[ 2 ];
+    float y = cov[ 1 ] * axis[ 0 ] + cov[ 3 ] * axis[ 1 ] + cov[ 4 ] * axis[ 2 ];
+    float z = cov[ 2 ] * axis[ 0 ] + cov[ 4 ] * axis[ 1 ] + cov[ 5 ] * axis[ 2 ];
+    float length = std::max( std::max( std::abs( x ), std::abs( y ) ), std::abs( z ) );
+    if( length < 1e-6f )
+      break;
+    axis[ 0 ] = x / length;
+    axis[ 1 ] = y / length;
+    axis[ 2 ] = z / length;
+  }
+
+  // Endpoints are the texels furthest along the axis, nudged inward by
+  // 1/16th of the range since the extremes are rarely hit exactly
+  float minDot = 1e30f;
+  float maxDot = -1e30f;
+  int minIndex = 0;
+  int maxIndex = 0;
+  for( int i = 0; i < 16; ++i )
+  {
+    float dot = block.r[ i ] * axis[ 0 ] + block.g[ i ] * axis[ 1 ] + block.b[ i ] * axis[ 2 ];
+    if( dot < minDot ) { minDot = dot; minIndex = i; }
+    if( dot > maxDot ) { maxDot = dot; maxIndex = i; }
+  }
+  float endpoint0[ 3 ] = { block.r[ maxIndex ], block.g[ maxIndex ], block.b[ maxIndex ] };
+  float endpoint1[ 3 ] = { block.r[ minIndex ], block.g[ minIndex ], block.b[ minIndex ] };
+  for( int c = 0; c < 3; ++c )
+  {
+    float inset = ( endpoint0[ c ] - endpoint1[ c ] ) / 16;
+    endpoint0[ c ] -= inset;
+    endpoint1[ c ] += inset;
+  }
+
+  uint16_t c0;
+  uint16_t c1;
+  uint32_t indexes;
+  float error;
+  PackColorBlock( block, endpoint0, endpoint1, &c0, &c1, &indexes, &error );
+
+  // One round of refitting the endpoints to the chosen indexes
+  if( error > 0 && LeastSquaresEndpoints( block, indexes, endpoint0, endpoint1 ) )
+  {
+    uint16_t refitC0;
+    uint16_t refitC1;
+    uint32_t refitIndexes;
+    float refitError;
+    PackColorBlock( block, endpoint0, endpoint1, &refitC0, &refitC1, &refitIndexes, &refitError );
+    if( refitError < error )
+    {
+      c0 = refitC0;
+      c1 = refitC1;
+      indexes = refitIndexes;
+    }
+  }
+
+  dst[ 0 ] = ( uint8_t )( c0 & 0xff );
+  dst[ 1 ] = ( uint8_t )( c0 >> 8 );
+  dst[ 2 ] = ( uint8_t )( c1 & 0xff );
+  dst[ 3 ] = ( uint8_t )( c1 >> 8 );
+  for( int i = 0; i < 4; ++i )
+    dst[ 4 + i ] = ( uint8_t )( indexes >> ( 8 * i ) );
+}
+
+static void DecodeBC1Block( const uint8_t* src, uint8_t* dst, int dstStride )
+{
+  uint16_t c0 = ( uint16_t )( src[ 0 ] | ( src[ 1 ] << 8 ) );
+  uint16_t c1 = ( uint16_t )( src[ 2 ] | ( src[ 3 ] << 8 ) );
+  float palette[ 4 ][ 4 ];
+  From565( c0, palette[ 0 ] );
+  From565( c1, palette[ 1 ] );
+  palette[ 0 ][ 3 ] = palette[ 1 ][ 3 ] = palette[ 2 ][ 3 ] = 255;
+  palette[ 3 ][ 3 ] = c0 > c1 ? 255.0f : 0.0f;
+  for( int i = 0; i < 3; ++i )
+  {
+    if( c0 > c1 )
+    {
+      palette[ 2 ][ i ] = ( 2 * palette[ 0 ][ i ] + palette[ 1 ][ i ] ) / 3;
+      palette[ 3 ][ i ] = ( palette[ 0 ][ i ] + 2 * palette[ 1 ][ i ] ) / 3;
+    }
+    else
+    {
+      palette[ 2 ][ i ] = ( palette[ 0 ][ i ] + palette[ 1 ][ i ] ) / 2;
+      palette[ 3 ][ i ] = 0;
+    }
+  }
+  uint32_t indexes = src[ 4 ] | ( src[ 5 ] << 8 ) | ( src[ 6 ] << 16 ) | ( ( uint32_t )src[ 7 ] << 24 );
+  for( int i = 0; i < 16; ++i )
+  {
+    float* color = palette[ ( indexes >> ( 2 * i ) ) & 3 ];
+    uint8_t* texel = dst + ( i / 4 ) * dstStride + ( i % 4 ) * 4;
+    for( int c = 0; c < 4; ++c )
+      texel[ c ] = ( uint8_t )( color[ c ] + 0.5f );
+  }
+}
+
+/////////
+// BC4 //
+/////////
+
+static void BuildBC4Palette( int a0, int a1, int palette[ 8 ] )
+{
+  palette[ 0 ] = a0;
+  palette[ 1 ] = a1;
+  if( a0 > a1 )
+  {
+    for( int i = 2; i < 8; ++i )
+      palette[ i ] = ( ( 8 - i ) * a0 + ( i - 1 ) * a1 + 3 ) / 7;
+  }
+  else
+  {
+    for( int i = 2; i < 6; ++i )
+      palette[ i ] = ( ( 6 - i ) * a0 + ( i - 1 ) * a1 + 2 ) / 5;
+    palette[ 6 ] = 0;
+    palette[ 7 ] = 255;
+  }
+}
+
+static void EncodeBC4Block( const uint8_t values[ 16 ], uint8_t* dst )
+{
+  int lo = 255;
+  int hi = 0;
+  for( int i = 0; i < 16; ++i )
+  {
+    lo = std::min( lo, ( int )values[ i ] );
+    hi = std::max( hi, ( int )values[ i ] );
+  }
+
+  // 8 value mode ( a0 > a1 ) covers the range evenly. When the block is flat
+  // every index is 0 anyways
+  int a0 = hi;
+  int a1 = lo;
+  int palette[ 8 ];
+  BuildBC4Palette( a0, a1, palette );
+
+  // 16 texels in two registers of 8 x 16 bit, test against all 8 palette values
+  __m128i texels[ 2 ];
+  texels[ 0 ] = _mm_unpacklo_epi8( _mm_loadu_si128( ( const __m128i* )values ), _mm_setzero_si128() );
+  texels[ 1 ] = _mm_unpackhi_epi8( _mm_loadu_si128( ( const __m128i* )values ), _mm_setzero_si128() );
+  alignas( 16 ) int16_t bestIndexes[ 16 ];
+  for( int half = 0; half < 2; ++half )
+  {
+    __m128i best = _mm_set1_epi16( 0x7fff );
+    __m128i bestIndex = _mm_setzero_si128();
+    for( int p = 0; p < 8; ++p )
+    {
+      __m128i value = _mm_set1_epi16( ( int16_t )palette[ p ] );
+      __m128i diff = _mm_sub_epi16( texels[ half ], value );
+      // |diff| = max( diff, -diff )
+      diff = _mm_max_epi16( diff, _mm_sub_epi16( _mm_setzero_si128(), diff ) );
+      __m128i closer = _mm_cmplt_epi16( diff, best );
+      best = _mm_min_epi16( diff, best );
+      bestIndex = _mm_or_si128(
+        _mm_and_si128( closer, _mm_set1_epi16( ( int16_t )p ) ),
+        _mm_andnot_si128( closer, bestIndex ) );
+    }
+    _mm_store_si128( ( __m128i* )( bestIndexes + 8 * half ), bestIndex );
+  }
+
+  uint64_t bits = 0;
+  for( int i = 0; i < 16; ++i )
+    bits |= ( uint64_t )bestIndexes[ i ] << ( 3 * i );
+  dst[ 0 ] = ( uint8_t )a0;
+  dst[ 1 ] = ( uint8_t )a1;
+  for( int i = 0; i < 6; ++i )
+    dst[ 2 + i ] = ( uint8_t )( bits >> ( 8 * i ) );
+}
+
+static void DecodeBC4Block( const uint8_t* src, uint8_t* dst, int dstStride, int texelBytes )
+{
+  int palette[ 8 ];
+  BuildBC4Palette( src[ 0 ], src[ 1 ], palette );
+  uint64_t bits = 0;
+  for( int i = 0; i < 6; ++i )
+    bits |= ( uint64_t )src[ 2 + i ] << ( 8 * i );
+  for( int i = 0; i < 16; ++i )
+    dst[ ( i / 4 ) * dstStride + ( i % 4 ) * texelBytes ]
+    = ( uint8_t )palette[ ( bits >> ( 3 * i ) ) & 7 ];
+}
+
+///////////
+// Image //
+///////////
+
+static void CompressBlockRows(
+  uint8_t* dst,
+  const uint8_t* src,
+  int width,
+  int height,
+  int srcStride,
+  int channelCount,
+  BlockFormat format,
+  int blockRowBegin,
+  int blockRowEnd )
+{
+  int blockCountX = ( width + 3 ) / 4;
+  int blockBytes = GetBlockByteCount( format );
+  int dstStride = GetBlockRowStride( format, width );
+  for( int blockY = blockRowBegin; blockY < blockRowEnd; ++blockY )
+  {
+    for( int blockX = 0; blockX < blockCountX; ++blockX )
+    {
+      ColorBlock colors;
+      uint8_t alphas[ 16 ];
+      for( int i = 0; i < 16; ++i )
+      {
+        int x = Clamp( blockX * 4 + i % 4, 0, width - 1 );
+        int y = Clamp( blockY * 4 + i / 4, 0, height - 1 );
+        const uint8_t* texel = src + y * srcStride + x * channelCount;
+        if( format == BlockFormat::BC4 )
+        {
+          alphas[ i ] = texel[ 0 ];
+          continue;
+        }
+        colors.r[ i ] = texel[ 0 ];
+        colors.g[ i ] = texel[ 1 ];
+        colors.b[ i ] = texel[ 2 ];
+        alphas[ i ] = texel[ 3 ];
+      }
+
+      uint8_t* block = dst + blockY * dstStride + blockX * blockBytes;
+      switch( format )
+      {
+        case BlockFormat::BC1: EncodeBC1Block( colors, block ); break;
+        case BlockFormat::BC3:
+          EncodeBC4Block( alphas, block );
+          EncodeBC1Block( colors, block + 8 );
+          break;
+        case BlockFormat::BC4: EncodeBC4Block( alphas, block ); break;
+      }
+    }
+  }
+}
+
+void CompressImage(
+  uint8_t* dst,
+  const uint8_t* src,
+  int width,
+  int height,
+  int srcStride,
+  int channelCount,
+  BlockFormat format,
+  int threadCount )
+{
+  Assert( format == BlockFormat::BC4 || channelCount == 4 );
+  int blockRowCount = ( height + 3 ) / 4;
+  if( threadCount <= 0 )
+    threadCount = std::max( 1, ( int )std::thread::hardware_concurrency() );
+  threadCount = std::min( threadCount, blockRowCount );
+
+  // Contiguous runs of block rows per thread, the caller's thread takes the first
+  std::vector< std::thread > threads;
+  int rowsPerThread = ( blockRowCount + threadCount - 1 ) / threadCount;
+  for( int i = 1; i < threadCount; ++i )
+  {
+    int begin = i * rowsPerThread;
+    int end = std::min( begin + rowsPerThread, blockRowCount );
+    if( begin >= end )
+      break;
+    threads.push_back( std::thread(
+      CompressBlockRows,
+      dst, src, width, height, srcStride, channelCount, format, begin, end ) );
+  }
+  CompressBlockRows(
+    dst, src, width, height, srcStride, channelCount, format,
+    0, std::min( rowsPerThread, blockRowCount ) );
+  for( std::thread& thread : threads )
+    thread.join();
+}
+
+void DecompressImage(
+  uint8_t* dst,
+  const uint8_t* src,
+  int width,
+  int height,
+  int dstStride,
+  BlockFormat format )
+{
+  int blockBytes = GetBlockByteCount( format );
+  int texelBytes = format == BlockFormat::BC4 ? 1 : 4;
+  for( int blockY = 0; blockY < ( height + 3 ) / 4; ++blockY )
+  {
+    for( int blockX = 0; blockX < ( width + 3 ) / 4; ++blockX )
+    {
+      uint8_t decoded[ 4 * 4 * 4 ];
+      const uint8_t* block = src
+        + blockY * GetBlockRowStride( format, width )
+        + blockX * blockBytes;
+      switch( format )
+      {
+        case BlockFormat::BC1: DecodeBC1Block( block, decoded, 16 ); break;
+        case BlockFormat::BC3:
+          DecodeBC1Block( block + 8, decoded, 16 );
+          DecodeBC4Block( block, decoded + 3, 16, 4 );
+          break;
+        case BlockFormat::BC4: DecodeBC4Block( block, decoded, 4, 1 ); break;
+      }
+
+      // partial blocks at the edge only copy what's inside the image
+      for( int y = 0; y < 4 && blockY * 4 + y < height; ++y )
+      {
+        int columnCount = std::min( 4, width - blockX * 4 );
+        std::memcpy(
+          dst + ( blockY * 4 + y ) * dstStride + blockX * 4 * texelBytes,
+          decoded + y * 4 * texelBytes,
+          columnCount * texelBytes );
+      }
+    }
+  }
+}
+
+void CompressMipChain(
+  MipChain* dst,
+  MipChain& src,
+  BlockFormat format,
+  int threadCount )
+{
+  dst->channelCount = src.channelCount;
+  dst->levels.resize( src.levels.size() );
+  size_t byteCount = 0;
+  for( int i = 0; i < ( int )src.levels.size(); ++i )
+  {
+    MipLevel& level = dst->levels[ i ];
+    level = src.levels[ i ];
+    level.stride = GetBlockRowStride( format, level.width );
+    level.offset = byteCount;
+    byteCount += level.stride * ( ( level.height + 3 ) / 4 );
+  }
+  dst->bytes.resize( byteCount );
+  for( int i = 0; i < ( int )src.levels.size(); ++i )
+  {
+    MipLevel& level = src.levels[ i ];
+    CompressImage(
+      dst->GetLevelBytes( i ),
+      src.GetLevelBytes( i ),
+      level.width,
+      level.height,
+      level.stride,
+      src.channelCount,
+      format,
+      threadCount );
+  }
+}
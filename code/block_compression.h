@@ -0,0 +1,51 @@
+#pragma once
+#include "utility.h"
+#include "mipmap.h"
+
+// Every format here stores 4x4 texel blocks
+enum class BlockFormat
+{
+  // rgb, 8 bytes per block
+  BC1,
+
+  // rgb + alpha, 16 bytes per block ( a BC4 alpha block, then a BC1 color block )
+  BC3,
+
+  // single channel, 8 bytes per block
+  BC4,
+};
+
+int GetBlockByteCount( BlockFormat format );
+
+// Bytes from one row of blocks to the next
+int GetBlockRowStride( BlockFormat format, int width );
+
+// BC1 and BC3 read r8g8b8a8 ( channelCount 4 ). BC4 reads the first channel,
+// so it takes r8 or r8g8b8a8. Edge blocks clamp to the last row / column.
+// threadCount of 0 means one per core
+void CompressImage(
+  uint8_t* dst,
+  const uint8_t* src,
+  int width,
+  int height,
+  int srcStride,
+  int channelCount,
+  BlockFormat format,
+  int threadCount = 0 );
+
+// Writes r8g8b8a8 for BC1 / BC3, and r8 for BC4. Used to measure quality
+void DecompressImage(
+  uint8_t* dst,
+  const uint8_t* src,
+  int width,
+  int height,
+  int dstStride,
+  BlockFormat format );
+
+// dst ends up with the same levels as src, where each level's stride is the
+// byte count of a row of blocks
+void CompressMipChain(
+  MipChain* dst,
+  MipChain& src,
+  BlockFormat format,
+  int threadCount = 0 );
@@ -0,0 +1,74 @@
+#pragma once
+#include "utility.h"
+#include <cstddef>
+
+// The one definition of the shader constants. The c++ structs below and the
+// hlsl cbuffers in constantBufferHlsl are both generated from these lists,
+// so the two can't drift apart.
+//
+// X( c++ type, hlsl type, name )
+
+// Uploaded once per frame
+#define PER_FRAME_CONSTANTS( X ) \
+  X( Matrix4, matrix, view ) \
+  X( float, float, time )
+
+// Uploaded for every draw
+#define PER_DRAW_CONSTANTS( X ) \
+  X( Matrix4, matrix, world ) \
+  X( Color4, float4, color ) \
+  X( Vector2, float2, uvMin ) \
+  X( Vector2, float2, uvMax )
+
+#define PER_FRAME_SLOT 0
+#define PER_DRAW_SLOT 1
+
+#define CONSTANT_MEMBER( cppType, hlslType, name ) cppType name;
+
+// alignas keeps the size a multiple of 16, which d3d wants for constant buffers
+struct alignas( 16 ) PerFrameConstants
+{
+  PER_FRAME_CONSTANTS( CONSTANT_MEMBER )
+};
+struct alignas( 16 ) PerDrawConstants
+{
+  PER_DRAW_CONSTANTS( CONSTANT_MEMBER )
+};
+
+// Sizes of the hlsl types, by name
+const size_t hlslSize_matrix = 64;
+const size_t hlslSize_float4 = 16;
+const size_t hlslSize_float2 = 8;
+const size_t hlslSize_float = 4;
+
+// hlsl packs members in order, but bumps anything that would straddle a
+// 16 byte register to the next one. As long as nothing straddles, the c++
+// offsets are the hlsl offsets
+#define CHECK_CONSTANT( structName, cppType, hlslType, name ) \
+  static_assert( sizeof( cppType ) == hlslSize_##hlslType, \
+    #structName "::" #name " is a different size than its hlsl type" ); \
+  static_assert( offsetof( structName, name ) % 16 == 0 \
+    || offsetof( structName, name ) % 16 + sizeof( cppType ) <= 16, \
+    #structName "::" #name " straddles a 16 byte register" );
+#define CHECK_PER_FRAME_CONSTANT( cppType, hlslType, name ) \
+  CHECK_CONSTANT( PerFrameConstants, cppType, hlslType, name )
+#define CHECK_PER_DRAW_CONSTANT( cppType, hlslType, name ) \
+  CHECK_CONSTANT( PerDrawConstants, cppType, hlslType, name )
+PER_FRAME_CONSTANTS( CHECK_PER_FRAME_CONSTANT )
+PER_DRAW_CONSTANTS( CHECK_PER_DRAW_CONSTANT )
+
+#define STRINGIFY_SLOT( slot ) #slot
+#define HLSL_REGISTER( slot ) "register( b" STRINGIFY_SLOT( slot ) " )"
+#define HLSL_CONSTANT_MEMBER( cppType, hlslType, name ) "  " #hlslType " " #name ";\n"
+
+// Prepended to every shader by Graphics::LoadShader
+const char constantBufferHlsl[] =
+  "#pragma pack_matrix( row_major )\n"
+  "cbuffer PerFrame : " HLSL_REGISTER( PER_FRAME_SLOT ) "\n"
+  "{\n"
+  PER_FRAME_CONSTANTS( HLSL_CONSTANT_MEMBER )
+  "}\n"
+  "cbuffer PerDraw : " HLSL_REGISTER( PER_DRAW_SLOT ) "\n"
+  "{\n"
+  PER_DRAW_CONSTANTS( HLSL_CONSTANT_MEMBER )
+  "}\n";
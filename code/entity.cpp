@@ -0,0 +1,331 @@
+#include "entity.h"
+#include "lanes.h"
+#include <cstring>
+
+static const uint32_t noFreeSlot = 0xffffffff;
+
+EntityStore::EntityStore()
+{
+  mFirstFree = noFreeSlot;
+}
+
+EntityId EntityStore::Add( Vector2 position )
+{
+  uint32_t index;
+  if( mFirstFree != noFreeSlot )
+  {
+    index = mFirstFree;
+    mFirstFree = mSlots[ index ].nextFree;
+  }
+  else
+  {
+    index = ( uint32_t )mSlots.size();
+    Slot slot;
+    slot.generation = 1;
+    mSlots.push_back( slot );
+  }
+  Slot& slot = mSlots[ index ];
+  slot.denseIndex = GetCount();
+  slot.nextFree = noFreeSlot;
+
+  EntityId id;
+  id.index = index;
+  id.generation = slot.generation;
+  mIds.push_back( id );
+  mPositions.Push( position );
+  mVelocities.Push( Vector2( 0, 0 ) );
+  mMoveInputs.Push( Vector2( 0, 0 ) );
+  return id;
+}
+
+void EntityStore::Remove( EntityId id )
+{
+  Assert( IsAlive( id ) );
+  Slot& slot = mSlots[ id.index ];
+  int denseIndex = slot.denseIndex;
+  int lastIndex = GetCount() - 1;
+  if( denseIndex != lastIndex )
+  {
+    EntityId moved = mIds[ lastIndex ];
+    mIds[ denseIndex ] = moved;
+    mPositions.Set( denseIndex, mPositions.Get( lastIndex ) );
+    mVelocities.Set( denseIndex, mVelocities.Get( lastIndex ) );
+    mMoveInputs.Set( denseIndex, mMoveInputs.Get( lastIndex ) );
+    mSlots[ moved.index ].denseIndex = denseIndex;
+  }
+  mIds.pop_back();
+  mPositions.Resize( lastIndex );
+  mVelocities.Resize( lastIndex );
+  mMoveInputs.Resize( lastIndex );
+
+  ++slot.generation;
+  if( !slot.generation )
+    slot.generation = 1;
+  slot.denseIndex = -1;
+  slot.nextFree = mFirstFree;
+  mFirstFree = id.index;
+}
+
+void EntityStore::Clear()
+{
+  mIds.clear();
+  mSlots.clear();
+  mFirstFree = noFreeSlot;
+  mPositions.Resize( 0 );
+  mVelocities.Resize( 0 );
+  mMoveInputs.Resize( 0 );
+}
+
+bool EntityStore::IsAlive( EntityId id ) const
+{
+  return id.index < mSlots.size()
+    && id.generation
+    && mSlots[ id.index ].generation == id.generation;
+}
+
+int EntityStore::GetIndex( EntityId id ) const
+{
+  Assert( IsAlive( id ) );
+  return mSlots[ id.index ].denseIndex;
+}
+
+int EntityStore::GetCount() const
+{
+  return ( int )mIds.size();
+}
+
+static void WriteStream( Snapshot* snapshot, const Vector2Stream& stream )
+{
+  snapshot->Write( stream.x, ( int )( stream.count * sizeof( float ) ) );
+  snapshot->Write( stream.y, ( int )( stream.count * sizeof( float ) ) );
+}
+
+static void ReadStream( Snapshot* snapshot, Vector2Stream* stream, int count )
+{
+  stream->Resize( count );
+  snapshot->Read( stream->x, ( int )( count * sizeof( float ) ) );
+  snapshot->Read( stream->y, ( int )( count * sizeof( float ) ) );
+}
+
+void EntityStore::WriteSnapshot( Snapshot* snapshot ) const
+{
+  int counts[ 2 ] = { GetCount(), ( int )mSlots.size() };
+  snapshot->Write( counts );
+  snapshot->Write( mFirstFree );
+  snapshot->Write( mIds.data(), ( int )( counts[ 0 ] * sizeof( EntityId ) ) );
+  snapshot->Write( mSlots.data(), ( int )( counts[ 1 ] * sizeof( Slot ) ) );
+  WriteStream( snapshot, mPositions );
+  WriteStream( snapshot, mVelocities );
+  WriteStream( snapshot, mMoveInputs );
+}
+
+void EntityStore::ReadSnapshot( Snapshot* snapshot )
+{
+  int counts[ 2 ];
+  snapshot->Read( &counts );
+  snapshot->Read( &mFirstFree );
+  mIds.resize( counts[ 0 ] );
+  mSlots.resize( counts[ 1 ] );
+  snapshot->Read( mIds.data(), ( int )( counts[ 0 ] * sizeof( EntityId ) ) );
+  snapshot->Read( mSlots.data(), ( int )( counts[ 1 ] * sizeof( Slot ) ) );
+  ReadStream( snapshot, &mPositions, counts[ 0 ] );
+  ReadStream( snapshot, &mVelocities, counts[ 0 ] );
+  ReadStream( snapshot, &mMoveInputs, counts[ 0 ] );
+}
+
+static const uint32_t entityFirstFreeTag = SaveTag( 'E', 'F', 'R', 'E' );
+static const uint32_t entityIdsTag = SaveTag( 'E', 'I', 'D', 'S' );
+static const uint32_t entitySlotsTag = SaveTag( 'E', 'S', 'L', 'T' );
+static const uint32_t entityStreamTags[ 6 ] = {
+  SaveTag( 'E', 'P', 'X', ' ' ),
+  SaveTag( 'E', 'P', 'Y', ' ' ),
+  SaveTag( 'E', 'V', 'X', ' ' ),
+  SaveTag( 'E', 'V', 'Y', ' ' ),
+  SaveTag( 'E', 'M', 'X', ' ' ),
+  SaveTag( 'E', 'M', 'Y', ' ' ) };
+
+void EntityStore::WriteSave( SaveWriter* writer ) const
+{
+  int count = GetCount();
+  writer->AddSection( entityFirstFreeTag, &mFirstFree, 1 );
+  writer->AddSection( entityIdsTag, mIds.data(), count );
+  writer->AddSection( entitySlotsTag, mSlots.data(), ( int )mSlots.size() );
+  const Vector2Stream* streams[ 3 ] = { &mPositions, &mVelocities, &mMoveInputs };
+  for( int i = 0; i < 3; ++i )
+  {
+    writer->AddSection( entityStreamTags[ 2 * i ], streams[ i ]->x, count );
+    writer->AddSection( entityStreamTags[ 2 * i + 1 ], streams[ i ]->y, count );
+  }
+}
+
+// The same invariants Add and Remove keep: each live id's slot points back
+// at it, every other slot is free, and the free list runs through free
+// slots only and ends. A save that breaks any of them would have Remove and
+// GetIndex indexing out of bounds later
+static bool IsValidSave(
+  const EntityId* ids,
+  int count,
+  const EntityStore::Slot* slots,
+  int slotCount,
+  uint32_t firstFree )
+{
+  for( int i = 0; i < count; ++i )
+  {
+    const EntityId& id = ids[ i ];
+    if( id.index >= ( uint32_t )slotCount || slots[ id.index ].denseIndex != i
+      || !id.generation || slots[ id.index ].generation != id.generation )
+      return false;
+  }
+  int freeCount = 0;
+  for( int i = 0; i < slotCount; ++i )
+  {
+    int denseIndex = slots[ i ].denseIndex;
+    if( denseIndex < -1 || denseIndex >= count )
+      return false;
+    if( denseIndex != -1 && ids[ denseIndex ].index != ( uint32_t )i )
+      return false;
+    freeCount += denseIndex == -1;
+  }
+
+  // Walking more free slots than there are means it loops
+  uint32_t freeSlot = firstFree;
+  for( int i = 0; freeSlot != noFreeSlot; ++i )
+  {
+    if( i == freeCount || freeSlot >= ( uint32_t )slotCount || slots[ freeSlot ].denseIndex != -1 )
+      return false;
+    freeSlot = slots[ freeSlot ].nextFree;
+  }
+  return true;
+}
+
+bool EntityStore::ReadSave( const SaveFile& save )
+{
+  int firstFreeCount;
+  int count;
+  int slotCount;
+  const uint32_t* firstFree = save.GetSection< uint32_t >( entityFirstFreeTag, &firstFreeCount );
+  const EntityId* ids = save.GetSection< EntityId >( entityIdsTag, &count );
+  const Slot* slots = save.GetSection< Slot >( entitySlotsTag, &slotCount );
+  if( !firstFree || firstFreeCount != 1 || !ids || !slots || count > slotCount )
+    return false;
+  const float* streamValues[ 6 ];
+  for( int i = 0; i < 6; ++i )
+  {
+    int streamCount;
+    streamValues[ i ] = save.GetSection< float >( entityStreamTags[ i ], &streamCount );
+    if( !streamValues[ i ] || streamCount != count )
+      return false;
+  }
+  if( !IsValidSave( ids, count, slots, slotCount, *firstFree ) )
+    return false;
+
+  mFirstFree = *firstFree;
+  mIds.assign( ids, ids + count );
+  mSlots.assign( slots, slots + slotCount );
+  Vector2Stream* streams[ 3 ] = { &mPositions, &mVelocities, &mMoveInputs };
+  for( int i = 0; i < 3; ++i )
+  {
+    streams[ i ]->Resize( count );
+    std::memcpy( streams[ i ]->x, streamValues[ 2 * i ], count * sizeof( float ) );
+    std::memcpy( streams[ i ]->y, streamValues[ 2 * i + 1 ], count * sizeof( float ) );
+  }
+  return true;
+}
+
+// Per entity, this is
+//   accel = settings.accel * input
+//   if input is zero and speed > 0.1, accel -= velocity / speed * brake
+//   velocity += accel * dt
+//   position += velocity * dt
+//   if speed > maxSpeed, velocity *= maxSpeed / speed
+//   velocity *= damping
+// where speed is from before the update, same as the character always did.
+// begin has to be a multiple of 8, the stream padding
+static void UpdateMovementRange(
+  EntityStore* store,
+  const MovementSettings& settings,
+  float dt,
+  int begin,
+  int end )
+{
+  float* px = store->mPositions.x;
+  float* py = store->mPositions.y;
+  float* vx = store->mVelocities.x;
+  float* vy = store->mVelocities.y;
+  const float* ix = store->mMoveInputs.x;
+  const float* iy = store->mMoveInputs.y;
+  Lanes zero = LanesSet( 0 );
+  Lanes one = LanesSet( 1 );
+  Lanes tiny = LanesSet( 1e-30f );
+  Lanes brakeSpeed = LanesSet( 0.1f );
+  Lanes accel = LanesSet( settings.accel );
+  Lanes brake = LanesSet( settings.brake );
+  Lanes maxSpeed = LanesSet( settings.maxSpeed );
+  Lanes damping = LanesSet( settings.damping );
+  Lanes lanesDt = LanesSet( dt );
+
+  // The streams are zero padded to a multiple of 8, and zeros stay zero
+  for( int i = begin; i < end; i += laneCount )
+  {
+    Lanes inputX = LanesLoad( ix + i );
+    Lanes inputY = LanesLoad( iy + i );
+    Lanes velocityX = LanesLoad( vx + i );
+    Lanes velocityY = LanesLoad( vy + i );
+    Lanes speed = LanesSqrt( LanesAdd( LanesMul( velocityX, velocityX ), LanesMul( velocityY, velocityY ) ) );
+    Lanes invSpeed = LanesDiv( one, LanesMax( speed, tiny ) );
+
+    Lanes accelX = LanesMul( accel, inputX );
+    Lanes accelY = LanesMul( accel, inputY );
+    Lanes isBraking = LanesAnd(
+      LanesAnd( LanesEqual( inputX, zero ), LanesEqual( inputY, zero ) ),
+      LanesGreater( speed, brakeSpeed ) );
+    Lanes brakeScale = LanesSelect( isBraking, LanesMul( brake, invSpeed ), zero );
+    accelX = LanesSub( accelX, LanesMul( velocityX, brakeScale ) );
+    accelY = LanesSub( accelY, LanesMul( velocityY, brakeScale ) );
+
+    velocityX = LanesAdd( velocityX, LanesMul( accelX, lanesDt ) );
+    velocityY = LanesAdd( velocityY, LanesMul( accelY, lanesDt ) );
+    LanesStore( px + i, LanesAdd( LanesLoad( px + i ), LanesMul( velocityX, lanesDt ) ) );
+    LanesStore( py + i, LanesAdd( LanesLoad( py + i ), LanesMul( velocityY, lanesDt ) ) );
+
+    Lanes clampScale = LanesSelect(
+      LanesGreater( speed, maxSpeed ),
+      LanesMul( maxSpeed, invSpeed ),
+      one );
+    Lanes scale = LanesMul( clampScale, damping );
+    LanesStore( vx + i, LanesMul( velocityX, scale ) );
+    LanesStore( vy + i, LanesMul( velocityY, scale ) );
+  }
+}
+
+void UpdateMovement( EntityStore* store, MovementSettings settings, float dt )
+{
+  UpdateMovementRange( store, settings, dt, 0, store->GetCount() );
+}
+
+// Each job index is a block of 8 entities, to keep ranges on the padding
+struct MovementJob
+{
+  EntityStore* store;
+  MovementSettings settings;
+  float dt;
+};
+
+static void MovementJobFunction( void* userData, int begin, int end )
+{
+  MovementJob* job = ( MovementJob* )userData;
+  int count = job->store->GetCount();
+  int endIndex = end * 8 < count ? end * 8 : count;
+  UpdateMovementRange( job->store, job->settings, job->dt, begin * 8, endIndex );
+}
+
+void UpdateMovement( JobSystem* jobs, EntityStore* store, MovementSettings settings, float dt )
+{
+  MovementJob job;
+  job.store = store;
+  job.settings = settings;
+  job.dt = dt;
+  JobCounter counter;
+  jobs->ParallelFor( MovementJobFunction, &job, ( store->GetCount() + 7 ) / 8, &counter );
+  jobs->Wait( &counter );
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "vector2_stream.h"
+#include "job_system.h"
+#include "snapshot.h"
+#include "save_file.h"
+
+// Handle to an entity. The generation goes up every time the slot gets
+// reused, so handles to removed entities stop resolving instead of pointing
+// at whatever took their place. A zeroed EntityId is never valid
+struct EntityId
+{
+  uint32_t index;
+  uint32_t generation;
+};
+
+// Every entity has every component, stored as dense structure of arrays so
+// systems stream through contiguous memory. Dense index i of each component
+// array belongs to the entity mIds[ i ].
+//
+// Removing swaps the last entity into the hole, so dense indexes move around,
+// hold on to EntityIds instead
+struct EntityStore
+{
+  EntityStore();
+
+  EntityId Add( Vector2 position );
+  void Remove( EntityId id );
+  // Back to how it was constructed, slots and all, so generations start over
+  // and ids from before can resolve again. Only for throwing away a store
+  // wholesale, like one that came from a bad save
+  void Clear();
+  bool IsAlive( EntityId id ) const;
+
+  // Dense index of a live entity, for reading and writing its components
+  int GetIndex( EntityId id ) const;
+  int GetCount() const;
+
+  // Every component and the slots, so ids stay valid across a restore
+  void WriteSnapshot( Snapshot* snapshot ) const;
+  void ReadSnapshot( Snapshot* snapshot );
+
+  // One section per array. Reading checks that the ids, slots and free list
+  // all point at each other before copying anything, and returns false and
+  // leaves the store alone if any section is missing or they don't agree
+  void WriteSave( SaveWriter* writer ) const;
+  bool ReadSave( const SaveFile& save );
+
+  // Components
+  Vector2Stream mPositions;
+  Vector2Stream mVelocities;
+  // Which way the entity is trying to go, each axis in [ -1, 1 ]
+  Vector2Stream mMoveInputs;
+
+  // Dense index -> id
+  std::vector< EntityId > mIds;
+
+  struct Slot
+  {
+    uint32_t generation;
+    int denseIndex;
+    uint32_t nextFree;
+  };
+  // EntityId::index -> slot
+  std::vector< Slot > mSlots;
+  uint32_t mFirstFree;
+};
+
+struct MovementSettings
+{
+  float accel = 30.0f;
+  // Pulls a moving entity to a stop when it has no input
+  float brake = 20.0f;
+  float maxSpeed = 10.0f;
+  float damping = 0.99f;
+};
+
+// The character movement, for every entity
+void UpdateMovement( EntityStore* store, MovementSettings settings, float dt );
+
+// Same, split across the job system's threads
+void UpdateMovement( JobSystem* jobs, EntityStore* store, MovementSettings settings, float dt );
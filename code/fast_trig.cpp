@@ -0,0 +1,68 @@
+#include "fast_trig.h"
+
+void FastSinCosArray( const float* radians, float* sins, float* coss, int count )
+{
+  int i = 0;
+#if defined( __AVX2__ )
+  for( ; i + 8 <= count; i += 8 )
+  {
+    __m256 sin;
+    __m256 cos;
+    FastSinCos8( _mm256_loadu_ps( radians + i ), &sin, &cos );
+    if( sins )
+      _mm256_storeu_ps( sins + i, sin );
+    if( coss )
+      _mm256_storeu_ps( coss + i, cos );
+  }
+#endif
+  for( ; i + 4 <= count; i += 4 )
+  {
+    __m128 sin;
+    __m128 cos;
+    FastSinCos4( _mm_loadu_ps( radians + i ), &sin, &cos );
+    if( sins )
+      _mm_storeu_ps( sins + i, sin );
+    if( coss )
+      _mm_storeu_ps( coss + i, cos );
+  }
+  for( ; i < count; ++i )
+  {
+    float sin;
+    float cos;
+    FastSinCos( radians[ i ], &sin, &cos );
+    if( sins )
+      sins[ i ] = sin;
+    if( coss )
+      coss[ i ] = cos;
+  }
+}
+
+void RotateBatch( const float* radians, Matrix2* out, int count )
+{
+  int i = 0;
+
+  // 4 angles at a time, then transpose ( cos, -sin, sin, cos ) into 4 matrices
+  for( ; i + 4 <= count; i += 4 )
+  {
+    __m128 sin;
+    __m128 cos;
+    FastSinCos4( _mm_loadu_ps( radians + i ), &sin, &cos );
+    __m128 negSin = _mm_xor_ps( sin, _mm_set1_ps( -0.0f ) );
+    __m128 m00 = cos;
+    __m128 m01 = negSin;
+    __m128 m10 = sin;
+    __m128 m11 = cos;
+    _MM_TRANSPOSE4_PS( m00, m01, m10, m11 );
+    _mm_storeu_ps( out[ i + 0 ].values, m00 );
+    _mm_storeu_ps( out[ i + 1 ].values, m01 );
+    _mm_storeu_ps( out[ i + 2 ].values, m10 );
+    _mm_storeu_ps( out[ i + 3 ].values, m11 );
+  }
+  for( ; i < count; ++i )
+  {
+    float sin;
+    float cos;
+    FastSinCos( radians[ i ], &sin, &cos );
+    out[ i ] = Matrix2::Rotate( cos, sin );
+  }
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include "utility.h"
+#include <emmintrin.h>
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+
+// sin / cos without libm. The angle is reduced to [ -pi/4, pi/4 ] around the
+// nearest multiple of pi/2 ( in three parts, so the reduction stays exact for
+// a while ) and then goes through minimax polynomials for that range.
+//
+// Max abs error against double precision sin / cos ( benchmark_fast_trig.cpp ):
+//   |radians| <= 8192   : 1e-7
+//   |radians| <= 100000 : 1e-6
+// Past that the reduction starts losing bits, so keep angles wrapped.
+// The scalar and simd versions give the same results. The scalar one is about
+// as fast as libm, the win is in the 4 and 8 wide ones and the batch calls.
+
+static const float fastTrigTwoOverPi = 0.636619772367581343f;
+// pi / 2 = fastTrigPiOver2A + fastTrigPiOver2B + fastTrigPiOver2C, where A and
+// B have few enough bits that k * A and k * B are exact
+static const float fastTrigPiOver2A = 1.5703125f;
+static const float fastTrigPiOver2B = 4.837512969970703125e-4f;
+static const float fastTrigPiOver2C = 7.54978995489188216e-8f;
+static const float fastTrigSin1 = -1.6666654611e-1f;
+static const float fastTrigSin2 = 8.3321608736e-3f;
+static const float fastTrigSin3 = -1.9515295891e-4f;
+static const float fastTrigCos1 = 4.166664568298827e-2f;
+static const float fastTrigCos2 = -1.388731625493765e-3f;
+static const float fastTrigCos3 = 2.443315711809948e-5f;
+
+inline void FastSinCos( float radians, float* sin, float* cos )
+{
+  // round to nearest even, the same as cvtps2dq does in the simd versions
+  int k = _mm_cvtss_si32( _mm_set_ss( radians * fastTrigTwoOverPi ) );
+  float r = radians
+    - k * fastTrigPiOver2A
+    - k * fastTrigPiOver2B
+    - k * fastTrigPiOver2C;
+  float r2 = r * r;
+  float s = r + r * r2 * ( fastTrigSin1 + r2 * ( fastTrigSin2 + r2 * fastTrigSin3 ) );
+  float c = 1 - 0.5f * r2 + r2 * r2 * ( fastTrigCos1 + r2 * ( fastTrigCos2 + r2 * fastTrigCos3 ) );
+
+  // sin( r + k pi/2 ), cos( r + k pi/2 ) by quadrant:
+  //   k & 3 = 0 : s, c
+  //           1 : c, -s
+  //           2 : -s, -c
+  //           3 : -c, s
+  float swappedSin = ( k & 1 ) ? c : s;
+  float swappedCos = ( k & 1 ) ? s : c;
+  *sin = ( k & 2 ) ? -swappedSin : swappedSin;
+  *cos = ( ( k + 1 ) & 2 ) ? -swappedCos : swappedCos;
+}
+
+inline float FastSin( float radians )
+{
+  float sin;
+  float cos;
+  FastSinCos( radians, &sin, &cos );
+  return sin;
+}
+
+inline float FastCos( float radians )
+{
+  float sin;
+  float cos;
+  FastSinCos( radians, &sin, &cos );
+  return cos;
+}
+
+inline void FastSinCos4( __m128 radians, __m128* sin, __m128* cos )
+{
+  __m128i k = _mm_cvtps_epi32( _mm_mul_ps( radians, _mm_set1_ps( fastTrigTwoOverPi ) ) );
+  __m128 kf = _mm_cvtepi32_ps( k );
+  __m128 r = _mm_sub_ps( radians, _mm_mul_ps( kf, _mm_set1_ps( fastTrigPiOver2A ) ) );
+  r = _mm_sub_ps( r, _mm_mul_ps( kf, _mm_set1_ps( fastTrigPiOver2B ) ) );
+  r = _mm_sub_ps( r, _mm_mul_ps( kf, _mm_set1_ps( fastTrigPiOver2C ) ) );
+  __m128 r2 = _mm_mul_ps( r, r );
+
+  __m128 s = _mm_add_ps( _mm_set1_ps( fastTrigSin2 ), _mm_mul_ps( r2, _mm_set1_ps( fastTrigSin3 ) ) );
+  s = _mm_add_ps( _mm_set1_ps( fastTrigSin1 ), _mm_mul_ps( r2, s ) );
+  s = _mm_add_ps( r, _mm_mul_ps( _mm_mul_ps( r, r2 ), s ) );
+  __m128 c = _mm_add_ps( _mm_set1_ps( fastTrigCos2 ), _mm_mul_ps( r2, _mm_set1_ps( fastTrigCos3 ) ) );
+  c = _mm_add_ps( _mm_set1_ps( fastTrigCos1 ), _mm_mul_ps( r2, c ) );
+  c = _mm_add_ps(
+    _mm_sub_ps( _mm_set1_ps( 1 ), _mm_mul_ps( _mm_set1_ps( 0.5f ), r2 ) ),
+    _mm_mul_ps( _mm_mul_ps( r2, r2 ), c ) );
+
+  // See the quadrant table in FastSinCos
+  __m128 swap = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( k, _mm_set1_epi32( 1 ) ), _mm_set1_epi32( 1 ) ) );
+  __m128 swappedSin = _mm_or_ps( _mm_and_ps( swap, c ), _mm_andnot_ps( swap, s ) );
+  __m128 swappedCos = _mm_or_ps( _mm_and_ps( swap, s ), _mm_andnot_ps( swap, c ) );
+  __m128 sinSign = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( k, _mm_set1_epi32( 2 ) ), 30 ) );
+  __m128i kPlusOne = _mm_add_epi32( k, _mm_set1_epi32( 1 ) );
+  __m128 cosSign = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( kPlusOne, _mm_set1_epi32( 2 ) ), 30 ) );
+  *sin = _mm_xor_ps( swappedSin, sinSign );
+  *cos = _mm_xor_ps( swappedCos, cosSign );
+}
+
+#if defined( __AVX2__ )
+inline void FastSinCos8( __m256 radians, __m256* sin, __m256* cos )
+{
+  __m256i k = _mm256_cvtps_epi32( _mm256_mul_ps( radians, _mm256_set1_ps( fastTrigTwoOverPi ) ) );
+  __m256 kf = _mm256_cvtepi32_ps( k );
+  __m256 r = _mm256_sub_ps( radians, _mm256_mul_ps( kf, _mm256_set1_ps( fastTrigPiOver2A ) ) );
+  r = _mm256_sub_ps( r, _mm256_mul_ps( kf, _mm256_set1_ps( fastTrigPiOver2B ) ) );
+  r = _mm256_sub_ps( r, _mm256_mul_ps( kf, _mm256_set1_ps( fastTrigPiOver2C ) ) );
+  __m256 r2 = _mm256_mul_ps( r, r );
+
+  __m256 s = _mm256_add_ps( _mm256_set1_ps( fastTrigSin2 ), _mm256_mul_ps( r2, _mm256_set1_ps( fastTrigSin3 ) ) );
+  s = _mm256_add_ps( _mm256_set1_ps( fastTrigSin1 ), _mm256_mul_ps( r2, s ) );
+  s = _mm256_add_ps( r, _mm256_mul_ps( _mm256_mul_ps( r, r2 ), s ) );
+  __m256 c = _mm256_add_ps( _mm256_set1_ps( fastTrigCos2 ), _mm256_mul_ps( r2, _mm256_set1_ps( fastTrigCos3 ) ) );
+  c = _mm256_add_ps( _mm256_set1_ps( fastTrigCos1 ), _mm256_mul_ps( r2, c ) );
+  c = _mm256_add_ps(
+    _mm256_sub_ps( _mm256_set1_ps( 1 ), _mm256_mul_ps( _mm256_set1_ps( 0.5f ), r2 ) ),
+    _mm256_mul_ps( _mm256_mul_ps( r2, r2 ), c ) );
+
+  // See the quadrant table in FastSinCos
+  __m256 swap = _mm256_castsi256_ps( _mm256_slli_epi32( k, 31 ) );
+  __m256 swappedSin = _mm256_blendv_ps( s, c, swap );
+  __m256 swappedCos = _mm256_blendv_ps( c, s, swap );
+  __m256 sinSign = _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_and_si256( k, _mm256_set1_epi32( 2 ) ), 30 ) );
+  __m256i kPlusOne = _mm256_add_epi32( k, _mm256_set1_epi32( 1 ) );
+  __m256 cosSign = _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_and_si256( kPlusOne, _mm256_set1_epi32( 2 ) ), 30 ) );
+  *sin = _mm256_xor_ps( swappedSin, sinSign );
+  *cos = _mm256_xor_ps( swappedCos, cosSign );
+}
+#endif
+
+// sins and coss may each be null if they aren't wanted
+void FastSinCosArray( const float* radians, float* sins, float* coss, int count );
+
+// out[ i ] = Matrix2::Rotate( radians[ i ] ), with the fast sin / cos
+void RotateBatch( const float* radians, Matrix2* out, int count );
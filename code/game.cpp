@@ -1,6 +1,10 @@
 #include "game.h"
-
-#define ENABLE_GAME_INPUT_DEBUG 0
+#include "block_compression.h"
+#include "fast_trig.h"
+#include "view_culling.h"
+#include "platform.h"
+#include "profiler.h"
+#include "logger.h"
 
 #pragma warning( push )  
 // unreferenced formal parameter
@@ -21,9 +25,85 @@ struct Vertex
 };
 
 
-Game::Game( Graphics* graphics, Input* input ) : mGraphics( graphics ), mInput( input )
+static bool LoadAtlasPage( void* userData, MipChain* mipChain, Format* format )
+{
+  PROFILE_SCOPE( "LoadAtlasPage" );
+  AtlasPageSource* source = ( AtlasPageSource* )userData;
+
+  // The baked pixels get dropped after the first upload, so after an
+  // eviction the page has to be baked again
+  AtlasPage rebaked;
+  const AtlasPage* page = &source->atlas->pages[ source->page ];
+  if( page->pixels.empty() )
+  {
+    BakeAtlasPage( *source->atlas, source->page, source->settings, &rebaked );
+    page = &rebaked;
+  }
+
+  MipSettings mipSettings;
+  mipSettings.filter = MipFilter::Tent;
+  mipSettings.maxLevelCount = 4;
+  MipChain uncompressed;
+  GenerateMipChain(
+    &uncompressed,
+    page->pixels.data(),
+    page->width,
+    page->height,
+    4 * page->width,
+    4,
+    mipSettings );
+  CompressMipChain( mipChain, uncompressed, BlockFormat::BC3 );
+  *format = Format::bc3unorm;
+  return true;
+}
+
+static size_t CreateManagedTexture( void* userData, MipChain& mipChain, Format format, Texture* texture )
+{
+  Graphics* graphics = ( Graphics* )userData;
+  *texture = graphics->CreateTexture( mipChain, format );
+  return EstimateTextureByteCount( *texture );
+}
+
+static void FreeManagedTexture( void* userData, Texture texture )
+{
+  Graphics* graphics = ( Graphics* )userData;
+  graphics->FreeTexture( texture );
+}
+
+Game::Game( Graphics* graphics, Input* input ) :
+  mGraphics( graphics ),
+  mInput( input ),
+  mTextureManager( TextureUploader{ CreateManagedTexture, FreeManagedTexture, graphics }, 64 * 1024 * 1024 ),
+  mRoom( 40, 24, 1.0f, Vector2( -20, -12 ) ),
+  mParticles( 4096, ParticleSettings() ),
+  mHistory( 600, 60 )
 {
-  characterPosition = Vector2( 0, 3 );
+  // Walls around the edge of the room
+  mRoom.FillRect( 0, 0, mRoom.mTileCountX - 1, 0, true );
+  mRoom.FillRect( 0, mRoom.mTileCountY - 1, mRoom.mTileCountX - 1, mRoom.mTileCountY - 1, true );
+  mRoom.FillRect( 0, 0, 0, mRoom.mTileCountY - 1, true );
+  mRoom.FillRect( mRoom.mTileCountX - 1, 0, mRoom.mTileCountX - 1, mRoom.mTileCountY - 1, true );
+
+  if( !LoadGame() )
+    mCharacter = mEntities.Add( Vector2( 0, 3 ) );
+
+  // Around wherever LoadGame() left it, the same box Update() moves it to
+  {
+    Vector2 characterPosition = mEntities.mPositions.Get( mEntities.GetIndex( mCharacter ) );
+    Vector2 halfSize( 5.0f, 5.0f );
+    mCharacterLeaf = mWorldTree.Insert( Aabb{ characterPosition - halfSize, characterPosition + halfSize } );
+  }
+
+  // Follows the character around, see Update()
+  {
+    mParticles.mSettings.startColor = Color4( 1, 0.9f, 0.4f, 1 );
+    mParticles.mSettings.endColor = Color4( 1, 0.4f, 0.1f, 0 );
+    ParticleEmitter emitter;
+    emitter.rate = 200;
+    emitter.speed = 3;
+    emitter.lifetime = 1.5f;
+    mParticles.mEmitters.push_back( emitter );
+  }
   mTextPosition = Vector2( 3, 3 );
   mTextScale = 4;
 
@@ -69,41 +149,68 @@ Game::Game( Graphics* graphics, Input* input ) : mGraphics( graphics ), mInput(
       }
       stbtt_PackEnd( &spc );
     }
+
+    // BC4 keeps the single coverage channel at half the size of r8
+    int fontAtlasBlockStride = GetBlockRowStride( BlockFormat::BC4, fontAtlasWidth );
+    std::vector< uint8_t > fontAtlasBlocks(
+      fontAtlasBlockStride * ( ( fontAtlasHeight + 3 ) / 4 ) );
+    CompressImage(
+      fontAtlasBlocks.data(),
+      ( uint8_t* )fontAtlasCPU.mBytes,
+      fontAtlasWidth,
+      fontAtlasHeight,
+      fontAtlasWidth,
+      1,
+      BlockFormat::BC4 );
     mHachicro = mGraphics->CreateTexture(
-      fontAtlasCPU.mBytes,
+      fontAtlasBlocks.data(),
       fontAtlasWidth,
       fontAtlasHeight,
-      Format::r8unorm,
-      fontAtlasWidth );
+      Format::bc4unorm,
+      fontAtlasBlockStride );
+
+    int ascent;
+    int descent;
+    int lineGap;
+    stbtt_GetFontVMetrics( &fontinfo, &ascent, &descent, &lineGap );
+    float scale = stbtt_ScaleForPixelHeight( &fontinfo, mFontSize );
+    mOverlayFont.glyphs = packedchars;
+    mOverlayFont.atlasWidth = ( float )fontAtlasWidth;
+    mOverlayFont.atlasHeight = ( float )fontAtlasHeight;
+    mOverlayFont.ascent = ascent * scale;
+    mOverlayFont.lineHeight = ( ascent - descent + lineGap ) * scale;
   }
 
-  // Star
+  // Sprites
   {
-    TemporaryMemory memory( "data/star.png" );
-    int x;
-    int y;
-    int channels;
-    void* pixels = stbi_load_from_memory(
-      ( stbi_uc* )memory.mBytes,
-      memory.mByteCount,
-      &x,
-      &y,
-      &channels,
-      4 );
-    Assert( pixels );
-    mStar = graphics->CreateTexture(
-      pixels,
-      x,
-      y,
-      Format::r8g8b8a8unorm,
-      4 * x );
-    stbi_image_free( pixels );
+    // Each sprite gets 2 * ( extrusion + padding ) texels of gutter, which
+    // stops neighbours bleeding into each other for the first 3 mips
+    AtlasBakeSettings settings;
+    settings.extrusion = 2;
+    settings.padding = 2;
+    BakeAtlas( &mAtlas, settings );
+
+    mAtlasPageSources.resize( mAtlas.pages.size() );
+    for( int i = 0; i < ( int )mAtlas.pages.size(); ++i )
+    {
+      AtlasPageSource& source = mAtlasPageSources[ i ];
+      source.atlas = &mAtlas;
+      source.settings = settings;
+      source.page = i;
+      TextureHandle handle = mTextureManager.Register(
+        va( "atlas page %i", i ),
+        LoadAtlasPage,
+        &source );
+      mTextureManager.Require( handle );
+      mAtlasPages.push_back( handle );
+      std::vector< uint8_t >().swap( mAtlas.pages[ i ].pixels );
+    }
   }
 
   // Graphics creation
   {
-    mSpriteShader = mGraphics->LoadShader( "data/sprite.fx" );
-    mTextShader = mGraphics->LoadShader( "data/text.fx" );
+    mSpriteShader = mGraphics->LoadShader( "data/sprite.fx", constantBufferHlsl );
+    mTextShader = mGraphics->LoadShader( "data/text.fx", constantBufferHlsl );
     mBlend = mGraphics->CreateBlend();
     mDepth = mGraphics->CreateDepth();
     mSampler = mGraphics->CreateSampler();
@@ -113,26 +220,33 @@ Game::Game( Graphics* graphics, Input* input ) : mGraphics( graphics ), mInput(
     layoutCreator.AddLayout( "TEXCOORD", Format::r32g32float );
     mInputLayout = mGraphics->CreateInputLayout( layoutCreator, mSpriteShader );
 
+    mParticleShader = mGraphics->LoadShader( "data/particle.fx", constantBufferHlsl );
+    LayoutCreator particleLayoutCreator = layoutCreator;
+    particleLayoutCreator.AddInstanceLayout( "PARTICLE_POSITION", Format::r32g32b32float );
+    particleLayoutCreator.AddInstanceLayout( "PARTICLE_COLOR", Format::r8g8b8a8unorm );
+    mParticleLayout = mGraphics->CreateInputLayout( particleLayoutCreator, mParticleShader );
+    mParticleInstances = mGraphics->CreateDynamicVertexBuffer(
+      mParticles.mCapacity * sizeof( ParticleInstance ),
+      sizeof( ParticleInstance ) );
+
+    mOverlayShader = mGraphics->LoadShader( "data/overlay.fx", constantBufferHlsl );
+    LayoutCreator overlayLayoutCreator = layoutCreator;
+    overlayLayoutCreator.AddInstanceLayout( "OVERLAY_RECT", Format::r32g32b32a32float );
+    overlayLayoutCreator.AddInstanceLayout( "OVERLAY_UV", Format::r32g32b32a32float );
+    overlayLayoutCreator.AddInstanceLayout( "OVERLAY_COLOR", Format::r8g8b8a8unorm );
+    mOverlayLayout = mGraphics->CreateInputLayout( overlayLayoutCreator, mOverlayShader );
+    mOverlayQuads = mGraphics->CreateDynamicVertexBuffer(
+      PerfOverlay::quadCapacity * sizeof( OverlayQuad ),
+      sizeof( OverlayQuad ) );
+
     // 3---2
     // | \ |
     // 0---1
-    Vertex ndcTriVerts[ 4 ];
-
-    Vertex& v0 = ndcTriVerts[ 0 ];
-    v0.pos = Vector3( -1, -1, 0 );
-    v0.uv = Vector2( 0, 1 );
-
-    Vertex& v1 = ndcTriVerts[ 1 ];
-    v1.pos = Vector3( 1, -1, 0 );
-    v1.uv = Vector2( 1, 1 );
-
-    Vertex& v2 = ndcTriVerts[ 2 ];
-    v2.pos = Vector3( 1, 1, 0 );
-    v2.uv = Vector2( 1, 0 );
-
-    Vertex& v3 = ndcTriVerts[ 3 ];
-    v3.pos = Vector3( -1, 1, 0 );
-    v3.uv = Vector2( 0, 0 );
+    static constexpr Vertex ndcTriVerts[] = {
+      { Vector3( -1, -1, 0 ), Vector2( 0, 1 ) },
+      { Vector3( 1, -1, 0 ), Vector2( 1, 1 ) },
+      { Vector3( 1, 1, 0 ), Vector2( 1, 0 ) },
+      { Vector3( -1, 1, 0 ), Vector2( 0, 0 ) } };
 
     mVertexBuffer = mGraphics->CreateVertexBuffer(
       ndcTriVerts,
@@ -141,7 +255,7 @@ Game::Game( Graphics* graphics, Input* input ) : mGraphics( graphics ), mInput(
 
     // in directx, front face default winding is clockwise
 
-    uint16_t indexes[] = {
+    static constexpr uint16_t indexes[] = {
       0, 3, 1, // bottom left
       1, 3, 2 }; // top right
     const UINT indexCount = ArraySize( indexes );
@@ -151,12 +265,14 @@ Game::Game( Graphics* graphics, Input* input ) : mGraphics( graphics ), mInput(
       Format::r16uint,
       indexCount );
 
-    mConstantBuffer = mGraphics->CreateConstantBuffer( sizeof( ConstantBufferData ) );
+    mPerFrameBuffer = mGraphics->CreateConstantBuffer( sizeof( PerFrameConstants ) );
+    mPerDrawBuffer = mGraphics->CreateConstantBuffer( sizeof( PerDrawConstants ) );
   }
 
   // Graphics state
   {
-    mGraphics->SetConstantBuffer( mConstantBuffer, 0 );
+    mGraphics->SetConstantBuffer( mPerFrameBuffer, PER_FRAME_SLOT );
+    mGraphics->SetConstantBuffer( mPerDrawBuffer, PER_DRAW_SLOT );
     mGraphics->SetIndexBuffer( mIndexBuffer );
     mGraphics->SetVertexBuffer( mVertexBuffer );
     mGraphics->SetBlend( mBlend );
@@ -166,14 +282,111 @@ Game::Game( Graphics* graphics, Input* input ) : mGraphics( graphics ), mInput(
   }
 }
 
-void Game::RenderEnd( ConstantBufferData constantBufferData )
+// Everything Update() changes that can't be worked out from the rest. The
+// move inputs are in the entities, so each frame carries the input that
+// produced it, and the particles carry the random state
+void Game::WriteSnapshot( Snapshot* snapshot ) const
+{
+  snapshot->Write( mCharacter );
+  mEntities.WriteSnapshot( snapshot );
+  mParticles.WriteSnapshot( snapshot );
+}
+
+void Game::ReadSnapshot( Snapshot* snapshot )
+{
+  snapshot->Read( &mCharacter );
+  mEntities.ReadSnapshot( snapshot );
+  mParticles.ReadSnapshot( snapshot );
+}
+
+static const char* saveDirectory = "save";
+static const char* savePath = "save/room.sav";
+static const uint32_t characterTag = SaveTag( 'C', 'H', 'A', 'R' );
+
+// Picks up where the last run left off, if its save is still good. The room
+// keeps its default walls if the save's is a different size
+bool Game::LoadGame()
+{
+  PROFILE_SCOPE( "Game::LoadGame" );
+  SaveFile save;
+  if( !save.Open( savePath ) )
+    return false;
+  int characterCount;
+  const EntityId* character = save.GetSection< EntityId >( characterTag, &characterCount );
+  if( !character || characterCount != 1 || !mEntities.ReadSave( save ) )
+    return false;
+  mCharacter = *character;
+  if( !mEntities.IsAlive( mCharacter ) )
+  {
+    mEntities.Clear();
+    return false;
+  }
+  mRoom.ReadSave( save );
+  return true;
+}
+
+void Game::SaveGame()
+{
+  PROFILE_SCOPE( "Game::SaveGame" );
+  SaveWriter writer;
+  writer.AddSection( characterTag, &mCharacter, 1 );
+  mEntities.WriteSave( &writer );
+  mRoom.WriteSave( &writer );
+  // A save that can't be written just means starting over next time
+  PlatformCreateDirectory( saveDirectory );
+  writer.Write( savePath );
+}
+
+void Game::RenderEnd( PerDrawConstants perDraw )
 {
-  mGraphics->SetConstantBufferData( mConstantBuffer, &constantBufferData );
+  mGraphics->SetConstantBufferData( mPerDrawBuffer, &perDraw );
   mGraphics->Draw( mIndexBuffer );
 }
 
+// One instanced draw over everything else
+void Game::DrawOverlay()
+{
+  PROFILE_SCOPE( "Game::DrawOverlay" );
+  OverlayQuad* quads = ( OverlayQuad* )mGraphics->MapVertexBuffer( mOverlayQuads );
+  int quadCount = mOverlay.WriteQuads( quads, mOverlayFont, 0.5f );
+  mGraphics->UnmapVertexBuffer( mOverlayQuads );
+
+  // Pixels from the top left, y down, to ndc
+  PerDrawConstants overlayDraw = {};
+  overlayDraw.world = Matrix4(
+    Affine2::Translate( Vector2( -1, 1 ) ) *
+    Affine2::Scale( 2 / mInput->width, -2 / mInput->height ) );
+  overlayDraw.color = Color4( 1, 1, 1, 1 );
+  mGraphics->SetConstantBufferData( mPerDrawBuffer, &overlayDraw );
+  mGraphics->SetShader( mOverlayShader );
+  mGraphics->SetTexture( mHachicro, 0 );
+  mGraphics->SetInputLayout( mOverlayLayout );
+  mGraphics->SetInstanceBuffer( mOverlayQuads );
+  mGraphics->DrawInstanced( mIndexBuffer, quadCount );
+  mGraphics->SetInputLayout( mInputLayout );
+}
+
 void Game::Update()
 {
+  PROFILE_SCOPE( "Game::Update" );
+
+  // Counters are last frame's, SwapBuffers() and TextureManager::Update()
+  // just finished them
+  if( mInput->IsKeyJustPressed( TacKey::Overlay ) )
+    mOverlay.mIsVisible = !mOverlay.mIsVisible;
+  PerfOverlayCounters overlayCounters;
+  if( mOverlay.mIsVisible )
+  {
+    const GraphicsStats& graphicsStats = mGraphics->lastFrameStats;
+    overlayCounters.drawCount = graphicsStats.drawCount;
+    overlayCounters.instanceCount = graphicsStats.instanceCount;
+    overlayCounters.stateChangeCount = graphicsStats.stateChangeCount;
+    overlayCounters.uploadCount = graphicsStats.uploadCount;
+    overlayCounters.residentBytes = PlatformGetResidentByteCount();
+    overlayCounters.textureBytes = mTextureManager.mResidentBytes;
+    overlayCounters.textureBudgetBytes = mTextureManager.mBudgetBytes;
+  }
+  mOverlay.Update( overlayCounters );
   Vector2 uvMin( 0, 0 );
   Vector2 uvMax( 1, 1 );
   Backbuffer backbuffer = mGraphics->GetBackbuffer();
@@ -181,20 +394,36 @@ void Game::Update()
   mGraphics->Clear( backbuffer, Color4( 1, 0.5f, 0, 1 ) );
   mGraphics->SetViewport( mInput->width, mInput->height );
 
+  AtlasRegion& starRegion = mAtlas.GetRegion( Sprite::Star );
+  Texture starTexture;
+  bool isStarResident = mTextureManager.Acquire(
+    mAtlasPages[ starRegion.page ],
+    &starTexture );
   mGraphics->SetShader( mSpriteShader );
-  mGraphics->SetTexture( mStar, 0 );
+  if( isStarResident )
+    mGraphics->SetTexture( starTexture, 0 );
 
-  ConstantBufferData constantBufferData = {};
-  constantBufferData.uvMin = uvMin;
-  constantBufferData.uvMax = uvMax;
-  constantBufferData.color = Color4(
+  PerDrawConstants perDraw = {};
+  perDraw.uvMin = starRegion.uvMin;
+  perDraw.uvMax = starRegion.uvMax;
+  perDraw.color = Color4(
     124 / 255.0f,
     186 / 255.0f,
     91 / 255.0f,
     1.0f );
 
-  // update character with input 
+  // Holding rewind steps back through the history a frame at a time instead
+  // of simulating, and letting go carries on from there
+  if( mInput->IsKeyDownCurr( TacKey::Rewind ) && mHistory.GetFrameCount() > 1 )
   {
+    PROFILE_SCOPE( "Rewind" );
+    mHistory.Discard( 1 );
+    mHistory.Restore( 0, &mSnapshot );
+    ReadSnapshot( &mSnapshot );
+  }
+  else // update character with input
+  {
+    PROFILE_SCOPE( "Simulate" );
     Vector2 inputDir( 0, 0 );
     std::map< TacKey, Vector2 > keyDir;
     keyDir[ TacKey::Right ] = Vector2( 1, 0 );
@@ -204,55 +433,135 @@ void Game::Update()
     for( auto pair : keyDir )
       inputDir += pair.second * mInput->IsKeyDownCurr( pair.first );
 
-    float maxSpeed = 10;
-    float accel = 30.0f;
-    Vector2 accelVec = accel * inputDir;
-
-    float curSpeed = characterVelocity.Length();
-    if( inputDir.IsZero() && curSpeed > 0.1f )
-      accelVec += -( characterVelocity / curSpeed ) * 20;
-
-    characterVelocity += accelVec * mInput->dt;
-    characterPosition += characterVelocity * mInput->dt;
-
-    if( curSpeed > maxSpeed )
-      characterVelocity *= maxSpeed / curSpeed;
-
-    characterVelocity *= 0.99f;
-
+    int characterIndex = mEntities.GetIndex( mCharacter );
+    Vector2 oldPosition = mEntities.mPositions.Get( characterIndex );
+    mEntities.mMoveInputs.Set( characterIndex, inputDir );
+    UpdateMovement( &mJobs, &mEntities, MovementSettings(), mInput->dt );
+
+    // Movement integrates freely, so take it back and sweep the same move
+    // against the room
+    const Vector2 characterHalfSize( 5, 5 );
+    Vector2 newPosition = mEntities.mPositions.Get( characterIndex );
+    TileSweep sweep = mRoom.SweepAabb(
+      Aabb{ oldPosition - characterHalfSize, oldPosition + characterHalfSize },
+      newPosition - oldPosition );
+    mEntities.mPositions.Set( characterIndex, oldPosition + sweep.delta );
+    Vector2 velocity = mEntities.mVelocities.Get( characterIndex );
+    if( sweep.isBlockedX )
+      velocity.x = 0;
+    if( sweep.isBlockedY )
+      velocity.y = 0;
+    mEntities.mVelocities.Set( characterIndex, velocity );
+
+    mParticles.mEmitters[ 0 ].position = mEntities.mPositions.Get( characterIndex );
+    mParticles.Update( mInput->dt );
+
+    PROFILE_SCOPE( "Snapshot" );
+    mSnapshot.Clear();
+    WriteSnapshot( &mSnapshot );
+    mHistory.Push( mSnapshot );
   }
 
 
-  Matrix4 world;
+  Affine2 world;
+  Aabb characterAabb;
   {
+    float elapsedSeconds = ( float )mInput->mElapsedSeconds;
     float characterRadius = 5.0f
-      + 0.05f * ( float )std::sin( mInput->mElapsedSeconds * 1.0f );
-    float temp = ( float )std::sin( mInput->mElapsedSeconds * 5.0f );
-    temp *= ( float )std::sin( mInput->mElapsedSeconds * 4.0f + 2.0f );
+      + 0.05f * FastSin( elapsedSeconds * 1.0f );
+    float temp = FastSin( elapsedSeconds * 5.0f );
+    temp *= FastSin( elapsedSeconds * 4.0f + 2.0f );
     float characterRotation = 0;// 1.1f * temp;
-    Matrix2 characterscale = Matrix2::Scale( characterRadius );
-    Matrix2 characterrotation = Matrix2::Rotate( characterRotation );
-    Matrix4 charactertranslation = Matrix4::Translate( characterPosition );
-    world = charactertranslation * characterrotation * characterscale;
+    int characterIndex = mEntities.GetIndex( mCharacter );
+    Vector2 characterPosition = mEntities.mPositions.Get( characterIndex );
+    world = Affine2::TranslateRotateScale(
+      characterPosition,
+      characterRotation,
+      Vector2( characterRadius, characterRadius ) );
+
+    // The sprite quad goes from -1 to 1
+    Vector2 halfSize( characterRadius, characterRadius );
+    characterAabb = Aabb{ characterPosition - halfSize, characterPosition + halfSize };
+    mWorldTree.Move(
+      mCharacterLeaf,
+      characterAabb,
+      mEntities.mVelocities.Get( characterIndex ) * mInput->dt );
   }
-  constantBufferData.world = world;
+  perDraw.world = Matrix4( world );
 
 
-  Matrix4 view;
+  Affine2 view;
   {
     float aspectRatio = mInput->width / mInput->height;
-    float cameraRotation = 0.0f;
-    float cameraWidth = 10.0f;
+    constexpr float cameraWidth = 10.0f;
+    constexpr Vector2 cameraPosition( 0, 0 );
+    // the camera doesn't rotate
+    constexpr Affine2 camerarotation = Affine2::Identity();
+    constexpr Affine2 cameratranslation = Affine2::Translate( -cameraPosition );
     float cameraHeight = cameraWidth / aspectRatio;
-    Vector2 cameraPosition( 0, 0 );
-    Matrix2 camerascale = Matrix2::Scale( 1.0f / cameraWidth, 1.0f / cameraHeight );
-    Matrix2 camerarotation = Matrix2::Rotate( -cameraRotation );
-    Matrix4 cameratranslation = Matrix4::Translate( -cameraPosition );
-    view = Matrix4( camerascale * camerarotation ) * cameratranslation;
+    Affine2 camerascale = Affine2::Scale( 1.0f / cameraWidth, 1.0f / cameraHeight );
+    view = camerascale * camerarotation * cameratranslation;
   }
-  constantBufferData.view = view;
 
-  RenderEnd( constantBufferData );
+  // Mouse picking. The view takes world space to ndc, so its inverse takes
+  // the mouse back out to the world
+  {
+    Vector2 mouseNdc(
+      2 * mInput->mouseX / mInput->width - 1,
+      1 - 2 * mInput->mouseY / mInput->height );
+    Vector2 mouseWorld = view.Inverse().TransformPoint( mouseNdc );
+    mWorldTree.QueryPoint( mouseWorld, &mPickResults );
+    for( AabbHandle handle : mPickResults )
+    {
+      // The tree only knows fat aabbs, so check the real one
+      if( handle == mCharacterLeaf
+        && AabbContains( characterAabb, Aabb{ mouseWorld, mouseWorld } ) )
+        perDraw.color = Color4( 1, 1, 1, 1 );
+    }
+  }
+
+  // Only what overlaps the camera gets drawn
+  mCullStats = CullStats();
+  Aabb viewBounds = GetViewBounds( view );
+  {
+    PROFILE_SCOPE( "Culling" );
+    CullSprites( mWorldTree, viewBounds, &mVisibleSprites, &mCullStats );
+  }
+  bool isCharacterVisible = false;
+  for( AabbHandle handle : mVisibleSprites )
+    isCharacterVisible |= handle == mCharacterLeaf;
+
+  PerFrameConstants perFrame = {};
+  perFrame.view = Matrix4( view );
+  perFrame.time = ( float )mInput->mElapsedSeconds;
+  mGraphics->SetConstantBufferData( mPerFrameBuffer, &perFrame );
+
+  if( isStarResident && isCharacterVisible )
+    RenderEnd( perDraw );
+
+  // Particles, one instanced draw of the star sprite. Instances go straight
+  // from the simulation into the mapped buffer
+  if( isStarResident && mParticles.mCount )
+  {
+    PROFILE_SCOPE( "Draw particles" );
+    ParticleInstance* instances =
+      ( ParticleInstance* )mGraphics->MapVertexBuffer( mParticleInstances );
+    int instanceCount = mParticles.WriteInstances( instances, viewBounds );
+    mGraphics->UnmapVertexBuffer( mParticleInstances );
+    mCullStats.submitted += instanceCount;
+    mCullStats.culled += mParticles.mCount - instanceCount;
+
+    PerDrawConstants particleDraw = perDraw;
+    particleDraw.world = Matrix4( Affine2::Identity() );
+    particleDraw.color = Color4( 1, 1, 1, 1 );
+    mGraphics->SetConstantBufferData( mPerDrawBuffer, &particleDraw );
+    mGraphics->SetShader( mParticleShader );
+    mGraphics->SetInputLayout( mParticleLayout );
+    mGraphics->SetInstanceBuffer( mParticleInstances );
+    if( instanceCount )
+      mGraphics->DrawInstanced( mIndexBuffer, instanceCount );
+    mGraphics->SetInputLayout( mInputLayout );
+  }
 
   ///////////////
   // DRAW TEXT //
@@ -305,16 +614,20 @@ void Game::Update()
     }
   }
 
-  constantBufferData.uvMin = uvMin;
-  constantBufferData.uvMax = uvMax;
-  constantBufferData.world
-    = Matrix4::Translate( mTextPosition )
-    * Matrix2::Scale( mTextScale );
+  perDraw.uvMin = uvMin;
+  perDraw.uvMax = uvMax;
+  perDraw.world = Matrix4(
+    Affine2::Translate( mTextPosition ) *
+    Affine2::Scale( mTextScale ) );
 
 
-  RenderEnd( constantBufferData );
+  RenderEnd( perDraw );
+
+  if( mOverlay.mIsVisible )
+    DrawOverlay();
 
   mGraphics->SwapBuffers();
+  mTextureManager.Update();
 
 #if _DEBUG
   if( mInput->IsKeyJustPressed( TacKey::Debug ) )
@@ -324,27 +637,36 @@ void Game::Update()
   if( mInput->IsKeyJustPressed( TacKey::Menu ) )
     mInput->mQuitGameRequested = true;
 
-#if ENABLE_GAME_INPUT_DEBUG
-    OutputDebugString( va( "wasd curr %i%i%i%i prev %i%i%i%i \n",
-      mInput->IsKeyDownCurr( TacKey::Up ),
-      mInput->IsKeyDownCurr( TacKey::Left ),
-      mInput->IsKeyDownCurr( TacKey::Down ),
-      mInput->IsKeyDownCurr( TacKey::Right ),
-      mInput->IsKeyDownPrev( TacKey::Up ),
-      mInput->IsKeyDownPrev( TacKey::Left ),
-      mInput->IsKeyDownPrev( TacKey::Down ),
-      mInput->IsKeyDownPrev( TacKey::Right ) ) );
-#endif
+  // Every frame, so only in builds with LOG_MIN_SEVERITY at Debug
+  LOG( Debug, Render, "cull submitted %i culled %i",
+    mCullStats.submitted,
+    mCullStats.culled );
+  LOG( Debug, Input, "wasd curr %i%i%i%i prev %i%i%i%i",
+    mInput->IsKeyDownCurr( TacKey::Up ),
+    mInput->IsKeyDownCurr( TacKey::Left ),
+    mInput->IsKeyDownCurr( TacKey::Down ),
+    mInput->IsKeyDownCurr( TacKey::Right ),
+    mInput->IsKeyDownPrev( TacKey::Up ),
+    mInput->IsKeyDownPrev( TacKey::Left ),
+    mInput->IsKeyDownPrev( TacKey::Down ),
+    mInput->IsKeyDownPrev( TacKey::Right ) );
 }
 
 Game::~Game()
 {
+  SaveGame();
   mGraphics->FreeShader( mSpriteShader );
+  mGraphics->FreeShader( mParticleShader );
+  mGraphics->FreeShader( mOverlayShader );
+  mGraphics->FreeInputLayout( mOverlayLayout );
+  mGraphics->FreeVertexBuffer( mOverlayQuads );
+  mGraphics->FreeInputLayout( mParticleLayout );
+  mGraphics->FreeVertexBuffer( mParticleInstances );
   mGraphics->FreeIndexBuffer( mIndexBuffer );
   mGraphics->FreeInputLayout( mInputLayout );
   mGraphics->FreeVertexBuffer( mVertexBuffer );
-  mGraphics->FreeConstantBuffer( mConstantBuffer );
-  mGraphics->FreeTexture( mStar );
+  mGraphics->FreeConstantBuffer( mPerFrameBuffer );
+  mGraphics->FreeConstantBuffer( mPerDrawBuffer );
   mGraphics->FreeTexture( mHachicro );
   mGraphics->FreeBlend( mBlend );
   mGraphics->FreeDepth( mDepth );
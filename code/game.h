@@ -1,16 +1,25 @@
 #pragma once
 #include "graphics.h"
+#include "atlas.h"
+#include "texture_manager.h"
+#include "constant_buffers.h"
+#include "entity.h"
+#include "aabb_tree.h"
+#include "tile_map.h"
+#include "particles.h"
+#include "view_culling.h"
+#include "perf_overlay.h"
 
 #include "stb_truetype.h"
 
-struct ConstantBufferData
+// Lets the texture manager rebuild an atlas page after it got evicted
+struct AtlasPageSource
 {
-  Matrix4 world;
-  Matrix4 view;
-  Color4 color;
-  Vector2 uvMin;
-  Vector2 uvMax;
+  Atlas* atlas;
+  AtlasBakeSettings settings;
+  int page;
 };
+
 struct Game
 {
   Game( Graphics* graphics, Input* input );
@@ -19,28 +28,71 @@ struct Game
 
   Input* mInput;
   Graphics* mGraphics;
+  JobSystem mJobs;
+
+  // Ahead of mTextureManager, so they're still there while its destructor
+  // waits on a page that's being rebaked
+  Atlas mAtlas;
+  std::vector< AtlasPageSource > mAtlasPageSources;
+  TextureManager mTextureManager;
 
   Shader mSpriteShader;
   Shader mTextShader;
+  Shader mParticleShader;
   InputLayout mInputLayout;
+  InputLayout mParticleLayout;
   VertexBuffer mVertexBuffer;
   IndexBuffer mIndexBuffer;
-  ConstantBuffer mConstantBuffer;
+  ConstantBuffer mPerFrameBuffer;
+  ConstantBuffer mPerDrawBuffer;
   Depth mDepth;
   Blend mBlend;
   Sampler mSampler;
-  Texture mStar;
+  std::vector< TextureHandle > mAtlasPages;
   Texture mHachicro;
 
   float mTextScale;
   Vector2 mTextPosition;
 
-  Vector2 characterPosition;
-  Vector2 characterVelocity;
+  EntityStore mEntities;
+  EntityId mCharacter;
+  TileMap mRoom;
+
+  // Sparkles off the character, drawn with the star sprite
+  ParticleSystem mParticles;
+  VertexBuffer mParticleInstances;
+
+  // Everything that can be picked or raycast against, in world space
+  AabbTree mWorldTree;
+  AabbHandle mCharacterLeaf;
+  std::vector< AabbHandle > mPickResults;
+
+  // Leaves of mWorldTree in view this frame, and what got drawn or skipped
+  std::vector< AabbHandle > mVisibleSprites;
+  CullStats mCullStats;
+
+  // The last ten seconds of simulation, for rewinding
+  Snapshot mSnapshot;
+  SnapshotHistory mHistory;
+  void WriteSnapshot( Snapshot* snapshot ) const;
+  void ReadSnapshot( Snapshot* snapshot );
+
+  // The entities and the room, in save/room.sav
+  bool LoadGame();
+  void SaveGame();
+
+  // Frame times, profiler scopes and counters over everything, toggled with
+  // TacKey::Overlay. Drawn with the font in mHachicro
+  PerfOverlay mOverlay;
+  OverlayFont mOverlayFont;
+  Shader mOverlayShader;
+  InputLayout mOverlayLayout;
+  VertexBuffer mOverlayQuads;
+  void DrawOverlay();
 
 
   float mFontSize;
   stbtt_fontinfo fontinfo;
   stbtt_packedchar packedchars[ 128 ];
-  void RenderEnd( ConstantBufferData constantBufferData );
+  void RenderEnd( PerDrawConstants perDraw );
 };
\ No newline at end of file
@@ -1,21 +1,31 @@
 #include "graphics.h"
+#include "profiler.h"
 #include <D3DCompiler.h>
+#include <cstring>
 
 static DXGI_FORMAT ToDXGI_Format( Format format )
 {
   switch( format )
   {
+    case Format::r32g32b32a32float: return DXGI_FORMAT_R32G32B32A32_FLOAT;
     case Format::r32g32b32float: return DXGI_FORMAT_R32G32B32_FLOAT;
     case Format::r32g32float:return DXGI_FORMAT_R32G32_FLOAT;
     case Format::r16uint:return DXGI_FORMAT_R16_UINT;
     case Format::r8g8b8a8unorm: return DXGI_FORMAT_R8G8B8A8_UNORM;
     case Format::r8unorm: return DXGI_FORMAT_R8_UNORM;
+    case Format::bc1unorm: return DXGI_FORMAT_BC1_UNORM;
+    case Format::bc3unorm: return DXGI_FORMAT_BC3_UNORM;
+    case Format::bc4unorm: return DXGI_FORMAT_BC4_UNORM;
   }
   InvalidCodePath;
   return DXGI_FORMAT_UNKNOWN;
 }
 
-void LayoutCreator::AddLayout( const char* SemanticName, Format format )
+static D3D11_INPUT_ELEMENT_DESC CreateInputElement(
+  const char* SemanticName,
+  Format format,
+  UINT inputSlot,
+  UINT* alignedByteOffset )
 {
   // https://msdn.microsoft.com/en-us/library/windows/desktop/ff476180(v=vs.85).aspx
   D3D11_INPUT_ELEMENT_DESC desc = {};
@@ -26,26 +36,89 @@ void LayoutCreator::AddLayout( const char* SemanticName, Format format )
   //   one element with the same semantic.
   switch( format )
   {
+    case Format::r32g32b32a32float: desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT; break;
     case Format::r32g32b32float: desc.Format = DXGI_FORMAT_R32G32B32_FLOAT; break;
     case Format::r32g32float: desc.Format = DXGI_FORMAT_R32G32_FLOAT; break;
+    case Format::r8g8b8a8unorm: desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; break;
       InvalidDefaultCase;
   }
   // InputSlot: input-assembler (see input slot). Valid values are between 0 and 15
+  desc.InputSlot = inputSlot;
   // AlignedByteOffset: Optional. Offset (in bytes) between each element.
   //   Use D3D11_APPEND_ALIGNED_ELEMENT for convenience to define the current
   //   element directly after the previous one, including any packing if necessary.
-  // InputSlotClass: either D3D11_INPUT_PER_VERTEX_DATA or D3D11_INPUT_PER_INSTANCE_DATA
-  desc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-  desc.AlignedByteOffset = alignedByteOffset;
+  desc.AlignedByteOffset = *alignedByteOffset;
   switch( format )
   {
-    case Format::r32g32b32float: alignedByteOffset += 12; break;
-    case Format::r32g32float: alignedByteOffset += 8; break;
+    case Format::r32g32b32a32float: *alignedByteOffset += 16; break;
+    case Format::r32g32b32float: *alignedByteOffset += 12; break;
+    case Format::r32g32float: *alignedByteOffset += 8; break;
+    case Format::r8g8b8a8unorm: *alignedByteOffset += 4; break;
       InvalidDefaultCase;
   }
+  return desc;
+}
+
+void LayoutCreator::AddLayout( const char* SemanticName, Format format )
+{
+  D3D11_INPUT_ELEMENT_DESC desc = CreateInputElement( SemanticName, format, 0, &alignedByteOffset );
+  // InputSlotClass: either D3D11_INPUT_PER_VERTEX_DATA or D3D11_INPUT_PER_INSTANCE_DATA
+  desc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
   layout.push_back( desc );
 }
 
+void LayoutCreator::AddInstanceLayout( const char* SemanticName, Format format )
+{
+  D3D11_INPUT_ELEMENT_DESC desc = CreateInputElement( SemanticName, format, 1, &instanceByteOffset );
+  desc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+  // InstanceDataStepRate: how many instances to draw with the same data
+  //   before moving on to the next element
+  desc.InstanceDataStepRate = 1;
+  layout.push_back( desc );
+}
+
+static bool D3DCompileShader(
+  void* userData,
+  const char* source,
+  size_t sourceByteCount,
+  const char* sourceName,
+  const char* entryPoint,
+  const char* target,
+  uint32_t flags,
+  std::vector< char >* bytecode,
+  std::string* errors )
+{
+  Unused( userData );
+  ID3DBlob* blob = nullptr;
+  ID3DBlob* errorBlob = nullptr;
+  UINT flags2 = 0;
+  HRESULT hr = D3DCompile(
+    source,
+    sourceByteCount,
+    sourceName,
+    nullptr,
+    nullptr,
+    entryPoint,
+    target,
+    flags,
+    flags2,
+    &blob,
+    &errorBlob );
+  if( errorBlob )
+  {
+    errors->assign(
+      ( const char* )errorBlob->GetBufferPointer(),
+      errorBlob->GetBufferSize() );
+    errorBlob->Release();
+  }
+  if( FAILED( hr ) )
+    return false;
+  const char* bytes = ( const char* )blob->GetBufferPointer();
+  bytecode->assign( bytes, bytes + blob->GetBufferSize() );
+  blob->Release();
+  return true;
+}
+
 Graphics::Graphics(
   HWND windowHandle,
   UINT width,
@@ -122,10 +195,17 @@ Graphics::Graphics(
     backbufferDepthStencil, &descDSV, &backbufferDepthStencilView );
   if( FAILED( hr ) )
     HandleErrorGracefully();
+
+  shaderCache = new ShaderCache(
+    "shader_cache",
+    D3DCOMPILER_DLL_A,
+    D3DCompileShader,
+    nullptr );
 }
 
 Graphics::~Graphics()
 {
+  delete shaderCache;
   device->Release();
   immediateContext->Release();
   swapChain->Release();
@@ -136,6 +216,7 @@ Graphics::~Graphics()
 
 void Graphics::SetViewport( float width, float height )
 {
+  ++frameStats.stateChangeCount;
   D3D11_VIEWPORT viewport = {};
   viewport.MinDepth = 0;
   viewport.MaxDepth = 1;
@@ -146,9 +227,12 @@ void Graphics::SetViewport( float width, float height )
 
 void Graphics::SwapBuffers()
 {
+  PROFILE_SCOPE( "Graphics::SwapBuffers" );
   UINT syncinterval = 0;
   UINT flags = 0;
   swapChain->Present( syncinterval, flags );
+  lastFrameStats = frameStats;
+  frameStats = GraphicsStats();
 }
 
 Backbuffer Graphics::GetBackbuffer()
@@ -161,6 +245,7 @@ Backbuffer Graphics::GetBackbuffer()
 
 void Graphics::SetRenderTarget( Backbuffer backbuffer )
 {
+  ++frameStats.stateChangeCount;
   ID3D11RenderTargetView* views[1] = { backbuffer.backbufferRTV };
   immediateContext->OMSetRenderTargets(
     1,
@@ -170,6 +255,7 @@ void Graphics::SetRenderTarget( Backbuffer backbuffer )
 
 void Graphics::Clear( Backbuffer backbuffer, Color4 color )
 {
+  PROFILE_SCOPE( "Graphics::Clear" );
   immediateContext->ClearRenderTargetView(
     backbuffer.backbufferRTV,
     &color.r );
@@ -180,51 +266,65 @@ void Graphics::Clear( Backbuffer backbuffer, Color4 color )
     0 );
 }
 
-ID3DBlob* CompileShader(
+static ID3DBlob* CompileShader(
+  ShaderCache* shaderCache,
+  const std::string& source,
   const char* entryPoint,
   const char* target,
   const char* path )
 {
-  TemporaryMemory memory( path );
-  ID3DBlob* blob;
-  ID3DBlob* errors;
-
-  UINT flags1 = 0;
+  UINT flags = 0;
 #ifdef _DEBUG
-  flags1 |= D3DCOMPILE_DEBUG;
+  flags |= D3DCOMPILE_DEBUG;
 #endif
-  UINT flags2 = 0;
-  HRESULT hr = D3DCompile(
-    memory.mBytes,
-    memory.mByteCount,
-    nullptr,
-    nullptr,
-    nullptr,
+  std::vector< char > bytecode;
+  std::string errors;
+  if( !shaderCache->GetBytecode(
+    source.data(),
+    source.size(),
+    path,
     entryPoint,
     target,
-    flags1,
-    flags2,
-    &blob,
-    &errors );
-  if( FAILED( hr ) )
-  {
-    const char* errorsReadable = ( const char* )errors->GetBufferPointer();
+    flags,
+    &bytecode,
+    &errors ) )
     HandleErrorGracefully( va( "%s\n%s",
       path,
-      errorsReadable ) );
-  }
+      errors.c_str() ) );
+
+  // CreateInputLayout wants the vertex shader's blob later on
+  ID3DBlob* blob;
+  HRESULT hr = D3DCreateBlob( bytecode.size(), &blob );
+  if( FAILED( hr ) )
+    HandleErrorGracefully();
+  std::memcpy( blob->GetBufferPointer(), bytecode.data(), bytecode.size() );
   return blob;
 }
 
-Shader Graphics::LoadShader( const char* path )
+Shader Graphics::LoadShader( const char* path, const char* preamble )
 {
+  PROFILE_SCOPE( "Graphics::LoadShader" );
   Shader shader;
 
+  // read once, compile ( or fetch from the cache ) once per entry point
+  TemporaryMemory file( path );
+  std::string source;
+  if( preamble )
+  {
+    // #line keeps error line numbers relative to the file
+    source += preamble;
+    source += va( "#line 1 \"%s\"\n", path );
+  }
+  source.append( file.mBytes, file.mByteCount );
   shader.vsBlob = CompileShader(
+    shaderCache,
+    source,
     "vsmain",
     "vs_5_0",
     path );
   shader.psBlob = CompileShader(
+    shaderCache,
+    source,
     "psmain",
     "ps_5_0",
     path );
@@ -256,6 +356,7 @@ void Graphics::FreeShader( Shader shader )
 
 void Graphics::SetShader( Shader shader )
 {
+  ++frameStats.stateChangeCount;
   immediateContext->VSSetShader( shader.vertexShader, nullptr, 0 );
   immediateContext->PSSetShader( shader.pixelShader, nullptr, 0 );
 }
@@ -277,6 +378,7 @@ InputLayout Graphics::CreateInputLayout( LayoutCreator layoutCreator, Shader sha
 
 void Graphics::SetInputLayout( InputLayout layout )
 {
+  ++frameStats.stateChangeCount;
   immediateContext->IASetInputLayout( layout.inputLayout );
 }
 
@@ -286,7 +388,7 @@ void Graphics::FreeInputLayout( InputLayout inputLayout )
 }
 
 VertexBuffer Graphics::CreateVertexBuffer(
-  void* bufferData,
+  const void* bufferData,
   UINT bufferByteCount,
   UINT stride )
 {
@@ -314,6 +416,7 @@ VertexBuffer Graphics::CreateVertexBuffer(
 
 void Graphics::SetVertexBuffer( VertexBuffer vertexBuffer )
 {
+  ++frameStats.stateChangeCount;
   const UINT bufferCount = 1;
   // One stride value for each buffer in the vertex-buffer array.
   // Each stride is the size (in bytes) of the elements that are to be used from that vertex buffer
@@ -336,8 +439,53 @@ void Graphics::FreeVertexBuffer( VertexBuffer vertexBuffer )
   vertexBuffer.buffer->Release();
 }
 
+VertexBuffer Graphics::CreateDynamicVertexBuffer( UINT bufferByteCount, UINT stride )
+{
+  VertexBuffer result;
+  result.stride = stride;
+
+  D3D11_BUFFER_DESC desc = {};
+  desc.ByteWidth = bufferByteCount;
+  desc.Usage = D3D11_USAGE_DYNAMIC;
+  desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+  desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+  HRESULT hr = device->CreateBuffer( &desc, nullptr, &result.buffer );
+  if( FAILED( hr ) )
+    HandleErrorGracefully();
+  return result;
+}
+
+void* Graphics::MapVertexBuffer( VertexBuffer vertexBuffer )
+{
+  // Discard hands back fresh memory, so this doesn't wait on the gpu to be
+  // done with last frame's contents
+  D3D11_MAPPED_SUBRESOURCE mapped;
+  HRESULT hr = immediateContext->Map( vertexBuffer.buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped );
+  ++frameStats.uploadCount;
+  if( FAILED( hr ) )
+    HandleErrorGracefully();
+  return mapped.pData;
+}
+
+void Graphics::UnmapVertexBuffer( VertexBuffer vertexBuffer )
+{
+  immediateContext->Unmap( vertexBuffer.buffer, 0 );
+}
+
+void Graphics::SetInstanceBuffer( VertexBuffer vertexBuffer )
+{
+  ++frameStats.stateChangeCount;
+  UINT offset = 0;
+  immediateContext->IASetVertexBuffers(
+    1,
+    1,
+    &vertexBuffer.buffer,
+    &vertexBuffer.stride,
+    &offset );
+}
+
 IndexBuffer Graphics::CreateIndexBuffer(
-  void* bufferData,
+  const void* bufferData,
   UINT bufferByteCount,
   Format format,
   UINT indexCount )
@@ -361,6 +509,7 @@ IndexBuffer Graphics::CreateIndexBuffer(
 
 void Graphics::SetIndexBuffer( IndexBuffer indexBuffer )
 {
+  ++frameStats.stateChangeCount;
   immediateContext->IASetIndexBuffer( indexBuffer.buffer, indexBuffer.format, 0 );
 }
 
@@ -371,40 +520,116 @@ void Graphics::FreeIndexBuffer( IndexBuffer indexBuffer )
 
 void Graphics::Draw( IndexBuffer indexBuffer )
 {
+  PROFILE_SCOPE( "Graphics::Draw" );
   immediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
   immediateContext->DrawIndexed( indexBuffer.indexCount, 0, 0 );
+  ++frameStats.drawCount;
+  ++frameStats.instanceCount;
 }
 
-Texture Graphics::CreateTexture(
-  void* bytes,
+void Graphics::DrawInstanced( IndexBuffer indexBuffer, UINT instanceCount )
+{
+  PROFILE_SCOPE( "Graphics::DrawInstanced" );
+  immediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+  immediateContext->DrawIndexedInstanced( indexBuffer.indexCount, instanceCount, 0, 0, 0 );
+  ++frameStats.drawCount;
+  frameStats.instanceCount += instanceCount;
+}
+
+static Texture CreateTexture(
+  ID3D11Device* device,
+  D3D11_SUBRESOURCE_DATA* datas,
+  int mipCount,
   int width,
   int height,
-  Format format,
-  int stride ) // number of bytes from one row to the next
+  Format format )
 {
   Texture result;
   result.width = width;
   result.height = height;
+  result.mipCount = mipCount;
+  result.format = format;
 
   D3D11_TEXTURE2D_DESC desc = {};
   desc.ArraySize = 1;
-  desc.MipLevels = 1;
+  desc.MipLevels = mipCount;
   desc.SampleDesc.Count = 1;
   desc.Width = width;
   desc.Height = height;
   desc.Format = ToDXGI_Format( format );
   desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+  HRESULT hr = device->CreateTexture2D( &desc, datas, &result.texture );
+  if( FAILED( hr ) )
+    HandleErrorGracefully();
+  device->CreateShaderResourceView( result.texture, nullptr, &result.srv );
+  return result;
+}
 
+Texture Graphics::CreateTexture(
+  void* bytes,
+  int width,
+  int height,
+  Format format,
+  int stride ) // number of bytes from one row to the next
+{
+  PROFILE_SCOPE( "Graphics::CreateTexture" );
   // SysMemPitch: Distance in bytes(?) between any two adjacent pixels on different lines.
   // SysMemSlicePitch: Size of the entire 2D surface in bytes.
   D3D11_SUBRESOURCE_DATA data = {};
   data.pSysMem = bytes;
   data.SysMemPitch = stride;
   data.SysMemSlicePitch = stride * height;
-  HRESULT hr = device->CreateTexture2D( &desc, &data, &result.texture );
-  if( FAILED( hr ) )
-    HandleErrorGracefully();
-  device->CreateShaderResourceView( result.texture, nullptr, &result.srv );
+  return ::CreateTexture( device, &data, 1, width, height, format );
+}
+
+Texture Graphics::CreateTexture( MipChain& mipChain, Format format )
+{
+  PROFILE_SCOPE( "Graphics::CreateTexture" );
+  // block compressed levels have one row per 4 texel rows
+  bool isBlockCompressed
+    = format == Format::bc1unorm
+    || format == Format::bc3unorm
+    || format == Format::bc4unorm;
+
+  // one subresource per mip, largest first
+  std::vector< D3D11_SUBRESOURCE_DATA > datas( mipChain.levels.size() );
+  for( int i = 0; i < ( int )datas.size(); ++i )
+  {
+    MipLevel& level = mipChain.levels[ i ];
+    int rowCount = isBlockCompressed ? ( level.height + 3 ) / 4 : level.height;
+    D3D11_SUBRESOURCE_DATA& data = datas[ i ];
+    data.pSysMem = mipChain.GetLevelBytes( i );
+    data.SysMemPitch = level.stride;
+    data.SysMemSlicePitch = level.stride * rowCount;
+  }
+  MipLevel& top = mipChain.levels[ 0 ];
+  return ::CreateTexture(
+    device,
+    datas.data(),
+    ( int )datas.size(),
+    top.width,
+    top.height,
+    format );
+}
+
+size_t EstimateTextureByteCount( Texture texture )
+{
+  size_t result = 0;
+  for( uint32_t i = 0; i < texture.mipCount; ++i )
+  {
+    size_t width = texture.width >> i ? texture.width >> i : 1;
+    size_t height = texture.height >> i ? texture.height >> i : 1;
+    size_t blockCount = ( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 );
+    switch( texture.format )
+    {
+      case Format::r8g8b8a8unorm: result += width * height * 4; break;
+      case Format::r8unorm: result += width * height; break;
+      case Format::bc1unorm: result += blockCount * 8; break;
+      case Format::bc3unorm: result += blockCount * 16; break;
+      case Format::bc4unorm: result += blockCount * 8; break;
+      InvalidDefaultCase;
+    }
+  }
   return result;
 }
 
@@ -416,6 +641,7 @@ void Graphics::FreeTexture( Texture texture )
 
 void Graphics::SetTexture( Texture texture, int index )
 {
+  ++frameStats.stateChangeCount;
   immediateContext->PSSetShaderResources( index, 1, &texture.srv );
 }
 
@@ -435,11 +661,13 @@ void Graphics::SetConstantBufferData(
   void* data )
 {
   immediateContext->UpdateSubresource( constantBuffer.buffer, 0, nullptr, data, 0, 0 );
+  ++frameStats.uploadCount;
 }
 void Graphics::SetConstantBuffer(
   ConstantBuffer constantBuffer,
   UINT slotIndex )
 {
+  ++frameStats.stateChangeCount;
   immediateContext->PSSetConstantBuffers( slotIndex, 1, &constantBuffer.buffer );
   immediateContext->VSSetConstantBuffers( slotIndex, 1, &constantBuffer.buffer );
 }
@@ -473,6 +701,7 @@ Blend Graphics::CreateBlend()
 }
 void Graphics::SetBlend( Blend blend )
 {
+  ++frameStats.stateChangeCount;
   // https://msdn.microsoft.com/en-us/library/windows/desktop/ff476462(v=vs.85).aspx
   immediateContext->OMSetBlendState( blend.state, nullptr, 0xffffffff );
 }
@@ -492,6 +721,7 @@ Depth Graphics::CreateDepth()
 }
 void Graphics::SetDepth( Depth depth )
 {
+  ++frameStats.stateChangeCount;
   immediateContext->OMSetDepthStencilState( depth.state, 1 );
 }
 void Graphics::FreeDepth( Depth depth )
@@ -518,6 +748,7 @@ Sampler Graphics::CreateSampler()
 }
 void Graphics::SetSampler( Sampler sampler, int slot )
 {
+  ++frameStats.stateChangeCount;
   immediateContext->PSSetSamplers( slot, 1, &sampler.state );
 }
 void Graphics::FreeSampler( Sampler sampler )
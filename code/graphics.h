@@ -1,32 +1,22 @@
 #pragma once
 #include <d3d11.h>
 #include "utility.h"
-
-enum class Format
-{
-  r32g32b32float,
-  r32g32float,
-
-  r16uint,
-
-  r8g8b8a8unorm,
-  r8unorm,
-};
+#include "mipmap.h"
+#include "shader_cache.h"
+#include "texture.h"
 
 struct LayoutCreator
 {
   UINT alignedByteOffset = 0;
+  UINT instanceByteOffset = 0;
   std::vector< D3D11_INPUT_ELEMENT_DESC > layout;
   void AddLayout( const char* SemanticName, Format format );
+  // Read once per instance, from the buffer set with SetInstanceBuffer()
+  void AddInstanceLayout( const char* SemanticName, Format format );
 };
 
-struct Texture
-{
-  ID3D11Texture2D* texture;
-  ID3D11ShaderResourceView* srv;
-  uint32_t width;
-  uint32_t height;
-};
+// Video memory the texture takes up, all mips included
+size_t EstimateTextureByteCount( Texture texture );
 
 struct Shader
 {
@@ -80,6 +70,17 @@ struct Sampler
   ID3D11SamplerState* state;
 };
 
+// What one frame asked of the gpu, counted as the calls are made
+struct GraphicsStats
+{
+  int drawCount = 0;
+  int instanceCount = 0;
+  // Every Set*() call, whether or not it changed anything
+  int stateChangeCount = 0;
+  // Constant buffer updates and vertex buffer maps
+  int uploadCount = 0;
+};
+
 struct Graphics
 {
   Graphics( HWND windowHandle, UINT width, UINT height );
@@ -95,13 +96,21 @@ struct Graphics
   ID3D11Texture2D* backbufferDepthStencil;
   ID3D11DepthStencilView* backbufferDepthStencilView;
 
+  // Compiled shaders from previous runs, keyed by source + entry point + target
+  ShaderCache* shaderCache;
+
+  // SwapBuffers() moves frameStats to lastFrameStats and starts over
+  GraphicsStats frameStats;
+  GraphicsStats lastFrameStats;
+
   void SetViewport( float width, float height );
   void SwapBuffers();
   Backbuffer GetBackbuffer();
   void SetRenderTarget( Backbuffer backbuffer );
   void Clear( Backbuffer backbuffer, Color4 color );
 
-  Shader LoadShader( const char* path );
+  // preamble ( optional ) is compiled in front of the file, eg. constantBufferHlsl
+  Shader LoadShader( const char* path, const char* preamble = nullptr );
   void FreeShader( Shader shader );
   void SetShader( Shader shader );
 
@@ -109,12 +118,20 @@ struct Graphics
   void SetInputLayout( InputLayout layout );
   void FreeInputLayout( InputLayout inputLayout );
 
-  VertexBuffer CreateVertexBuffer( void* bufferData, UINT bufferByteCount, UINT stride );
+  VertexBuffer CreateVertexBuffer( const void* bufferData, UINT bufferByteCount, UINT stride );
   void SetVertexBuffer( VertexBuffer vertexBuffer );
   void FreeVertexBuffer( VertexBuffer vertexBuffer );
 
+  // Rewritten by the cpu every frame. Map() throws away the old contents, and
+  // the memory it returns is write combined, so write it in order and never
+  // read it back
+  VertexBuffer CreateDynamicVertexBuffer( UINT bufferByteCount, UINT stride );
+  void* MapVertexBuffer( VertexBuffer vertexBuffer );
+  void UnmapVertexBuffer( VertexBuffer vertexBuffer );
+  void SetInstanceBuffer( VertexBuffer vertexBuffer );
+
   IndexBuffer CreateIndexBuffer(
-    void* bufferData,
+    const void* bufferData,
     UINT bufferByteCount,
     Format format,
     UINT indexCount );
@@ -127,6 +144,7 @@ struct Graphics
   void FreeConstantBuffer( ConstantBuffer constantBuffer );
 
   void Draw( IndexBuffer indexBuffer );
+  void DrawInstanced( IndexBuffer indexBuffer, UINT instanceCount );
 
   Texture CreateTexture(
     void* bytes,
@@ -135,6 +153,7 @@ struct Graphics
     Format format,
     int stride
   );
+  Texture CreateTexture( MipChain& mipChain, Format format );
   void FreeTexture( Texture texture );
   void SetTexture( Texture texture, int index );
 
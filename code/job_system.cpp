@@ -0,0 +1,260 @@
+#include "job_system.h"
+#include "profiler.h"
+
+// Which system the current thread is a worker of, and which deque it pushes
+// to and pops from in that one. Threads that don't belong to a system, and a
+// worker of one system calling into another, use worker 0's
+static thread_local const JobSystem* currentJobSystem = nullptr;
+static thread_local int currentWorkerIndex = 0;
+
+static int GetWorkerIndex( const JobSystem* system )
+{
+  return currentJobSystem == system ? currentWorkerIndex : 0;
+}
+
+JobSystem::JobSystem( int threadCount ) : mWorkers( threadCount
+  ? threadCount
+  : ( std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1 ) )
+{
+  mQueuedCount = 0;
+  mSleepingCount = 0;
+  mQuit = false;
+  for( int i = 1; i < GetThreadCount(); ++i )
+    mThreads.push_back( std::thread( &JobSystem::WorkerThread, this, i ) );
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard< std::mutex > lock( mSleepMutex );
+    mQuit = true;
+  }
+  mWake.notify_all();
+  for( std::thread& thread : mThreads )
+    thread.join();
+  Assert( mQueuedCount == 0 );
+}
+
+int JobSystem::GetThreadCount() const
+{
+  return ( int )mWorkers.size();
+}
+
+void JobSystem::Run( JobFunction function, void* userData, JobCounter* counter )
+{
+  Job job;
+  job.function = function;
+  job.userData = userData;
+  job.begin = 0;
+  job.end = 1;
+  job.grainSize = 0;
+  job.counter = counter;
+  if( counter )
+    ++counter->count;
+  Push( job );
+}
+
+void JobSystem::ParallelFor(
+  JobFunction function,
+  void* userData,
+  int count,
+  JobCounter* counter,
+  int grainSize )
+{
+  if( count <= 0 )
+    return;
+  if( !grainSize )
+  {
+    // Enough chunks for stealing to even out the load, not so many that the
+    // queueing costs more than the work
+    grainSize = count / ( GetThreadCount() * 8 );
+    if( grainSize < 1 )
+      grainSize = 1;
+  }
+  if( count <= grainSize )
+  {
+    function( userData, 0, count );
+    return;
+  }
+
+  Job job;
+  job.function = function;
+  job.userData = userData;
+  job.begin = 0;
+  job.end = count;
+  job.grainSize = grainSize;
+  job.counter = counter;
+  if( counter )
+    ++counter->count;
+  Push( job );
+}
+
+void JobSystem::RunAfter(
+  JobCounter* dependency,
+  JobFunction function,
+  void* userData,
+  JobCounter* counter )
+{
+  Job job;
+  job.function = function;
+  job.userData = userData;
+  job.begin = 0;
+  job.end = 1;
+  job.grainSize = 0;
+  job.counter = counter;
+  if( counter )
+    ++counter->count;
+  {
+    // Finish() takes the continuations under the same lock after the count
+    // hits zero, so the job either goes in the list before that or sees zero
+    std::lock_guard< std::mutex > lock( dependency->mutex );
+    if( dependency->count )
+    {
+      dependency->continuations.push_back( job );
+      return;
+    }
+  }
+  Push( job );
+}
+
+void JobSystem::Wait( JobCounter* counter )
+{
+  while( counter->count )
+  {
+    Job job;
+    if( FindJob( &job ) )
+      Execute( job );
+    else
+      std::this_thread::yield();
+  }
+
+  // Let the Finish() that got it to zero let go of the counter
+  std::lock_guard< std::mutex > lock( counter->mutex );
+}
+
+void JobSystem::Push( Job job )
+{
+  // Counted before it's visible, so FindJob() can't take it and decrement
+  // first. At worst someone sees a count with no job yet and looks again
+  ++mQueuedCount;
+  Worker& worker = mWorkers[ GetWorkerIndex( this ) ];
+  {
+    std::lock_guard< std::mutex > lock( worker.mutex );
+    worker.jobs.push_back( job );
+  }
+
+  // Pairs with the increment of mSleepingCount in WorkerThread(), one of the
+  // two always sees the other
+  if( mSleepingCount )
+  {
+    std::lock_guard< std::mutex > lock( mSleepMutex );
+    mWake.notify_one();
+  }
+}
+
+bool JobSystem::FindJob( Job* job )
+{
+  if( !mQueuedCount )
+    return false;
+
+  // Own deque from the back, it's the most recently split so still in cache
+  int workerIndex = GetWorkerIndex( this );
+  {
+    Worker& worker = mWorkers[ workerIndex ];
+    std::lock_guard< std::mutex > lock( worker.mutex );
+    if( !worker.jobs.empty() )
+    {
+      *job = worker.jobs.back();
+      worker.jobs.pop_back();
+      --mQueuedCount;
+      return true;
+    }
+  }
+
+  // Steal from the front, which has the biggest ranges
+  int workerCount = GetThreadCount();
+  for( int i = 1; i < workerCount; ++i )
+  {
+    Worker& victim = mWorkers[ ( workerIndex + i ) % workerCount ];
+    std::lock_guard< std::mutex > lock( victim.mutex );
+    if( !victim.jobs.empty() )
+    {
+      *job = victim.jobs.front();
+      victim.jobs.pop_front();
+      --mQueuedCount;
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::Execute( Job job )
+{
+  while( job.grainSize && job.end - job.begin > job.grainSize )
+  {
+    Job other = job;
+    other.begin = job.begin + ( job.end - job.begin ) / 2;
+    job.end = other.begin;
+    if( other.counter )
+      ++other.counter->count;
+    Push( other );
+  }
+  {
+    PROFILE_SCOPE( "Job" );
+    job.function( job.userData, job.begin, job.end );
+  }
+  Finish( job.counter );
+}
+
+void JobSystem::Finish( JobCounter* counter )
+{
+  if( !counter )
+    return;
+  for( ;; )
+  {
+    int count = counter->count;
+    if( count == 1 )
+      break;
+    if( counter->count.compare_exchange_weak( count, count - 1 ) )
+      return;
+  }
+
+  // Last one. The counter may belong to a Wait() that returns as soon as it
+  // sees zero, so zero only gets published under the lock, and Wait() takes
+  // the lock before returning. Nothing touches the counter after the unlock
+  //
+  // It's only the last one if it still is under the lock, a Run() or
+  // ParallelFor() onto the same counter can add to it in between. Then the
+  // continuations stay until whoever gets it to zero
+  std::vector< Job > continuations;
+  {
+    std::lock_guard< std::mutex > lock( counter->mutex );
+    if( --counter->count == 0 )
+      continuations.swap( counter->continuations );
+  }
+  for( Job& continuation : continuations )
+    Push( continuation );
+}
+
+void JobSystem::WorkerThread( int workerIndex )
+{
+  currentJobSystem = this;
+  currentWorkerIndex = workerIndex;
+  ProfilerSetThreadName( "Job worker" );
+  for( ;; )
+  {
+    Job job;
+    if( FindJob( &job ) )
+    {
+      Execute( job );
+      continue;
+    }
+
+    std::unique_lock< std::mutex > lock( mSleepMutex );
+    ++mSleepingCount;
+    mWake.wait( lock, [ this ]() { return mQuit || mQueuedCount > 0; } );
+    --mSleepingCount;
+    if( mQuit )
+      return;
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "utility.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+
+// Does [ begin, end ) of some work. Plain jobs get [ 0, 1 )
+typedef void( *JobFunction )( void* userData, int begin, int end );
+
+struct JobCounter;
+
+struct Job
+{
+  JobFunction function;
+  void* userData;
+  int begin;
+  int end;
+
+  // Ranges longer than this get split in half when they start running, and
+  // the other half goes back in the deque for someone to steal. 0 never splits
+  int grainSize;
+
+  // Decremented when the job is done, may be null
+  JobCounter* counter;
+};
+
+// Counts unfinished jobs. Jobs added with RunAfter() get queued once it gets
+// back to zero
+struct JobCounter
+{
+  JobCounter() : count( 0 ) {}
+  std::atomic< int > count;
+  std::mutex mutex;
+  std::vector< Job > continuations;
+};
+
+// Work stealing job system. Each thread has its own deque, it pushes and pops
+// jobs at the back, and when it runs out it steals from the front of the
+// others. The thread that creates the JobSystem is worker 0 and only runs jobs
+// while it's inside Wait().
+struct JobSystem
+{
+  // threadCount includes the calling thread, 0 means one per core
+  JobSystem( int threadCount = 0 );
+  ~JobSystem();
+
+  void Run( JobFunction function, void* userData, JobCounter* counter );
+
+  // function gets called on chunks of [ 0, count ), in parallel. grainSize of
+  // 0 picks one that gives each thread several chunks to balance with.
+  // Small counts run right away on the calling thread
+  void ParallelFor(
+    JobFunction function,
+    void* userData,
+    int count,
+    JobCounter* counter,
+    int grainSize = 0 );
+
+  // Queues the job once dependency gets to zero. counter counts it from now
+  void RunAfter(
+    JobCounter* dependency,
+    JobFunction function,
+    void* userData,
+    JobCounter* counter );
+
+  // Runs jobs on this thread until counter gets to zero
+  void Wait( JobCounter* counter );
+
+  int GetThreadCount() const;
+
+  struct Worker
+  {
+    std::mutex mutex;
+    std::deque< Job > jobs;
+  };
+
+  void Push( Job job );
+  bool FindJob( Job* job );
+  void Execute( Job job );
+  void Finish( JobCounter* counter );
+  void WorkerThread( int workerIndex );
+
+  std::vector< Worker > mWorkers;
+  std::vector< std::thread > mThreads;
+
+  // Sleeping workers wake up when mQueuedCount goes above zero. Pushing only
+  // takes mSleepMutex when someone is asleep
+  std::atomic< int > mQueuedCount;
+  std::atomic< int > mSleepingCount;
+  std::mutex mSleepMutex;
+  std::condition_variable mWake;
+  bool mQuit;
+};
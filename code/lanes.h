@@ -0,0 +1,52 @@
+#pragma once
+#include <emmintrin.h>
+#if defined( __AVX__ )
+#include <immintrin.h>
+#endif
+
+// Loops over float arrays get written once against Lanes, which is 8 floats
+// with avx and 4 with sse. LanesLoad / LanesStore need laneCount * 4 byte
+// alignment, see Vector2Stream for arrays that are padded and aligned for it
+#if defined( __AVX__ )
+typedef __m256 Lanes;
+const int laneCount = 8;
+inline Lanes LanesLoad( const float* p ) { return _mm256_load_ps( p ); }
+inline void LanesStore( float* p, Lanes a ) { _mm256_store_ps( p, a ); }
+inline void LanesStoreUnaligned( float* p, Lanes a ) { _mm256_storeu_ps( p, a ); }
+inline Lanes LanesSet( float f ) { return _mm256_set1_ps( f ); }
+inline Lanes LanesAdd( Lanes a, Lanes b ) { return _mm256_add_ps( a, b ); }
+inline Lanes LanesSub( Lanes a, Lanes b ) { return _mm256_sub_ps( a, b ); }
+inline Lanes LanesMul( Lanes a, Lanes b ) { return _mm256_mul_ps( a, b ); }
+inline Lanes LanesDiv( Lanes a, Lanes b ) { return _mm256_div_ps( a, b ); }
+inline Lanes LanesSqrt( Lanes a ) { return _mm256_sqrt_ps( a ); }
+inline Lanes LanesMin( Lanes a, Lanes b ) { return _mm256_min_ps( a, b ); }
+inline Lanes LanesMax( Lanes a, Lanes b ) { return _mm256_max_ps( a, b ); }
+inline Lanes LanesGreater( Lanes a, Lanes b ) { return _mm256_cmp_ps( a, b, _CMP_GT_OQ ); }
+inline Lanes LanesEqual( Lanes a, Lanes b ) { return _mm256_cmp_ps( a, b, _CMP_EQ_OQ ); }
+inline Lanes LanesAnd( Lanes a, Lanes b ) { return _mm256_and_ps( a, b ); }
+inline Lanes LanesSelect( Lanes mask, Lanes a, Lanes b ) { return _mm256_blendv_ps( b, a, mask ); }
+// Bit i is the sign of lane i, for branching on a comparison
+inline int LanesMoveMask( Lanes a ) { return _mm256_movemask_ps( a ); }
+#else
+typedef __m128 Lanes;
+const int laneCount = 4;
+inline Lanes LanesLoad( const float* p ) { return _mm_load_ps( p ); }
+inline void LanesStore( float* p, Lanes a ) { _mm_store_ps( p, a ); }
+inline void LanesStoreUnaligned( float* p, Lanes a ) { _mm_storeu_ps( p, a ); }
+inline Lanes LanesSet( float f ) { return _mm_set1_ps( f ); }
+inline Lanes LanesAdd( Lanes a, Lanes b ) { return _mm_add_ps( a, b ); }
+inline Lanes LanesSub( Lanes a, Lanes b ) { return _mm_sub_ps( a, b ); }
+inline Lanes LanesMul( Lanes a, Lanes b ) { return _mm_mul_ps( a, b ); }
+inline Lanes LanesDiv( Lanes a, Lanes b ) { return _mm_div_ps( a, b ); }
+inline Lanes LanesSqrt( Lanes a ) { return _mm_sqrt_ps( a ); }
+inline Lanes LanesMin( Lanes a, Lanes b ) { return _mm_min_ps( a, b ); }
+inline Lanes LanesMax( Lanes a, Lanes b ) { return _mm_max_ps( a, b ); }
+inline Lanes LanesGreater( Lanes a, Lanes b ) { return _mm_cmpgt_ps( a, b ); }
+inline Lanes LanesEqual( Lanes a, Lanes b ) { return _mm_cmpeq_ps( a, b ); }
+inline Lanes LanesAnd( Lanes a, Lanes b ) { return _mm_and_ps( a, b ); }
+inline Lanes LanesSelect( Lanes mask, Lanes a, Lanes b )
+{
+  return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+inline int LanesMoveMask( Lanes a ) { return _mm_movemask_ps( a ); }
+#endif
@@ -0,0 +1,245 @@
+#include "logger.h"
+#include "platform.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+thread_local LogThreadBuffer* logThreadBuffer = nullptr;
+static std::atomic< LogThreadBuffer* > logThreadBuffers( nullptr );
+
+static std::thread loggerThread;
+static std::atomic< bool > loggerIsRunning( false );
+static LogOutput loggerOutput = nullptr;
+static void* loggerUserData = nullptr;
+
+LogThreadBuffer* LoggerAddThreadBuffer()
+{
+  LogThreadBuffer* buffer = new LogThreadBuffer;
+  buffer->head = 0;
+  buffer->cachedTail = 0;
+  buffer->droppedCount = 0;
+  buffer->tail = 0;
+  buffer->next = logThreadBuffers.load();
+  while( !logThreadBuffers.compare_exchange_weak( buffer->next, buffer ) )
+    ;
+  logThreadBuffer = buffer;
+  return buffer;
+}
+
+void LogCaptureString( LogRecord* record, const char* value )
+{
+  if( !value )
+    value = "(null)";
+  uint32_t offset = record->stringByteCount;
+  uint32_t room = sizeof( record->strings ) - offset - 1;
+  uint32_t length = 0;
+  while( length < room && value[ length ] )
+    ++length;
+  std::memcpy( record->strings + offset, value, length );
+  record->strings[ offset + length ] = '\0';
+  record->stringByteCount = offset + length + 1;
+  if( record->stringByteCount == sizeof( record->strings ) )
+    record->stringByteCount = sizeof( record->strings ) - 1;
+  LogCaptureArg( record, LogArgType::String, offset );
+}
+
+static bool IsOneOf( char c, const char* chars )
+{
+  return c && std::strchr( chars, c );
+}
+
+int LogFormatMessage( const LogRecord& record, char* text, int textSize )
+{
+  const char* format = record.site->format;
+  int length = 0;
+  uint32_t argIndex = 0;
+  while( *format && length < textSize - 1 )
+  {
+    if( *format != '%' )
+    {
+      text[ length++ ] = *format++;
+      continue;
+    }
+    if( format[ 1 ] == '%' )
+    {
+      text[ length++ ] = '%';
+      format += 2;
+      continue;
+    }
+
+    // %[flags][width][.precision], then room for ll and the conversion
+    char spec[ 32 ];
+    int specLength = 0;
+    spec[ specLength++ ] = *format++;
+    while( IsOneOf( *format, "-+ #0123456789." ) && specLength < 24 )
+      spec[ specLength++ ] = *format++;
+    while( IsOneOf( *format, "hljztL" ) )
+      ++format;
+    char conversion = *format;
+    if( !conversion )
+      break;
+    ++format;
+    if( argIndex == record.argCount )
+      break;
+    LogArgType type = record.argTypes[ argIndex ];
+    uint64_t value = record.args[ argIndex ];
+    ++argIndex;
+
+    char* out = text + length;
+    int outSize = textSize - length;
+    int written = 0;
+    if( IsOneOf( conversion, "diuoxXc" ) )
+    {
+      bool isInt64 = type == LogArgType::Int64 || type == LogArgType::Pointer;
+      if( isInt64 && conversion != 'c' )
+      {
+        spec[ specLength++ ] = 'l';
+        spec[ specLength++ ] = 'l';
+      }
+      spec[ specLength++ ] = conversion;
+      spec[ specLength ] = '\0';
+      if( IsOneOf( conversion, "dic" ) )
+        written = isInt64 && conversion != 'c'
+          ? std::snprintf( out, outSize, spec, ( long long )value )
+          : std::snprintf( out, outSize, spec, ( int )( uint32_t )value );
+      else
+        written = isInt64
+          ? std::snprintf( out, outSize, spec, ( unsigned long long )value )
+          : std::snprintf( out, outSize, spec, ( unsigned )value );
+    }
+    else if( IsOneOf( conversion, "fFeEgGaA" ) )
+    {
+      double number;
+      if( type == LogArgType::Double )
+        std::memcpy( &number, &value, sizeof( number ) );
+      else
+        number = ( double )( int64_t )value;
+      spec[ specLength++ ] = conversion;
+      spec[ specLength ] = '\0';
+      written = std::snprintf( out, outSize, spec, number );
+    }
+    else if( conversion == 's' )
+    {
+      const char* string = type == LogArgType::String ? record.strings + value : "(?)";
+      spec[ specLength++ ] = 's';
+      spec[ specLength ] = '\0';
+      written = std::snprintf( out, outSize, spec, string );
+    }
+    else if( conversion == 'p' )
+    {
+      spec[ specLength++ ] = 'p';
+      spec[ specLength ] = '\0';
+      written = std::snprintf( out, outSize, spec, ( void* )( uintptr_t )value );
+    }
+    if( written > 0 )
+      length += written < outSize ? written : outSize - 1;
+  }
+  text[ length ] = '\0';
+  return length;
+}
+
+void LogToPlatform( void* userData, const char* text )
+{
+  Unused( userData );
+  PlatformDebugOutput( text );
+}
+
+static const char* severityNames[] = { "debug", "info", "warning", "error" };
+static const char* categoryNames[] = { "general", "input", "render", "assets" };
+static_assert( sizeof( categoryNames ) / sizeof( categoryNames[ 0 ] ) == ( int )LogCategory::Count,
+  "Every LogCategory needs a name" );
+
+// Outputs the oldest record waiting in any ring, so threads come out
+// interleaved in the order they logged. Returns false if there were none
+static bool OutputOldestRecord( double ticksPerMillisecond, uint64_t startTimestamp )
+{
+  LogThreadBuffer* oldest = nullptr;
+  uint64_t oldestTimestamp = 0;
+  for( LogThreadBuffer* buffer = logThreadBuffers.load(); buffer; buffer = buffer->next )
+  {
+    uint32_t tail = buffer->tail.load( std::memory_order_relaxed );
+    if( tail == buffer->head.load( std::memory_order_acquire ) )
+      continue;
+    uint64_t timestamp = buffer->records[ tail % LogThreadBuffer::capacity ].timestamp;
+    if( !oldest || timestamp < oldestTimestamp )
+    {
+      oldest = buffer;
+      oldestTimestamp = timestamp;
+    }
+  }
+  if( !oldest )
+    return false;
+
+  uint32_t tail = oldest->tail.load( std::memory_order_relaxed );
+  const LogRecord& record = oldest->records[ tail % LogThreadBuffer::capacity ];
+  char line[ 1024 ];
+  int length = std::snprintf( line, sizeof( line ), "%10.3f %s %s: ",
+    ( int64_t )( record.timestamp - startTimestamp ) / ticksPerMillisecond,
+    severityNames[ ( int )record.site->severity ],
+    categoryNames[ ( int )record.site->category ] );
+  length += LogFormatMessage( record, line + length, ( int )sizeof( line ) - length - 1 );
+  line[ length++ ] = '\n';
+  line[ length ] = '\0';
+  loggerOutput( loggerUserData, line );
+  oldest->tail.store( tail + 1, std::memory_order_release );
+  return true;
+}
+
+static void LoggerThread()
+{
+  ProfilerSetThreadName( "Logger" );
+  double ticksPerMillisecond = ProfilerGetTicksPerMicrosecond() * 1000;
+  uint64_t startTimestamp = ProfileTimestamp();
+  for( ;; )
+  {
+    // Read before draining, so nothing logged before a stop gets left
+    bool isRunning = loggerIsRunning.load();
+    while( OutputOldestRecord( ticksPerMillisecond, startTimestamp ) )
+      ;
+    if( !isRunning )
+      break;
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  }
+}
+
+void LoggerStart( LogOutput output, void* userData )
+{
+  Assert( !loggerIsRunning );
+  loggerOutput = output;
+  loggerUserData = userData;
+  loggerIsRunning = true;
+  loggerThread = std::thread( LoggerThread );
+}
+
+void LoggerStop()
+{
+  if( !loggerIsRunning )
+    return;
+  loggerIsRunning = false;
+  loggerThread.join();
+}
+
+void LoggerFlush()
+{
+  if( !loggerIsRunning )
+    return;
+  // Buffers only ever go on the front of the list, so from first on it
+  // stays the same and anything added later has nothing to wait for
+  LogThreadBuffer* first = logThreadBuffers.load();
+  std::vector< uint32_t > heads;
+  for( LogThreadBuffer* buffer = first; buffer; buffer = buffer->next )
+    heads.push_back( buffer->head.load( std::memory_order_acquire ) );
+  int i = 0;
+  for( LogThreadBuffer* buffer = first; buffer; buffer = buffer->next, ++i )
+    while( ( int32_t )( buffer->tail.load( std::memory_order_acquire ) - heads[ i ] ) < 0 )
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+}
+
+uint32_t LoggerGetDroppedCount()
+{
+  uint32_t droppedCount = 0;
+  for( LogThreadBuffer* buffer = logThreadBuffers.load(); buffer; buffer = buffer->next )
+    droppedCount += buffer->droppedCount.load( std::memory_order_relaxed );
+  return droppedCount;
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include "profiler.h"
+#include <cstring>
+#include <type_traits>
+
+// Logging that costs the calling thread a copy of its arguments and nothing
+// else. A LOG() call writes the call site and the raw arguments into the
+// thread's own ring, and a background thread does the formatting and the
+// writing.
+//
+//   LOG( Info, Input, "%c %s", key, isKeyDown ? "pressed" : "released" );
+//
+// Anything below LOG_MIN_SEVERITY or outside LOG_CATEGORIES is compiled out
+
+enum class LogSeverity
+{
+  Debug,
+  Info,
+  Warning,
+  Error,
+};
+
+enum class LogCategory
+{
+  General,
+  Input,
+  Render,
+  Assets,
+  Count
+};
+
+#ifndef LOG_MIN_SEVERITY
+#define LOG_MIN_SEVERITY LogSeverity::Info
+#endif
+
+// One bit per LogCategory
+#ifndef LOG_CATEGORIES
+#define LOG_CATEGORIES 0xffffffffu
+#endif
+
+constexpr bool LogIsCompiledIn( LogSeverity severity, LogCategory category )
+{
+  return severity >= LOG_MIN_SEVERITY && ( ( LOG_CATEGORIES >> ( int )category ) & 1 );
+}
+
+// One per LOG() in the code. Its address is the message's id, the format
+// string never gets copied
+struct LogSite
+{
+  const char* format;
+  LogSeverity severity;
+  LogCategory category;
+};
+
+enum class LogArgType : uint8_t
+{
+  // Anything int sized or smaller, the way printf would see it promoted
+  Int32,
+  Int64,
+  Double,
+  // Copied into the record's strings
+  String,
+  Pointer,
+};
+
+// Strings that don't fit in strings get cut short
+struct LogRecord
+{
+  static const int argCapacity = 8;
+  const LogSite* site;
+  uint64_t timestamp;
+  uint64_t args[ argCapacity ];
+  LogArgType argTypes[ argCapacity ];
+  uint32_t argCount;
+  uint32_t stringByteCount;
+  char strings[ 160 ];
+};
+
+// Each thread writes into its own ring, the logger thread reads them all.
+// When one is full new messages get dropped, the caller never waits
+struct LogThreadBuffer
+{
+  static const uint32_t capacity = 1 << 10;
+  LogRecord records[ capacity ];
+
+  // Written by the owning thread. head is records ever written, stored
+  // after the record is, and cachedTail saves loading tail every call
+  std::atomic< uint32_t > head;
+  uint32_t cachedTail;
+  std::atomic< uint32_t > droppedCount;
+
+  // Written by the logger thread, a cache line away from head. Records
+  // ever output
+  uint8_t padding[ 64 ];
+  std::atomic< uint32_t > tail;
+  LogThreadBuffer* next;
+};
+
+extern thread_local LogThreadBuffer* logThreadBuffer;
+LogThreadBuffer* LoggerAddThreadBuffer();
+
+void LogCaptureString( LogRecord* record, const char* value );
+
+inline void LogCaptureArg( LogRecord* record, LogArgType type, uint64_t value )
+{
+  record->argTypes[ record->argCount ] = type;
+  record->args[ record->argCount ] = value;
+  ++record->argCount;
+}
+
+template< typename T >
+typename std::enable_if< std::is_integral< T >::value || std::is_enum< T >::value >::type
+LogCapture( LogRecord* record, T value )
+{
+  LogCaptureArg( record, sizeof( T ) <= 4 ? LogArgType::Int32 : LogArgType::Int64, ( uint64_t )value );
+}
+
+template< typename T >
+typename std::enable_if< std::is_floating_point< T >::value >::type
+LogCapture( LogRecord* record, T value )
+{
+  double promoted = value;
+  uint64_t bits;
+  std::memcpy( &bits, &promoted, sizeof( bits ) );
+  LogCaptureArg( record, LogArgType::Double, bits );
+}
+
+// Pointers print as addresses, except chars which are strings
+template< typename T >
+typename std::enable_if< std::is_pointer< T >::value
+  && !std::is_same< typename std::decay< typename std::remove_pointer< T >::type >::type, char >::value >::type
+LogCapture( LogRecord* record, T value )
+{
+  LogCaptureArg( record, LogArgType::Pointer, ( uint64_t )( uintptr_t )value );
+}
+
+inline void LogCapture( LogRecord* record, const char* value )
+{
+  LogCaptureString( record, value );
+}
+
+inline void LogCapture( LogRecord* record, char* value )
+{
+  LogCaptureString( record, value );
+}
+
+// Arguments are taken by value, so arrays and string literals arrive as
+// pointers
+template< typename... Args >
+void LogFillRecord( LogRecord* record, const LogSite* site, Args... args )
+{
+  static_assert( sizeof...( Args ) <= LogRecord::argCapacity, "Too many arguments to LOG()" );
+  record->site = site;
+  record->timestamp = ProfileTimestamp();
+  record->argCount = 0;
+  record->stringByteCount = 0;
+  int expand[] = { 0, ( LogCapture( record, args ), 0 )... };
+  ( void )expand;
+}
+
+template< typename... Args >
+void LogWrite( const LogSite* site, Args... args )
+{
+  LogThreadBuffer* buffer = logThreadBuffer;
+  if( !buffer )
+    buffer = LoggerAddThreadBuffer();
+  uint32_t head = buffer->head.load( std::memory_order_relaxed );
+  if( head - buffer->cachedTail == LogThreadBuffer::capacity )
+  {
+    buffer->cachedTail = buffer->tail.load( std::memory_order_acquire );
+    if( head - buffer->cachedTail == LogThreadBuffer::capacity )
+    {
+      buffer->droppedCount.fetch_add( 1, std::memory_order_relaxed );
+      return;
+    }
+  }
+  LogFillRecord( &buffer->records[ head % LogThreadBuffer::capacity ], site, args... );
+  buffer->head.store( head + 1, std::memory_order_release );
+}
+
+#define LOG( severity, category, format, ... ) \
+  do \
+  { \
+    if( LogIsCompiledIn( LogSeverity::severity, LogCategory::category ) ) \
+    { \
+      static const LogSite logSite = { format, LogSeverity::severity, LogCategory::category }; \
+      LogWrite( &logSite, ##__VA_ARGS__ ); \
+    } \
+  } while( 0 )
+
+// Formats the message the way printf would have, without the newline.
+// Length modifiers in the format are ignored, the captured types decide.
+// Returns the length, truncated to fit textSize
+int LogFormatMessage( const LogRecord& record, char* text, int textSize );
+
+// Called on the logger thread with one line at a time, newline included
+typedef void( *LogOutput )( void* userData, const char* text );
+
+// Sends lines to PlatformDebugOutput()
+void LogToPlatform( void* userData, const char* text );
+
+// Messages logged before LoggerStart() wait in the rings, up to capacity
+void LoggerStart( LogOutput output, void* userData );
+
+// Outputs everything logged so far, then stops the thread
+void LoggerStop();
+
+// Waits until everything logged before the call has been output
+void LoggerFlush();
+
+// Messages dropped because a ring was full, over every thread
+uint32_t LoggerGetDroppedCount();
@@ -0,0 +1,631 @@
+#include "mipmap.h"
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+
+// NOTE:
+//   Mip sizes follow d3d, max( 1, size / 2 ). Even sizes go through the 2:1
+//   loops below. A level with an odd side goes through ResampleFloat(), which
+//   spreads each output texel over size / newSize source texels, so the last
+//   row and column count as much as any other and the image doesn't shift
+
+uint8_t* MipChain::GetLevelBytes( int level )
+{
+  return bytes.data() + levels[ level ].offset;
+}
+
+int GetMipLevelCount( int width, int height )
+{
+  int size = std::max( width, height );
+  int count = 1;
+  while( size > 1 )
+  {
+    size /= 2;
+    ++count;
+  }
+  return count;
+}
+
+struct GammaTables
+{
+  GammaTables()
+  {
+    for( int i = 0; i < 256; ++i )
+    {
+      float srgb = i / 255.0f;
+      toLinear[ i ] = srgb <= 0.04045f
+        ? srgb / 12.92f
+        : std::pow( ( srgb + 0.055f ) / 1.055f, 2.4f );
+    }
+    for( int i = 0; i < toSrgbCount; ++i )
+    {
+      float linear = i / ( float )( toSrgbCount - 1 );
+      float srgb = linear <= 0.0031308f
+        ? linear * 12.92f
+        : 1.055f * std::pow( linear, 1 / 2.4f ) - 0.055f;
+      toSrgb[ i ] = ( uint8_t )( srgb * 255.0f + 0.5f );
+    }
+  }
+  static const int toSrgbCount = 4096;
+  float toLinear[ 256 ];
+  uint8_t toSrgb[ toSrgbCount ];
+};
+
+static const GammaTables& GetGammaTables()
+{
+  static GammaTables tables;
+  return tables;
+}
+
+///////////////////////////
+// Integer box, no gamma //
+///////////////////////////
+
+// ( a + b + c + d + 2 ) / 4 for whatever the simd loops didn't get to
+static void BoxRowScalar(
+  const uint8_t* row0,
+  const uint8_t* row1,
+  uint8_t* dst,
+  int srcWidth,
+  int dstWidth,
+  int channelCount,
+  int x )
+{
+  for( ; x < dstWidth; ++x )
+  {
+    int x0 = 2 * x * channelCount;
+    int x1 = std::min( 2 * x + 1, srcWidth - 1 ) * channelCount;
+    for( int c = 0; c < channelCount; ++c )
+      dst[ x * channelCount + c ] = ( uint8_t )( (
+        row0[ x0 + c ] + row0[ x1 + c ] +
+        row1[ x0 + c ] + row1[ x1 + c ] + 2 ) >> 2 );
+  }
+}
+
+static void BoxRowR8(
+  const uint8_t* row0,
+  const uint8_t* row1,
+  uint8_t* dst,
+  int srcWidth,
+  int dstWidth )
+{
+  int x = 0;
+
+  // Each 16 bit lane holds an even texel in its low byte and the odd texel
+  // next to it in its high byte, so mask + shift gives the horizontal pairs
+#if defined( __AVX2__ )
+  {
+    const __m256i mask = _mm256_set1_epi16( 0x00ff );
+    const __m256i two = _mm256_set1_epi16( 2 );
+    for( ; x + 32 <= dstWidth && 2 * x + 64 <= srcWidth; x += 32 )
+    {
+      __m256i sums[ 2 ];
+      for( int i = 0; i < 2; ++i )
+      {
+        __m256i a = _mm256_loadu_si256( ( const __m256i* )( row0 + 2 * x + 32 * i ) );
+        __m256i b = _mm256_loadu_si256( ( const __m256i* )( row1 + 2 * x + 32 * i ) );
+        __m256i sum = _mm256_add_epi16(
+          _mm256_add_epi16( _mm256_and_si256( a, mask ), _mm256_srli_epi16( a, 8 ) ),
+          _mm256_add_epi16( _mm256_and_si256( b, mask ), _mm256_srli_epi16( b, 8 ) ) );
+        sums[ i ] = _mm256_srli_epi16( _mm256_add_epi16( sum, two ), 2 );
+      }
+      // packus works per 128 bit lane, put the 64 bit chunks back in order
+      __m256i packed = _mm256_packus_epi16( sums[ 0 ], sums[ 1 ] );
+      packed = _mm256_permute4x64_epi64( packed, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+      _mm256_storeu_si256( ( __m256i* )( dst + x ), packed );
+    }
+  }
+#endif
+
+  const __m128i mask = _mm_set1_epi16( 0x00ff );
+  const __m128i two = _mm_set1_epi16( 2 );
+  for( ; x + 16 <= dstWidth && 2 * x + 32 <= srcWidth; x += 16 )
+  {
+    __m128i sums[ 2 ];
+    for( int i = 0; i < 2; ++i )
+    {
+      __m128i a = _mm_loadu_si128( ( const __m128i* )( row0 + 2 * x + 16 * i ) );
+      __m128i b = _mm_loadu_si128( ( const __m128i* )( row1 + 2 * x + 16 * i ) );
+      __m128i sum = _mm_add_epi16(
+        _mm_add_epi16( _mm_and_si128( a, mask ), _mm_srli_epi16( a, 8 ) ),
+        _mm_add_epi16( _mm_and_si128( b, mask ), _mm_srli_epi16( b, 8 ) ) );
+      sums[ i ] = _mm_srli_epi16( _mm_add_epi16( sum, two ), 2 );
+    }
+    _mm_storeu_si128( ( __m128i* )( dst + x ), _mm_packus_epi16( sums[ 0 ], sums[ 1 ] ) );
+  }
+
+  BoxRowScalar( row0, row1, dst, srcWidth, dstWidth, 1, x );
+}
+
+static void BoxRowR8G8B8A8(
+  const uint8_t* row0,
+  const uint8_t* row1,
+  uint8_t* dst,
+  int srcWidth,
+  int dstWidth )
+{
+  int x = 0;
+
+  // Widen to 16 bits so one register holds 2 texels, add the rows, then
+  // unpacklo/hi_epi64 lines up each texel with its right neighbour
+#if defined( __AVX2__ )
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i two = _mm256_set1_epi16( 2 );
+    for( ; x + 8 <= dstWidth && 2 * x + 16 <= srcWidth; x += 8 )
+    {
+      __m256i sums[ 2 ];
+      for( int i = 0; i < 2; ++i )
+      {
+        __m256i a = _mm256_loadu_si256( ( const __m256i* )( row0 + 8 * x + 32 * i ) );
+        __m256i b = _mm256_loadu_si256( ( const __m256i* )( row1 + 8 * x + 32 * i ) );
+        __m256i lo = _mm256_add_epi16(
+          _mm256_unpacklo_epi8( a, zero ),
+          _mm256_unpacklo_epi8( b, zero ) );
+        __m256i hi = _mm256_add_epi16(
+          _mm256_unpackhi_epi8( a, zero ),
+          _mm256_unpackhi_epi8( b, zero ) );
+        __m256i sum = _mm256_add_epi16(
+          _mm256_unpacklo_epi64( lo, hi ),
+          _mm256_unpackhi_epi64( lo, hi ) );
+        sums[ i ] = _mm256_srli_epi16( _mm256_add_epi16( sum, two ), 2 );
+      }
+      __m256i packed = _mm256_packus_epi16( sums[ 0 ], sums[ 1 ] );
+      packed = _mm256_permute4x64_epi64( packed, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+      _mm256_storeu_si256( ( __m256i* )( dst + 4 * x ), packed );
+    }
+  }
+#endif
+
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16( 2 );
+  for( ; x + 4 <= dstWidth && 2 * x + 8 <= srcWidth; x += 4 )
+  {
+    __m128i sums[ 2 ];
+    for( int i = 0; i < 2; ++i )
+    {
+      __m128i a = _mm_loadu_si128( ( const __m128i* )( row0 + 8 * x + 16 * i ) );
+      __m128i b = _mm_loadu_si128( ( const __m128i* )( row1 + 8 * x + 16 * i ) );
+      __m128i lo = _mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) );
+      __m128i hi = _mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) );
+      __m128i sum = _mm_add_epi16( _mm_unpacklo_epi64( lo, hi ), _mm_unpackhi_epi64( lo, hi ) );
+      sums[ i ] = _mm_srli_epi16( _mm_add_epi16( sum, two ), 2 );
+    }
+    _mm_storeu_si128( ( __m128i* )( dst + 4 * x ), _mm_packus_epi16( sums[ 0 ], sums[ 1 ] ) );
+  }
+
+  BoxRowScalar( row0, row1, dst, srcWidth, dstWidth, 4, x );
+}
+
+static void BoxInteger(
+  const uint8_t* src,
+  int srcWidth,
+  int srcHeight,
+  uint8_t* dst,
+  int dstWidth,
+  int dstHeight,
+  int channelCount )
+{
+  int srcStride = srcWidth * channelCount;
+  int dstStride = dstWidth * channelCount;
+  for( int y = 0; y < dstHeight; ++y )
+  {
+    const uint8_t* row0 = src + 2 * y * srcStride;
+    const uint8_t* row1 = src + std::min( 2 * y + 1, srcHeight - 1 ) * srcStride;
+    uint8_t* row = dst + y * dstStride;
+    if( channelCount == 4 )
+      BoxRowR8G8B8A8( row0, row1, row, srcWidth, dstWidth );
+    else
+      BoxRowR8( row0, row1, row, srcWidth, dstWidth );
+  }
+}
+
+//////////////////////////////////////
+// Float, linear space, box or tent //
+//////////////////////////////////////
+
+static void Decode(
+  const uint8_t* src,
+  int count,
+  int channelCount,
+  bool sRGB,
+  float* dst )
+{
+  const GammaTables& tables = GetGammaTables();
+  for( int i = 0; i < count; ++i )
+  {
+    bool isColor = sRGB && channelCount == 4 && ( i & 3 ) != 3;
+    dst[ i ] = isColor ? tables.toLinear[ src[ i ] ] : src[ i ] / 255.0f;
+  }
+}
+
+static void Encode(
+  const float* src,
+  int count,
+  int channelCount,
+  bool sRGB,
+  uint8_t* dst )
+{
+  const GammaTables& tables = GetGammaTables();
+  for( int i = 0; i < count; ++i )
+  {
+    float value = std::min( std::max( src[ i ], 0.0f ), 1.0f );
+    bool isColor = sRGB && channelCount == 4 && ( i & 3 ) != 3;
+    dst[ i ] = isColor
+      ? tables.toSrgb[ ( int )( value * ( GammaTables::toSrgbCount - 1 ) + 0.5f ) ]
+      : ( uint8_t )( value * 255.0f + 0.5f );
+  }
+}
+
+static void BoxFloat(
+  const float* src,
+  int srcWidth,
+  int srcHeight,
+  float* dst,
+  int dstWidth,
+  int dstHeight,
+  int channelCount )
+{
+  const __m128 quarter = _mm_set1_ps( 0.25f );
+  int srcStride = srcWidth * channelCount;
+  int dstStride = dstWidth * channelCount;
+  for( int y = 0; y < dstHeight; ++y )
+  {
+    const float* row0 = src + 2 * y * srcStride;
+    const float* row1 = src + std::min( 2 * y + 1, srcHeight - 1 ) * srcStride;
+    float* row = dst + y * dstStride;
+    int x = 0;
+    if( channelCount == 4 )
+    {
+      // one texel per register
+      for( ; x < dstWidth; ++x )
+      {
+        int x0 = 2 * x * 4;
+        int x1 = std::min( 2 * x + 1, srcWidth - 1 ) * 4;
+        __m128 sum = _mm_add_ps(
+          _mm_add_ps( _mm_loadu_ps( row0 + x0 ), _mm_loadu_ps( row0 + x1 ) ),
+          _mm_add_ps( _mm_loadu_ps( row1 + x0 ), _mm_loadu_ps( row1 + x1 ) ) );
+        _mm_storeu_ps( row + 4 * x, _mm_mul_ps( sum, quarter ) );
+      }
+      continue;
+    }
+
+    // four texels per register, deinterleave even / odd with shuffles
+    for( ; x + 4 <= dstWidth && 2 * x + 8 <= srcWidth; x += 4 )
+    {
+      __m128 a = _mm_add_ps( _mm_loadu_ps( row0 + 2 * x ), _mm_loadu_ps( row1 + 2 * x ) );
+      __m128 b = _mm_add_ps( _mm_loadu_ps( row0 + 2 * x + 4 ), _mm_loadu_ps( row1 + 2 * x + 4 ) );
+      __m128 even = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+      __m128 odd = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+      _mm_storeu_ps( row + x, _mm_mul_ps( _mm_add_ps( even, odd ), quarter ) );
+    }
+    for( ; x < dstWidth; ++x )
+    {
+      int x0 = 2 * x;
+      int x1 = std::min( 2 * x + 1, srcWidth - 1 );
+      row[ x ] = ( row0[ x0 ] + row0[ x1 ] + row1[ x0 ] + row1[ x1 ] ) * 0.25f;
+    }
+  }
+}
+
+// Horizontal half of the tent, srcWidth -> dstWidth, every row
+static void TentRow(
+  const float* src,
+  int srcWidth,
+  float* dst,
+  int dstWidth,
+  int channelCount )
+{
+  auto clampX = [ srcWidth ]( int x ) { return std::min( std::max( x, 0 ), srcWidth - 1 ); };
+  const __m128 one8th = _mm_set1_ps( 1 / 8.0f );
+  const __m128 three = _mm_set1_ps( 3.0f );
+  if( channelCount == 4 )
+  {
+    for( int x = 0; x < dstWidth; ++x )
+    {
+      __m128 t0 = _mm_loadu_ps( src + 4 * clampX( 2 * x - 1 ) );
+      __m128 t1 = _mm_loadu_ps( src + 4 * clampX( 2 * x ) );
+      __m128 t2 = _mm_loadu_ps( src + 4 * clampX( 2 * x + 1 ) );
+      __m128 t3 = _mm_loadu_ps( src + 4 * clampX( 2 * x + 2 ) );
+      __m128 sum = _mm_add_ps(
+        _mm_add_ps( t0, t3 ),
+        _mm_mul_ps( _mm_add_ps( t1, t2 ), three ) );
+      _mm_storeu_ps( dst + 4 * x, _mm_mul_ps( sum, one8th ) );
+    }
+    return;
+  }
+
+  auto scalar = [ & ]( int x )
+  {
+    dst[ x ] = (
+      src[ clampX( 2 * x - 1 ) ] +
+      3 * src[ clampX( 2 * x ) ] +
+      3 * src[ clampX( 2 * x + 1 ) ] +
+      src[ clampX( 2 * x + 2 ) ] ) / 8;
+  };
+
+  // The first texel needs the clamp, after that 4 outputs read taps
+  // 2x-1 ... 2x+8, which two pairs of unaligned loads cover
+  int x = 0;
+  for( ; x < std::min( 1, dstWidth ); ++x )
+    scalar( x );
+  for( ; x + 4 <= dstWidth && 2 * x + 9 <= srcWidth; x += 4 )
+  {
+    const float* base = src + 2 * x;
+    __m128 a0 = _mm_loadu_ps( base - 1 );
+    __m128 a1 = _mm_loadu_ps( base + 3 );
+    __m128 b0 = _mm_loadu_ps( base + 1 );
+    __m128 b1 = _mm_loadu_ps( base + 5 );
+    __m128 t0 = _mm_shuffle_ps( a0, a1, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+    __m128 t1 = _mm_shuffle_ps( a0, a1, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+    __m128 t2 = _mm_shuffle_ps( b0, b1, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+    __m128 t3 = _mm_shuffle_ps( b0, b1, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+    __m128 sum = _mm_add_ps(
+      _mm_add_ps( t0, t3 ),
+      _mm_mul_ps( _mm_add_ps( t1, t2 ), three ) );
+    _mm_storeu_ps( dst + x, _mm_mul_ps( sum, one8th ) );
+  }
+  for( ; x < dstWidth; ++x )
+    scalar( x );
+}
+
+static void TentFloat(
+  const float* src,
+  int srcWidth,
+  int srcHeight,
+  float* dst,
+  int dstWidth,
+  int dstHeight,
+  int channelCount,
+  std::vector< float >& scratch )
+{
+  int srcStride = srcWidth * channelCount;
+  int dstStride = dstWidth * channelCount;
+
+  // horizontal pass into scratch ( dstWidth x srcHeight )
+  scratch.resize( dstStride * srcHeight );
+  for( int y = 0; y < srcHeight; ++y )
+    TentRow( src + y * srcStride, srcWidth, &scratch[ y * dstStride ], dstWidth, channelCount );
+
+  // vertical pass, rows are independent so this is just a weighted row sum
+  auto clampY = [ srcHeight ]( int y ) { return std::min( std::max( y, 0 ), srcHeight - 1 ); };
+  const __m128 one8th = _mm_set1_ps( 1 / 8.0f );
+  const __m128 three = _mm_set1_ps( 3.0f );
+  for( int y = 0; y < dstHeight; ++y )
+  {
+    const float* r0 = &scratch[ clampY( 2 * y - 1 ) * dstStride ];
+    const float* r1 = &scratch[ clampY( 2 * y ) * dstStride ];
+    const float* r2 = &scratch[ clampY( 2 * y + 1 ) * dstStride ];
+    const float* r3 = &scratch[ clampY( 2 * y + 2 ) * dstStride ];
+    float* row = dst + y * dstStride;
+    int i = 0;
+    for( ; i + 4 <= dstStride; i += 4 )
+    {
+      __m128 sum = _mm_add_ps(
+        _mm_add_ps( _mm_loadu_ps( r0 + i ), _mm_loadu_ps( r3 + i ) ),
+        _mm_mul_ps( _mm_add_ps( _mm_loadu_ps( r1 + i ), _mm_loadu_ps( r2 + i ) ), three ) );
+      _mm_storeu_ps( row + i, _mm_mul_ps( sum, one8th ) );
+    }
+    for( ; i < dstStride; ++i )
+      row[ i ] = ( r0[ i ] + 3 * r1[ i ] + 3 * r2[ i ] + r3[ i ] ) / 8;
+  }
+}
+
+////////////////////////////////
+// Odd sizes, any scale, float //
+////////////////////////////////
+
+// Source texels and weights for one output texel along one axis
+struct ResampleTaps
+{
+  static const int capacity = 8;
+  int first;
+  int count;
+  float weights[ capacity ];
+};
+
+// Box covers the output texel's footprint, weighted by how much of each
+// source texel is inside it. Tent is a triangle twice as wide. At 2:1 these
+// are the same [ 1 1 ] / 2 and [ 1 3 3 1 ] / 8 as the loops above. Taps off
+// the edge clamp to it
+static void ComputeResampleTaps(
+  MipFilter filter,
+  int srcSize,
+  int dstSize,
+  std::vector< ResampleTaps >* taps )
+{
+  float scale = ( float )srcSize / dstSize;
+  float radius = filter == MipFilter::Box ? scale * 0.5f : scale;
+  taps->resize( dstSize );
+  for( int i = 0; i < dstSize; ++i )
+  {
+    ResampleTaps& tap = ( *taps )[ i ];
+    float center = ( i + 0.5f ) * scale;
+    int begin = ( int )std::floor( center - radius );
+    int end = ( int )std::ceil( center + radius );
+    tap.first = std::max( begin, 0 );
+    tap.count = std::min( end, srcSize ) - tap.first;
+    Assert( tap.count <= ResampleTaps::capacity );
+    for( float& weight : tap.weights )
+      weight = 0;
+    float sum = 0;
+    for( int x = begin; x < end; ++x )
+    {
+      float weight = filter == MipFilter::Box
+        ? std::max( 0.0f, std::min( ( float )x + 1, center + radius ) - std::max( ( float )x, center - radius ) )
+        : std::max( 0.0f, 1 - std::abs( x + 0.5f - center ) / radius );
+      int clamped = std::min( std::max( x, 0 ), srcSize - 1 );
+      tap.weights[ clamped - tap.first ] += weight;
+      sum += weight;
+    }
+    for( int k = 0; k < tap.count; ++k )
+      tap.weights[ k ] /= sum;
+  }
+}
+
+static void ResampleFloat(
+  const float* src,
+  int srcWidth,
+  int srcHeight,
+  float* dst,
+  int dstWidth,
+  int dstHeight,
+  int channelCount,
+  MipFilter filter,
+  std::vector< float >& scratch )
+{
+  std::vector< ResampleTaps > tapsX;
+  std::vector< ResampleTaps > tapsY;
+  ComputeResampleTaps( filter, srcWidth, dstWidth, &tapsX );
+  ComputeResampleTaps( filter, srcHeight, dstHeight, &tapsY );
+  int srcStride = srcWidth * channelCount;
+  int dstStride = dstWidth * channelCount;
+
+  // horizontal pass into scratch ( dstWidth x srcHeight )
+  scratch.assign( dstStride * srcHeight, 0.0f );
+  for( int y = 0; y < srcHeight; ++y )
+  {
+    const float* srcRow = src + y * srcStride;
+    float* row = &scratch[ y * dstStride ];
+    for( int x = 0; x < dstWidth; ++x )
+    {
+      const ResampleTaps& tap = tapsX[ x ];
+      for( int k = 0; k < tap.count; ++k )
+        for( int c = 0; c < channelCount; ++c )
+          row[ x * channelCount + c ] += srcRow[ ( tap.first + k ) * channelCount + c ] * tap.weights[ k ];
+    }
+  }
+
+  // vertical pass
+  for( int y = 0; y < dstHeight; ++y )
+  {
+    const ResampleTaps& tap = tapsY[ y ];
+    float* row = dst + y * dstStride;
+    for( int i = 0; i < dstStride; ++i )
+      row[ i ] = 0;
+    for( int k = 0; k < tap.count; ++k )
+    {
+      const float* scratchRow = &scratch[ ( tap.first + k ) * dstStride ];
+      for( int i = 0; i < dstStride; ++i )
+        row[ i ] += scratchRow[ i ] * tap.weights[ k ];
+    }
+  }
+}
+
+static bool IsOddLevel( const MipLevel& level )
+{
+  return ( level.width > 1 && ( level.width & 1 ) ) || ( level.height > 1 && ( level.height & 1 ) );
+}
+
+void GenerateMipChain(
+  MipChain* chain,
+  const void* bytes,
+  int width,
+  int height,
+  int stride,
+  int channelCount,
+  MipSettings settings )
+{
+  Assert( channelCount == 1 || channelCount == 4 );
+  int levelCount = GetMipLevelCount( width, height );
+  if( settings.maxLevelCount > 0 )
+    levelCount = std::min( levelCount, settings.maxLevelCount );
+
+  chain->channelCount = channelCount;
+  chain->levels.resize( levelCount );
+  size_t byteCount = 0;
+  for( int i = 0; i < levelCount; ++i )
+  {
+    MipLevel& level = chain->levels[ i ];
+    level.width = std::max( 1, width >> i );
+    level.height = std::max( 1, height >> i );
+    level.stride = level.width * channelCount;
+    level.offset = byteCount;
+    byteCount += level.stride * level.height;
+  }
+  chain->bytes.resize( byteCount );
+
+  MipLevel& top = chain->levels[ 0 ];
+  for( int y = 0; y < height; ++y )
+    std::memcpy(
+      chain->GetLevelBytes( 0 ) + y * top.stride,
+      ( const uint8_t* )bytes + y * stride,
+      top.stride );
+
+  bool isGammaCorrected = settings.sRGB && channelCount == 4;
+  if( settings.filter == MipFilter::Box && !isGammaCorrected )
+  {
+    std::vector< float > curr;
+    std::vector< float > next;
+    std::vector< float > scratch;
+    for( int i = 1; i < levelCount; ++i )
+    {
+      MipLevel& src = chain->levels[ i - 1 ];
+      MipLevel& dst = chain->levels[ i ];
+      if( IsOddLevel( src ) )
+      {
+        curr.resize( src.stride * src.height );
+        next.resize( dst.stride * dst.height );
+        Decode( chain->GetLevelBytes( i - 1 ), ( int )curr.size(), channelCount, false, curr.data() );
+        ResampleFloat(
+          curr.data(), src.width, src.height,
+          next.data(), dst.width, dst.height,
+          channelCount,
+          MipFilter::Box,
+          scratch );
+        Encode( next.data(), ( int )next.size(), channelCount, false, chain->GetLevelBytes( i ) );
+        continue;
+      }
+      BoxInteger(
+        chain->GetLevelBytes( i - 1 ), src.width, src.height,
+        chain->GetLevelBytes( i ), dst.width, dst.height,
+        channelCount );
+    }
+    return;
+  }
+
+  // Keep the chain in float so rounding doesn't pile up level over level
+  std::vector< float > curr( top.stride * top.height );
+  std::vector< float > next;
+  std::vector< float > scratch;
+  Decode(
+    chain->GetLevelBytes( 0 ),
+    ( int )curr.size(),
+    channelCount,
+    settings.sRGB,
+    curr.data() );
+  for( int i = 1; i < levelCount; ++i )
+  {
+    MipLevel& src = chain->levels[ i - 1 ];
+    MipLevel& dst = chain->levels[ i ];
+    next.resize( dst.stride * dst.height );
+    if( IsOddLevel( src ) )
+      ResampleFloat(
+        curr.data(), src.width, src.height,
+        next.data(), dst.width, dst.height,
+        channelCount,
+        settings.filter,
+        scratch );
+    else if( settings.filter == MipFilter::Box )
+      BoxFloat(
+        curr.data(), src.width, src.height,
+        next.data(), dst.width, dst.height,
+        channelCount );
+    else
+      TentFloat(
+        curr.data(), src.width, src.height,
+        next.data(), dst.width, dst.height,
+        channelCount,
+        scratch );
+    Encode(
+      next.data(),
+      ( int )next.size(),
+      channelCount,
+      settings.sRGB,
+      chain->GetLevelBytes( i ) );
+    std::swap( curr, next );
+  }
+}
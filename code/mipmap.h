@@ -0,0 +1,53 @@
+#pragma once
+#include "utility.h"
+
+enum class MipFilter
+{
+  // 2x2 average
+  Box,
+
+  // Separable [ 1 3 3 1 ] / 8, ie. a bilinear downsample that also pulls in
+  // half of each neighbouring texel. Softer, but aliases a lot less than Box
+  Tent,
+};
+
+struct MipLevel
+{
+  int width;
+  int height;
+  int stride;
+  size_t offset; // into MipChain::bytes
+};
+
+// Every level lives in one allocation, tightly packed, largest first
+struct MipChain
+{
+  int channelCount;
+  std::vector< MipLevel > levels;
+  std::vector< uint8_t > bytes;
+  uint8_t* GetLevelBytes( int level );
+};
+
+struct MipSettings
+{
+  MipFilter filter = MipFilter::Box;
+
+  // Average color in linear space. Only applies to rgb, alpha is always linear
+  bool sRGB = true;
+
+  // 0 means all the way down to 1x1
+  int maxLevelCount = 0;
+};
+
+int GetMipLevelCount( int width, int height );
+
+// channelCount is 1 ( r8 ) or 4 ( r8g8b8a8 ).
+// stride is the number of bytes from one row to the next
+void GenerateMipChain(
+  MipChain* chain,
+  const void* bytes,
+  int width,
+  int height,
+  int stride,
+  int channelCount,
+  MipSettings settings );
@@ -0,0 +1,271 @@
+#include "particles.h"
+#include "fast_trig.h"
+#include "lanes.h"
+#include <cstring>
+
+static const int particlePadding = 8;
+static const int particleAlignment = 32;
+static const int particleArrayCount = 6;
+
+static int GetPaddedCount( int count )
+{
+  return ( count + particlePadding - 1 ) / particlePadding * particlePadding;
+}
+
+static float RandomUnit( uint32_t& state )
+{
+  state = state * 1664525 + 1013904223;
+  return ( state >> 8 ) / ( float )( 1 << 24 );
+}
+
+ParticleSystem::ParticleSystem( int capacity, ParticleSettings settings )
+{
+  Assert( capacity > 0 );
+  mSettings = settings;
+  mCount = 0;
+  mCapacity = capacity;
+  mRandomState = 1;
+
+  // One allocation, split into the arrays
+  int paddedCount = GetPaddedCount( capacity );
+  size_t byteCount = particleArrayCount * paddedCount * sizeof( float );
+  float* memory = ( float* )_mm_malloc( byteCount, particleAlignment );
+  if( !memory )
+    HandleErrorGracefully( "Out of memory for a ParticleSystem" );
+  std::memset( memory, 0, byteCount );
+  mPositionX = memory;
+  mPositionY = mPositionX + paddedCount;
+  mVelocityX = mPositionY + paddedCount;
+  mVelocityY = mVelocityX + paddedCount;
+  mAge = mVelocityY + paddedCount;
+  mAgeRate = mAge + paddedCount;
+}
+
+ParticleSystem::~ParticleSystem()
+{
+  _mm_free( mPositionX );
+}
+
+bool ParticleSystem::Spawn( Vector2 position, Vector2 velocity, float lifetime )
+{
+  Assert( lifetime > 0 );
+  if( mCount == mCapacity )
+    return false;
+  int i = mCount++;
+  mPositionX[ i ] = position.x;
+  mPositionY[ i ] = position.y;
+  mVelocityX[ i ] = velocity.x;
+  mVelocityY[ i ] = velocity.y;
+  mAge[ i ] = 0;
+  mAgeRate[ i ] = 1 / lifetime;
+  return true;
+}
+
+void ParticleSystem::Update( float dt )
+{
+  Integrate( dt );
+  for( ParticleEmitter& emitter : mEmitters )
+    Emit( &emitter, dt );
+}
+
+void ParticleSystem::Integrate( float dt )
+{
+  // One pass that moves a block, then removes whatever in it died, so the
+  // ages don't have to be streamed through a second time.
+  //
+  // A dead particle gets the last one swapped in. That one hasn't been moved
+  // yet unless it's in this block, so it's moved first, with the same math
+  // one at a time. It might be dead as well, so the block gets checked
+  // again until it's clean. Lanes past mCount get integrated too, which is
+  // harmless and saves a scalar tail
+  float dragScale = 1 - mSettings.drag * dt;
+  float drag = dragScale > 0 ? dragScale : 0;
+  float gravityX = mSettings.gravity.x * dt;
+  float gravityY = mSettings.gravity.y * dt;
+  Lanes dragLanes = LanesSet( drag );
+  Lanes gravityXLanes = LanesSet( gravityX );
+  Lanes gravityYLanes = LanesSet( gravityY );
+  Lanes dtLanes = LanesSet( dt );
+  Lanes one = LanesSet( 1 );
+  for( int i = 0; i < mCount; i += laneCount )
+  {
+    Lanes vx = LanesMul( LanesAdd( LanesLoad( mVelocityX + i ), gravityXLanes ), dragLanes );
+    Lanes vy = LanesMul( LanesAdd( LanesLoad( mVelocityY + i ), gravityYLanes ), dragLanes );
+    LanesStore( mVelocityX + i, vx );
+    LanesStore( mVelocityY + i, vy );
+    LanesStore( mPositionX + i, LanesAdd( LanesLoad( mPositionX + i ), LanesMul( vx, dtLanes ) ) );
+    LanesStore( mPositionY + i, LanesAdd( LanesLoad( mPositionY + i ), LanesMul( vy, dtLanes ) ) );
+    Lanes age = LanesAdd( LanesLoad( mAge + i ), LanesMul( LanesLoad( mAgeRate + i ), dtLanes ) );
+    LanesStore( mAge + i, age );
+
+    int deadMask = LanesMoveMask( LanesGreater( age, one ) );
+    while( deadMask )
+    {
+      int liveLaneCount = mCount - i;
+      if( liveLaneCount < laneCount )
+        deadMask &= ( 1 << liveLaneCount ) - 1;
+      if( !deadMask )
+        break;
+
+      int lane = 0;
+      while( !( ( deadMask >> lane ) & 1 ) )
+        ++lane;
+      int dead = i + lane;
+      int last = --mCount;
+      if( last >= i + laneCount )
+      {
+        mVelocityX[ last ] = ( mVelocityX[ last ] + gravityX ) * drag;
+        mVelocityY[ last ] = ( mVelocityY[ last ] + gravityY ) * drag;
+        mPositionX[ last ] += mVelocityX[ last ] * dt;
+        mPositionY[ last ] += mVelocityY[ last ] * dt;
+        mAge[ last ] += mAgeRate[ last ] * dt;
+      }
+      mPositionX[ dead ] = mPositionX[ last ];
+      mPositionY[ dead ] = mPositionY[ last ];
+      mVelocityX[ dead ] = mVelocityX[ last ];
+      mVelocityY[ dead ] = mVelocityY[ last ];
+      mAge[ dead ] = mAge[ last ];
+      mAgeRate[ dead ] = mAgeRate[ last ];
+      deadMask = LanesMoveMask( LanesGreater( LanesLoad( mAge + i ), one ) );
+    }
+  }
+}
+
+void ParticleSystem::Emit( ParticleEmitter* emitter, float dt )
+{
+  emitter->accumulator += emitter->rate * dt;
+  int spawnCount = ( int )emitter->accumulator;
+  emitter->accumulator -= spawnCount;
+  Vector2 direction = emitter->direction;
+  for( int i = 0; i < spawnCount; ++i )
+  {
+    float angle = ( 2 * RandomUnit( mRandomState ) - 1 ) * emitter->spread;
+    float sin;
+    float cos;
+    FastSinCos( angle, &sin, &cos );
+    Vector2 velocity(
+      direction.x * cos - direction.y * sin,
+      direction.x * sin + direction.y * cos );
+    float speed = emitter->speed * ( 0.5f + RandomUnit( mRandomState ) );
+    if( !Spawn( emitter->position, velocity * speed, emitter->lifetime ) )
+      break;
+  }
+}
+
+void ParticleSystem::WriteSnapshot( Snapshot* snapshot ) const
+{
+  int emitterCount = ( int )mEmitters.size();
+  int counts[ 2 ] = { mCount, emitterCount };
+  snapshot->Write( counts );
+  snapshot->Write( mRandomState );
+  snapshot->Write( mEmitters.data(), ( int )( emitterCount * sizeof( ParticleEmitter ) ) );
+  const float* arrays[ particleArrayCount ] = { mPositionX, mPositionY, mVelocityX, mVelocityY, mAge, mAgeRate };
+  for( const float* values : arrays )
+    snapshot->Write( values, ( int )( mCount * sizeof( float ) ) );
+}
+
+void ParticleSystem::ReadSnapshot( Snapshot* snapshot )
+{
+  int counts[ 2 ];
+  snapshot->Read( &counts );
+  Assert( counts[ 0 ] <= mCapacity );
+  mCount = counts[ 0 ];
+  snapshot->Read( &mRandomState );
+  mEmitters.resize( counts[ 1 ] );
+  snapshot->Read( mEmitters.data(), ( int )( counts[ 1 ] * sizeof( ParticleEmitter ) ) );
+  float* arrays[ particleArrayCount ] = { mPositionX, mPositionY, mVelocityX, mVelocityY, mAge, mAgeRate };
+  for( float* values : arrays )
+    snapshot->Read( values, ( int )( mCount * sizeof( float ) ) );
+}
+
+int ParticleSystem::WriteInstances( ParticleInstance* instances, const Aabb& viewBounds ) const
+{
+  // Always 4 wide, packing the colors needs integer ops that only come 8
+  // wide with avx2
+  const ParticleSettings& settings = mSettings;
+  __m128 one = _mm_set1_ps( 1 );
+  __m128 startSize = _mm_set1_ps( settings.startSize );
+  __m128 deltaSize = _mm_set1_ps( settings.endSize - settings.startSize );
+  __m128 startColor[ 4 ];
+  __m128 deltaColor[ 4 ];
+  for( int channel = 0; channel < 4; ++channel )
+  {
+    // Scaled to 0-255 up front, plus a half so truncating rounds
+    startColor[ channel ] = _mm_set1_ps( settings.startColor[ channel ] * 255 + 0.5f );
+    deltaColor[ channel ] = _mm_set1_ps( ( settings.endColor[ channel ] - settings.startColor[ channel ] ) * 255 );
+  }
+  __m128 viewMinX = _mm_set1_ps( viewBounds.min.x );
+  __m128 viewMinY = _mm_set1_ps( viewBounds.min.y );
+  __m128 viewMaxX = _mm_set1_ps( viewBounds.max.x );
+  __m128 viewMaxY = _mm_set1_ps( viewBounds.max.y );
+
+  int written = 0;
+  for( int i = 0; i < mCount; i += 4 )
+  {
+    __m128 age = _mm_min_ps( _mm_load_ps( mAge + i ), one );
+    __m128 x = _mm_load_ps( mPositionX + i );
+    __m128 y = _mm_load_ps( mPositionY + i );
+    __m128 size = _mm_add_ps( startSize, _mm_mul_ps( age, deltaSize ) );
+
+    // size is half the quad, so this is the quad against the view
+    __m128 isVisible = _mm_and_ps(
+      _mm_and_ps(
+        _mm_cmpge_ps( _mm_add_ps( x, size ), viewMinX ),
+        _mm_cmple_ps( _mm_sub_ps( x, size ), viewMaxX ) ),
+      _mm_and_ps(
+        _mm_cmpge_ps( _mm_add_ps( y, size ), viewMinY ),
+        _mm_cmple_ps( _mm_sub_ps( y, size ), viewMaxY ) ) );
+    int visibleMask = _mm_movemask_ps( isVisible );
+    int liveLaneCount = mCount - i < 4 ? mCount - i : 4;
+    visibleMask &= ( 1 << liveLaneCount ) - 1;
+    if( !visibleMask )
+      continue;
+
+    __m128i color = _mm_setzero_si128();
+    for( int channel = 0; channel < 4; ++channel )
+    {
+      __m128 value = _mm_add_ps( startColor[ channel ], _mm_mul_ps( age, deltaColor[ channel ] ) );
+      color = _mm_or_si128( color, _mm_slli_epi32( _mm_cvttps_epi32( value ), 8 * channel ) );
+    }
+
+    // Four particles as four columns, transposed into four instances
+    __m128 packed = _mm_castsi128_ps( color );
+    _MM_TRANSPOSE4_PS( x, y, size, packed );
+
+    // written <= i, so when all four are visible they fit
+    float* out = ( float* )( instances + written );
+    if( visibleMask == 15 )
+    {
+      _mm_storeu_ps( out, x );
+      _mm_storeu_ps( out + 4, y );
+      _mm_storeu_ps( out + 8, size );
+      _mm_storeu_ps( out + 12, packed );
+      written += 4;
+      continue;
+    }
+
+    // Each transposed register is one instance. They all get stored, and
+    // only the visible ones move written on, which mispredicts less than
+    // branching per lane. written stays at or below i + lane, so only the
+    // last block has to stop at the live lanes to stay inside the buffer
+    if( liveLaneCount == 4 )
+    {
+      _mm_storeu_ps( out, x );
+      written += visibleMask & 1;
+      _mm_storeu_ps( ( float* )( instances + written ), y );
+      written += ( visibleMask >> 1 ) & 1;
+      _mm_storeu_ps( ( float* )( instances + written ), size );
+      written += ( visibleMask >> 2 ) & 1;
+      _mm_storeu_ps( ( float* )( instances + written ), packed );
+      written += ( visibleMask >> 3 ) & 1;
+      continue;
+    }
+    __m128 lanes[ 4 ] = { x, y, size, packed };
+    for( int lane = 0; lane < liveLaneCount; ++lane )
+    {
+      _mm_storeu_ps( ( float* )( instances + written ), lanes[ lane ] );
+      written += ( visibleMask >> lane ) & 1;
+    }
+  }
+  return written;
+}
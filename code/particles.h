@@ -0,0 +1,85 @@
+#pragma once
+#include "aabb_tree.h"
+#include "snapshot.h"
+
+// What the particle shader reads per instance. color is r8g8b8a8
+struct ParticleInstance
+{
+  Vector2 position;
+  float size;
+  uint32_t color;
+};
+
+// Shared by every particle in a system. Color and size go from start to end
+// over each particle's life
+struct ParticleSettings
+{
+  Vector2 gravity = Vector2( 0, -2 );
+  // Fraction of velocity lost per second
+  float drag = 0.5f;
+  Color4 startColor = Color4( 1, 1, 1, 1 );
+  Color4 endColor = Color4( 1, 1, 1, 0 );
+  float startSize = 0.3f;
+  float endSize = 0.05f;
+};
+
+// Spawns rate particles a second in a cone around direction
+struct ParticleEmitter
+{
+  Vector2 position;
+  Vector2 direction = Vector2( 0, 1 );
+  // Radians either side of direction
+  float spread = 3.14159265f;
+  float speed = 2;
+  float rate = 100;
+  float lifetime = 1;
+  // Fractional particles carried to the next update
+  float accumulator = 0;
+};
+
+// Particles in structure of arrays, so the update is a straight simd loop.
+//
+// Each array holds capacity floats, padded to a multiple of 8 and 32 byte
+// aligned. Dead particles get the last live one swapped in, so [ 0, count )
+// are always the live ones, in no particular order
+struct ParticleSystem
+{
+  ParticleSystem( int capacity, ParticleSettings settings );
+  ~ParticleSystem();
+  ParticleSystem( const ParticleSystem& ) = delete;
+  ParticleSystem& operator = ( const ParticleSystem& ) = delete;
+
+  // Returns false if it's full
+  bool Spawn( Vector2 position, Vector2 velocity, float lifetime );
+
+  // Moves and ages everything, removes what died, then runs the emitters
+  void Update( float dt );
+
+  // Writes the particles that overlap viewBounds, returns how many.
+  // instances needs room for count
+  int WriteInstances( ParticleInstance* instances, const Aabb& viewBounds ) const;
+
+  // The live particles, the emitters and the random state. Settings don't
+  // change while it runs, so they're left out
+  void WriteSnapshot( Snapshot* snapshot ) const;
+  void ReadSnapshot( Snapshot* snapshot );
+
+  // Moves and ages everything, and removes what died
+  void Integrate( float dt );
+  void Emit( ParticleEmitter* emitter, float dt );
+
+  ParticleSettings mSettings;
+  std::vector< ParticleEmitter > mEmitters;
+
+  float* mPositionX;
+  float* mPositionY;
+  float* mVelocityX;
+  float* mVelocityY;
+  // 0 when spawned, dead past 1
+  float* mAge;
+  // 1 / lifetime
+  float* mAgeRate;
+  int mCount;
+  int mCapacity;
+  uint32_t mRandomState;
+};
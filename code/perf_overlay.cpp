@@ -0,0 +1,250 @@
+#include "perf_overlay.h"
+#include <cstdio>
+
+// r8g8b8a8, so red is the low byte
+static const uint32_t overlayBackground = 0xc0000000;
+static const uint32_t overlayText = 0xffffffff;
+static const uint32_t overlayHeading = 0xff80d0ff;
+static const uint32_t overlayGood = 0xff40e040;
+static const uint32_t overlaySlow = 0xff40e0ff;
+static const uint32_t overlayVerySlow = 0xff4040ff;
+static const uint32_t overlayGuide = 0x80ffffff;
+
+// The graph's top is two 60hz frames, with a line across at one
+static const float overlayGraphMilliseconds = 1000.0f / 30.0f;
+static const float overlayFrameMilliseconds = 1000.0f / 60.0f;
+
+// How much of each new frame goes into a scope's time
+static const float overlayScopeSmoothing = 0.1f;
+
+PerfOverlay::PerfOverlay()
+{
+  mIsVisible = false;
+  for( float& milliseconds : mFrameMilliseconds )
+    milliseconds = 0;
+  mNewestFrame = 0;
+  mLastTimestamp = 0;
+  mTicksPerMillisecond = 0;
+  mScopeCount = 0;
+  for( uint32_t& count : mThreadEventCounts )
+    count = 0;
+}
+
+void PerfOverlay::Update( const PerfOverlayCounters& counters )
+{
+  uint64_t timestamp = ProfileTimestamp();
+  if( mLastTimestamp )
+  {
+    // Waits out the calibration the first time, if the game started less
+    // than that ago
+    if( !mTicksPerMillisecond )
+      mTicksPerMillisecond = ProfilerGetTicksPerMicrosecond() * 1000;
+    mNewestFrame = ( mNewestFrame + 1 ) % frameCapacity;
+    mFrameMilliseconds[ mNewestFrame ] = ( float )( ( timestamp - mLastTimestamp ) / mTicksPerMillisecond );
+  }
+  mLastTimestamp = timestamp;
+  mCounters = counters;
+  AddScopes();
+}
+
+void PerfOverlay::AddScopes()
+{
+  for( int i = 0; i < mScopeCount; ++i )
+  {
+    mScopes[ i ].frameTicks = 0;
+    mScopes[ i ].callCount = 0;
+  }
+
+  for( ProfileThreadBuffer* buffer = ProfilerGetThreadBuffers(); buffer; buffer = buffer->next )
+  {
+    if( buffer->threadIndex >= threadCapacity )
+      continue;
+    uint32_t& readCount = mThreadEventCounts[ buffer->threadIndex ];
+    uint32_t count = buffer->count.load( std::memory_order_acquire );
+    uint32_t first = readCount;
+    // Anything older got written over
+    if( count - first > ProfileThreadBuffer::capacity )
+      first = count - ProfileThreadBuffer::capacity;
+    readCount = count;
+    if( !mIsVisible )
+      continue;
+
+    // Consecutive events are mostly the same scope, so start looking there
+    int scopeIndex = 0;
+    for( uint32_t i = first; i != count; ++i )
+    {
+      const ProfileEvent& event = buffer->events[ i % ProfileThreadBuffer::capacity ];
+      if( scopeIndex >= mScopeCount || mScopes[ scopeIndex ].name != event.name )
+      {
+        scopeIndex = 0;
+        while( scopeIndex < mScopeCount && mScopes[ scopeIndex ].name != event.name )
+          ++scopeIndex;
+        if( scopeIndex == mScopeCount )
+        {
+          if( mScopeCount == scopeCapacity )
+            continue;
+          Scope& added = mScopes[ mScopeCount++ ];
+          added.name = event.name;
+          added.milliseconds = 0;
+          added.callCount = 0;
+          added.frameTicks = 0;
+        }
+      }
+      Scope& scope = mScopes[ scopeIndex ];
+      scope.frameTicks += event.end - event.begin;
+      ++scope.callCount;
+    }
+  }
+
+  if( !mIsVisible || !mTicksPerMillisecond )
+    return;
+  for( int i = 0; i < mScopeCount; ++i )
+  {
+    Scope& scope = mScopes[ i ];
+    float frameMilliseconds = ( float )( scope.frameTicks / mTicksPerMillisecond );
+    scope.milliseconds += ( frameMilliseconds - scope.milliseconds ) * overlayScopeSmoothing;
+  }
+}
+
+// Quads go out strictly in order, they can be going straight into write
+// combined memory
+struct OverlayWriter
+{
+  OverlayQuad* quads;
+  int quadCount;
+  const OverlayFont* font;
+  float scale;
+};
+
+static void AddRect( OverlayWriter* writer, Vector2 min, Vector2 max, uint32_t color )
+{
+  if( writer->quadCount == PerfOverlay::quadCapacity )
+    return;
+  OverlayQuad quad;
+  quad.min = min;
+  quad.max = max;
+  quad.uvMin = Vector2( -1, -1 );
+  quad.uvMax = Vector2( -1, -1 );
+  quad.color = color;
+  writer->quads[ writer->quadCount++ ] = quad;
+}
+
+// position is the top left of the line
+static void AddText( OverlayWriter* writer, Vector2 position, const char* text, uint32_t color )
+{
+  const OverlayFont& font = *writer->font;
+  float scale = writer->scale;
+  float x = position.x;
+  float baseline = position.y + font.ascent * scale;
+  for( const char* c = text; *c; ++c )
+  {
+    if( ( unsigned char )*c >= 128 )
+      continue;
+    const stbtt_packedchar& glyph = font.glyphs[ ( unsigned char )*c ];
+    if( glyph.x1 > glyph.x0 && writer->quadCount < PerfOverlay::quadCapacity )
+    {
+      OverlayQuad quad;
+      quad.min = Vector2( x + glyph.xoff * scale, baseline + glyph.yoff * scale );
+      quad.max = Vector2( x + glyph.xoff2 * scale, baseline + glyph.yoff2 * scale );
+      quad.uvMin = Vector2( glyph.x0 / font.atlasWidth, glyph.y0 / font.atlasHeight );
+      quad.uvMax = Vector2( glyph.x1 / font.atlasWidth, glyph.y1 / font.atlasHeight );
+      quad.color = color;
+      writer->quads[ writer->quadCount++ ] = quad;
+    }
+    x += glyph.xadvance * scale;
+  }
+}
+
+int PerfOverlay::WriteQuads( OverlayQuad* quads, const OverlayFont& font, float scale ) const
+{
+  OverlayWriter writer;
+  writer.quads = quads;
+  writer.quadCount = 0;
+  writer.font = &font;
+  writer.scale = scale;
+
+  // Everything is sized off the line height, so it all scales with the text
+  float lineHeight = font.lineHeight * scale;
+  float padding = lineHeight * 0.5f;
+  float width = lineHeight * 24;
+  float graphHeight = lineHeight * 4;
+  float valueColumn = padding + lineHeight * 14;
+  float countColumn = padding + lineHeight * 19;
+  int textLineCount = 5 + mScopeCount;
+  float height = padding * 3 + graphHeight + lineHeight * textLineCount;
+  AddRect( &writer, Vector2( 0, 0 ), Vector2( width, height ), overlayBackground );
+
+  float newest = mFrameMilliseconds[ mNewestFrame ];
+  // Slots that haven't had a frame yet are 0
+  float sum = 0;
+  float slowest = 0;
+  int frameCount = 0;
+  for( float milliseconds : mFrameMilliseconds )
+  {
+    sum += milliseconds;
+    slowest = milliseconds > slowest ? milliseconds : slowest;
+    frameCount += milliseconds > 0;
+  }
+  char line[ 128 ];
+  Vector2 cursor( padding, padding );
+  std::snprintf( line, sizeof( line ), "frame %.2f ms  avg %.2f  max %.2f",
+    newest,
+    frameCount ? sum / frameCount : 0,
+    slowest );
+  AddText( &writer, cursor, line, overlayText );
+  cursor.y += lineHeight;
+
+  // Oldest on the left
+  float graphWidth = width - padding * 2;
+  float barWidth = graphWidth / frameCapacity;
+  float graphBottom = cursor.y + graphHeight;
+  for( int i = 0; i < frameCapacity; ++i )
+  {
+    float milliseconds = mFrameMilliseconds[ ( mNewestFrame + 1 + i ) % frameCapacity ];
+    float barHeight = milliseconds / overlayGraphMilliseconds;
+    barHeight = ( barHeight < 1 ? barHeight : 1 ) * graphHeight;
+    uint32_t color
+      = milliseconds <= overlayFrameMilliseconds ? overlayGood
+      : milliseconds <= overlayGraphMilliseconds ? overlaySlow
+      : overlayVerySlow;
+    float x = padding + i * barWidth;
+    AddRect( &writer, Vector2( x, graphBottom - barHeight ), Vector2( x + barWidth, graphBottom ), color );
+  }
+  float guideY = graphBottom - graphHeight * overlayFrameMilliseconds / overlayGraphMilliseconds;
+  AddRect( &writer, Vector2( padding, guideY ), Vector2( padding + graphWidth, guideY + 1 ), overlayGuide );
+  cursor.y = graphBottom + padding;
+
+  std::snprintf( line, sizeof( line ), "draws %i  instances %i",
+    mCounters.drawCount,
+    mCounters.instanceCount );
+  AddText( &writer, cursor, line, overlayText );
+  cursor.y += lineHeight;
+  std::snprintf( line, sizeof( line ), "state changes %i  uploads %i",
+    mCounters.stateChangeCount,
+    mCounters.uploadCount );
+  AddText( &writer, cursor, line, overlayText );
+  cursor.y += lineHeight;
+  const float megabyte = 1024.0f * 1024.0f;
+  std::snprintf( line, sizeof( line ), "ram %.1f MB  textures %.1f/%.1f MB",
+    mCounters.residentBytes / megabyte,
+    mCounters.textureBytes / megabyte,
+    mCounters.textureBudgetBytes / megabyte );
+  AddText( &writer, cursor, line, overlayText );
+  cursor.y += lineHeight;
+
+  AddText( &writer, cursor, "scope", overlayHeading );
+  AddText( &writer, Vector2( valueColumn, cursor.y ), "ms", overlayHeading );
+  AddText( &writer, Vector2( countColumn, cursor.y ), "calls", overlayHeading );
+  cursor.y += lineHeight;
+  for( int i = 0; i < mScopeCount; ++i )
+  {
+    const Scope& scope = mScopes[ i ];
+    AddText( &writer, cursor, scope.name, overlayText );
+    std::snprintf( line, sizeof( line ), "%.3f", scope.milliseconds );
+    AddText( &writer, Vector2( valueColumn, cursor.y ), line, overlayText );
+    std::snprintf( line, sizeof( line ), "%i", scope.callCount );
+    AddText( &writer, Vector2( countColumn, cursor.y ), line, overlayText );
+    cursor.y += lineHeight;
+  }
+  return writer.quadCount;
+}
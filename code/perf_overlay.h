@@ -0,0 +1,91 @@
+#pragma once
+#include "profiler.h"
+#include "stb_truetype.h"
+
+// What the overlay shader reads per instance. Rectangles are in pixels from
+// the top left of the screen, color is r8g8b8a8. A negative uvMin.x draws
+// the rectangle solid instead of sampling the font
+struct OverlayQuad
+{
+  Vector2 min;
+  Vector2 max;
+  Vector2 uvMin;
+  Vector2 uvMax;
+  uint32_t color;
+};
+
+// A font packed with stbtt_PackFontRange, characters 0 to 127
+struct OverlayFont
+{
+  const stbtt_packedchar* glyphs;
+  float atlasWidth;
+  float atlasHeight;
+  // Pixels from the top of a line down to the baseline, and from one line to
+  // the next, at the size it was packed
+  float ascent;
+  float lineHeight;
+};
+
+// Everything the overlay shows that it doesn't measure itself, from last
+// frame
+struct PerfOverlayCounters
+{
+  int drawCount = 0;
+  int instanceCount = 0;
+  int stateChangeCount = 0;
+  int uploadCount = 0;
+  size_t residentBytes = 0;
+  size_t textureBytes = 0;
+  size_t textureBudgetBytes = 0;
+};
+
+// Frame times, the profiler's scopes and the gpu and memory counters, drawn
+// as text and a graph in one instanced draw.
+//
+// Everything lives in fixed size arrays and the text is formatted on the
+// stack, so nothing gets allocated after construction
+struct PerfOverlay
+{
+  static const int frameCapacity = 120;
+  static const int scopeCapacity = 32;
+  static const int threadCapacity = 64;
+  static const int quadCapacity = 4096;
+
+  PerfOverlay();
+
+  // Call once a frame whether or not it's visible, so the graph has no gaps.
+  // Scopes are read from every thread's profiler buffer since the last call,
+  // but only added up while it's visible
+  void Update( const PerfOverlayCounters& counters );
+
+  // Writes at most quadCapacity quads, returns how many. The panel starts
+  // at the top left, scale is the size of the text relative to the font's
+  int WriteQuads( OverlayQuad* quads, const OverlayFont& font, float scale ) const;
+
+  struct Scope
+  {
+    const char* name;
+    // Smoothed over the last few frames. Scopes that ran on several threads
+    // are added together, so this can be more than a frame
+    float milliseconds;
+    int callCount;
+    uint64_t frameTicks;
+  };
+
+  void AddScopes();
+
+  bool mIsVisible;
+  PerfOverlayCounters mCounters;
+
+  // Oldest to newest starting after mNewestFrame
+  float mFrameMilliseconds[ frameCapacity ];
+  int mNewestFrame;
+  uint64_t mLastTimestamp;
+  double mTicksPerMillisecond;
+
+  // In the order they were first seen, matched by name pointer
+  Scope mScopes[ scopeCapacity ];
+  int mScopeCount;
+  // How far into each thread's buffer has been read, by thread index
+  uint32_t mThreadEventCounts[ threadCapacity ];
+};
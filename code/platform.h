@@ -1,3 +1,29 @@
 #pragma once
+#include <cstddef>
 
 void PlatformMessageBox( const char* msg );
+
+// The debugger's output window, or stderr
+void PlatformDebugOutput( const char* text );
+
+// Does nothing if it already exists
+void PlatformCreateDirectory( const char* path );
+
+// Moves from over to, replacing it in one step, so there's never a moment
+// without a file at to. Returns false if it couldn't
+bool PlatformReplaceFile( const char* from, const char* to );
+
+// A whole file mapped read only. bytes stays valid until PlatformUnmapFile
+struct PlatformMappedFile
+{
+  const void* bytes = nullptr;
+  size_t byteCount = 0;
+  void* handle = nullptr;
+};
+
+// Returns false if it doesn't exist, is empty or can't be mapped
+bool PlatformMapFile( const char* path, PlatformMappedFile* file );
+void PlatformUnmapFile( PlatformMappedFile* file );
+
+// Bytes of this process's memory that are actually in ram, 0 if unknown
+size_t PlatformGetResidentByteCount();
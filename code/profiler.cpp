@@ -0,0 +1,120 @@
+#include "profiler.h"
+#include <chrono>
+#include <cstdio>
+
+typedef std::chrono::steady_clock ProfileClock;
+
+thread_local ProfileThreadBuffer* profileThreadBuffer = nullptr;
+static std::atomic< ProfileThreadBuffer* > profileThreadBuffers( nullptr );
+static std::atomic< int > profileThreadCount( 0 );
+
+// When the first thread started recording. A function static, so whoever
+// gets here first sets it and anyone else at the same time waits for them
+struct ProfileStart
+{
+  ProfileClock::time_point time;
+  uint64_t timestamp;
+};
+
+static const ProfileStart& GetProfileStart()
+{
+  static ProfileStart start = { ProfileClock::now(), ProfileTimestamp() };
+  return start;
+}
+
+ProfileThreadBuffer* ProfilerAddThreadBuffer()
+{
+  GetProfileStart();
+  ProfileThreadBuffer* buffer = new ProfileThreadBuffer;
+  buffer->count = 0;
+  buffer->threadIndex = profileThreadCount++;
+  buffer->name = nullptr;
+  buffer->next = profileThreadBuffers.load();
+  while( !profileThreadBuffers.compare_exchange_weak( buffer->next, buffer ) )
+    ;
+  profileThreadBuffer = buffer;
+  return buffer;
+}
+
+void ProfilerSetThreadName( const char* name )
+{
+  ProfileThreadBuffer* buffer = profileThreadBuffer;
+  if( !buffer )
+    buffer = ProfilerAddThreadBuffer();
+  buffer->name = name;
+}
+
+double ProfilerGetTicksPerMicrosecond()
+{
+  const ProfileStart& start = GetProfileStart();
+  const std::chrono::microseconds minElapsed( 10000 );
+  ProfileClock::time_point now;
+  uint64_t timestamp;
+  do
+  {
+    now = ProfileClock::now();
+    timestamp = ProfileTimestamp();
+  } while( now - start.time < minElapsed );
+  std::chrono::duration< double, std::micro > elapsed = now - start.time;
+  return ( timestamp - start.timestamp ) / elapsed.count();
+}
+
+ProfileThreadBuffer* ProfilerGetThreadBuffers()
+{
+  return profileThreadBuffers.load();
+}
+
+// Names are literals from the code, this only has to keep the json valid
+static void WriteJsonString( FILE* file, const char* text )
+{
+  std::fputc( '"', file );
+  for( const char* c = text; *c; ++c )
+  {
+    if( *c == '"' || *c == '\\' )
+      std::fputc( '\\', file );
+    if( ( unsigned char )*c >= ' ' )
+      std::fputc( *c, file );
+  }
+  std::fputc( '"', file );
+}
+
+bool ProfilerWriteTrace( const char* path )
+{
+  FILE* file = std::fopen( path, "w" );
+  if( !file )
+    return false;
+  double ticksPerMicrosecond = ProfilerGetTicksPerMicrosecond();
+  uint64_t startTimestamp = GetProfileStart().timestamp;
+  std::fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+  const char* separator = "";
+  for( ProfileThreadBuffer* buffer = ProfilerGetThreadBuffers(); buffer; buffer = buffer->next )
+  {
+    if( buffer->name )
+    {
+      std::fprintf( file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"name\":\"thread_name\",\"args\":{\"name\":",
+        separator,
+        buffer->threadIndex );
+      WriteJsonString( file, buffer->name );
+      std::fprintf( file, "}}" );
+      separator = ",\n";
+    }
+
+    uint32_t count = buffer->count.load( std::memory_order_acquire );
+    uint32_t first = count > ProfileThreadBuffer::capacity ? count - ProfileThreadBuffer::capacity : 0;
+    for( uint32_t i = first; i < count; ++i )
+    {
+      const ProfileEvent& event = buffer->events[ i % ProfileThreadBuffer::capacity ];
+      // Complete events, a begin and a duration
+      std::fprintf( file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+        separator,
+        buffer->threadIndex,
+        ( int64_t )( event.begin - startTimestamp ) / ticksPerMicrosecond,
+        ( event.end - event.begin ) / ticksPerMicrosecond );
+      WriteJsonString( file, event.name );
+      std::fputc( '}', file );
+      separator = ",\n";
+    }
+  }
+  std::fprintf( file, "\n]}\n" );
+  return std::fclose( file ) == 0;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "utility.h"
+#include <atomic>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// Build with ENABLE_PROFILER 0 and every PROFILE_SCOPE compiles to nothing
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+// Cpu timestamp counter. It runs at a constant rate on anything recent,
+// ProfilerGetTicksPerMicrosecond() says how fast
+inline uint64_t ProfileTimestamp()
+{
+  return __rdtsc();
+}
+
+// name has to outlive the profiler, a string literal
+struct ProfileEvent
+{
+  const char* name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// Each thread records into its own ring, so recording never takes a lock or
+// writes to memory another thread does. Only the newest capacity events are
+// kept
+struct ProfileThreadBuffer
+{
+  static const uint32_t capacity = 1 << 16;
+  ProfileEvent events[ capacity ];
+  // Events ever recorded, the newest is events[ ( count - 1 ) % capacity ].
+  // Stored after the event is written, so a reader that loads it sees
+  // whole events
+  std::atomic< uint32_t > count;
+  int threadIndex;
+  const char* name;
+  ProfileThreadBuffer* next;
+};
+
+// This thread's buffer, made the first time it's asked for
+extern thread_local ProfileThreadBuffer* profileThreadBuffer;
+ProfileThreadBuffer* ProfilerAddThreadBuffer();
+
+inline void ProfileRecord( const char* name, uint64_t begin, uint64_t end )
+{
+  ProfileThreadBuffer* buffer = profileThreadBuffer;
+  if( !buffer )
+    buffer = ProfilerAddThreadBuffer();
+  uint32_t count = buffer->count.load( std::memory_order_relaxed );
+  ProfileEvent& event = buffer->events[ count % ProfileThreadBuffer::capacity ];
+  event.name = name;
+  event.begin = begin;
+  event.end = end;
+  buffer->count.store( count + 1, std::memory_order_release );
+}
+
+// Records from construction to destruction
+struct ProfileScope
+{
+  ProfileScope( const char* name )
+  {
+    mName = name;
+    mBegin = ProfileTimestamp();
+  }
+  ~ProfileScope()
+  {
+    ProfileRecord( mName, mBegin, ProfileTimestamp() );
+  }
+  const char* mName;
+  uint64_t mBegin;
+};
+
+#define PROFILE_JOIN2( a, b ) a##b
+#define PROFILE_JOIN( a, b ) PROFILE_JOIN2( a, b )
+#if ENABLE_PROFILER
+#define PROFILE_SCOPE( name ) ProfileScope PROFILE_JOIN( profileScope, __LINE__ )( name )
+#else
+#define PROFILE_SCOPE( name )
+#endif
+
+// Shows up as the thread's name in the trace. name has to outlive the
+// profiler
+void ProfilerSetThreadName( const char* name );
+
+// Measured against the steady clock since the first event, the first call
+// waits for a few milliseconds of that if it has to
+double ProfilerGetTicksPerMicrosecond();
+
+// Every thread's buffer, newest first
+ProfileThreadBuffer* ProfilerGetThreadBuffers();
+
+// Chrome trace event json, for chrome://tracing or ui.perfetto.dev. Events
+// that are still being written can come out torn, so call it while the
+// other threads are idle, eg. between frames
+bool ProfilerWriteTrace( const char* path );
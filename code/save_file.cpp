@@ -0,0 +1,133 @@
+#include "save_file.h"
+#include <cstdio>
+#include <cstring>
+
+static const uint32_t saveFileMagic = SaveTag( 'S', 'A', 'V', 'E' );
+static const uint64_t saveSectionAlignment = 64;
+
+static uint64_t AlignUp( uint64_t value )
+{
+  return ( value + saveSectionAlignment - 1 ) / saveSectionAlignment * saveSectionAlignment;
+}
+
+void SaveWriter::AddSection( uint32_t tag, const void* elements, int elementByteCount, int elementCount )
+{
+  Assert( elementByteCount > 0 && elementCount >= 0 );
+  size_t offset = ( size_t )AlignUp( mBytes.size() );
+  size_t byteCount = ( size_t )elementByteCount * elementCount;
+  mBytes.resize( offset + byteCount );
+  if( byteCount )
+    std::memcpy( mBytes.data() + offset, elements, byteCount );
+  SaveSection section;
+  section.tag = tag;
+  section.elementByteCount = elementByteCount;
+  section.offset = offset;
+  section.elementCount = elementCount;
+  mSections.push_back( section );
+}
+
+bool SaveWriter::Write( const char* path ) const
+{
+  // The sections go after the table
+  std::vector< SaveSection > sections = mSections;
+  uint64_t dataOffset = AlignUp( sizeof( SaveHeader ) + sections.size() * sizeof( SaveSection ) );
+  for( SaveSection& section : sections )
+    section.offset += dataOffset;
+  SaveHeader header;
+  header.magic = saveFileMagic;
+  header.version = saveFileVersion;
+  header.byteCount = dataOffset + AlignUp( mBytes.size() );
+  header.sectionCount = ( uint32_t )sections.size();
+  header.padding = 0;
+
+  std::string temporaryPath = std::string( path ) + ".tmp";
+  FILE* file = std::fopen( temporaryPath.c_str(), "wb" );
+  if( !file )
+    return false;
+  static const uint8_t zeros[ saveSectionAlignment ] = {};
+  size_t tableEnd = sizeof( header ) + sections.size() * sizeof( SaveSection );
+  size_t tailPadding = ( size_t )( AlignUp( mBytes.size() ) - mBytes.size() );
+  bool isWritten = std::fwrite( &header, sizeof( header ), 1, file ) == 1
+    && std::fwrite( sections.data(), sizeof( SaveSection ), sections.size(), file ) == sections.size()
+    && std::fwrite( zeros, 1, ( size_t )dataOffset - tableEnd, file ) == ( size_t )dataOffset - tableEnd
+    && std::fwrite( mBytes.data(), 1, mBytes.size(), file ) == mBytes.size()
+    && std::fwrite( zeros, 1, tailPadding, file ) == tailPadding;
+  isWritten = std::fclose( file ) == 0 && isWritten;
+  isWritten = isWritten && PlatformReplaceFile( temporaryPath.c_str(), path );
+  if( !isWritten )
+    std::remove( temporaryPath.c_str() );
+  return isWritten;
+}
+
+SaveFile::SaveFile()
+{
+  mHeader = nullptr;
+  mSections = nullptr;
+}
+
+SaveFile::~SaveFile()
+{
+  Close();
+}
+
+bool SaveFile::Open( const char* path )
+{
+  Close();
+  if( !PlatformMapFile( path, &mFile ) )
+    return false;
+
+  // Only the header and the table get looked at, however big the save is
+  const SaveHeader* header = ( const SaveHeader* )mFile.bytes;
+  uint64_t byteCount = mFile.byteCount;
+  bool isValid = byteCount >= sizeof( SaveHeader )
+    && header->magic == saveFileMagic
+    && header->version == saveFileVersion
+    && header->byteCount == byteCount
+    && header->sectionCount <= ( byteCount - sizeof( SaveHeader ) ) / sizeof( SaveSection );
+  const SaveSection* sections = ( const SaveSection* )( header + 1 );
+  uint64_t tableEnd = isValid ? sizeof( SaveHeader ) + header->sectionCount * sizeof( SaveSection ) : 0;
+  for( uint32_t i = 0; isValid && i < header->sectionCount; ++i )
+  {
+    // Divided rather than multiplied, so a huge count can't wrap around
+    const SaveSection& section = sections[ i ];
+    isValid = section.elementByteCount > 0
+      && section.offset % saveSectionAlignment == 0
+      && section.offset >= tableEnd
+      && section.offset <= byteCount
+      && section.elementCount <= ( byteCount - section.offset ) / section.elementByteCount
+      && section.elementCount <= 0x7fffffff;
+  }
+  if( !isValid )
+  {
+    Close();
+    return false;
+  }
+  mHeader = header;
+  mSections = sections;
+  return true;
+}
+
+void SaveFile::Close()
+{
+  PlatformUnmapFile( &mFile );
+  mHeader = nullptr;
+  mSections = nullptr;
+}
+
+const void* SaveFile::GetSection( uint32_t tag, int elementByteCount, int* elementCount ) const
+{
+  *elementCount = 0;
+  if( !mHeader )
+    return nullptr;
+  for( uint32_t i = 0; i < mHeader->sectionCount; ++i )
+  {
+    const SaveSection& section = mSections[ i ];
+    if( section.tag != tag )
+      continue;
+    if( section.elementByteCount != ( uint32_t )elementByteCount )
+      return nullptr;
+    *elementCount = ( int )section.elementCount;
+    return ( const uint8_t* )mFile.bytes + section.offset;
+  }
+  return nullptr;
+}
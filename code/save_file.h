@@ -0,0 +1,83 @@
+#pragma once
+#include "utility.h"
+#include "platform.h"
+
+// Bump this when the layout of any section changes
+static const uint32_t saveFileVersion = 1;
+
+// Four characters, the first in the lowest byte
+constexpr uint32_t SaveTag( char a, char b, char c, char d )
+{
+  return ( uint32_t )a | ( uint32_t )b << 8 | ( uint32_t )c << 16 | ( uint32_t )d << 24;
+}
+
+// A save is this header, a table of sections, then each section's elements
+// back to back starting on a 64 byte boundary. Everything in it is plain
+// old data and offsets from the start of the file, never pointers, so a
+// section gets used right where it sits in the mapped file
+struct SaveHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t byteCount;
+  uint32_t sectionCount;
+  uint32_t padding;
+};
+
+struct SaveSection
+{
+  uint32_t tag;
+  uint32_t elementByteCount;
+  uint64_t offset;
+  uint64_t elementCount;
+};
+
+// Collects copies of the sections, then writes them all out in one go
+struct SaveWriter
+{
+  void AddSection( uint32_t tag, const void* elements, int elementByteCount, int elementCount );
+  template< typename T >
+  void AddSection( uint32_t tag, const T* elements, int elementCount )
+  {
+    AddSection( tag, elements, sizeof( T ), elementCount );
+  }
+
+  // Written to a temporary first and then replaces path in one step, so a
+  // crash at any point leaves either the old save or the new one. Returns
+  // false if it couldn't be written
+  bool Write( const char* path ) const;
+
+  // Offsets are from the start of mBytes until Write() moves them past the
+  // table
+  std::vector< SaveSection > mSections;
+  std::vector< uint8_t > mBytes;
+};
+
+// A save mapped into memory. Open() checks the header, and that every
+// section is aligned and inside the file. That's the whole load, sections
+// are never parsed or copied, only pointed into
+struct SaveFile
+{
+  SaveFile();
+  ~SaveFile();
+  SaveFile( const SaveFile& ) = delete;
+  SaveFile& operator = ( const SaveFile& ) = delete;
+
+  // Returns false if it's missing, from another version or malformed
+  bool Open( const char* path );
+  void Close();
+
+  // Null if there's no such section, or its elements aren't
+  // elementByteCount big, which catches structs that changed without the
+  // version going up
+  const void* GetSection( uint32_t tag, int elementByteCount, int* elementCount ) const;
+  template< typename T >
+  const T* GetSection( uint32_t tag, int* elementCount ) const
+  {
+    return ( const T* )GetSection( tag, sizeof( T ), elementCount );
+  }
+
+  PlatformMappedFile mFile;
+  const SaveHeader* mHeader;
+  const SaveSection* mSections;
+};
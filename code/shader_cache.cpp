@@ -0,0 +1,163 @@
+#include "shader_cache.h"
+#include "platform.h"
+#include <cstdio>
+#include <cstring>
+
+// Bump this when the file layout changes
+static const uint32_t shaderCacheVersion = 1;
+static const uint32_t shaderCacheMagic = 'S' | 'H' << 8 | 'D' << 16 | 'C' << 24;
+
+struct ShaderCacheHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint64_t bytecodeByteCount;
+};
+
+static uint64_t Fnv1a( uint64_t hash, const void* bytes, size_t byteCount )
+{
+  const uint8_t* data = ( const uint8_t* )bytes;
+  for( size_t i = 0; i < byteCount; ++i )
+  {
+    hash ^= data[ i ];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t HashShaderKey(
+  const char* source,
+  size_t sourceByteCount,
+  const char* entryPoint,
+  const char* target,
+  uint32_t flags,
+  const char* compilerName )
+{
+  // strings include their null so "ab" + "c" != "a" + "bc"
+  uint64_t hash = 14695981039346656037ull;
+  hash = Fnv1a( hash, &shaderCacheVersion, sizeof( shaderCacheVersion ) );
+  hash = Fnv1a( hash, source, sourceByteCount );
+  hash = Fnv1a( hash, entryPoint, std::strlen( entryPoint ) + 1 );
+  hash = Fnv1a( hash, target, std::strlen( target ) + 1 );
+  hash = Fnv1a( hash, &flags, sizeof( flags ) );
+  hash = Fnv1a( hash, compilerName, std::strlen( compilerName ) + 1 );
+  return hash;
+}
+
+ShaderCache::ShaderCache(
+  const char* directory,
+  const char* compilerName,
+  ShaderCompiler compiler,
+  void* compilerUserData )
+{
+  mDirectory = directory;
+  mCompilerName = compilerName;
+  mCompiler = compiler;
+  mCompilerUserData = compilerUserData;
+  mHitCount = 0;
+  mMissCount = 0;
+  PlatformCreateDirectory( directory );
+}
+
+std::string ShaderCache::GetPath( uint64_t key )
+{
+  return mDirectory + "/" + va( "%016llx.cso", ( unsigned long long )key );
+}
+
+static bool ReadCacheFile(
+  const std::string& path,
+  uint64_t key,
+  std::vector< char >* bytecode )
+{
+  FILE* file = std::fopen( path.c_str(), "rb" );
+  if( !file )
+    return false;
+  ShaderCacheHeader header;
+  bool isValid = std::fread( &header, sizeof( header ), 1, file ) == 1
+    && header.magic == shaderCacheMagic
+    && header.version == shaderCacheVersion
+    && header.key == key
+    && header.bytecodeByteCount > 0;
+  // The size is only trusted if it's what's left of the file, a truncated
+  // or corrupt entry is a miss rather than a huge allocation
+  if( isValid )
+  {
+    long headerEnd = std::ftell( file );
+    isValid = std::fseek( file, 0, SEEK_END ) == 0
+      && ( uint64_t )( std::ftell( file ) - headerEnd ) == header.bytecodeByteCount
+      && std::fseek( file, headerEnd, SEEK_SET ) == 0;
+  }
+  if( isValid )
+  {
+    bytecode->resize( ( size_t )header.bytecodeByteCount );
+    isValid = std::fread( bytecode->data(), 1, bytecode->size(), file ) == bytecode->size();
+  }
+  std::fclose( file );
+  return isValid;
+}
+
+// Written to a temporary first, so a crash halfway doesn't leave a
+// truncated file that looks like a hit
+static void WriteCacheFile(
+  const std::string& path,
+  uint64_t key,
+  const std::vector< char >& bytecode )
+{
+  std::string temporaryPath = path + ".tmp";
+  FILE* file = std::fopen( temporaryPath.c_str(), "wb" );
+  if( !file )
+    return;
+  ShaderCacheHeader header;
+  header.magic = shaderCacheMagic;
+  header.version = shaderCacheVersion;
+  header.key = key;
+  header.bytecodeByteCount = bytecode.size();
+  bool isWritten = std::fwrite( &header, sizeof( header ), 1, file ) == 1
+    && std::fwrite( bytecode.data(), 1, bytecode.size(), file ) == bytecode.size();
+  isWritten = std::fclose( file ) == 0 && isWritten;
+  if( !isWritten || !PlatformReplaceFile( temporaryPath.c_str(), path.c_str() ) )
+    std::remove( temporaryPath.c_str() );
+}
+
+bool ShaderCache::GetBytecode(
+  const char* source,
+  size_t sourceByteCount,
+  const char* sourceName,
+  const char* entryPoint,
+  const char* target,
+  uint32_t flags,
+  std::vector< char >* bytecode,
+  std::string* errors )
+{
+  uint64_t key = HashShaderKey(
+    source,
+    sourceByteCount,
+    entryPoint,
+    target,
+    flags,
+    mCompilerName.c_str() );
+  std::string path = GetPath( key );
+  if( ReadCacheFile( path, key, bytecode ) )
+  {
+    ++mHitCount;
+    return true;
+  }
+
+  ++mMissCount;
+  if( !mCompiler(
+    mCompilerUserData,
+    source,
+    sourceByteCount,
+    sourceName,
+    entryPoint,
+    target,
+    flags,
+    bytecode,
+    errors ) )
+    return false;
+
+  // A cache that can't be written just means compiling again next time
+  WriteCacheFile( path, key, *bytecode );
+  return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "utility.h"
+
+// Turns hlsl into bytecode. Returns false and fills in errors if it didn't compile.
+// Graphics passes D3DCompile, anything else ( eg. a stub off windows ) works too
+typedef bool( *ShaderCompiler )(
+  void* userData,
+  const char* source,
+  size_t sourceByteCount,
+  const char* sourceName,
+  const char* entryPoint,
+  const char* target,
+  uint32_t flags,
+  std::vector< char >* bytecode,
+  std::string* errors );
+
+// 64 bit FNV-1a of everything that changes the compiled output
+uint64_t HashShaderKey(
+  const char* source,
+  size_t sourceByteCount,
+  const char* entryPoint,
+  const char* target,
+  uint32_t flags,
+  const char* compilerName );
+
+// Compiled bytecode on disk, one file per key, so shaders only get compiled
+// the first time a given source + entry point + target + flags is seen
+struct ShaderCache
+{
+  // compilerName should change whenever the compiler does, eg. the dll name
+  ShaderCache(
+    const char* directory,
+    const char* compilerName,
+    ShaderCompiler compiler,
+    void* compilerUserData );
+
+  bool GetBytecode(
+    const char* source,
+    size_t sourceByteCount,
+    const char* sourceName,
+    const char* entryPoint,
+    const char* target,
+    uint32_t flags,
+    std::vector< char >* bytecode,
+    std::string* errors );
+
+  std::string GetPath( uint64_t key );
+
+  std::string mDirectory;
+  std::string mCompilerName;
+  ShaderCompiler mCompiler;
+  void* mCompilerUserData;
+  int mHitCount;
+  int mMissCount;
+};
@@ -0,0 +1,217 @@
+#include "snapshot.h"
+#include <emmintrin.h>
+#include <cstring>
+
+static const int snapshotBlockSize = 16;
+
+static int GetPaddedSize( int byteCount )
+{
+  return ( byteCount + snapshotBlockSize - 1 ) / snapshotBlockSize * snapshotBlockSize;
+}
+
+Snapshot::Snapshot()
+{
+  mSize = 0;
+  mReadOffset = 0;
+}
+
+void Snapshot::Clear()
+{
+  mSize = 0;
+  mReadOffset = 0;
+}
+
+void Snapshot::Write( const void* data, int byteCount )
+{
+  Assert( byteCount >= 0 );
+  int paddedSize = GetPaddedSize( byteCount );
+  int newSize = mSize + paddedSize;
+  if( newSize > ( int )mBytes.size() )
+    mBytes.resize( newSize > 2 * ( int )mBytes.size() ? newSize : 2 * mBytes.size() );
+  std::memcpy( mBytes.data() + mSize, data, byteCount );
+  std::memset( mBytes.data() + mSize + byteCount, 0, paddedSize - byteCount );
+  mSize = newSize;
+}
+
+void Snapshot::Read( void* data, int byteCount )
+{
+  Assert( byteCount >= 0 && mReadOffset + byteCount <= mSize );
+  std::memcpy( data, mBytes.data() + mReadOffset, byteCount );
+  mReadOffset += GetPaddedSize( byteCount );
+}
+
+// Runs of ( unchanged count, changed count ) as two int32s, then the changed
+// blocks xor'd. Trailing unchanged blocks don't get a run. Returns the
+// stored size, which is at most size + 8
+static int EncodeDelta( const uint8_t* previous, const uint8_t* current, int size, uint8_t* stored )
+{
+  int blockCount = size / snapshotBlockSize;
+  uint8_t* out = stored;
+  int block = 0;
+  while( block < blockCount )
+  {
+    int unchangedBegin = block;
+    while( block < blockCount )
+    {
+      __m128i a = _mm_loadu_si128( ( const __m128i* )( previous + block * snapshotBlockSize ) );
+      __m128i b = _mm_loadu_si128( ( const __m128i* )( current + block * snapshotBlockSize ) );
+      if( _mm_movemask_epi8( _mm_cmpeq_epi8( a, b ) ) != 0xffff )
+        break;
+      ++block;
+    }
+    if( block == blockCount )
+      break;
+
+    int32_t* run = ( int32_t* )out;
+    out += 2 * sizeof( int32_t );
+    int changedBegin = block;
+    while( block < blockCount )
+    {
+      __m128i a = _mm_loadu_si128( ( const __m128i* )( previous + block * snapshotBlockSize ) );
+      __m128i b = _mm_loadu_si128( ( const __m128i* )( current + block * snapshotBlockSize ) );
+      __m128i delta = _mm_xor_si128( a, b );
+      if( _mm_movemask_epi8( _mm_cmpeq_epi8( delta, _mm_setzero_si128() ) ) == 0xffff )
+        break;
+      _mm_storeu_si128( ( __m128i* )out, delta );
+      out += snapshotBlockSize;
+      ++block;
+    }
+    run[ 0 ] = changedBegin - unchangedBegin;
+    run[ 1 ] = block - changedBegin;
+  }
+  return ( int )( out - stored );
+}
+
+static void ApplyDelta( const uint8_t* stored, int storedSize, uint8_t* bytes )
+{
+  const uint8_t* in = stored;
+  const uint8_t* end = stored + storedSize;
+  while( in < end )
+  {
+    const int32_t* run = ( const int32_t* )in;
+    in += 2 * sizeof( int32_t );
+    bytes += run[ 0 ] * snapshotBlockSize;
+    for( int i = 0; i < run[ 1 ]; ++i )
+    {
+      __m128i delta = _mm_loadu_si128( ( const __m128i* )in );
+      __m128i value = _mm_loadu_si128( ( const __m128i* )bytes );
+      _mm_storeu_si128( ( __m128i* )bytes, _mm_xor_si128( value, delta ) );
+      in += snapshotBlockSize;
+      bytes += snapshotBlockSize;
+    }
+  }
+}
+
+// Whole frame, from the keyframe before it
+static void DecodeFrame( const SnapshotHistory& history, int frame, Snapshot* snapshot )
+{
+  int keyframe = frame;
+  while( !history.GetFrame( keyframe ).isKeyframe )
+    --keyframe;
+  const SnapshotHistory::Frame& stored = history.GetFrame( keyframe );
+  snapshot->Clear();
+  snapshot->Write( stored.bytes.data(), stored.snapshotSize );
+  for( int i = keyframe + 1; i <= frame; ++i )
+  {
+    const SnapshotHistory::Frame& delta = history.GetFrame( i );
+    ApplyDelta( delta.bytes.data(), delta.storedSize, snapshot->mBytes.data() );
+  }
+}
+
+SnapshotHistory::SnapshotHistory( int frameCapacity, int keyframeInterval )
+{
+  Assert( frameCapacity > 0 && keyframeInterval > 0 );
+  mFrames.resize( frameCapacity );
+  mFrameCount = 0;
+  mOldestFrame = 0;
+  mLastKeyframe = 0;
+  mKeyframeInterval = keyframeInterval;
+}
+
+SnapshotHistory::Frame& SnapshotHistory::GetFrame( int frame )
+{
+  return mFrames[ frame % mFrames.size() ];
+}
+
+const SnapshotHistory::Frame& SnapshotHistory::GetFrame( int frame ) const
+{
+  return mFrames[ frame % mFrames.size() ];
+}
+
+void SnapshotHistory::Push( const Snapshot& snapshot )
+{
+  int frameIndex = mFrameCount;
+  Frame& frame = GetFrame( frameIndex );
+  frame.snapshotSize = snapshot.mSize;
+  frame.isKeyframe = frameIndex == 0
+    || frameIndex - mLastKeyframe >= mKeyframeInterval
+    || snapshot.mSize != mNewest.mSize;
+  if( frame.isKeyframe )
+  {
+    if( ( int )frame.bytes.size() < snapshot.mSize )
+      frame.bytes.resize( snapshot.mSize );
+    std::memcpy( frame.bytes.data(), snapshot.mBytes.data(), snapshot.mSize );
+    frame.storedSize = snapshot.mSize;
+    mLastKeyframe = frameIndex;
+  }
+  else
+  {
+    int maxStoredSize = snapshot.mSize + 2 * sizeof( int32_t );
+    if( ( int )frame.bytes.size() < maxStoredSize )
+      frame.bytes.resize( maxStoredSize );
+    frame.storedSize = EncodeDelta(
+      mNewest.mBytes.data(),
+      snapshot.mBytes.data(),
+      snapshot.mSize,
+      frame.bytes.data() );
+  }
+  mNewest.Clear();
+  mNewest.Write( snapshot.mBytes.data(), snapshot.mSize );
+  ++mFrameCount;
+  if( mFrameCount - ( int )mFrames.size() > mOldestFrame )
+    mOldestFrame = mFrameCount - ( int )mFrames.size();
+}
+
+int SnapshotHistory::GetFrameCount() const
+{
+  int oldest = mOldestFrame;
+  while( oldest < mFrameCount && !GetFrame( oldest ).isKeyframe )
+    ++oldest;
+  return mFrameCount - oldest;
+}
+
+void SnapshotHistory::Restore( int framesBack, Snapshot* snapshot ) const
+{
+  Assert( framesBack >= 0 && framesBack < GetFrameCount() );
+  if( framesBack == 0 )
+  {
+    snapshot->Clear();
+    snapshot->Write( mNewest.mBytes.data(), mNewest.mSize );
+  }
+  else
+  {
+    DecodeFrame( *this, mFrameCount - 1 - framesBack, snapshot );
+  }
+  snapshot->mReadOffset = 0;
+}
+
+void SnapshotHistory::Discard( int count )
+{
+  // The newest has to stay, the next delta goes against it
+  Assert( count >= 0 && count < GetFrameCount() );
+  if( !count )
+    return;
+  mFrameCount -= count;
+  DecodeFrame( *this, mFrameCount - 1, &mNewest );
+  mLastKeyframe = mFrameCount - 1;
+  while( !GetFrame( mLastKeyframe ).isKeyframe )
+    --mLastKeyframe;
+}
+
+int SnapshotHistory::GetStoredByteCount() const
+{
+  int result = 0;
+  for( int i = mOldestFrame; i < mFrameCount; ++i )
+    result += GetFrame( i ).storedSize;
+  return result;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "utility.h"
+
+// One frame of simulation state, flat and pointer free. Systems write their
+// arrays in with a memcpy each and read them back in the same order, so a
+// snapshot can be copied anywhere, stored, and xor'd against the one before.
+//
+// Every write is padded with zeros to a multiple of 16 bytes, which keeps
+// the layout lined up from frame to frame and lets the deltas go 16 bytes
+// at a time
+struct Snapshot
+{
+  Snapshot();
+
+  // Forgets the contents but keeps the memory, so saving every frame stops
+  // allocating once it's big enough
+  void Clear();
+  void Write( const void* data, int byteCount );
+  void Read( void* data, int byteCount );
+
+  template< typename T >
+  void Write( const T& value )
+  {
+    Write( &value, sizeof( T ) );
+  }
+  template< typename T >
+  void Read( T* value )
+  {
+    Read( value, sizeof( T ) );
+  }
+
+  // Sized up to capacity, only [ 0, mSize ) is the snapshot
+  std::vector< uint8_t > mBytes;
+  int mSize;
+  int mReadOffset;
+};
+
+// The last frameCapacity snapshots, for rewinding and resimulating.
+//
+// Every keyframeInterval frames, and whenever the size changes, a frame is
+// stored whole. The rest are stored as the xor against the frame before,
+// with the runs of unchanged 16 byte blocks squeezed out. Restoring starts
+// from the keyframe before and applies the deltas after it
+struct SnapshotHistory
+{
+  SnapshotHistory( int frameCapacity, int keyframeInterval );
+
+  void Push( const Snapshot& snapshot );
+
+  // How many frames back can be restored, counting the newest. Frames from
+  // before the oldest keyframe still in the ring can't be
+  int GetFrameCount() const;
+
+  // framesBack 0 is the newest
+  void Restore( int framesBack, Snapshot* snapshot ) const;
+
+  // Forgets the newest count frames, so the next Push follows on from what
+  // is then the newest
+  void Discard( int count );
+
+  // Everything stored, keyframes and deltas
+  int GetStoredByteCount() const;
+
+  struct Frame
+  {
+    // Whole for a keyframe, runs of ( unchanged count, changed count,
+    // changed blocks ) otherwise, counting 16 byte blocks
+    std::vector< uint8_t > bytes;
+    int storedSize = 0;
+    int snapshotSize = 0;
+    bool isKeyframe = false;
+  };
+  Frame& GetFrame( int frame );
+  const Frame& GetFrame( int frame ) const;
+
+  std::vector< Frame > mFrames;
+  // The newest frame, whole, for the next delta to go against
+  Snapshot mNewest;
+  // Frames ever pushed, minus discarded ones. Frame i is in
+  // mFrames[ i % capacity ]
+  int mFrameCount;
+  // Discarding frees up slots without bringing older frames back, so this
+  // only goes up
+  int mOldestFrame;
+  int mLastKeyframe;
+  int mKeyframeInterval;
+};
@@ -0,0 +1,228 @@
+#include "spatial_hash.h"
+
+float GetSpatialHashCellSize( float maxRadius )
+{
+  return 2 * maxRadius;
+}
+
+SpatialHash::SpatialHash( float cellSize )
+{
+  Assert( cellSize > 0 );
+  mCellSize = cellSize;
+  mInvCellSize = 1 / cellSize;
+  mMaxRadius = 0;
+  mFirstFree = -1;
+  mCount = 0;
+  mBucketMask = 0;
+  Rehash( 1024 );
+}
+
+int SpatialHash::GetCount() const
+{
+  return mCount;
+}
+
+int SpatialHash::GetBucket( int cellX, int cellY ) const
+{
+  // Neighbors along x land in neighboring buckets, which keeps FindPairs()
+  // walking the buckets mostly in order
+  uint32_t hash = ( uint32_t )cellX + ( uint32_t )cellY * 19349663u;
+  return ( int )( hash & ( uint32_t )mBucketMask );
+}
+
+void SpatialHash::Link( SpatialHandle handle )
+{
+  Object& object = mObjects[ handle ];
+  int& head = mBuckets[ GetBucket( object.cellX, object.cellY ) ];
+  object.prev = -1;
+  object.next = head;
+  if( head != -1 )
+    mObjects[ head ].prev = handle;
+  head = handle;
+}
+
+void SpatialHash::Unlink( SpatialHandle handle )
+{
+  Object& object = mObjects[ handle ];
+  if( object.prev != -1 )
+    mObjects[ object.prev ].next = object.next;
+  else
+    mBuckets[ GetBucket( object.cellX, object.cellY ) ] = object.next;
+  if( object.next != -1 )
+    mObjects[ object.next ].prev = object.prev;
+}
+
+void SpatialHash::Rehash( int bucketCount )
+{
+  mBuckets.assign( bucketCount, -1 );
+  mBucketMask = bucketCount - 1;
+  for( int i = 0; i < ( int )mObjects.size(); ++i )
+    if( mObjects[ i ].isUsed )
+      Link( i );
+}
+
+SpatialHandle SpatialHash::Insert( Vector2 position, float radius )
+{
+  Assert( 2 * radius <= mCellSize );
+  if( radius > mMaxRadius )
+    mMaxRadius = radius;
+
+  SpatialHandle handle;
+  if( mFirstFree != -1 )
+  {
+    handle = mFirstFree;
+    mFirstFree = mObjects[ handle ].next;
+  }
+  else
+  {
+    handle = ( SpatialHandle )mObjects.size();
+    mObjects.push_back( Object() );
+  }
+  Object& object = mObjects[ handle ];
+  object.position = position;
+  object.radius = radius;
+  object.cellX = ( int )std::floor( position.x * mInvCellSize );
+  object.cellY = ( int )std::floor( position.y * mInvCellSize );
+  object.isUsed = true;
+  ++mCount;
+
+  // Keep the buckets at least as many as the objects, so lists stay short
+  if( mCount > ( int )mBuckets.size() )
+    Rehash( ( int )mBuckets.size() * 2 );
+  else
+    Link( handle );
+  return handle;
+}
+
+void SpatialHash::Move( SpatialHandle handle, Vector2 position )
+{
+  Object& object = mObjects[ handle ];
+  Assert( object.isUsed );
+  object.position = position;
+  int cellX = ( int )std::floor( position.x * mInvCellSize );
+  int cellY = ( int )std::floor( position.y * mInvCellSize );
+  if( cellX == object.cellX && cellY == object.cellY )
+    return;
+  Unlink( handle );
+  object.cellX = cellX;
+  object.cellY = cellY;
+  Link( handle );
+}
+
+void SpatialHash::Remove( SpatialHandle handle )
+{
+  Object& object = mObjects[ handle ];
+  Assert( object.isUsed );
+  Unlink( handle );
+  object.isUsed = false;
+  object.next = mFirstFree;
+  mFirstFree = handle;
+  --mCount;
+}
+
+static bool AreOverlapping( const SpatialHash::Object& a, const SpatialHash::Object& b )
+{
+  float distanceSq = Square( a.position.x - b.position.x ) + Square( a.position.y - b.position.y );
+  return distanceSq < Square( a.radius + b.radius );
+}
+
+void SpatialHash::FindPairs( std::vector< SpatialPair >* pairs )
+{
+  pairs->clear();
+
+  // Each object checks the rest of its own cell, and the 4 neighbors on one
+  // side. The other 4 neighbors check it, so each pair comes up once
+  const int neighborCount = 4;
+  const int neighborX[ neighborCount ] = { 1, 1, 0, -1 };
+  const int neighborY[ neighborCount ] = { 0, 1, 1, 1 };
+
+  int bucketCount = ( int )mBuckets.size();
+  for( int bucket = 0; bucket < bucketCount; ++bucket )
+  {
+    for( int i = mBuckets[ bucket ]; i != -1; i = mObjects[ i ].next )
+    {
+      const Object& object = mObjects[ i ];
+      for( int other = object.next; other != -1; other = mObjects[ other ].next )
+      {
+        const Object& o = mObjects[ other ];
+        if( o.cellX != object.cellX || o.cellY != object.cellY )
+          continue;
+        if( AreOverlapping( object, o ) )
+          pairs->push_back( SpatialPair{ i < other ? i : other, i < other ? other : i } );
+      }
+
+      for( int n = 0; n < neighborCount; ++n )
+      {
+        int cellX = object.cellX + neighborX[ n ];
+        int cellY = object.cellY + neighborY[ n ];
+        for( int other = mBuckets[ GetBucket( cellX, cellY ) ]; other != -1; other = mObjects[ other ].next )
+        {
+          const Object& o = mObjects[ other ];
+          if( o.cellX != cellX || o.cellY != cellY )
+            continue;
+          if( AreOverlapping( object, o ) )
+            pairs->push_back( SpatialPair{ i < other ? i : other, i < other ? other : i } );
+        }
+      }
+    }
+  }
+}
+
+template< typename Overlaps >
+void SpatialHash::QueryCells(
+  Vector2 min,
+  Vector2 max,
+  Overlaps overlaps,
+  std::vector< SpatialHandle >* results )
+{
+  results->clear();
+
+  // A circle can hang out of its cell by up to its radius
+  int minCellX = ( int )std::floor( ( min.x - mMaxRadius ) * mInvCellSize );
+  int minCellY = ( int )std::floor( ( min.y - mMaxRadius ) * mInvCellSize );
+  int maxCellX = ( int )std::floor( ( max.x + mMaxRadius ) * mInvCellSize );
+  int maxCellY = ( int )std::floor( ( max.y + mMaxRadius ) * mInvCellSize );
+
+  // Past a point, walking every object beats walking every cell
+  int64_t cellCount = ( int64_t )( maxCellX - minCellX + 1 ) * ( maxCellY - minCellY + 1 );
+  if( cellCount > ( int64_t )mObjects.size() )
+  {
+    for( int i = 0; i < ( int )mObjects.size(); ++i )
+      if( mObjects[ i ].isUsed && overlaps( mObjects[ i ] ) )
+        results->push_back( i );
+    return;
+  }
+
+  for( int cellY = minCellY; cellY <= maxCellY; ++cellY )
+  {
+    for( int cellX = minCellX; cellX <= maxCellX; ++cellX )
+    {
+      for( int other = mBuckets[ GetBucket( cellX, cellY ) ]; other != -1; other = mObjects[ other ].next )
+      {
+        const Object& o = mObjects[ other ];
+        if( o.cellX == cellX && o.cellY == cellY && overlaps( o ) )
+          results->push_back( other );
+      }
+    }
+  }
+}
+
+void SpatialHash::QueryRadius( Vector2 center, float radius, std::vector< SpatialHandle >* results )
+{
+  Vector2 extent( radius, radius );
+  QueryCells( center - extent, center + extent, [ & ]( const Object& o )
+  {
+    return Square( o.position.x - center.x ) + Square( o.position.y - center.y ) < Square( o.radius + radius );
+  }, results );
+}
+
+void SpatialHash::QueryAabb( Vector2 min, Vector2 max, std::vector< SpatialHandle >* results )
+{
+  QueryCells( min, max, [ & ]( const Object& o )
+  {
+    // Closest point of the box to the circle
+    float x = o.position.x < min.x ? min.x : o.position.x > max.x ? max.x : o.position.x;
+    float y = o.position.y < min.y ? min.y : o.position.y > max.y ? max.y : o.position.y;
+    return Square( o.position.x - x ) + Square( o.position.y - y ) < Square( o.radius );
+  }, results );
+}
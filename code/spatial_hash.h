@@ -0,0 +1,69 @@
+#pragma once
+#include "utility.h"
+
+typedef int SpatialHandle;
+
+struct SpatialPair
+{
+  SpatialHandle a;
+  SpatialHandle b;
+};
+
+// Uniform grid broadphase for circles, hashed so the world has no bounds.
+//
+// Each circle lives in the cell that holds its center. As long as no circle
+// is wider than a cell, anything overlapping it is in the same cell or one of
+// the 8 around it. GetSpatialHashCellSize() picks the cell size from the
+// biggest radius.
+//
+// Cells are intrusive lists through the objects, so insert, move and remove
+// are O(1) and nothing allocates unless the object count grows past what it
+// has seen before. Queries write into vectors the caller keeps around.
+struct SpatialHash
+{
+  SpatialHash( float cellSize );
+
+  SpatialHandle Insert( Vector2 position, float radius );
+  void Move( SpatialHandle handle, Vector2 position );
+  void Remove( SpatialHandle handle );
+
+  // Every overlapping pair once, with a < b. Clears pairs first
+  void FindPairs( std::vector< SpatialPair >* pairs );
+
+  // Everything that overlaps the circle or box. Clears results first
+  void QueryRadius( Vector2 center, float radius, std::vector< SpatialHandle >* results );
+  void QueryAabb( Vector2 min, Vector2 max, std::vector< SpatialHandle >* results );
+
+  int GetCount() const;
+
+  struct Object
+  {
+    Vector2 position;
+    float radius;
+    int cellX;
+    int cellY;
+    // Within the cell's bucket list, or the free list
+    int next;
+    int prev;
+    bool isUsed;
+  };
+
+  int GetBucket( int cellX, int cellY ) const;
+  void Link( SpatialHandle handle );
+  void Unlink( SpatialHandle handle );
+  void Rehash( int bucketCount );
+  template< typename Overlaps >
+  void QueryCells( Vector2 min, Vector2 max, Overlaps overlaps, std::vector< SpatialHandle >* results );
+
+  float mCellSize;
+  float mInvCellSize;
+  float mMaxRadius;
+  std::vector< Object > mObjects;
+  std::vector< int > mBuckets;
+  int mBucketMask;
+  int mFirstFree;
+  int mCount;
+};
+
+// Smallest cell that keeps every circle inside the 3x3 cells around its own
+float GetSpatialHashCellSize( float maxRadius );
@@ -4269,6 +4269,187 @@ static int stbi__paeth(int a, int b, int c)
 
 static stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+#ifdef STBI_SSE2
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// sse2 versions of the 8-bit row unfilters in stbi__create_png_image_raw below,
+// with output identical to the C loops there.
+//
+// up doesn't look to the left so it goes 16 bytes at a time (32 with avx2).
+// sub is a running sum along the row, done as a prefix sum over 16 bytes for
+// 1 and 4 channels. avg and paeth need the unfiltered pixel to the left before
+// they can do the next one, so for 3 and 4 channels they do a whole pixel per
+// step, and for 1 channel they stay on the C loops.
+
+static __m128i stbi__png_load_pixel(stbi_uc const *p, int n)
+{
+   int v;
+   if (n == 4) {
+      memcpy(&v, p, 4);
+      return _mm_cvtsi32_si128(v);
+   }
+   return _mm_cvtsi32_si128(p[0] | (p[1] << 8) | (p[2] << 16));
+}
+
+static void stbi__png_store_pixel(stbi_uc *p, __m128i v, int n)
+{
+   int x = _mm_cvtsi128_si32(v);
+   if (n == 4) {
+      memcpy(p, &x, 4);
+   } else {
+      p[0] = STBI__BYTECAST(x);
+      p[1] = STBI__BYTECAST(x >> 8);
+      p[2] = STBI__BYTECAST(x >> 16);
+   }
+}
+
+// count pixels of in_n channels from raw, written to cur as out_n channels:
+// in_n is 3 or 4, and out_n is either the same or 4 with alpha added. the
+// pixel left of cur is already done
+static void stbi__unfilter_pixels_sse2(stbi_uc *cur, stbi_uc const *prior, stbi_uc const *raw, int count, int filter, int in_n, int out_n)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i one = _mm_set1_epi8(1);
+   __m128i alpha = _mm_cvtsi32_si128(in_n != out_n ? (int) 0xff000000 : 0);
+   __m128i a = stbi__png_load_pixel(cur - out_n, out_n);
+   __m128i b, c, d;
+   int i;
+   switch (filter) {
+      case STBI__F_sub:
+      case STBI__F_paeth_first: // paeth with b and c 0 always picks a
+         for (i=0; i < count; ++i, cur += out_n, raw += in_n) {
+            a = _mm_add_epi8(stbi__png_load_pixel(raw, in_n), a);
+            stbi__png_store_pixel(cur, _mm_or_si128(a, alpha), out_n);
+         }
+         break;
+      case STBI__F_up:
+         for (i=0; i < count; ++i, cur += out_n, prior += out_n, raw += in_n) {
+            d = _mm_add_epi8(stbi__png_load_pixel(raw, in_n), stbi__png_load_pixel(prior, out_n));
+            stbi__png_store_pixel(cur, _mm_or_si128(d, alpha), out_n);
+         }
+         break;
+      case STBI__F_avg:
+      case STBI__F_avg_first:
+         // _mm_avg_epu8 rounds up where (a+b)>>1 rounds down, so take the odd bit back off
+         b = zero;
+         for (i=0; i < count; ++i, cur += out_n, prior += out_n, raw += in_n) {
+            if (filter == STBI__F_avg)
+               b = stbi__png_load_pixel(prior, out_n);
+            d = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(stbi__png_load_pixel(raw, in_n), d);
+            stbi__png_store_pixel(cur, _mm_or_si128(a, alpha), out_n);
+         }
+         break;
+      case STBI__F_paeth:
+         // in 16 bits, where a+b-c can't wrap. ties go to a, then b, like stbi__paeth
+         a = _mm_unpacklo_epi8(a, zero);
+         c = _mm_unpacklo_epi8(stbi__png_load_pixel(prior - out_n, out_n), zero);
+         for (i=0; i < count; ++i, cur += out_n, prior += out_n, raw += in_n) {
+            __m128i pa, pb, pc, smallest, is_a, is_b, nearest;
+            b = _mm_unpacklo_epi8(stbi__png_load_pixel(prior, out_n), zero);
+            pa = _mm_sub_epi16(b, c);   // p-a
+            pb = _mm_sub_epi16(a, c);   // p-b
+            pc = _mm_add_epi16(pa, pb); // p-c
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            is_a = _mm_cmpeq_epi16(smallest, pa);
+            is_b = _mm_cmpeq_epi16(smallest, pb);
+            nearest = _mm_or_si128(_mm_and_si128(is_b, b), _mm_andnot_si128(is_b, c));
+            nearest = _mm_or_si128(_mm_and_si128(is_a, a), _mm_andnot_si128(is_a, nearest));
+            d = _mm_add_epi8(stbi__png_load_pixel(raw, in_n), _mm_packus_epi16(nearest, nearest));
+            stbi__png_store_pixel(cur, _mm_or_si128(d, alpha), out_n);
+            a = _mm_unpacklo_epi8(d, zero);
+            c = b;
+         }
+         break;
+   }
+}
+
+static void stbi__unfilter_up_sse2(stbi_uc *cur, stbi_uc const *prior, stbi_uc const *raw, int nk)
+{
+   int k = 0;
+#ifdef __AVX2__
+   for (; k+32 <= nk; k += 32) {
+      __m256i r = _mm256_loadu_si256((__m256i const *) (raw + k));
+      __m256i p = _mm256_loadu_si256((__m256i const *) (prior + k));
+      _mm256_storeu_si256((__m256i *) (cur + k), _mm256_add_epi8(r, p));
+   }
+#endif
+   for (; k+16 <= nk; k += 16) {
+      __m128i r = _mm_loadu_si128((__m128i const *) (raw + k));
+      __m128i p = _mm_loadu_si128((__m128i const *) (prior + k));
+      _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(r, p));
+   }
+   for (; k < nk; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+
+// n is 1 or 4. the last pixel of each block is carried into the next in left
+static void stbi__unfilter_sub_sse2(stbi_uc *cur, stbi_uc const *raw, int nk, int n)
+{
+   __m128i left;
+   int k = 0;
+   if (n == 1) {
+      left = _mm_set1_epi8((char) cur[-1]);
+   } else {
+      int v;
+      memcpy(&v, cur - 4, 4);
+      left = _mm_set1_epi32(v);
+   }
+   for (; k+16 <= nk; k += 16) {
+      __m128i x = _mm_loadu_si128((__m128i const *) (raw + k));
+      if (n == 1) {
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+      }
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi8(x, left);
+      _mm_storeu_si128((__m128i *) (cur + k), x);
+      if (n == 1) {
+         // byte 15 into every byte
+         x = _mm_unpackhi_epi8(x, x);
+         x = _mm_shufflehi_epi16(x, 0xff);
+         left = _mm_shuffle_epi32(x, 0xff);
+      } else {
+         left = _mm_shuffle_epi32(x, 0xff);
+      }
+   }
+   for (; k < nk; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + cur[k-n]);
+}
+
+// unfilters one row after its first pixel, count pixels of 8-bit samples.
+// returns 0 for the rows it leaves to the C loops
+static int stbi__unfilter_row_sse2(stbi_uc *cur, stbi_uc const *prior, stbi_uc const *raw, int count, int filter, int in_n, int out_n)
+{
+   if (in_n == out_n) {
+      if (filter == STBI__F_up) {
+         stbi__unfilter_up_sse2(cur, prior, raw, count*in_n);
+         return 1;
+      }
+      if ((filter == STBI__F_sub || filter == STBI__F_paeth_first) && (in_n == 1 || in_n == 4)) {
+         stbi__unfilter_sub_sse2(cur, raw, count*in_n, in_n);
+         return 1;
+      }
+   }
+   if (filter == STBI__F_none || in_n < 3)
+      return 0;
+   // constant channel counts, so the compiler can drop the per-pixel checks
+   if (in_n == 4)
+      stbi__unfilter_pixels_sse2(cur, prior, raw, count, filter, 4, 4);
+   else if (out_n == 3)
+      stbi__unfilter_pixels_sse2(cur, prior, raw, count, filter, 3, 3);
+   else
+      stbi__unfilter_pixels_sse2(cur, prior, raw, count, filter, 3, 4);
+   return 1;
+}
+#endif
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4282,6 +4463,16 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+   int (*unfilter_row)(stbi_uc *cur, stbi_uc const *prior, stbi_uc const *raw, int count, int filter, int in_n, int out_n) = NULL;
+
+#ifdef STBI_SSE2
+   if (depth == 8 && stbi__sse2_available())
+      unfilter_row = stbi__unfilter_row_sse2;
+#endif
+#ifdef STBI_NEON
+   // no neon row unfilters yet; one with the same signature as
+   // stbi__unfilter_row_sse2 gets picked here
+#endif
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
    a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4352,6 +4543,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          #define STBI__CASE(f) \
              case f:     \
                 for (k=0; k < nk; ++k)
+         if (!unfilter_row || !unfilter_row(cur, prior, raw, width - 1, filter, img_n, out_n))
          switch (filter) {
             // "none" filter turns into a memcpy here; make that explicit.
             case STBI__F_none:         memcpy(cur, raw, nk); break;
@@ -4366,6 +4558,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          raw += nk;
       } else {
          STBI_ASSERT(img_n+1 == out_n);
+         if (unfilter_row && unfilter_row(cur, prior, raw, x - 1, filter, img_n, out_n))
+            raw += (x-1)*filter_bytes;
+         else {
          #define STBI__CASE(f) \
              case f:     \
                 for (i=x-1; i >= 1; --i, cur[filter_bytes]=255,raw+=filter_bytes,cur+=output_bytes,prior+=output_bytes) \
@@ -4380,6 +4575,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
             STBI__CASE(STBI__F_paeth_first)  { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k- output_bytes],0,0)); } break;
          }
          #undef STBI__CASE
+         }
 
          // the loop above sets the high byte of the pixels' alpha, but for
          // 16 bit png files we also need the low byte set. we'll do that here.
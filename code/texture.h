@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+// Formats and textures without the rest of graphics.h, so code that only
+// passes textures around builds without d3d
+struct ID3D11Texture2D;
+struct ID3D11ShaderResourceView;
+
+enum class Format
+{
+  r32g32b32a32float,
+  r32g32b32float,
+  r32g32float,
+
+  r16uint,
+
+  r8g8b8a8unorm,
+  r8unorm,
+
+  // 4x4 blocks, see block_compression.h
+  bc1unorm,
+  bc3unorm,
+  bc4unorm,
+};
+
+struct Texture
+{
+  ID3D11Texture2D* texture;
+  ID3D11ShaderResourceView* srv;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+  Format format;
+};
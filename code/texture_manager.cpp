@@ -0,0 +1,206 @@
+#include "texture_manager.h"
+#include "profiler.h"
+
+TextureManager::TextureManager( TextureUploader uploader, size_t budgetBytes )
+{
+  mUploader = uploader;
+  mBudgetBytes = budgetBytes;
+  mResidentBytes = 0;
+  mLruHead = -1;
+  mLruTail = -1;
+  mFrame = 0;
+  mQuitLoader = false;
+  mLoader = std::thread( &TextureManager::LoaderThread, this );
+}
+
+TextureManager::~TextureManager()
+{
+  {
+    std::lock_guard< std::mutex > lock( mMutex );
+    mQuitLoader = true;
+  }
+  mWakeLoader.notify_one();
+  mLoader.join();
+  for( Entry& entry : mEntries )
+    if( entry.state == State::Resident )
+      mUploader.free( mUploader.userData, entry.texture );
+}
+
+TextureHandle TextureManager::Register(
+  const char* name,
+  TextureLoader loader,
+  void* userData )
+{
+  Entry entry;
+  entry.name = name;
+  entry.loader = loader;
+  entry.userData = userData;
+  entry.state = State::Unloaded;
+  entry.texture = Texture();
+  entry.byteCount = 0;
+  entry.lastUsedFrame = 0;
+  entry.prev = -1;
+  entry.next = -1;
+  mEntries.push_back( entry );
+  return ( TextureHandle )mEntries.size() - 1;
+}
+
+void TextureManager::Require( TextureHandle handle )
+{
+  Entry& entry = mEntries[ handle ];
+  if( entry.state == State::Resident )
+    return;
+
+  // If it was already queued, the async result gets dropped in Update()
+  MipChain mipChain;
+  Format format;
+  if( !entry.loader( entry.userData, &mipChain, &format ) )
+    HandleErrorGracefully( va( "Failed to load texture %s", entry.name.c_str() ) );
+  MakeResident( handle, mipChain, format );
+  mFrameStats.bytesStreamed += mipChain.bytes.size();
+}
+
+bool TextureManager::Acquire( TextureHandle handle, Texture* texture )
+{
+  Entry& entry = mEntries[ handle ];
+  entry.lastUsedFrame = mFrame;
+  if( entry.state == State::Resident )
+  {
+    ++mFrameStats.hits;
+    Unlink( handle );
+    LinkFront( handle );
+    *texture = entry.texture;
+    return true;
+  }
+
+  ++mFrameStats.misses;
+  if( entry.state == State::Unloaded )
+  {
+    entry.state = State::Loading;
+    LoadRequest request;
+    request.handle = handle;
+    request.loader = entry.loader;
+    request.userData = entry.userData;
+    {
+      std::lock_guard< std::mutex > lock( mMutex );
+      mRequests.push_back( request );
+    }
+    mWakeLoader.notify_one();
+  }
+  return false;
+}
+
+void TextureManager::Update()
+{
+  std::vector< LoadResult > results;
+  {
+    std::lock_guard< std::mutex > lock( mMutex );
+    results.swap( mResults );
+  }
+  for( LoadResult& result : results )
+  {
+    Entry& entry = mEntries[ result.handle ];
+    if( entry.state != State::Loading )
+      continue;
+    if( !result.succeeded )
+    {
+      // try again next time someone asks for it
+      entry.state = State::Unloaded;
+      continue;
+    }
+    MakeResident( result.handle, result.mipChain, result.format );
+    mFrameStats.bytesStreamed += result.mipChain.bytes.size();
+  }
+
+  // Least recently used goes first, but never anything drawn this frame
+  while( mResidentBytes > mBudgetBytes && mLruTail != -1 )
+  {
+    if( mEntries[ mLruTail ].lastUsedFrame == mFrame )
+      break;
+    Evict( mLruTail );
+  }
+
+  mLastFrameStats = mFrameStats;
+  mTotalStats.hits += mFrameStats.hits;
+  mTotalStats.misses += mFrameStats.misses;
+  mTotalStats.evictions += mFrameStats.evictions;
+  mTotalStats.bytesStreamed += mFrameStats.bytesStreamed;
+  mFrameStats = TextureManagerStats();
+  ++mFrame;
+}
+
+void TextureManager::MakeResident(
+  TextureHandle handle,
+  MipChain& mipChain,
+  Format format )
+{
+  PROFILE_SCOPE( "TextureManager::MakeResident" );
+  Entry& entry = mEntries[ handle ];
+  entry.byteCount = mUploader.create( mUploader.userData, mipChain, format, &entry.texture );
+  entry.state = State::Resident;
+  entry.lastUsedFrame = mFrame;
+  mResidentBytes += entry.byteCount;
+  LinkFront( handle );
+}
+
+void TextureManager::Evict( TextureHandle handle )
+{
+  Entry& entry = mEntries[ handle ];
+  Unlink( handle );
+  mUploader.free( mUploader.userData, entry.texture );
+  mResidentBytes -= entry.byteCount;
+  entry.state = State::Unloaded;
+  ++mFrameStats.evictions;
+}
+
+void TextureManager::LinkFront( TextureHandle handle )
+{
+  Entry& entry = mEntries[ handle ];
+  entry.prev = -1;
+  entry.next = mLruHead;
+  if( mLruHead != -1 )
+    mEntries[ mLruHead ].prev = handle;
+  mLruHead = handle;
+  if( mLruTail == -1 )
+    mLruTail = handle;
+}
+
+void TextureManager::Unlink( TextureHandle handle )
+{
+  Entry& entry = mEntries[ handle ];
+  if( entry.prev != -1 )
+    mEntries[ entry.prev ].next = entry.next;
+  else
+    mLruHead = entry.next;
+  if( entry.next != -1 )
+    mEntries[ entry.next ].prev = entry.prev;
+  else
+    mLruTail = entry.prev;
+  entry.prev = -1;
+  entry.next = -1;
+}
+
+void TextureManager::LoaderThread()
+{
+  ProfilerSetThreadName( "Texture loader" );
+  for( ;; )
+  {
+    LoadRequest request;
+    {
+      std::unique_lock< std::mutex > lock( mMutex );
+      mWakeLoader.wait( lock, [ this ]() { return mQuitLoader || !mRequests.empty(); } );
+      if( mQuitLoader )
+        return;
+      request = mRequests.front();
+      mRequests.erase( mRequests.begin() );
+    }
+
+    PROFILE_SCOPE( "TextureManager load" );
+    LoadResult result;
+    result.handle = request.handle;
+    result.succeeded = request.loader( request.userData, &result.mipChain, &result.format );
+
+    std::lock_guard< std::mutex > lock( mMutex );
+    mResults.push_back( std::move( result ) );
+  }
+}
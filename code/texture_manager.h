@@ -0,0 +1,110 @@
+#pragma once
+#include "texture.h"
+#include "mipmap.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Fills in the cpu side of a texture. Runs on the loader thread, so it must
+// not touch Graphics. Return false if it failed
+typedef bool( *TextureLoader )( void* userData, MipChain* mipChain, Format* format );
+
+typedef int TextureHandle;
+
+// Where the textures go on the gpu. Called on the thread that calls the
+// manager. create returns the video memory the texture takes up
+struct TextureUploader
+{
+  size_t( *create )( void* userData, MipChain& mipChain, Format format, Texture* texture );
+  void( *free )( void* userData, Texture texture );
+  void* userData;
+};
+
+struct TextureManagerStats
+{
+  int hits = 0;
+  int misses = 0;
+  int evictions = 0;
+  size_t bytesStreamed = 0;
+};
+
+// Keeps the textures that were used recently on the gpu, within a budget.
+//
+// Acquire() a texture every frame that it's drawn. If it isn't resident, a
+// load gets queued and Acquire() returns false, so the caller skips the draw
+// ( or draws something else ) until it shows up.
+struct TextureManager
+{
+  TextureManager( TextureUploader uploader, size_t budgetBytes );
+  ~TextureManager();
+
+  TextureHandle Register( const char* name, TextureLoader loader, void* userData );
+
+  // Loads on the calling thread right now. For things that can't pop in
+  void Require( TextureHandle handle );
+
+  bool Acquire( TextureHandle handle, Texture* texture );
+
+  // Call once per frame. Uploads finished loads, evicts down to the budget
+  // and starts a new frame of stats
+  void Update();
+
+  size_t mBudgetBytes;
+  size_t mResidentBytes;
+  TextureManagerStats mFrameStats;
+  TextureManagerStats mLastFrameStats;
+  TextureManagerStats mTotalStats;
+
+  enum class State
+  {
+    Unloaded,
+    Loading,
+    Resident,
+  };
+  struct Entry
+  {
+    std::string name;
+    TextureLoader loader;
+    void* userData;
+    State state;
+    Texture texture;
+    size_t byteCount;
+    uint64_t lastUsedFrame;
+
+    // Intrusive lru list of resident entries, front is most recently used
+    int prev;
+    int next;
+  };
+  struct LoadRequest
+  {
+    TextureHandle handle;
+    TextureLoader loader;
+    void* userData;
+  };
+  struct LoadResult
+  {
+    TextureHandle handle;
+    bool succeeded;
+    Format format;
+    MipChain mipChain;
+  };
+
+  void MakeResident( TextureHandle handle, MipChain& mipChain, Format format );
+  void Evict( TextureHandle handle );
+  void LinkFront( TextureHandle handle );
+  void Unlink( TextureHandle handle );
+  void LoaderThread();
+
+  TextureUploader mUploader;
+  std::vector< Entry > mEntries;
+  int mLruHead;
+  int mLruTail;
+  uint64_t mFrame;
+
+  std::thread mLoader;
+  std::mutex mMutex;
+  std::condition_variable mWakeLoader;
+  bool mQuitLoader;
+  std::vector< LoadRequest > mRequests;
+  std::vector< LoadResult > mResults;
+};
@@ -0,0 +1,278 @@
+#include "tile_map.h"
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+// How far a box can sink into a wall, in tiles. Positions lose precision as
+// they get far from the origin, this has to stay above that
+static const float kSkin = 0.01f;
+
+static int LowestBit( uint64_t bits )
+{
+#if defined( _MSC_VER )
+  unsigned long index;
+  _BitScanForward64( &index, bits );
+  return ( int )index;
+#else
+  return __builtin_ctzll( bits );
+#endif
+}
+
+static int HighestBit( uint64_t bits )
+{
+#if defined( _MSC_VER )
+  unsigned long index;
+  _BitScanReverse64( &index, bits );
+  return ( int )index;
+#else
+  return 63 - __builtin_clzll( bits );
+#endif
+}
+
+// Bits lo to hi, inclusive
+static uint64_t RangeMask( int lo, int hi )
+{
+  return ( ~0ull >> ( 63 - hi ) ) & ( ~0ull << lo );
+}
+
+static int MinInt( int a, int b )
+{
+  return a < b ? a : b;
+}
+
+static int MaxInt( int a, int b )
+{
+  return a > b ? a : b;
+}
+
+static int FloorToInt( float value )
+{
+  return ( int )std::floor( value );
+}
+
+static int CeilToInt( float value )
+{
+  return ( int )std::ceil( value );
+}
+
+TileMap::TileMap( int tileCountX, int tileCountY, float tileSize, Vector2 origin )
+{
+  Assert( tileCountX > 0 && tileCountY > 0 && tileSize > 0 );
+  mTileCountX = tileCountX;
+  mTileCountY = tileCountY;
+  mTileSize = tileSize;
+  mOrigin = origin;
+  mChunkCountX = ( tileCountX + 63 ) / 64;
+  mChunkCountY = ( tileCountY + 63 ) / 64;
+  mChunkIndexes.assign( mChunkCountX * mChunkCountY, -1 );
+}
+
+int TileMap::GetChunkIndex( int chunkX, int chunkY ) const
+{
+  return mChunkIndexes[ chunkX + chunkY * mChunkCountX ];
+}
+
+TileChunk* TileMap::GetOrAddChunk( int chunkX, int chunkY )
+{
+  int& index = mChunkIndexes[ chunkX + chunkY * mChunkCountX ];
+  if( index == -1 )
+  {
+    index = ( int )mChunks.size();
+    // Value initialized, so all empty
+    mChunks.push_back( TileChunk() );
+  }
+  return &mChunks[ index ];
+}
+
+bool TileMap::IsSolid( int x, int y ) const
+{
+  if( x < 0 || y < 0 || x >= mTileCountX || y >= mTileCountY )
+    return true;
+  int index = GetChunkIndex( x >> 6, y >> 6 );
+  if( index == -1 )
+    return false;
+  return ( mChunks[ index ].rows[ y & 63 ] >> ( x & 63 ) ) & 1;
+}
+
+void TileMap::SetSolid( int x, int y, bool isSolid )
+{
+  FillRect( x, y, x, y, isSolid );
+}
+
+void TileMap::FillRect( int minX, int minY, int maxX, int maxY, bool isSolid )
+{
+  minX = MaxInt( minX, 0 );
+  minY = MaxInt( minY, 0 );
+  maxX = MinInt( maxX, mTileCountX - 1 );
+  maxY = MinInt( maxY, mTileCountY - 1 );
+  for( int chunkY = minY >> 6; chunkY <= maxY >> 6; ++chunkY )
+  {
+    for( int chunkX = minX >> 6; chunkX <= maxX >> 6; ++chunkX )
+    {
+      int loX = MaxInt( minX, chunkX * 64 ) & 63;
+      int hiX = MinInt( maxX, chunkX * 64 + 63 ) & 63;
+      int loY = MaxInt( minY, chunkY * 64 ) & 63;
+      int hiY = MinInt( maxY, chunkY * 64 + 63 ) & 63;
+      if( !isSolid && GetChunkIndex( chunkX, chunkY ) == -1 )
+        continue;
+      TileChunk* chunk = GetOrAddChunk( chunkX, chunkY );
+      uint64_t rowMask = RangeMask( loX, hiX );
+      uint64_t columnMask = RangeMask( loY, hiY );
+      for( int y = loY; y <= hiY; ++y )
+        chunk->rows[ y ] = isSolid ? chunk->rows[ y ] | rowMask : chunk->rows[ y ] & ~rowMask;
+      for( int x = loX; x <= hiX; ++x )
+        chunk->columns[ x ] = isSolid ? chunk->columns[ x ] | columnMask : chunk->columns[ x ] & ~columnMask;
+    }
+  }
+}
+
+uint64_t TileMap::GatherLines( int axis, int chunkAlong, int lineMin, int lineMax ) const
+{
+  // Solid anywhere in the lines means solid in the result, so a box many
+  // tiles tall costs one or per row instead of a test per tile
+  uint64_t bits = 0;
+  for( int chunkAcross = lineMin >> 6; chunkAcross <= lineMax >> 6; ++chunkAcross )
+  {
+    int index = axis == 0
+      ? GetChunkIndex( chunkAlong, chunkAcross )
+      : GetChunkIndex( chunkAcross, chunkAlong );
+    if( index == -1 )
+      continue;
+    const TileChunk& chunk = mChunks[ index ];
+    const uint64_t* lines = axis == 0 ? chunk.rows : chunk.columns;
+    int lo = MaxInt( lineMin, chunkAcross * 64 ) & 63;
+    int hi = MinInt( lineMax, chunkAcross * 64 + 63 ) & 63;
+    for( int line = lo; line <= hi; ++line )
+      bits |= lines[ line ];
+  }
+  return bits;
+}
+
+bool TileMap::FindSolid( int axis, int lineMin, int lineMax, int from, int to, int* found ) const
+{
+  int countAlong = axis == 0 ? mTileCountX : mTileCountY;
+  int countAcross = axis == 0 ? mTileCountY : mTileCountX;
+  if( lineMin < 0 || lineMax >= countAcross || from < 0 || from >= countAlong )
+  {
+    *found = from;
+    return true;
+  }
+
+  if( from <= to )
+  {
+    int end = MinInt( to, countAlong - 1 );
+    for( int chunkAlong = from >> 6; chunkAlong <= end >> 6; ++chunkAlong )
+    {
+      int lo = MaxInt( from, chunkAlong * 64 ) & 63;
+      int hi = MinInt( end, chunkAlong * 64 + 63 ) & 63;
+      uint64_t bits = GatherLines( axis, chunkAlong, lineMin, lineMax ) & RangeMask( lo, hi );
+      if( bits )
+      {
+        *found = chunkAlong * 64 + LowestBit( bits );
+        return true;
+      }
+    }
+    *found = countAlong;
+    return to >= countAlong;
+  }
+
+  int end = MaxInt( to, 0 );
+  for( int chunkAlong = from >> 6; chunkAlong >= end >> 6; --chunkAlong )
+  {
+    int lo = MaxInt( end, chunkAlong * 64 ) & 63;
+    int hi = MinInt( from, chunkAlong * 64 + 63 ) & 63;
+    uint64_t bits = GatherLines( axis, chunkAlong, lineMin, lineMax ) & RangeMask( lo, hi );
+    if( bits )
+    {
+      *found = chunkAlong * 64 + HighestBit( bits );
+      return true;
+    }
+  }
+  *found = -1;
+  return to < 0;
+}
+
+float TileMap::SweepAxis( int axis, const Aabb& aabb, float distance, bool* isBlocked ) const
+{
+  *isBlocked = false;
+  if( distance == 0 )
+    return 0;
+
+  // In tiles from here on
+  int across = 1 - axis;
+  float invTileSize = 1 / mTileSize;
+  float minAlong = ( aabb.min[ axis ] - mOrigin[ axis ] ) * invTileSize;
+  float maxAlong = ( aabb.max[ axis ] - mOrigin[ axis ] ) * invTileSize;
+  float minAcross = ( aabb.min[ across ] - mOrigin[ across ] ) * invTileSize;
+  float maxAcross = ( aabb.max[ across ] - mOrigin[ across ] ) * invTileSize;
+  float tiles = distance * invTileSize;
+
+  // The lines the box covers, not counting ones it only touches
+  int lineMin = FloorToInt( minAcross + kSkin );
+  int lineMax = CeilToInt( maxAcross - kSkin ) - 1;
+
+  // The tiles the leading edge sweeps over, starting past the ones the box
+  // is already in
+  int tile;
+  if( distance > 0 )
+  {
+    int from = CeilToInt( maxAlong - kSkin );
+    int to = CeilToInt( maxAlong + tiles - kSkin ) - 1;
+    if( to < from || !FindSolid( axis, lineMin, lineMax, from, to, &tile ) )
+      return distance;
+    *isBlocked = true;
+    float moved = tile * mTileSize + mOrigin[ axis ] - aabb.max[ axis ];
+    return moved > 0 ? moved : 0;
+  }
+  int from = FloorToInt( minAlong + kSkin ) - 1;
+  int to = FloorToInt( minAlong + tiles + kSkin );
+  if( to > from || !FindSolid( axis, lineMin, lineMax, from, to, &tile ) )
+    return distance;
+  *isBlocked = true;
+  float moved = ( tile + 1 ) * mTileSize + mOrigin[ axis ] - aabb.min[ axis ];
+  return moved < 0 ? moved : 0;
+}
+
+static const uint32_t tileMapSizeTag = SaveTag( 'T', 'S', 'I', 'Z' );
+static const uint32_t tileChunkIndexesTag = SaveTag( 'T', 'C', 'I', 'X' );
+static const uint32_t tileChunksTag = SaveTag( 'T', 'C', 'H', 'K' );
+
+void TileMap::WriteSave( SaveWriter* writer ) const
+{
+  int size[ 2 ] = { mTileCountX, mTileCountY };
+  writer->AddSection( tileMapSizeTag, size, 2 );
+  writer->AddSection( tileChunkIndexesTag, mChunkIndexes.data(), ( int )mChunkIndexes.size() );
+  writer->AddSection( tileChunksTag, mChunks.data(), ( int )mChunks.size() );
+}
+
+bool TileMap::ReadSave( const SaveFile& save )
+{
+  int sizeCount;
+  int indexCount;
+  int chunkCount;
+  const int* size = save.GetSection< int >( tileMapSizeTag, &sizeCount );
+  const int* indexes = save.GetSection< int >( tileChunkIndexesTag, &indexCount );
+  const TileChunk* chunks = save.GetSection< TileChunk >( tileChunksTag, &chunkCount );
+  if( !size || sizeCount != 2 || size[ 0 ] != mTileCountX || size[ 1 ] != mTileCountY
+    || !indexes || indexCount != ( int )mChunkIndexes.size() || !chunks )
+    return false;
+  for( int i = 0; i < indexCount; ++i )
+  {
+    if( indexes[ i ] < -1 || indexes[ i ] >= chunkCount )
+      return false;
+  }
+  mChunkIndexes.assign( indexes, indexes + indexCount );
+  mChunks.assign( chunks, chunks + chunkCount );
+  return true;
+}
+
+TileSweep TileMap::SweepAabb( const Aabb& aabb, Vector2 delta ) const
+{
+  TileSweep result;
+  result.delta.x = SweepAxis( 0, aabb, delta.x, &result.isBlockedX );
+  Aabb moved = aabb;
+  moved.min.x += result.delta.x;
+  moved.max.x += result.delta.x;
+  result.delta.y = SweepAxis( 1, moved, delta.y, &result.isBlockedY );
+  return result;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "aabb_tree.h"
+#include "save_file.h"
+
+// 64x64 tiles, one bit each. Stored both ways round, so a sweep along
+// either axis can or whole lines of tiles together
+struct TileChunk
+{
+  // Bit x of rows[ y ] and bit y of columns[ x ] are both tile ( x, y )
+  uint64_t rows[ 64 ];
+  uint64_t columns[ 64 ];
+};
+
+// How far a box got before it ran into a solid tile
+struct TileSweep
+{
+  Vector2 delta;
+  bool isBlockedX;
+  bool isBlockedY;
+};
+
+// Solid / empty tiles for the room, tile ( 0, 0 ) has its bottom left corner
+// at origin. Everything outside the map is solid.
+//
+// Chunks that were never written to aren't stored, so a big room only costs
+// memory where it has walls
+struct TileMap
+{
+  TileMap( int tileCountX, int tileCountY, float tileSize, Vector2 origin );
+
+  bool IsSolid( int x, int y ) const;
+  void SetSolid( int x, int y, bool isSolid );
+  // The tiles from ( minX, minY ) to ( maxX, maxY ), inclusive
+  void FillRect( int minX, int minY, int maxX, int maxY, bool isSolid );
+
+  // Moves the box along x and then along y, stopping each axis at the first
+  // solid tile. The box should start out of the walls. It's allowed to sink
+  // in by a hundredth of a tile, so a box resting on a wall stays put
+  TileSweep SweepAabb( const Aabb& aabb, Vector2 delta ) const;
+
+  // The chunks go in as they are. Reading returns false and leaves the map
+  // alone unless the save is for a map the same size, and every chunk index
+  // in it is -1 or one of its chunks
+  void WriteSave( SaveWriter* writer ) const;
+  bool ReadSave( const SaveFile& save );
+
+  int GetChunkIndex( int chunkX, int chunkY ) const;
+  TileChunk* GetOrAddChunk( int chunkX, int chunkY );
+  // The first solid tile going from -> to along axis ( 0 is x ) within the
+  // lines lineMin to lineMax of the other axis. Off the map counts as solid
+  bool FindSolid( int axis, int lineMin, int lineMax, int from, int to, int* found ) const;
+  uint64_t GatherLines( int axis, int chunkAlong, int lineMin, int lineMax ) const;
+  float SweepAxis( int axis, const Aabb& aabb, float distance, bool* isBlocked ) const;
+
+  int mTileCountX;
+  int mTileCountY;
+  float mTileSize;
+  Vector2 mOrigin;
+  int mChunkCountX;
+  int mChunkCountY;
+  // -1 for chunks that are all empty
+  std::vector< int > mChunkIndexes;
+  std::vector< TileChunk > mChunks;
+};
@@ -1,6 +1,12 @@
 #include "utility.h"
 #include "platform.h"
-#include <stdarg.h> // vsprintf 
+#include "profiler.h"
+#include <stdarg.h> // va_list
+#include <stdio.h> // vsnprintf
+#include <emmintrin.h>
+#if defined( __AVX__ )
+#include <immintrin.h>
+#endif
 
 void HandleErrorGracefully( const char* message )
 {
@@ -14,348 +20,186 @@ void HandleErrorGracefully( const char* message )
   exit( -1 );
 }
 
-// is this legit?
-Vector4::Vector4( float x, float y, float z, float w ) :x( x ), y( y ), z( z ), w( w ) { }
-
-Vector4 Vector4::operator*( float scale )
-{
-  return Vector4( x * scale, y * scale, z * scale, w * scale );
-}
-
-Vector4 Vector4::operator/( float scale )
-{
-  return Vector4( x / scale, y / scale, z / scale, w / scale );
-}
-
-float& Vector4::operator[]( int index )
-{
-  return *( &x + index );
-
-}
-
-Vector4 Vector4::operator-()
-{
-  return Vector4( -x, -y, -z, -w );
-}
-
-Vector3::Vector3( float x, float y, float z ) : x( x ), y( y ), z( z ){ }
-
-Vector3 Vector3::operator-()
-{
-  return Vector3( -x, -y, -z );
-}
-
-float& Vector3::operator[]( int index )
-{
-  return *( &x + index );
-}
-
-Vector2::Vector2( float x, float y ) : x( x ), y( y ){ }
-
-Vector2 Vector2::operator-()
-{
-  return Vector2( -x, -y );
-}
-
-Vector2& Vector2::operator*=( float scale )
-{
-  x *= scale;
-  y *= scale;
-  return *this;
-}
-
-Vector2& Vector2::operator/=( float scale )
-{
-  x /= scale;
-  y /= scale;
-  return *this;
-}
-
-Vector2 Vector2::operator/( float scale )
-{
-  return Vector2( x / scale, y / scale );
-}
-
-bool Vector2::IsZero()
-{
-  return x == 0 && y == 0;
-}
-
-float Dot( Vector2 lhs, Vector2 rhs )
-{
-  return lhs.x * rhs.x + lhs.y * rhs.y;
-}
-
-float Vector2::Length()
-{
-  return std::sqrt( Square( x ) + Square( y ) );
-}
-
-float& Vector2::operator[]( int index )
-{
-  return *( &x + index );
-}
-
-Vector2& Vector2::operator+=( Vector2 rhs )
-{
-  x += rhs.x;
-  y += rhs.y;
-  return *this;
-}
-
-Vector2 operator*( float scale, Vector2 vector )
-{
-  return Vector2(
-    scale * vector.x,
-    scale * vector.y );
-}
-
-Vector2 operator*( Vector2 vector, float scale )
-{
-  return Vector2(
-    scale * vector.x,
-    scale * vector.y );
-}
-
-
-Color4::Color4( float red, float green, float blue, float alpha )
-{
-  r = red;
-  g = green;
-  b = blue;
-  a = alpha;
-}
-
-float& Color4::operator[]( int index )
-{
-  return *( &r + index );
-
-}
-
-template< typename T, int N >
-T MatrixMultiply( T lhs, T rhs )
+// Row r of lhs * rhs is lhs[ r ][ 0 ] * rhs row 0 + ... + lhs[ r ][ 3 ] * rhs row 3.
+// The adds happen in the same order as MatrixMultiply, so the results match
+// it exactly ( as long as the compiler doesn't contract them into fmas )
+static void Matrix4MultiplySSE( const float* lhs, const float* rhs, float* out )
 {
-  T result;
-  for( int r = 0; r < N; ++r )
+  __m128 rhs0 = _mm_loadu_ps( rhs + 0 );
+  __m128 rhs1 = _mm_loadu_ps( rhs + 4 );
+  __m128 rhs2 = _mm_loadu_ps( rhs + 8 );
+  __m128 rhs3 = _mm_loadu_ps( rhs + 12 );
+  __m128 rows[ 4 ];
+  for( int r = 0; r < 4; ++r )
   {
-    for( int c = 0; c < N; ++c )
-    {
-      float dot = 0;
-      for( int i = 0; i < N; ++i )
-      {
-        dot += lhs[ r ][ i ] * rhs[ i ][ c ];
-      }
-      result[ r ][ c ] = dot;
-    }
+    const float* l = lhs + r * 4;
+    __m128 row = _mm_mul_ps( _mm_set1_ps( l[ 0 ] ), rhs0 );
+    row = _mm_add_ps( row, _mm_mul_ps( _mm_set1_ps( l[ 1 ] ), rhs1 ) );
+    row = _mm_add_ps( row, _mm_mul_ps( _mm_set1_ps( l[ 2 ] ), rhs2 ) );
+    row = _mm_add_ps( row, _mm_mul_ps( _mm_set1_ps( l[ 3 ] ), rhs3 ) );
+    rows[ r ] = row;
   }
-  return result;
-}
-
-Matrix2::Matrix2(
-  float m00, float m01,
-  float m10, float m11 )
-{
-  values[ 0 ] = m00;
-  values[ 1 ] = m01;
-  values[ 2 ] = m10;
-  values[ 3 ] = m11;
-}
-
-Matrix2 Matrix2::Rotate( float radians )
-{
-  float cos = std::cos( radians );
-  float sin = std::sin( radians );
-  return Rotate( cos, sin );
-}
-
-Matrix2 Matrix2::Rotate( float cos, float sin )
-{
-  return Matrix2(
-    cos, -sin,
-    sin, cos );
-}
-
-float* Matrix2::operator[]( int index )
-{
-  return values + index * 2;
-}
-
-Matrix2 Matrix2::operator*( Matrix2 rhs )
-{
-  return MatrixMultiply< Matrix2, 2 >( *this, rhs );
-}
-
-Matrix2 Matrix2::Identity()
-{
-  return Matrix2(
-    1, 0,
-    0, 1 );
-}
-
-Matrix2 Matrix2::Scale( float value )
-{
-  return Matrix2(
-    value, 0,
-    0, value );
-}
-
-Matrix2 Matrix2::Scale( float scaleX, float scaleY )
-{
-  return Matrix2(
-    scaleX, 0,
-    0, scaleY );
-}
-
-
-Matrix3::Matrix3(
-  float m00, float m01, float m02,
-  float m10, float m11, float m12,
-  float m20, float m21, float m22 )
-{
-  values[ 0 ] = m00;
-  values[ 1 ] = m01;
-  values[ 2 ] = m02;
-  values[ 3 ] = m10;
-  values[ 4 ] = m11;
-  values[ 5 ] = m12;
-  values[ 6 ] = m20;
-  values[ 7 ] = m21;
-  values[ 8 ] = m22;
+  // stored after all the loads so out may alias lhs or rhs
+  for( int r = 0; r < 4; ++r )
+    _mm_storeu_ps( out + r * 4, rows[ r ] );
+}
+
+#if defined( __AVX__ )
+// Same as Matrix4MultiplySSE, two rows per register
+static void Matrix4MultiplyAVX( const float* lhs, const float* rhs, float* out )
+{
+  __m256 rhs0 = _mm256_broadcast_ps( ( const __m128* )( rhs + 0 ) );
+  __m256 rhs1 = _mm256_broadcast_ps( ( const __m128* )( rhs + 4 ) );
+  __m256 rhs2 = _mm256_broadcast_ps( ( const __m128* )( rhs + 8 ) );
+  __m256 rhs3 = _mm256_broadcast_ps( ( const __m128* )( rhs + 12 ) );
+  __m256 l01 = _mm256_loadu_ps( lhs + 0 );
+  __m256 l23 = _mm256_loadu_ps( lhs + 8 );
+  __m256 rows[ 2 ];
+  __m256 ls[ 2 ] = { l01, l23 };
+  for( int i = 0; i < 2; ++i )
+  {
+    __m256 l = ls[ i ];
+    __m256 row = _mm256_mul_ps( _mm256_permute_ps( l, 0x00 ), rhs0 );
+    row = _mm256_add_ps( row, _mm256_mul_ps( _mm256_permute_ps( l, 0x55 ), rhs1 ) );
+    row = _mm256_add_ps( row, _mm256_mul_ps( _mm256_permute_ps( l, 0xaa ), rhs2 ) );
+    row = _mm256_add_ps( row, _mm256_mul_ps( _mm256_permute_ps( l, 0xff ), rhs3 ) );
+    rows[ i ] = row;
+  }
+  _mm256_storeu_ps( out + 0, rows[ 0 ] );
+  _mm256_storeu_ps( out + 8, rows[ 1 ] );
 }
+#endif
 
-Matrix3::Matrix3( Matrix2 m )
+static void Matrix4Multiply( const float* lhs, const float* rhs, float* out )
 {
-  *this = Matrix3(
-    m[ 0 ][ 0 ], m[ 0 ][ 1 ], 0.0f,
-    m[ 1 ][ 0 ], m[ 1 ][ 1 ], 0.0f,
-    0.0f, 0.0f, 1.0f );
+#if defined( __AVX__ )
+  Matrix4MultiplyAVX( lhs, rhs, out );
+#else
+  Matrix4MultiplySSE( lhs, rhs, out );
+#endif
 }
 
-Matrix3 Matrix3::Identity()
+Matrix4 Matrix4::operator*( const Matrix4& rhs ) const
 {
-  return Matrix3(
-    1, 0, 0,
-    0, 1, 0,
-    0, 0, 1 );
+  Matrix4 result;
+  Matrix4Multiply( values, rhs.values, result.values );
+  return result;
 }
 
-
-
-float* Matrix3::operator[]( int index )
+void ComposeMatrices( const Matrix4* lhs, const Matrix4* rhs, Matrix4* out, int count )
 {
-  return values + 3 * index;
+  for( int i = 0; i < count; ++i )
+    Matrix4Multiply( lhs[ i ].values, rhs[ i ].values, out[ i ].values );
 }
 
-Matrix3 Matrix3::operator*( Matrix3 rhs )
+Affine2 Affine2::Inverse() const
 {
-  return MatrixMultiply< Matrix3, 3 >( *this, rhs );
+  const float* m = values;
+  float determinant = m[ 0 ] * m[ 4 ] - m[ 1 ] * m[ 3 ];
+  Assert( determinant != 0 );
+  float invDet = 1.0f / determinant;
+  float i00 = m[ 4 ] * invDet;
+  float i01 = -m[ 1 ] * invDet;
+  float i10 = -m[ 3 ] * invDet;
+  float i11 = m[ 0 ] * invDet;
+  return Affine2(
+    i00, i01, -( i00 * m[ 2 ] + i01 * m[ 5 ] ),
+    i10, i11, -( i10 * m[ 2 ] + i11 * m[ 5 ] ) );
 }
 
-Matrix4::Matrix4(
-  float m00, float m01, float m02, float m03,
-  float m10, float m11, float m12, float m13,
-  float m20, float m21, float m22, float m23,
-  float m30, float m31, float m32, float m33 )
+void TransformPoints( Affine2 transform, const Vector2* points, Vector2* out, int count )
 {
-  int index = 0;
-  values[ index++ ] = m00;
-  values[ index++ ] = m01;
-  values[ index++ ] = m02;
-  values[ index++ ] = m03;
-
-  values[ index++ ] = m10;
-  values[ index++ ] = m11;
-  values[ index++ ] = m12;
-  values[ index++ ] = m13;
-
-  values[ index++ ] = m20;
-  values[ index++ ] = m21;
-  values[ index++ ] = m22;
-  values[ index++ ] = m23;
-
-  values[ index++ ] = m30;
-  values[ index++ ] = m31;
-  values[ index++ ] = m32;
-  values[ index++ ] = m33;
+  // locals so the compiler knows out doesn't overwrite the transform
+  float m00 = transform.values[ 0 ];
+  float m01 = transform.values[ 1 ];
+  float m02 = transform.values[ 2 ];
+  float m10 = transform.values[ 3 ];
+  float m11 = transform.values[ 4 ];
+  float m12 = transform.values[ 5 ];
+  for( int i = 0; i < count; ++i )
+  {
+    float x = points[ i ].x;
+    float y = points[ i ].y;
+    out[ i ].x = m00 * x + m01 * y + m02;
+    out[ i ].y = m10 * x + m11 * y + m12;
+  }
 }
 
-Matrix4::Matrix4( Matrix2 matrix )
+void ComposeAffines( const Affine2* lhs, const Affine2* rhs, Affine2* out, int count )
 {
-  *this = Matrix4(
-    matrix[ 0 ][ 0 ], matrix[ 0 ][ 1 ], 0, 0,
-    matrix[ 1 ][ 0 ], matrix[ 1 ][ 1 ], 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1 );
+  for( int i = 0; i < count; ++i )
+  {
+    Affine2 a = lhs[ i ];
+    out[ i ] = a * rhs[ i ];
+  }
 }
 
-Matrix4::Matrix4( Matrix3 matrix )
+// m * v = column 0 * v.x + ... + column 3 * v.w, which adds in the same order
+// as a dot product of each row with v
+static __m128 Matrix4TimesVector( const __m128* columns, __m128 v )
 {
-  *this = Matrix4(
-    matrix[ 0 ][ 0 ], matrix[ 0 ][ 1 ], matrix[ 0 ][ 1 ], 0,
-    matrix[ 1 ][ 0 ], matrix[ 1 ][ 1 ], matrix[ 1 ][ 2 ], 0,
-    matrix[ 2 ][ 0 ], matrix[ 2 ][ 1 ], matrix[ 2 ][ 2 ], 0,
-    0, 0, 0, 1 );
+  __m128 result = _mm_mul_ps( columns[ 0 ], _mm_shuffle_ps( v, v, 0x00 ) );
+  result = _mm_add_ps( result, _mm_mul_ps( columns[ 1 ], _mm_shuffle_ps( v, v, 0x55 ) ) );
+  result = _mm_add_ps( result, _mm_mul_ps( columns[ 2 ], _mm_shuffle_ps( v, v, 0xaa ) ) );
+  result = _mm_add_ps( result, _mm_mul_ps( columns[ 3 ], _mm_shuffle_ps( v, v, 0xff ) ) );
+  return result;
 }
 
-float* Matrix4::operator[]( int index )
+static void LoadColumns( const Matrix4& m, __m128* columns )
 {
-  return values + index * 4;
-}
-Matrix4 Matrix4::Identity()
-{
-  return Matrix4(
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1 );
+  columns[ 0 ] = _mm_loadu_ps( m.values + 0 );
+  columns[ 1 ] = _mm_loadu_ps( m.values + 4 );
+  columns[ 2 ] = _mm_loadu_ps( m.values + 8 );
+  columns[ 3 ] = _mm_loadu_ps( m.values + 12 );
+  _MM_TRANSPOSE4_PS( columns[ 0 ], columns[ 1 ], columns[ 2 ], columns[ 3 ] );
 }
 
-Matrix4 Matrix4::operator*( Matrix4 rhs )
-{
-  return MatrixMultiply< Matrix4, 4 >( *this, rhs );
-}
-Matrix4 Matrix4::Translate( float x, float y )
-{
-  return Matrix4(
-    1, 0, 0, x,
-    0, 1, 0, y,
-    0, 0, 1, 0,
-    0, 0, 0, 1 );
-}
-Matrix4 Matrix4::Translate( Vector2 pos )
+Vector4 operator*( const Matrix4& lhs, Vector4 rhs )
 {
-  return Translate( pos.x, pos.y );
+  __m128 columns[ 4 ];
+  LoadColumns( lhs, columns );
+  Vector4 result;
+  _mm_storeu_ps( &result.x, Matrix4TimesVector( columns, _mm_loadu_ps( &rhs.x ) ) );
+  return result;
 }
 
-Vector4 operator*( Matrix4 lhs, Vector4 rhs )
+Vector4 operator*( Vector4 lhs, const Matrix4& rhs )
 {
-  int N = 4;
+  // v * m = v.x * row 0 + ... + v.w * row 3
+  __m128 rows[ 4 ] = {
+    _mm_loadu_ps( rhs.values + 0 ),
+    _mm_loadu_ps( rhs.values + 4 ),
+    _mm_loadu_ps( rhs.values + 8 ),
+    _mm_loadu_ps( rhs.values + 12 ) };
   Vector4 result;
-  for( int r = 0; r < N; ++r )
-  {
-    float dot = 0;
-    for( int i = 0; i < N; ++i )
-    {
-      dot += lhs[ r ][ i ] * rhs[ i ];
-    }
-    result[ r ] = dot;
-  }
+  _mm_storeu_ps( &result.x, Matrix4TimesVector( rows, _mm_loadu_ps( &lhs.x ) ) );
   return result;
 }
-Vector4 operator*( Vector4 lhs, Matrix4 rhs )
+
+void TransformVectors( Matrix4 transform, const Vector4* vectors, Vector4* out, int count )
 {
-  Vector4 result;
-  int N = 4;
-  for( int c = 0; c < N; ++c )
+  __m128 columns[ 4 ];
+  LoadColumns( transform, columns );
+  int i = 0;
+#if defined( __AVX__ )
   {
-    float dot = 0;
-    for( int i = 0; i < N; ++i )
+    __m256 c0 = _mm256_set_m128( columns[ 0 ], columns[ 0 ] );
+    __m256 c1 = _mm256_set_m128( columns[ 1 ], columns[ 1 ] );
+    __m256 c2 = _mm256_set_m128( columns[ 2 ], columns[ 2 ] );
+    __m256 c3 = _mm256_set_m128( columns[ 3 ], columns[ 3 ] );
+    for( ; i + 2 <= count; i += 2 )
     {
-      dot += lhs[ i ] * rhs[ i ][ c ];
+      __m256 v = _mm256_loadu_ps( &vectors[ i ].x );
+      __m256 result = _mm256_mul_ps( c0, _mm256_permute_ps( v, 0x00 ) );
+      result = _mm256_add_ps( result, _mm256_mul_ps( c1, _mm256_permute_ps( v, 0x55 ) ) );
+      result = _mm256_add_ps( result, _mm256_mul_ps( c2, _mm256_permute_ps( v, 0xaa ) ) );
+      result = _mm256_add_ps( result, _mm256_mul_ps( c3, _mm256_permute_ps( v, 0xff ) ) );
+      _mm256_storeu_ps( &out[ i ].x, result );
     }
-    result[ c ] = dot;
   }
-  return result;
+#endif
+  for( ; i < count; ++i )
+    _mm_storeu_ps( &out[ i ].x, Matrix4TimesVector( columns, _mm_loadu_ps( &vectors[ i ].x ) ) );
 }
 
 TemporaryMemory::TemporaryMemory( unsigned byteCount )
@@ -365,6 +209,7 @@ TemporaryMemory::TemporaryMemory( unsigned byteCount )
 
 TemporaryMemory::TemporaryMemory( const char* path )
 {
+  PROFILE_SCOPE( "TemporaryMemory load" );
   std::ifstream ifs( path, std::ifstream::binary );
   if( !ifs.is_open() )
     HandleErrorGracefully( path );
@@ -382,10 +227,10 @@ TemporaryMemory::~TemporaryMemory()
 
 const char* va( const char* format, ... )
 {
-  static char buffer[ 512 ];
+  static thread_local char buffer[ 512 ];
   va_list args;
   va_start( args, format );
-  vsprintf_s( buffer, format, args );
+  vsnprintf( buffer, sizeof( buffer ), format, args );
   va_end( args );
   return buffer;
 }
@@ -25,6 +25,8 @@ enum TacKey
   Interact,
   Debug,
   Menu,
+  Rewind,
+  Overlay,
 
   Count,
 };
@@ -57,46 +59,72 @@ struct Input
   bool mQuitGameRequested = false;
   float width;
   float height;
+  // Client area pixels, y goes down
+  float mouseX = 0;
+  float mouseY = 0;
   std::set< TacKey > keysDownCurr;
   std::set< TacKey > keysDownPrev;
 };
 
+template< typename T >
+constexpr T Square( T t )
+{
+  return t * t;
+}
+
+constexpr int Clamp( int value, int lo, int hi )
+{
+  return value < lo ? lo : value > hi ? hi : value;
+}
+
+// The math types below are header only so they inline everywhere, and
+// constexpr so constant geometry and transforms can be built at compile time.
+// The ones that call into libm or simd are inline, but not constexpr.
+// constexpr here is C++11's, which is all vs2015 has: a single return, no
+// loops, locals or assignments
 struct Vector2
 {
-  Vector2(){ x = y = 0; };
-  Vector2( float x, float y );
-  Vector2 operator-();
-  Vector2& operator += ( Vector2 rhs );
-  Vector2& operator *= ( float scale );
-  Vector2& operator /= ( float scale );
-  Vector2 operator/ ( float scale );
-  bool IsZero();
-  float Length();
-  float& operator[]( int index );
+  constexpr Vector2() : x( 0 ), y( 0 ) {}
+  constexpr Vector2( float x, float y ) : x( x ), y( y ) {}
+  constexpr Vector2 operator-() const { return Vector2( -x, -y ); }
+  constexpr Vector2 operator+( Vector2 rhs ) const { return Vector2( x + rhs.x, y + rhs.y ); }
+  constexpr Vector2 operator-( Vector2 rhs ) const { return Vector2( x - rhs.x, y - rhs.y ); }
+  constexpr Vector2 operator/( float scale ) const { return Vector2( x / scale, y / scale ); }
+  Vector2& operator+=( Vector2 rhs ) { x += rhs.x; y += rhs.y; return *this; }
+  Vector2& operator*=( float scale ) { x *= scale; y *= scale; return *this; }
+  Vector2& operator/=( float scale ) { x /= scale; y /= scale; return *this; }
+  constexpr bool IsZero() const { return x == 0 && y == 0; }
+  float Length() const { return std::sqrt( Square( x ) + Square( y ) ); }
+  float& operator[]( int index ) { return *( &x + index ); }
+  float operator[]( int index ) const { return *( &x + index ); }
   float x;
   float y;
 };
-float Dot( Vector2 lhs, Vector2 rhs );
-Vector2 operator*( float scale, Vector2 vector );
-Vector2 operator*( Vector2 vector, float scale );
+constexpr float Dot( Vector2 lhs, Vector2 rhs ) { return lhs.x * rhs.x + lhs.y * rhs.y; }
+constexpr Vector2 operator*( float scale, Vector2 vector ) { return Vector2( scale * vector.x, scale * vector.y ); }
+constexpr Vector2 operator*( Vector2 vector, float scale ) { return Vector2( scale * vector.x, scale * vector.y ); }
+
 struct Vector3
 {
-  Vector3(){};
-  Vector3( float x, float y, float z );
-  Vector3 operator-();
-  float& operator[]( int index );
+  constexpr Vector3() : x( 0 ), y( 0 ), z( 0 ) {}
+  constexpr Vector3( float x, float y, float z ) : x( x ), y( y ), z( z ) {}
+  constexpr Vector3 operator-() const { return Vector3( -x, -y, -z ); }
+  float& operator[]( int index ) { return *( &x + index ); }
+  float operator[]( int index ) const { return *( &x + index ); }
   float x;
   float y;
   float z;
 };
+
 struct Vector4
 {
-  Vector4(){};
-  Vector4( float x, float y, float z, float w );
-  Vector4 operator -();
-  Vector4 operator *( float scale );
-  Vector4 operator /( float scale );
-  float& operator[]( int index );
+  constexpr Vector4() : x( 0 ), y( 0 ), z( 0 ), w( 0 ) {}
+  constexpr Vector4( float x, float y, float z, float w ) : x( x ), y( y ), z( z ), w( w ) {}
+  constexpr Vector4 operator-() const { return Vector4( -x, -y, -z, -w ); }
+  constexpr Vector4 operator*( float scale ) const { return Vector4( x * scale, y * scale, z * scale, w * scale ); }
+  constexpr Vector4 operator/( float scale ) const { return Vector4( x / scale, y / scale, z / scale, w / scale ); }
+  float& operator[]( int index ) { return *( &x + index ); }
+  float operator[]( int index ) const { return *( &x + index ); }
   float x;
   float y;
   float z;
@@ -105,72 +133,265 @@ struct Vector4
 
 struct Color4
 {
-  Color4(){};
-  Color4( float red, float green, float blue, float alpha );
-  float& operator[]( int index );
+  constexpr Color4() : r( 0 ), g( 0 ), b( 0 ), a( 0 ) {}
+  constexpr Color4( float red, float green, float blue, float alpha ) : r( red ), g( green ), b( blue ), a( alpha ) {}
+  float& operator[]( int index ) { return *( &r + index ); }
+  float operator[]( int index ) const { return *( &r + index ); }
   float r;
   float g;
   float b;
   float a;
 };
 
+// Element [ index / N ][ index % N ] of lhs * rhs, both row major. Recurses
+// instead of looping to stay constexpr, adding in the same order as
+// MatrixMultiply
+template< typename T, int N >
+constexpr float MatrixProductElement( const T& lhs, const T& rhs, int index, int i = 0, float dot = 0 )
+{
+  return i == N
+    ? dot
+    : MatrixProductElement< T, N >( lhs, rhs, index, i + 1,
+      dot + lhs.values[ index / N * N + i ] * rhs.values[ i * N + index % N ] );
+}
+
+// Row major, T needs operator[] to return a row. The loop version, for
+// products that don't need to happen at compile time
+template< typename T, int N >
+T MatrixMultiply( const T& lhs, const T& rhs )
+{
+  T result;
+  for( int r = 0; r < N; ++r )
+  {
+    for( int c = 0; c < N; ++c )
+    {
+      float dot = 0;
+      for( int i = 0; i < N; ++i )
+      {
+        dot += lhs[ r ][ i ] * rhs[ i ][ c ];
+      }
+      result[ r ][ c ] = dot;
+    }
+  }
+  return result;
+}
+
 // NOTE:
 //   HLSL assumes column major unless otherwise specified with
 //   #pragma pack_matrix( row_major )
 struct Matrix2
 {
-  Matrix2(){};
-  Matrix2(
+  constexpr Matrix2() : values{} {}
+  constexpr Matrix2(
     float m00, float m01,
-    float m10, float m11 );
-  static Matrix2 Identity();
-  static Matrix2 Scale( float value );
-  static Matrix2 Scale( float scaleX, float scaleY );
-  static Matrix2 Rotate( float radians );
-  static Matrix2 Rotate( float cos, float sin );
-  float* operator[]( int index );
-  Matrix2 operator*( Matrix2 rhs );
+    float m10, float m11 ) : values{ m00, m01, m10, m11 } {}
+  static constexpr Matrix2 Identity()
+  {
+    return Matrix2(
+      1, 0,
+      0, 1 );
+  }
+  static constexpr Matrix2 Scale( float value ) { return Scale( value, value ); }
+  static constexpr Matrix2 Scale( float scaleX, float scaleY )
+  {
+    return Matrix2(
+      scaleX, 0,
+      0, scaleY );
+  }
+  static Matrix2 Rotate( float radians ) { return Rotate( std::cos( radians ), std::sin( radians ) ); }
+  static constexpr Matrix2 Rotate( float cos, float sin )
+  {
+    return Matrix2(
+      cos, -sin,
+      sin, cos );
+  }
+  float* operator[]( int index ) { return values + index * 2; }
+  constexpr const float* operator[]( int index ) const { return values + index * 2; }
+  constexpr Matrix2 operator*( const Matrix2& rhs ) const
+  {
+    return Matrix2(
+      MatrixProductElement< Matrix2, 2 >( *this, rhs, 0 ),
+      MatrixProductElement< Matrix2, 2 >( *this, rhs, 1 ),
+      MatrixProductElement< Matrix2, 2 >( *this, rhs, 2 ),
+      MatrixProductElement< Matrix2, 2 >( *this, rhs, 3 ) );
+  }
   float values[ 2 * 2 ];
 };
+
 struct Matrix3
 {
-  Matrix3(){};
-  Matrix3( Matrix2 m );
-  Matrix3(
+  constexpr Matrix3() : values{} {}
+  constexpr Matrix3( const Matrix2& m ) : values{
+    m.values[ 0 ], m.values[ 1 ], 0,
+    m.values[ 2 ], m.values[ 3 ], 0,
+    0, 0, 1 } {}
+  constexpr Matrix3(
     float m00, float m01, float m02,
     float m10, float m11, float m12,
-    float m20, float m21, float m22 );
-  static Matrix3 Identity();
-  float* operator[]( int index );
-  Matrix3 operator*( Matrix3 rhs );
+    float m20, float m21, float m22 ) : values{
+      m00, m01, m02,
+      m10, m11, m12,
+      m20, m21, m22 } {}
+  static constexpr Matrix3 Identity()
+  {
+    return Matrix3(
+      1, 0, 0,
+      0, 1, 0,
+      0, 0, 1 );
+  }
+  float* operator[]( int index ) { return values + index * 3; }
+  constexpr const float* operator[]( int index ) const { return values + index * 3; }
+  constexpr Matrix3 operator*( const Matrix3& rhs ) const
+  {
+    return Matrix3(
+      MatrixProductElement< Matrix3, 3 >( *this, rhs, 0 ),
+      MatrixProductElement< Matrix3, 3 >( *this, rhs, 1 ),
+      MatrixProductElement< Matrix3, 3 >( *this, rhs, 2 ),
+      MatrixProductElement< Matrix3, 3 >( *this, rhs, 3 ),
+      MatrixProductElement< Matrix3, 3 >( *this, rhs, 4 ),
+      MatrixProductElement< Matrix3, 3 >( *this, rhs, 5 ),
+      MatrixProductElement< Matrix3, 3 >( *this, rhs, 6 ),
+      MatrixProductElement< Matrix3, 3 >( *this, rhs, 7 ),
+      MatrixProductElement< Matrix3, 3 >( *this, rhs, 8 ) );
+  }
   float values[ 3 * 3 ];
 };
+
+// 2d affine transform, ie. the top two rows of a Matrix3
+//   | m00 m01 m02 |
+//   | m10 m11 m12 |
+// where the last column is the translation. Composes in 12 multiply-adds
+// instead of the 64 a Matrix4 takes, so build with this and only expand
+// to a Matrix4 when uploading
+struct Affine2
+{
+  constexpr Affine2() : values{} {}
+  constexpr Affine2( const Matrix2& linear, Vector2 translation ) : values{
+    linear.values[ 0 ], linear.values[ 1 ], translation.x,
+    linear.values[ 2 ], linear.values[ 3 ], translation.y } {}
+  constexpr Affine2(
+    float m00, float m01, float m02,
+    float m10, float m11, float m12 ) : values{
+      m00, m01, m02,
+      m10, m11, m12 } {}
+  static constexpr Affine2 Identity()
+  {
+    return Affine2(
+      1, 0, 0,
+      0, 1, 0 );
+  }
+  static constexpr Affine2 Translate( Vector2 pos )
+  {
+    return Affine2(
+      1, 0, pos.x,
+      0, 1, pos.y );
+  }
+  static constexpr Affine2 Scale( float value ) { return Scale( value, value ); }
+  static constexpr Affine2 Scale( float scaleX, float scaleY )
+  {
+    return Affine2(
+      scaleX, 0, 0,
+      0, scaleY, 0 );
+  }
+  static Affine2 Rotate( float radians ) { return Affine2( Matrix2::Rotate( radians ), Vector2( 0, 0 ) ); }
+  // Translate( pos ) * Rotate( radians ) * Scale( scale ), without the multiplies
+  static Affine2 TranslateRotateScale( Vector2 pos, float radians, Vector2 scale )
+  {
+    float cos = std::cos( radians );
+    float sin = std::sin( radians );
+    return Affine2(
+      cos * scale.x, -sin * scale.y, pos.x,
+      sin * scale.x, cos * scale.y, pos.y );
+  }
+  constexpr Affine2 operator*( const Affine2& rhs ) const
+  {
+    return Affine2(
+      values[ 0 ] * rhs.values[ 0 ] + values[ 1 ] * rhs.values[ 3 ],
+      values[ 0 ] * rhs.values[ 1 ] + values[ 1 ] * rhs.values[ 4 ],
+      values[ 0 ] * rhs.values[ 2 ] + values[ 1 ] * rhs.values[ 5 ] + values[ 2 ],
+      values[ 3 ] * rhs.values[ 0 ] + values[ 4 ] * rhs.values[ 3 ],
+      values[ 3 ] * rhs.values[ 1 ] + values[ 4 ] * rhs.values[ 4 ],
+      values[ 3 ] * rhs.values[ 2 ] + values[ 4 ] * rhs.values[ 5 ] + values[ 5 ] );
+  }
+  Affine2 Inverse() const;
+  constexpr Vector2 TransformPoint( Vector2 point ) const
+  {
+    return Vector2(
+      values[ 0 ] * point.x + values[ 1 ] * point.y + values[ 2 ],
+      values[ 3 ] * point.x + values[ 4 ] * point.y + values[ 5 ] );
+  }
+  constexpr Vector2 TransformVector( Vector2 vector ) const
+  {
+    return Vector2(
+      values[ 0 ] * vector.x + values[ 1 ] * vector.y,
+      values[ 3 ] * vector.x + values[ 4 ] * vector.y );
+  }
+  float values[ 2 * 3 ];
+};
+
+// out[ i ] = transform * points[ i ], out may alias points
+void TransformPoints( Affine2 transform, const Vector2* points, Vector2* out, int count );
+// out[ i ] = lhs[ i ] * rhs[ i ], out may alias either
+void ComposeAffines( const Affine2* lhs, const Affine2* rhs, Affine2* out, int count );
+
 struct Matrix4
 {
-  Matrix4(){};
-  Matrix4( Matrix2 matrix );
-  Matrix4( Matrix3 matrix );
-  Matrix4(
+  constexpr Matrix4() : values{} {}
+  constexpr Matrix4( const Matrix2& m ) : values{
+    m.values[ 0 ], m.values[ 1 ], 0, 0,
+    m.values[ 2 ], m.values[ 3 ], 0, 0,
+    0, 0, 1, 0,
+    0, 0, 0, 1 } {}
+  constexpr Matrix4( const Matrix3& m ) : values{
+    m.values[ 0 ], m.values[ 1 ], m.values[ 2 ], 0,
+    m.values[ 3 ], m.values[ 4 ], m.values[ 5 ], 0,
+    m.values[ 6 ], m.values[ 7 ], m.values[ 8 ], 0,
+    0, 0, 0, 1 } {}
+  constexpr Matrix4( const Affine2& m ) : values{
+    m.values[ 0 ], m.values[ 1 ], 0, m.values[ 2 ],
+    m.values[ 3 ], m.values[ 4 ], 0, m.values[ 5 ],
+    0, 0, 1, 0,
+    0, 0, 0, 1 } {}
+  constexpr Matrix4(
     float m00, float m01, float m02, float m03,
     float m10, float m11, float m12, float m13,
     float m20, float m21, float m22, float m23,
-    float m30, float m31, float m32, float m33 );
-  static Matrix4 Translate( float x, float y );
-  static Matrix4 Translate( Vector2 pos );
-  static Matrix4 Identity();
-  float* operator[]( int index );
-  Matrix4 operator*( Matrix4 rhs );
+    float m30, float m31, float m32, float m33 ) : values{
+      m00, m01, m02, m03,
+      m10, m11, m12, m13,
+      m20, m21, m22, m23,
+      m30, m31, m32, m33 } {}
+  static constexpr Matrix4 Translate( float x, float y )
+  {
+    return Matrix4(
+      1, 0, 0, x,
+      0, 1, 0, y,
+      0, 0, 1, 0,
+      0, 0, 0, 1 );
+  }
+  static constexpr Matrix4 Translate( Vector2 pos ) { return Translate( pos.x, pos.y ); }
+  static constexpr Matrix4 Identity()
+  {
+    return Matrix4(
+      1, 0, 0, 0,
+      0, 1, 0, 0,
+      0, 0, 1, 0,
+      0, 0, 0, 1 );
+  }
+  float* operator[]( int index ) { return values + index * 4; }
+  constexpr const float* operator[]( int index ) const { return values + index * 4; }
+  // simd, see utility.cpp. MatrixMultiply< Matrix4, 4 > is the plain loop
+  Matrix4 operator*( const Matrix4& rhs ) const;
   float values[ 4 * 4 ];
 };
 
-Vector4 operator*( Matrix4 lhs, Vector4 rhs );
-Vector4 operator*( Vector4 lhs, Matrix4 rhs );
+Vector4 operator*( const Matrix4& lhs, Vector4 rhs );
+Vector4 operator*( Vector4 lhs, const Matrix4& rhs );
 
-template< typename T >
-T Square( T t )
-{
-  return t * t;
-}
+// out[ i ] = transform * vectors[ i ], out may alias vectors
+void TransformVectors( Matrix4 transform, const Vector4* vectors, Vector4* out, int count );
+// out[ i ] = lhs[ i ] * rhs[ i ], out may alias either
+void ComposeMatrices( const Matrix4* lhs, const Matrix4* rhs, Matrix4* out, int count );
 
 // December 12, 2016
 // The most beautiful struct I've ever written
@@ -183,5 +404,7 @@ struct TemporaryMemory
   unsigned mByteCount;
 };
 
+// Formats into a buffer that the next va() on the same thread overwrites.
+// For messages that go out right away, logging should use LOG() instead
 const char* va( const char* format, ... );
 const char* boolToString( bool b );
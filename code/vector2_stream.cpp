@@ -0,0 +1,184 @@
+#include "vector2_stream.h"
+#include "lanes.h"
+#include <cstring>
+
+static const int streamPadding = 8;
+static const int streamAlignment = 32;
+
+static int GetPaddedCount( int count )
+{
+  return ( count + streamPadding - 1 ) / streamPadding * streamPadding;
+}
+
+Vector2Stream::Vector2Stream()
+{
+  x = nullptr;
+  y = nullptr;
+  count = 0;
+  capacity = 0;
+}
+
+Vector2Stream::~Vector2Stream()
+{
+  _mm_free( x );
+  _mm_free( y );
+}
+
+void Vector2Stream::Resize( int newCount )
+{
+  Assert( newCount >= 0 );
+  int paddedCount = GetPaddedCount( newCount );
+  if( paddedCount > capacity )
+  {
+    int newCapacity = capacity * 2 > paddedCount ? capacity * 2 : paddedCount;
+    float* newX = ( float* )_mm_malloc( newCapacity * sizeof( float ), streamAlignment );
+    float* newY = ( float* )_mm_malloc( newCapacity * sizeof( float ), streamAlignment );
+    if( !newX || !newY )
+      HandleErrorGracefully( "Out of memory for a Vector2Stream" );
+    std::memset( newX, 0, newCapacity * sizeof( float ) );
+    std::memset( newY, 0, newCapacity * sizeof( float ) );
+    if( count )
+    {
+      std::memcpy( newX, x, count * sizeof( float ) );
+      std::memcpy( newY, y, count * sizeof( float ) );
+    }
+    _mm_free( x );
+    _mm_free( y );
+    x = newX;
+    y = newY;
+    capacity = newCapacity;
+  }
+  if( newCount < count )
+  {
+    // Put the padding back to zero
+    std::memset( x + newCount, 0, ( count - newCount ) * sizeof( float ) );
+    std::memset( y + newCount, 0, ( count - newCount ) * sizeof( float ) );
+  }
+  count = newCount;
+}
+
+void Vector2Stream::Push( Vector2 v )
+{
+  Resize( count + 1 );
+  Set( count - 1, v );
+}
+
+Vector2 Vector2Stream::Get( int index ) const
+{
+  return Vector2( x[ index ], y[ index ] );
+}
+
+void Vector2Stream::Set( int index, Vector2 v )
+{
+  x[ index ] = v.x;
+  y[ index ] = v.y;
+}
+
+void StreamAdd( Vector2Stream* dst, const Vector2Stream& src )
+{
+  Assert( dst->count == src.count );
+  int paddedCount = GetPaddedCount( dst->count );
+  for( int i = 0; i < paddedCount; i += laneCount )
+  {
+    LanesStore( dst->x + i, LanesAdd( LanesLoad( dst->x + i ), LanesLoad( src.x + i ) ) );
+    LanesStore( dst->y + i, LanesAdd( LanesLoad( dst->y + i ), LanesLoad( src.y + i ) ) );
+  }
+}
+
+void StreamAddScaled( Vector2Stream* dst, const Vector2Stream& src, float scale )
+{
+  Assert( dst->count == src.count );
+  Lanes s = LanesSet( scale );
+  int paddedCount = GetPaddedCount( dst->count );
+  for( int i = 0; i < paddedCount; i += laneCount )
+  {
+    LanesStore( dst->x + i, LanesAdd( LanesLoad( dst->x + i ), LanesMul( LanesLoad( src.x + i ), s ) ) );
+    LanesStore( dst->y + i, LanesAdd( LanesLoad( dst->y + i ), LanesMul( LanesLoad( src.y + i ), s ) ) );
+  }
+}
+
+void StreamScale( Vector2Stream* dst, float scale )
+{
+  Lanes s = LanesSet( scale );
+  int paddedCount = GetPaddedCount( dst->count );
+  for( int i = 0; i < paddedCount; i += laneCount )
+  {
+    LanesStore( dst->x + i, LanesMul( LanesLoad( dst->x + i ), s ) );
+    LanesStore( dst->y + i, LanesMul( LanesLoad( dst->y + i ), s ) );
+  }
+}
+
+void StreamLength( const Vector2Stream& src, float* lengths )
+{
+  // lengths isn't padded, so the last partial group goes through a local
+  int fullCount = src.count / laneCount * laneCount;
+  int i = 0;
+  for( ; i < fullCount; i += laneCount )
+  {
+    Lanes x = LanesLoad( src.x + i );
+    Lanes y = LanesLoad( src.y + i );
+    Lanes length = LanesSqrt( LanesAdd( LanesMul( x, x ), LanesMul( y, y ) ) );
+    LanesStoreUnaligned( lengths + i, length );
+  }
+  if( i < src.count )
+  {
+    alignas( 32 ) float tail[ laneCount ];
+    Lanes x = LanesLoad( src.x + i );
+    Lanes y = LanesLoad( src.y + i );
+    LanesStore( tail, LanesSqrt( LanesAdd( LanesMul( x, x ), LanesMul( y, y ) ) ) );
+    std::memcpy( lengths + i, tail, ( src.count - i ) * sizeof( float ) );
+  }
+}
+
+void StreamNormalize( Vector2Stream* dst )
+{
+  Lanes zero = LanesSet( 0 );
+  int paddedCount = GetPaddedCount( dst->count );
+  for( int i = 0; i < paddedCount; i += laneCount )
+  {
+    Lanes x = LanesLoad( dst->x + i );
+    Lanes y = LanesLoad( dst->y + i );
+    Lanes length = LanesSqrt( LanesAdd( LanesMul( x, x ), LanesMul( y, y ) ) );
+    Lanes isNonZero = LanesGreater( length, zero );
+    LanesStore( dst->x + i, LanesSelect( isNonZero, LanesDiv( x, length ), zero ) );
+    LanesStore( dst->y + i, LanesSelect( isNonZero, LanesDiv( y, length ), zero ) );
+  }
+}
+
+void StreamIntegrate(
+  Vector2Stream* positions,
+  Vector2Stream* velocities,
+  const Vector2Stream* accelerations,
+  float dt,
+  float damping,
+  float maxSpeed )
+{
+  Assert( positions->count == velocities->count );
+  Assert( !accelerations || accelerations->count == velocities->count );
+  Lanes lanesDt = LanesSet( dt );
+  Lanes lanesDamping = LanesSet( damping );
+  Lanes lanesMaxSpeed = LanesSet( maxSpeed );
+  Lanes one = LanesSet( 1 );
+  Lanes tiny = LanesSet( 1e-30f );
+  int paddedCount = GetPaddedCount( positions->count );
+  for( int i = 0; i < paddedCount; i += laneCount )
+  {
+    Lanes vx = LanesLoad( velocities->x + i );
+    Lanes vy = LanesLoad( velocities->y + i );
+    if( accelerations )
+    {
+      vx = LanesAdd( vx, LanesMul( LanesLoad( accelerations->x + i ), lanesDt ) );
+      vy = LanesAdd( vy, LanesMul( LanesLoad( accelerations->y + i ), lanesDt ) );
+    }
+    LanesStore( positions->x + i, LanesAdd( LanesLoad( positions->x + i ), LanesMul( vx, lanesDt ) ) );
+    LanesStore( positions->y + i, LanesAdd( LanesLoad( positions->y + i ), LanesMul( vy, lanesDt ) ) );
+    vx = LanesMul( vx, lanesDamping );
+    vy = LanesMul( vy, lanesDamping );
+
+    // min( 1, maxSpeed / speed ), where tiny keeps a zero speed from dividing by zero
+    Lanes speed = LanesSqrt( LanesAdd( LanesMul( vx, vx ), LanesMul( vy, vy ) ) );
+    Lanes scale = LanesMin( one, LanesDiv( lanesMaxSpeed, LanesMax( speed, tiny ) ) );
+    LanesStore( velocities->x + i, LanesMul( vx, scale ) );
+    LanesStore( velocities->y + i, LanesMul( vy, scale ) );
+  }
+}
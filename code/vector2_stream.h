@@ -0,0 +1,55 @@
+#pragma once
+#include "utility.h"
+
+// Structure of arrays Vector2s, for updating lots of bodies at once.
+//
+// x and y are separate 32 byte aligned arrays, padded with zeros up to a
+// multiple of 8 so the loops in vector2_stream.cpp never need a scalar tail.
+// Only touch x[ 0, count ) and y[ 0, count ), the padding has to stay zero
+struct Vector2Stream
+{
+  Vector2Stream();
+  ~Vector2Stream();
+  Vector2Stream( const Vector2Stream& ) = delete;
+  Vector2Stream& operator = ( const Vector2Stream& ) = delete;
+
+  // Keeps the first min( count, newCount ) elements, new ones are zero
+  void Resize( int newCount );
+  void Push( Vector2 v );
+  Vector2 Get( int index ) const;
+  void Set( int index, Vector2 v );
+
+  float* x;
+  float* y;
+  int count;
+  int capacity;
+};
+
+// dst += src
+void StreamAdd( Vector2Stream* dst, const Vector2Stream& src );
+
+// dst += src * scale
+void StreamAddScaled( Vector2Stream* dst, const Vector2Stream& src, float scale );
+
+// dst *= scale
+void StreamScale( Vector2Stream* dst, float scale );
+
+// lengths needs room for src.count floats
+void StreamLength( const Vector2Stream& src, float* lengths );
+
+// Zero length vectors stay zero
+void StreamNormalize( Vector2Stream* dst );
+
+// Semi-implicit euler:
+//   velocity += acceleration * dt
+//   position += velocity * dt
+//   velocity *= damping
+// then velocities longer than maxSpeed get clamped to it.
+// acceleration may be null for none
+void StreamIntegrate(
+  Vector2Stream* positions,
+  Vector2Stream* velocities,
+  const Vector2Stream* accelerations,
+  float dt,
+  float damping,
+  float maxSpeed );
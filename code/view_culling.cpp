@@ -0,0 +1,27 @@
+#include "view_culling.h"
+
+Aabb GetViewBounds( const Affine2& view )
+{
+  Affine2 inverse = view.Inverse();
+  Vector2 corners[ 4 ] = {
+    inverse.TransformPoint( Vector2( -1, -1 ) ),
+    inverse.TransformPoint( Vector2( 1, -1 ) ),
+    inverse.TransformPoint( Vector2( 1, 1 ) ),
+    inverse.TransformPoint( Vector2( -1, 1 ) ) };
+  Aabb result = { corners[ 0 ], corners[ 0 ] };
+  for( int i = 1; i < 4; ++i )
+    result = AabbUnion( result, Aabb{ corners[ i ], corners[ i ] } );
+  return result;
+}
+
+void CullSprites(
+  const AabbTree& tree,
+  const Aabb& viewBounds,
+  std::vector< AabbHandle >* visible,
+  CullStats* stats )
+{
+  tree.QueryAabb( viewBounds, visible );
+  int visibleCount = ( int )visible->size();
+  stats->submitted += visibleCount;
+  stats->culled += tree.GetLeafCount() - visibleCount;
+}
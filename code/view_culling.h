@@ -0,0 +1,22 @@
+#pragma once
+#include "aabb_tree.h"
+
+// World space box around everything the view can see. view takes world
+// space to ndc, so this is ndc's [ -1, 1 ] square taken back out through
+// the inverse, and it stays right if the camera ever rotates
+Aabb GetViewBounds( const Affine2& view );
+
+// Sprites that made it to the gpu and ones that got skipped, per frame
+struct CullStats
+{
+  int submitted = 0;
+  int culled = 0;
+};
+
+// The leaves of tree that overlap viewBounds go in visible, and get counted
+// as submitted. All the rest get counted as culled, without being visited
+void CullSprites(
+  const AabbTree& tree,
+  const Aabb& viewBounds,
+  std::vector< AabbHandle >* visible,
+  CullStats* stats );
@@ -1,5 +1,7 @@
 ﻿#include "game.h"
 #include "windows_platform.h"
+#include "profiler.h"
+#include "logger.h"
 #include <chrono>
 
 //typedef std::chrono::time_point<std::chrono::high_resolution_clock> TimePoint;
@@ -36,6 +38,12 @@ LRESULT CALLBACK MyWindowProc(
       input->keysDownCurr.clear();
     } break;
     break;
+    case WM_MOUSEMOVE:
+    {
+      // LOWORD and HIWORD are unsigned, but the coordinates aren't
+      input->mouseX = ( float )( short )LOWORD( lParam );
+      input->mouseY = ( float )( short )HIWORD( lParam );
+    } break;
     case WM_KEYDOWN:
     case WM_KEYUP:
     {
@@ -52,6 +60,8 @@ LRESULT CALLBACK MyWindowProc(
       keyMap[ 'E' ] = TacKey::Interact;
       keyMap[ VK_F1 ] = TacKey::Debug;
       keyMap[ VK_ESCAPE ] = TacKey::Menu;
+      keyMap[ 'R' ] = TacKey::Rewind;
+      keyMap[ VK_F2 ] = TacKey::Overlay;
 
       bool isKeyDown = ( lParam & ( 1 << 31 ) ) == 0;
       Assert( ( msg == WM_KEYDOWN && isKeyDown )
@@ -67,9 +77,9 @@ LRESULT CALLBACK MyWindowProc(
       else
         input->keysDownCurr.erase( key );
 
-      OutputDebugString( va( "%c %s\n",
+      LOG( Info, Input, "%c %s",
         ( char )wParam,
-        isKeyDown ? "pressed" : "released" ) );
+        isKeyDown ? "pressed" : "released" );
 
       VK_LBUTTON; // left mouse
       VK_RBUTTON; // right mouse
@@ -147,6 +157,8 @@ int CALLBACK WinMain(
     HandleErrorGracefully();
   }
 
+  ProfilerSetThreadName( "Main" );
+  LoggerStart( LogToPlatform, nullptr );
   input = new Input( ( float )clientwidth, ( float )clientheight );
   Graphics* graphics = new Graphics( windowHandle, clientwidth, clientheight );
   Game* game = new Game( graphics, input );
@@ -167,11 +179,19 @@ int CALLBACK WinMain(
       continue;
     input->mElapsedSeconds += input->dt;
     mLastTime = currTime;
-    game->Update();
+    {
+      PROFILE_SCOPE( "Frame" );
+      game->Update();
+    }
     input->keysDownPrev = input->keysDownCurr;
   }
   delete input;
   delete game;
   delete graphics;
+  LoggerStop();
+#if ENABLE_PROFILER
+  // Load it in chrome://tracing or ui.perfetto.dev
+  ProfilerWriteTrace( "profile.json" );
+#endif
   return 0;
 }
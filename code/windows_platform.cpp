@@ -1,6 +1,79 @@
 #include "windows_platform.h"
+#include <psapi.h>
 
 void PlatformMessageBox( const char* msg )
 {
   MessageBox( nullptr, msg, nullptr, MB_OK );
 }
+
+void PlatformDebugOutput( const char* text )
+{
+  OutputDebugStringA( text );
+}
+
+void PlatformCreateDirectory( const char* path )
+{
+  CreateDirectoryA( path, nullptr );
+}
+
+bool PlatformReplaceFile( const char* from, const char* to )
+{
+  // Write through, so it doesn't return before the rename is on disk
+  return MoveFileExA( from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != 0;
+}
+
+bool PlatformMapFile( const char* path, PlatformMappedFile* file )
+{
+  HANDLE fileHandle = CreateFileA(
+    path,
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    nullptr );
+  if( fileHandle == INVALID_HANDLE_VALUE )
+    return false;
+  LARGE_INTEGER size;
+  if( !GetFileSizeEx( fileHandle, &size ) || size.QuadPart == 0 )
+  {
+    CloseHandle( fileHandle );
+    return false;
+  }
+
+  // The mapping keeps the file open
+  HANDLE mapping = CreateFileMappingA( fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+  CloseHandle( fileHandle );
+  if( !mapping )
+    return false;
+  const void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+  if( !view )
+  {
+    CloseHandle( mapping );
+    return false;
+  }
+  file->bytes = view;
+  file->byteCount = ( size_t )size.QuadPart;
+  file->handle = mapping;
+  return true;
+}
+
+void PlatformUnmapFile( PlatformMappedFile* file )
+{
+  if( file->bytes )
+  {
+    UnmapViewOfFile( file->bytes );
+    CloseHandle( ( HANDLE )file->handle );
+  }
+  *file = PlatformMappedFile();
+}
+
+size_t PlatformGetResidentByteCount()
+{
+  // Since windows 7 this is K32GetProcessMemoryInfo in kernel32, so there's
+  // no psapi.lib to link
+  PROCESS_MEMORY_COUNTERS counters = {};
+  if( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+    return 0;
+  return counters.WorkingSetSize;
+}
@@ -0,0 +1,56 @@
+#pragma pack_matrix( row_major )
+
+// IMPORTANT:
+//   Shares the quad and the cbuffers with sprite.fx, the rest comes per
+//   instance from OverlayQuad in perf_overlay.h
+//
+// The cbuffers ( view, time, world, color, uvMin, uvMax ) aren't declared
+// here, Graphics::LoadShader prepends them from constant_buffers.h. world
+// takes pixels to ndc, view isn't used
+
+Texture2D txDiffuse : register( t0 );
+SamplerState LinSampler : register( s0 );
+
+struct VS_INPUT
+{
+    float4 Pos : POSITION;
+    float2 Tex : TEXCOORD0;
+
+    // xy is the top left in pixels, zw the bottom right
+    float4 Rect : OVERLAY_RECT;
+    // xy is the top left in the font, zw the bottom right. Negative for a
+    // solid rectangle
+    float4 Uv : OVERLAY_UV;
+    float4 Color : OVERLAY_COLOR;
+};
+
+struct PS_INPUT
+{
+    float4 Pos : SV_POSITION;
+    float2 Tex : TEXCOORD0;
+    float4 Color : COLOR0;
+    float Solid : TEXCOORD1;
+};
+
+
+PS_INPUT vsmain( VS_INPUT input )
+{
+  // The quad's texcoords go left to right and top to bottom, like pixels
+  float2 pixelPos = lerp( input.Rect.xy, input.Rect.zw, input.Tex );
+  float4 Pos = mul( world, float4( pixelPos, 0, 1 ) );
+
+  PS_INPUT output;
+  output.Pos = Pos;
+  output.Tex = lerp( input.Uv.xy, input.Uv.zw, input.Tex );
+  output.Color = input.Color * color;
+  output.Solid = input.Uv.x < 0 ? 1 : 0;
+  return output;
+}
+
+float4 psmain( PS_INPUT input) : SV_Target
+{
+  float4 result = input.Color;
+  float coverage = txDiffuse.Sample( LinSampler, input.Tex ).r;
+  result.a *= max( coverage, input.Solid );
+  return result;
+}
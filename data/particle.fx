@@ -0,0 +1,46 @@
+#pragma pack_matrix( row_major )
+
+// IMPORTANT:
+//   Shares the quad and the cbuffers with sprite.fx, the rest comes per
+//   instance from ParticleInstance in particles.h
+//
+// The cbuffers ( view, time, world, color, uvMin, uvMax ) aren't declared
+// here, Graphics::LoadShader prepends them from constant_buffers.h
+
+Texture2D txDiffuse : register( t0 );
+SamplerState LinSampler : register( s0 );
+
+struct VS_INPUT
+{
+    float4 Pos : POSITION;
+    float2 Tex : TEXCOORD0;
+
+    // xy is the world position, z is the half size
+    float3 Particle : PARTICLE_POSITION;
+    float4 Color : PARTICLE_COLOR;
+};
+
+struct PS_INPUT
+{
+    float4 Pos : SV_POSITION;
+    float2 Tex : TEXCOORD0;
+    float4 Color : COLOR0;
+};
+
+
+PS_INPUT vsmain( VS_INPUT input )
+{
+  float2 worldPos = input.Pos.xy * input.Particle.z + input.Particle.xy;
+  float4 Pos = mul( view, float4( worldPos, 0, 1 ) );
+
+  PS_INPUT output;
+  output.Pos = Pos;
+  output.Tex = lerp( uvMin, uvMax, input.Tex );
+  output.Color = input.Color * color;
+  return output;
+}
+
+float4 psmain( PS_INPUT input) : SV_Target
+{
+  return txDiffuse.Sample( LinSampler, input.Tex ) * input.Color;
+}
@@ -2,19 +2,13 @@
 
 // IMPORTANT:
 //   A lot of this shit has to match text.fx
+//
+// The cbuffers ( view, time, world, color, uvMin, uvMax ) aren't declared
+// here, Graphics::LoadShader prepends them from constant_buffers.h
 
 Texture2D txDiffuse : register( t0 );
 SamplerState LinSampler : register( s0 );
 
-cbuffer DataConstantBuffer : register( b0 )
-{
-  matrix world;
-  matrix view;
-  float4 color;
-  float2 uvMin;
-  float2 uvMax;
-}
-
 struct VS_INPUT
 {
     float4 Pos : POSITION;